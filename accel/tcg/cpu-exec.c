@@ -390,15 +390,38 @@ static inline bool check_for_breakpoints(CPUState *cpu, vaddr pc,
         check_for_breakpoints_slow(cpu, pc, cflags);
 }
 
-/**
- * helper_lookup_tb_ptr: quick check for next tb
- * @env: current cpu state
- *
- * Look for an existing TB matching the current cpu state.
- * If found, return the code pointer.  If not found, return
- * the tcg epilogue so that we return into cpu_tb_exec.
+/*
+ * Look up the TB for a return that the shadow return stack did not
+ * predict, or whose TB it did not remember yet.  If the prediction was
+ * right, remember the TB for the generated code of the next returns
+ * from TBs with @ret_flags and @ret_cs_base.
  */
-const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+static inline TranslationBlock *ras_lookup(CPUState *cpu, vaddr pc,
+                                           uint64_t cs_base, uint32_t flags,
+                                           uint32_t cflags, uint32_t ret_flags,
+                                           uint64_t ret_cs_base)
+{
+    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    CPUReturnStack *ras = &cpu->neg.ras;
+    /* The slot has been popped already. */
+    unsigned i = (ras->top + 1) % TB_RAS_SIZE;
+    TranslationBlock *tb;
+
+    qatomic_set(&jc->ras_miss_count, jc->ras_miss_count + 1);
+
+    tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
+    if (tb && ras->slot[i].pc == pc) {
+        ras->slot[i].flags = ret_flags;
+        ras->slot[i].cs_base = ret_cs_base;
+        ras->slot[i].code = tb->tc.ptr;
+        qatomic_set(&ras->slot[i].valid, 1);
+    }
+    return tb;
+}
+
+static inline const void *lookup_tb_ptr(CPUArchState *env, bool ret,
+                                        uint32_t ret_flags,
+                                        uint64_t ret_cs_base)
 {
     CPUState *cpu = env_cpu(env);
     TranslationBlock *tb;
@@ -421,7 +444,12 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
         cpu_loop_exit(cpu);
     }
 
-    tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
+    if (ret) {
+        tb = ras_lookup(cpu, pc, cs_base, flags, cflags,
+                        ret_flags, ret_cs_base);
+    } else {
+        tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
+    }
     if (tb == NULL) {
         return tcg_code_gen_epilogue;
     }
@@ -433,6 +461,43 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     return tb->tc.ptr;
 }
 
+/**
+ * helper_lookup_tb_ptr: quick check for next tb
+ * @env: current cpu state
+ *
+ * Look for an existing TB matching the current cpu state.
+ * If found, return the code pointer.  If not found, return
+ * the tcg epilogue so that we return into cpu_tb_exec.
+ */
+const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+{
+    return lookup_tb_ptr(env, false, 0, 0);
+}
+
+/**
+ * helper_lookup_tb_ptr_ret: quick check for next tb, after a return
+ * @env: current cpu state
+ * @ret_flags: flags of the TB that returned
+ * @ret_cs_base: cs_base of the TB that returned
+ *
+ * As helper_lookup_tb_ptr, when the shadow return stack could not
+ * provide the TB; see tcg_gen_lookup_return_and_goto_ptr().
+ */
+const void *HELPER(lookup_tb_ptr_ret)(CPUArchState *env, uint32_t ret_flags,
+                                      uint64_t ret_cs_base)
+{
+    return lookup_tb_ptr(env, true, ret_flags, ret_cs_base);
+}
+
+/**
+ * helper_tb_hot: promote a TB to the second translation tier
+ * @tb: the TB, which has just run tcg_tier_threshold times
+ */
+void HELPER(tb_hot)(void *tb)
+{
+    tb_mark_hot(tb);
+}
+
 /* Execute a TB, and fix up the CPU state afterwards if necessary */
 /*
  * Disable CFI checks.
@@ -1004,6 +1069,10 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             }
 
 #ifndef CONFIG_USER_ONLY
+            if (unlikely(qatomic_read(&cpu->tb_profile_pending))) {
+                tb_profile_record(cpu, pc);
+            }
+
             /*
              * We don't take care of direct jumps when address mapping
              * changes in system emulation.  So it's not safe to make a
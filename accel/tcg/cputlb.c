@@ -167,6 +167,11 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
     for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
     }
+    for (i = 0; i < TB_RAS_SIZE; i++) {
+        if ((cpu->neg.ras.slot[i].pc & TARGET_PAGE_MASK) == page_addr) {
+            qatomic_set(&cpu->neg.ras.slot[i].valid, 0);
+        }
+    }
 }
 
 /**
@@ -289,6 +294,10 @@ static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
     desc->n_used_entries = 0;
     desc->large_page_addr = -1;
     desc->large_page_mask = -1;
+    desc->lpindex = 0;
+    for (int i = 0; i < CPU_LPTLB_SIZE; i++) {
+        desc->lptable[i].addr = -1;
+    }
     desc->vindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
     memset(desc->vtable, -1, sizeof(desc->vtable));
@@ -316,6 +325,58 @@ static void tlb_mmu_init(CPUTLBDesc *desc, CPUTLBDescFast *fast, int64_t now)
     tlb_mmu_flush_locked(desc, fast);
 }
 
+/*
+ * Address space tagging.  Rather than teach the fast path about tags,
+ * the entries of up to CPU_TLB_ASID_CACHE_SIZE inactive address spaces
+ * per mmu_idx are set aside whole, and swapped back in on a switch.
+ */
+#define CPU_TLB_ASID_CACHE_SIZE 4
+
+typedef struct CPUTLBAsidEntry {
+    /* d and f hold the entries of address space d.asid */
+    bool valid;
+    CPUTLBDesc d;
+    CPUTLBDescFast f;
+} CPUTLBAsidEntry;
+
+struct CPUTLBAsidCache {
+    /* round-robin replacement */
+    unsigned next;
+    CPUTLBAsidEntry e[CPU_TLB_ASID_CACHE_SIZE];
+};
+
+static void tlb_asid_swap_locked(CPUState *cpu, int mmu_idx,
+                                 CPUTLBAsidEntry *e)
+{
+    CPUTLBDesc d = cpu->neg.tlb.d[mmu_idx];
+    CPUTLBDescFast f = cpu->neg.tlb.f[mmu_idx];
+
+    cpu->neg.tlb.d[mmu_idx] = e->d;
+    cpu->neg.tlb.f[mmu_idx] = e->f;
+    e->d = d;
+    e->f = f;
+}
+
+/* Return the i'th set aside address space of @mmu_idx, if any. */
+static CPUTLBAsidEntry *tlb_asid_entry(CPUState *cpu, int mmu_idx, int i)
+{
+    struct CPUTLBAsidCache *cache = cpu->neg.tlb.c.asid_cache[mmu_idx];
+
+    return cache && cache->e[i].valid ? &cache->e[i] : NULL;
+}
+
+static void tlb_asid_discard_locked(CPUState *cpu, int mmu_idx)
+{
+    struct CPUTLBAsidCache *cache = cpu->neg.tlb.c.asid_cache[mmu_idx];
+
+    cpu->neg.tlb.d[mmu_idx].has_asid = false;
+    if (cache) {
+        for (int i = 0; i < CPU_TLB_ASID_CACHE_SIZE; i++) {
+            cache->e[i].valid = false;
+        }
+    }
+}
+
 static inline void tlb_n_used_entries_inc(CPUState *cpu, uintptr_t mmu_idx)
 {
     cpu->neg.tlb.d[mmu_idx].n_used_entries++;
@@ -349,9 +410,18 @@ void tlb_destroy(CPUState *cpu)
     for (i = 0; i < NB_MMU_MODES; i++) {
         CPUTLBDesc *desc = &cpu->neg.tlb.d[i];
         CPUTLBDescFast *fast = &cpu->neg.tlb.f[i];
+        struct CPUTLBAsidCache *cache = cpu->neg.tlb.c.asid_cache[i];
 
         g_free(fast->table);
         g_free(desc->fulltlb);
+        if (cache) {
+            for (int j = 0; j < CPU_TLB_ASID_CACHE_SIZE; j++) {
+                g_free(cache->e[j].f.table);
+                g_free(cache->e[j].d.fulltlb);
+            }
+            g_free(cache);
+            cpu->neg.tlb.c.asid_cache[i] = NULL;
+        }
     }
 }
 
@@ -396,6 +466,11 @@ static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
         tlb_flush_one_mmuidx_locked(cpu, mmu_idx, now);
     }
 
+    /* Clean or not, the address spaces set aside go as well. */
+    for (work = asked; work != 0; work &= work - 1) {
+        tlb_asid_discard_locked(cpu, ctz32(work));
+    }
+
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
 
     tcg_flush_jmp_cache(cpu);
@@ -443,6 +518,130 @@ void tlb_flush_all_cpus_synced(CPUState *src_cpu)
     tlb_flush_by_mmuidx_all_cpus_synced(src_cpu, ALL_MMUIDX_BITS);
 }
 
+static void tlb_set_asid_locked(CPUState *cpu, int mmu_idx, uint32_t asid,
+                                int64_t now)
+{
+    CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+    struct CPUTLBAsidCache *cache = cpu->neg.tlb.c.asid_cache[mmu_idx];
+    CPUTLBAsidEntry *e = NULL;
+
+    if (desc->has_asid && desc->asid == asid) {
+        return;
+    }
+
+    if (!cache) {
+        cache = g_new0(struct CPUTLBAsidCache, 1);
+        cpu->neg.tlb.c.asid_cache[mmu_idx] = cache;
+    }
+    for (int i = 0; i < CPU_TLB_ASID_CACHE_SIZE; i++) {
+        if (cache->e[i].valid && cache->e[i].d.asid == asid) {
+            e = &cache->e[i];
+            break;
+        }
+    }
+
+    if (e) {
+        tlb_asid_swap_locked(cpu, mmu_idx, e);
+        qatomic_set(&cpu->neg.tlb.c.asid_reuse_count,
+                    cpu->neg.tlb.c.asid_reuse_count + 1);
+    } else {
+        e = &cache->e[cache->next];
+        cache->next = (cache->next + 1) % CPU_TLB_ASID_CACHE_SIZE;
+        if (!e->f.table) {
+            tlb_mmu_init(&e->d, &e->f, now);
+            tlb_asid_swap_locked(cpu, mmu_idx, e);
+        } else {
+            tlb_asid_swap_locked(cpu, mmu_idx, e);
+            tlb_flush_one_mmuidx_locked(cpu, mmu_idx, now);
+        }
+        desc->has_asid = true;
+        desc->asid = asid;
+    }
+
+    /* The previous entries can only be kept if we know whose they are. */
+    e->valid = e->d.has_asid;
+    cpu->neg.tlb.c.dirty |= 1 << mmu_idx;
+}
+
+void tlb_set_asid_by_mmuidx(CPUState *cpu, uint16_t idxmap, uint32_t asid)
+{
+    int64_t now = get_clock_realtime();
+    uint16_t work;
+
+    tlb_debug("mmu_idx: 0x%" PRIx16 " asid: 0x%" PRIx32 "\n", idxmap, asid);
+
+    assert_cpu_is_self(cpu);
+
+    qemu_spin_lock(&cpu->neg.tlb.c.lock);
+    for (work = idxmap; work != 0; work &= work - 1) {
+        tlb_set_asid_locked(cpu, ctz32(work), asid, now);
+    }
+    qemu_spin_unlock(&cpu->neg.tlb.c.lock);
+
+    tcg_flush_jmp_cache(cpu);
+
+    qatomic_set(&cpu->neg.tlb.c.asid_switch_count,
+                cpu->neg.tlb.c.asid_switch_count + 1);
+}
+
+static void tlb_flush_asid_by_mmuidx_async_work(CPUState *cpu,
+                                                run_on_cpu_data data)
+{
+    uint16_t idxmap = data.target_ptr;
+    uint32_t asid = data.target_ptr >> 16;
+    int64_t now = get_clock_realtime();
+    bool flushed = false;
+    uint16_t work;
+
+    assert_cpu_is_self(cpu);
+
+    tlb_debug("mmu_idx: 0x%" PRIx16 " asid: 0x%" PRIx32 "\n", idxmap, asid);
+
+    qemu_spin_lock(&cpu->neg.tlb.c.lock);
+    for (work = idxmap; work != 0; work &= work - 1) {
+        int mmu_idx = ctz32(work);
+        CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+
+        /* Entries of unknown address space may belong to @asid. */
+        if (!desc->has_asid || desc->asid == asid) {
+            tlb_flush_one_mmuidx_locked(cpu, mmu_idx, now);
+            flushed = true;
+        }
+        for (int i = 0; i < CPU_TLB_ASID_CACHE_SIZE; i++) {
+            CPUTLBAsidEntry *e = tlb_asid_entry(cpu, mmu_idx, i);
+
+            if (e && e->d.asid == asid) {
+                e->valid = false;
+            }
+        }
+    }
+    qemu_spin_unlock(&cpu->neg.tlb.c.lock);
+
+    if (flushed) {
+        tcg_flush_jmp_cache(cpu);
+    }
+}
+
+void tlb_flush_asid_by_mmuidx(CPUState *cpu, uint16_t idxmap, uint32_t asid)
+{
+    assert_cpu_is_self(cpu);
+
+    tlb_flush_asid_by_mmuidx_async_work(cpu,
+        RUN_ON_CPU_TARGET_PTR((vaddr)asid << 16 | idxmap));
+}
+
+void tlb_flush_asid_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
+                                              uint16_t idxmap, uint32_t asid)
+{
+    const run_on_cpu_func fn = tlb_flush_asid_by_mmuidx_async_work;
+    run_on_cpu_data d = RUN_ON_CPU_TARGET_PTR((vaddr)asid << 16 | idxmap);
+
+    tlb_debug("mmu_idx: 0x%" PRIx16 " asid: 0x%" PRIx32 "\n", idxmap, asid);
+
+    flush_all_helper(src_cpu, fn, d);
+    async_safe_run_on_cpu(src_cpu, fn, d);
+}
+
 static bool tlb_hit_page_mask_anyprot(CPUTLBEntry *tlb_entry,
                                       vaddr page, vaddr mask)
 {
@@ -507,6 +706,68 @@ static inline void tlb_flush_vtlb_page_locked(CPUState *cpu, int mmu_idx,
     tlb_flush_vtlb_page_mask_locked(cpu, mmu_idx, page, -1);
 }
 
+/* Flush every target page of @lp and drop it.  Called with tlb_c.lock held */
+static void tlb_flush_large_page_locked(CPUState *cpu, int midx,
+                                        CPUTLBLargePage *lp)
+{
+    CPUTLBDescFast *f = &cpu->neg.tlb.f[midx];
+    size_t n_entries = tlb_n_entries(f);
+    vaddr n_pages = (~lp->mask >> TARGET_PAGE_BITS) + 1;
+    /* Keep TLB_INVALID_MASK so that empty entries never match */
+    vaddr mask = lp->mask | TLB_INVALID_MASK;
+
+    tlb_debug("large page flush midx %d (%016" VADDR_PRIx "/%016"
+              VADDR_PRIx ")\n", midx, lp->addr, lp->mask);
+
+    if (n_pages <= n_entries) {
+        for (vaddr i = 0; i < n_pages; i++) {
+            vaddr page = lp->addr + (i << TARGET_PAGE_BITS);
+
+            if (tlb_flush_entry_locked(tlb_entry(cpu, midx, page), page)) {
+                tlb_n_used_entries_dec(cpu, midx);
+            }
+        }
+    } else {
+        /* Cheaper to look at each entry than at each page. */
+        for (size_t i = 0; i < n_entries; i++) {
+            if (tlb_flush_entry_mask_locked(&f->table[i], lp->addr, mask)) {
+                tlb_n_used_entries_dec(cpu, midx);
+            }
+        }
+    }
+    tlb_flush_vtlb_page_mask_locked(cpu, midx, lp->addr, mask);
+    lp->addr = -1;
+
+    qatomic_set(&cpu->neg.tlb.c.large_page_flush_count,
+                cpu->neg.tlb.c.large_page_flush_count + 1);
+}
+
+/*
+ * Flush the large pages in lptable that overlap [@addr, @last] once
+ * both are masked with @mask.  Called with tlb_c.lock held.
+ */
+static void tlb_flush_large_range_locked(CPUState *cpu, int midx,
+                                         vaddr addr, vaddr last, vaddr mask)
+{
+    CPUTLBDesc *d = &cpu->neg.tlb.d[midx];
+
+    addr &= mask;
+    last &= mask;
+    for (int i = 0; i < CPU_LPTLB_SIZE; i++) {
+        CPUTLBLargePage *lp = &d->lptable[i];
+
+        if (lp->addr == (vaddr)-1) {
+            continue;
+        }
+        /* A range wrapping around under @mask may overlap anything */
+        if (addr > last ||
+            ((lp->addr & mask) <= last &&
+             ((lp->addr | ~lp->mask) & mask) >= addr)) {
+            tlb_flush_large_page_locked(cpu, midx, lp);
+        }
+    }
+}
+
 static void tlb_flush_page_locked(CPUState *cpu, int midx, vaddr page)
 {
     vaddr lp_addr = cpu->neg.tlb.d[midx].large_page_addr;
@@ -518,7 +779,11 @@ static void tlb_flush_page_locked(CPUState *cpu, int midx, vaddr page)
                   VADDR_PRIx "/%016" VADDR_PRIx ")\n",
                   midx, lp_addr, lp_mask);
         tlb_flush_one_mmuidx_locked(cpu, midx, get_clock_realtime());
+        qatomic_set(&cpu->neg.tlb.c.large_flush_count,
+                    cpu->neg.tlb.c.large_flush_count + 1);
     } else {
+        tlb_flush_large_range_locked(cpu, midx, page,
+                                     page + TARGET_PAGE_SIZE - 1, -1);
         if (tlb_flush_entry_locked(tlb_entry(cpu, midx, page), page)) {
             tlb_n_used_entries_dec(cpu, midx);
         }
@@ -549,6 +814,15 @@ static void tlb_flush_page_by_mmuidx_async_0(CPUState *cpu,
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
         if ((idxmap >> mmu_idx) & 1) {
             tlb_flush_page_locked(cpu, mmu_idx, addr);
+            for (int i = 0; i < CPU_TLB_ASID_CACHE_SIZE; i++) {
+                CPUTLBAsidEntry *e = tlb_asid_entry(cpu, mmu_idx, i);
+
+                if (e) {
+                    tlb_asid_swap_locked(cpu, mmu_idx, e);
+                    tlb_flush_page_locked(cpu, mmu_idx, addr);
+                    tlb_asid_swap_locked(cpu, mmu_idx, e);
+                }
+            }
         }
     }
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
@@ -691,6 +965,8 @@ static void tlb_flush_range_locked(CPUState *cpu, int midx,
                   "%016" VADDR_PRIx "/%016" VADDR_PRIx "+%016" VADDR_PRIx ")\n",
                   midx, addr, mask, len);
         tlb_flush_one_mmuidx_locked(cpu, midx, get_clock_realtime());
+        qatomic_set(&cpu->neg.tlb.c.range_flush_count,
+                    cpu->neg.tlb.c.range_flush_count + 1);
         return;
     }
 
@@ -704,9 +980,13 @@ static void tlb_flush_range_locked(CPUState *cpu, int midx,
                   "%016" VADDR_PRIx "/%016" VADDR_PRIx ")\n",
                   midx, d->large_page_addr, d->large_page_mask);
         tlb_flush_one_mmuidx_locked(cpu, midx, get_clock_realtime());
+        qatomic_set(&cpu->neg.tlb.c.large_flush_count,
+                    cpu->neg.tlb.c.large_flush_count + 1);
         return;
     }
 
+    tlb_flush_large_range_locked(cpu, midx, addr, addr + len - 1, mask);
+
     for (vaddr i = 0; i < len; i += TARGET_PAGE_SIZE) {
         vaddr page = addr + i;
         CPUTLBEntry *entry = tlb_entry(cpu, midx, page);
@@ -739,6 +1019,16 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
         if ((d.idxmap >> mmu_idx) & 1) {
             tlb_flush_range_locked(cpu, mmu_idx, d.addr, d.len, d.bits);
+            for (int i = 0; i < CPU_TLB_ASID_CACHE_SIZE; i++) {
+                CPUTLBAsidEntry *e = tlb_asid_entry(cpu, mmu_idx, i);
+
+                if (e) {
+                    tlb_asid_swap_locked(cpu, mmu_idx, e);
+                    tlb_flush_range_locked(cpu, mmu_idx, d.addr, d.len,
+                                           d.bits);
+                    tlb_asid_swap_locked(cpu, mmu_idx, e);
+                }
+            }
         }
     }
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
@@ -949,6 +1239,21 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
             tlb_reset_dirty_range_locked(&cpu->neg.tlb.d[mmu_idx].vtable[i],
                                          start1, length);
         }
+
+        for (int j = 0; j < CPU_TLB_ASID_CACHE_SIZE; j++) {
+            CPUTLBAsidEntry *e = tlb_asid_entry(cpu, mmu_idx, j);
+
+            if (!e) {
+                continue;
+            }
+            n = tlb_n_entries(&e->f);
+            for (i = 0; i < n; i++) {
+                tlb_reset_dirty_range_locked(&e->f.table[i], start1, length);
+            }
+            for (i = 0; i < CPU_VTLB_SIZE; i++) {
+                tlb_reset_dirty_range_locked(&e->d.vtable[i], start1, length);
+            }
+        }
     }
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
 }
@@ -987,8 +1292,8 @@ static void tlb_set_dirty(CPUState *cpu, vaddr addr)
 
 /* Our TLB does not support large pages, so remember the area covered by
    large pages and trigger a full TLB flush if these are invalidated.  */
-static void tlb_add_large_page(CPUState *cpu, int mmu_idx,
-                               vaddr addr, uint64_t size)
+static void tlb_add_large_region(CPUState *cpu, int mmu_idx,
+                                 vaddr addr, uint64_t size)
 {
     vaddr lp_addr = cpu->neg.tlb.d[mmu_idx].large_page_addr;
     vaddr lp_mask = ~(size - 1);
@@ -1009,6 +1314,39 @@ static void tlb_add_large_page(CPUState *cpu, int mmu_idx,
     cpu->neg.tlb.d[mmu_idx].large_page_mask = lp_mask;
 }
 
+/*
+ * Remember the large page containing @addr in lptable, so that it can be
+ * flushed precisely and refilled by tlb_fill_large_page().  The entry it
+ * replaces, if any, falls back to the coarse large page region.
+ */
+static void tlb_add_large_page(CPUState *cpu, int mmu_idx, vaddr addr,
+                               uint64_t size, const CPUTLBEntryFull *full)
+{
+    CPUTLBDesc *d = &cpu->neg.tlb.d[mmu_idx];
+    vaddr lp_mask = ~(vaddr)(size - 1);
+    vaddr lp_addr = addr & lp_mask;
+    CPUTLBLargePage *lp = NULL;
+
+    for (int i = 0; i < CPU_LPTLB_SIZE; i++) {
+        if (d->lptable[i].addr == lp_addr && d->lptable[i].mask == lp_mask) {
+            lp = &d->lptable[i];
+            break;
+        }
+    }
+    if (!lp) {
+        lp = &d->lptable[d->lpindex++ % CPU_LPTLB_SIZE];
+        if (lp->addr != (vaddr)-1) {
+            tlb_add_large_region(cpu, mmu_idx, lp->addr, ~lp->mask + 1);
+        }
+    }
+
+    lp->addr = lp_addr;
+    lp->mask = lp_mask;
+    lp->full = *full;
+    lp->full.phys_addr = (full->phys_addr & TARGET_PAGE_MASK) -
+                         ((addr & TARGET_PAGE_MASK) - lp_addr);
+}
+
 static inline void tlb_set_compare(CPUTLBEntryFull *full, CPUTLBEntry *ent,
                                    vaddr address, int flags,
                                    MMUAccessType access_type, bool enable)
@@ -1055,7 +1393,7 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
         sz = TARGET_PAGE_SIZE;
     } else {
         sz = (hwaddr)1 << full->lg_page_size;
-        tlb_add_large_page(cpu, mmu_idx, addr, sz);
+        tlb_add_large_page(cpu, mmu_idx, addr, sz, full);
     }
     addr_page = addr & TARGET_PAGE_MASK;
     paddr_page = full->phys_addr & TARGET_PAGE_MASK;
@@ -1220,6 +1558,39 @@ void tlb_set_page(CPUState *cpu, vaddr addr,
                             prot, mmu_idx, size);
 }
 
+/*
+ * Install the tlb entry for @addr from lptable, if @addr lies within
+ * a known large page that permits @access_type.  The target page table
+ * walk is skipped: the large page translation and protection hold for
+ * all of its target pages until it is flushed.
+ */
+static bool tlb_fill_large_page(CPUState *cpu, vaddr addr,
+                                MMUAccessType access_type, int mmu_idx)
+{
+    static const uint8_t access_prot[] = {
+        [MMU_DATA_LOAD] = PAGE_READ,
+        [MMU_DATA_STORE] = PAGE_WRITE,
+        [MMU_INST_FETCH] = PAGE_EXEC,
+    };
+    CPUTLBDesc *d = &cpu->neg.tlb.d[mmu_idx];
+
+    for (int i = 0; i < CPU_LPTLB_SIZE; i++) {
+        CPUTLBLargePage *lp = &d->lptable[i];
+
+        if (lp->addr != (vaddr)-1 && (addr & lp->mask) == lp->addr &&
+            (lp->full.prot & access_prot[access_type])) {
+            CPUTLBEntryFull full = lp->full;
+
+            full.phys_addr += (addr & TARGET_PAGE_MASK) - lp->addr;
+            tlb_set_page_full(cpu, mmu_idx, addr, &full);
+            qatomic_set(&cpu->neg.tlb.c.large_page_fill_count,
+                        cpu->neg.tlb.c.large_page_fill_count + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
  * Note: tlb_fill_align() can trigger a resize of the TLB.
  * This means that all of the caller's prior references to the TLB table
@@ -1244,6 +1615,13 @@ static bool tlb_fill_align(CPUState *cpu, vaddr addr, MMUAccessType type,
         if (addr & ((1u << memop_alignment_bits(memop)) - 1)) {
             ops->do_unaligned_access(cpu, addr, type, mmu_idx, ra);
         }
+        /*
+         * Only here, since tlb_fill_align may check alignment against
+         * the attributes of the page, which requires the walk.
+         */
+        if (tlb_fill_large_page(cpu, addr, type, mmu_idx)) {
+            return true;
+        }
         if (ops->tlb_fill(cpu, addr, size, type, mmu_idx, probe, ra)) {
             return true;
         }
@@ -16,6 +16,10 @@ extern int64_t max_delay;
 extern int64_t max_advance;
 
 extern bool one_insn_per_tb;
+extern uint32_t tcg_tier_threshold;
+
+void tb_mark_hot(TranslationBlock *tb);
+bool tb_is_hot(const TranslationBlock *tb);
 
 /*
  * Return true if CS is not running in parallel with other cpus, either
@@ -49,6 +53,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu, vaddr pc,
 void page_init(void);
 void tb_htable_init(void);
 void tb_reset_jump(TranslationBlock *tb, int n);
+void tb_evict(CPUState *cpu);
 TranslationBlock *tb_link_page(TranslationBlock *tb);
 void cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
                                uintptr_t host_pc);
@@ -56,4 +61,6 @@ void cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
 bool tcg_exec_realizefn(CPUState *cpu, Error **errp);
 void tcg_exec_unrealizefn(CPUState *cpu);
 
+void tb_profile_record(CPUState *cpu, vaddr pc);
+
 #endif
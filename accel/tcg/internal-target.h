@@ -71,6 +71,13 @@ G_NORETURN void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 
 bool tb_invalidate_phys_page_unwind(tb_page_addr_t addr, uintptr_t pc);
 
+#ifdef CONFIG_USER_ONLY
+/* Persistent TB cache, see user/tb-cache.h */
+int tb_cache_load(TranslationBlock *tb, vaddr pc, void *gen_code_buf);
+void tb_cache_record(TranslationBlock *tb, vaddr pc,
+                     const void *gen_code_buf, int search_size);
+#endif
+
 /* Return the current PC from CPU, which may be cached in TB. */
 static inline vaddr log_pc(CPUState *cpu, const TranslationBlock *tb)
 {
@@ -19,6 +19,7 @@
 #include "tcg/tcg.h"
 #include "internal-common.h"
 #include "tb-context.h"
+#include "tb-jmp-cache.h"
 
 
 static void dump_drift_info(GString *buf)
@@ -126,19 +127,51 @@ static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
     return false;
 }
 
-static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
+typedef struct TLBFlushStats {
+    size_t full;
+    size_t part;
+    size_t elide;
+    size_t large;
+    size_t range;
+    size_t large_page;
+    size_t large_page_fill;
+    size_t asid_switch;
+    size_t asid_reuse;
+} TLBFlushStats;
+
+static void tlb_flush_counts(TLBFlushStats *st)
 {
     CPUState *cpu;
-    size_t full = 0, part = 0, elide = 0;
 
+    memset(st, 0, sizeof(*st));
     CPU_FOREACH(cpu) {
-        full += qatomic_read(&cpu->neg.tlb.c.full_flush_count);
-        part += qatomic_read(&cpu->neg.tlb.c.part_flush_count);
-        elide += qatomic_read(&cpu->neg.tlb.c.elide_flush_count);
+        CPUTLBCommon *c = &cpu->neg.tlb.c;
+
+        st->full += qatomic_read(&c->full_flush_count);
+        st->part += qatomic_read(&c->part_flush_count);
+        st->elide += qatomic_read(&c->elide_flush_count);
+        st->large += qatomic_read(&c->large_flush_count);
+        st->range += qatomic_read(&c->range_flush_count);
+        st->large_page += qatomic_read(&c->large_page_flush_count);
+        st->large_page_fill += qatomic_read(&c->large_page_fill_count);
+        st->asid_switch += qatomic_read(&c->asid_switch_count);
+        st->asid_reuse += qatomic_read(&c->asid_reuse_count);
     }
-    *pfull = full;
-    *ppart = part;
-    *pelide = elide;
+}
+
+static size_t ras_miss_count(void)
+{
+    CPUState *cpu;
+    size_t miss = 0;
+
+    CPU_FOREACH(cpu) {
+        CPUJumpCache *jc = cpu->tb_jmp_cache;
+
+        if (jc) {
+            miss += qatomic_read(&jc->ras_miss_count);
+        }
+    }
+    return miss;
 }
 
 static void tcg_dump_info(GString *buf)
@@ -150,7 +183,8 @@ static void dump_exec_info(GString *buf)
 {
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
-    size_t nb_tbs, flush_full, flush_part, flush_elide;
+    TLBFlushStats tlb;
+    size_t nb_tbs;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -189,13 +223,33 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "\nStatistics:\n");
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB evict count      %u\n",
+                           qatomic_read(&tb_ctx.tb_evict_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
-
-    tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
-    g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
-    g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
-    g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    g_string_append_printf(buf, "TB superblocks      %u\n",
+                           qatomic_read(&tb_ctx.tb_hot_count));
+    g_string_append_printf(buf, "code page writes    %u "
+                           "(%u skipped by code bitmap)\n",
+                           qatomic_read(&tb_ctx.smc_write_count),
+                           qatomic_read(&tb_ctx.smc_skip_count));
+
+    g_string_append_printf(buf, "return stack misses %zu\n",
+                           ras_miss_count());
+
+    tlb_flush_counts(&tlb);
+    g_string_append_printf(buf, "TLB full flushes    %zu\n", tlb.full);
+    g_string_append_printf(buf, "TLB partial flushes %zu\n", tlb.part);
+    g_string_append_printf(buf, "TLB elided flushes  %zu\n", tlb.elide);
+    g_string_append_printf(buf, "TLB mmu_idx flushes %zu "
+                           "(large page region=%zu, large range=%zu)\n",
+                           tlb.large + tlb.range, tlb.large, tlb.range);
+    g_string_append_printf(buf, "TLB large pages     %zu flushed, "
+                           "%zu refills\n",
+                           tlb.large_page, tlb.large_page_fill);
+    g_string_append_printf(buf, "TLB ASID switches   %zu "
+                           "(%zu found entries set aside)\n",
+                           tlb.asid_switch, tlb.asid_reuse);
     tcg_dump_info(buf);
 }
 
@@ -212,6 +212,55 @@ static void gen_mem_cb(struct qemu_plugin_regular_cb *cb,
     tcg_temp_free_i32(cpu_index);
 }
 
+/*
+ * Append a record to the batch buffer of the current vCPU, and hand the
+ * buffer to the plugin once it is full:
+ *
+ *   buf->recs[buf->n] = { addr, pc, meminfo };
+ *   if (++buf->n == capacity) {
+ *       plugin_mem_batch_flush_vcpu(cpu_index, batch);
+ *   }
+ */
+static void gen_mem_batch_cb(struct qemu_plugin_batch_cb *cb,
+                             qemu_plugin_meminfo_t meminfo, TCGv_i64 addr)
+{
+    struct qemu_plugin_mem_batch *batch = cb->batch;
+    qemu_plugin_u64 entry = { .score = batch->score, .offset = 0 };
+    size_t recs = offsetof(struct qemu_plugin_mem_batch_buf, recs);
+    TCGv_ptr ptr = gen_plugin_u64_ptr(entry);
+    TCGv_ptr rec = tcg_temp_ebb_new_ptr();
+    TCGv_i64 n = tcg_temp_ebb_new_i64();
+    TCGv_i64 off = tcg_temp_ebb_new_i64();
+    TCGLabel *after_cb = gen_new_label();
+
+    tcg_gen_ld_i64(n, ptr, offsetof(struct qemu_plugin_mem_batch_buf, n));
+    tcg_gen_muli_i64(off, n, sizeof(qemu_plugin_mem_record));
+    tcg_gen_trunc_i64_ptr(rec, off);
+    tcg_gen_add_ptr(rec, rec, ptr);
+
+    tcg_gen_st_i64(addr, rec, recs + offsetof(qemu_plugin_mem_record, vaddr));
+    tcg_gen_st_i64(tcg_constant_i64(cb->pc), rec,
+                   recs + offsetof(qemu_plugin_mem_record, pc));
+    tcg_gen_st_i32(tcg_constant_i32(meminfo), rec,
+                   recs + offsetof(qemu_plugin_mem_record, info));
+
+    tcg_gen_addi_i64(n, n, 1);
+    tcg_gen_st_i64(n, ptr, offsetof(struct qemu_plugin_mem_batch_buf, n));
+    tcg_gen_brcondi_i64(TCG_COND_NE, n, batch->capacity, after_cb);
+
+    TCGv_i32 cpu_index = gen_cpu_index();
+    tcg_gen_call2(plugin_mem_batch_flush_vcpu, cb->info, NULL,
+                  tcgv_i32_temp(cpu_index),
+                  tcgv_ptr_temp(tcg_constant_ptr(batch)));
+    tcg_temp_free_i32(cpu_index);
+    gen_set_label(after_cb);
+
+    tcg_temp_free_i64(off);
+    tcg_temp_free_i64(n);
+    tcg_temp_free_ptr(rec);
+    tcg_temp_free_ptr(ptr);
+}
+
 static void inject_cb(struct qemu_plugin_dyn_cb *cb)
 
 {
@@ -228,6 +277,10 @@ static void inject_cb(struct qemu_plugin_dyn_cb *cb)
     case PLUGIN_CB_INLINE_STORE_U64:
         gen_inline_store_u64_cb(&cb->inline_insn);
         break;
+    case PLUGIN_CB_MEM_BATCH:
+        /* Instruction execution record */
+        gen_mem_batch_cb(&cb->batch, 0, tcg_constant_i64(cb->batch.pc));
+        break;
     default:
         g_assert_not_reached();
     }
@@ -249,6 +302,11 @@ static void inject_mem_cb(struct qemu_plugin_dyn_cb *cb,
             inject_cb(cb);
         }
         break;
+    case PLUGIN_CB_MEM_BATCH:
+        if (rw & cb->batch.rw) {
+            gen_mem_batch_cb(&cb->batch, meminfo, addr);
+        }
+        break;
     default:
         g_assert_not_reached();
     }
@@ -0,0 +1,557 @@
+/*
+ * Persistent translation block cache for user-mode emulation
+ *
+ * The host code of translation blocks is saved to a file when the
+ * emulated process exits, and copied back into the code buffer by
+ * later runs instead of translating the guest code again.  This
+ * helps short-lived processes, which spend most of their time in the
+ * translator.
+ *
+ * Only code that the backend generated in relocatable form is saved:
+ * calls into QEMU are made through constant pool entries that are
+ * rewritten for the load address of QEMU, branches to the prologue
+ * are adjusted for the location of the code buffer, and TBs that
+ * embed any other host pointer are not saved at all.  Pointer
+ * constants are rejected when they are created, and the backend also
+ * asks tb_cache_imm_ok() about every 64-bit immediate, which catches
+ * pointers that reach the code as plain integer constants.  An entry
+ * is only used if the guest code it was translated from is unchanged,
+ * and the file is only used if its checksum matches.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/cacheflush.h"
+#include "qemu/cacheinfo.h"
+#include "qemu/units.h"
+#include "qemu/error-report.h"
+#include "qapi/error.h"
+#include "exec/exec-all.h"
+#include "exec/cpu_ldst.h"
+#include "exec/page-protection.h"
+#include "tcg/tcg.h"
+#include "user/guest-base.h"
+#include "user/tb-cache.h"
+#include "internal-common.h"
+#include "internal-target.h"
+#include "trace.h"
+
+#ifdef TCG_TARGET_TB_CACHE
+#include "elf.h"
+#include "host/cpuinfo.h"
+
+#define TB_CACHE_MAGIC          "QEMU-TBC"
+#define TB_CACHE_VERSION        2
+#define TB_CACHE_BUILD_ID_MAX   64
+#define TB_CACHE_MAX_SIZE       (256 * MiB)
+
+#ifndef NT_GNU_BUILD_ID
+#define NT_GNU_BUILD_ID         3
+#endif
+
+typedef struct TBCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t build_id_len;
+    uint8_t build_id[TB_CACHE_BUILD_ID_MAX];
+    uint64_t config;
+    uint64_t nb_entries;
+    uint64_t checksum;          /* of everything after the header */
+} TBCacheHeader;
+
+QEMU_BUILD_BUG_ON(sizeof(TBCacheHeader) != 104);
+
+/*
+ * Each entry is stored as this header, followed by the relocations,
+ * the guest code and the host code plus search data, the last two
+ * padded to 8 bytes.
+ */
+typedef struct TBCacheEntryHeader {
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t size;
+    uint32_t code_size;
+    uint32_t search_size;
+    uint32_t nb_relocs;
+    uint16_t icount;
+    uint16_t page1;
+    uint16_t jmp_reset_offset[2];
+    uint16_t jmp_insn_offset[2];
+    uint32_t pad;
+} TBCacheEntryHeader;
+
+QEMU_BUILD_BUG_ON(sizeof(TBCacheEntryHeader) != 56);
+QEMU_BUILD_BUG_ON(sizeof(TCGTBReloc) != 16);
+
+typedef struct TBCacheEntry {
+    struct TBCacheEntry *next;
+    TBCacheEntryHeader *h;
+    bool used;                  /* hit or recorded by this run */
+} TBCacheEntry;
+
+static struct {
+    char *path;
+    uint8_t build_id[TB_CACHE_BUILD_ID_MAX];
+    uint32_t build_id_len;
+    uint64_t config;
+    uintptr_t image_start, image_end;
+    GHashTable *entries;        /* pc -> chain of TBCacheEntry */
+    char *file;                 /* contents of the file at startup */
+    size_t size;                /* of all entries */
+} tb_cache;
+
+static inline TCGTBReloc *entry_relocs(TBCacheEntryHeader *h)
+{
+    return (TCGTBReloc *)(h + 1);
+}
+
+static inline uint8_t *entry_guest(TBCacheEntryHeader *h)
+{
+    return (uint8_t *)(entry_relocs(h) + h->nb_relocs);
+}
+
+static inline uint8_t *entry_host(TBCacheEntryHeader *h)
+{
+    return entry_guest(h) + ROUND_UP(h->size, 8);
+}
+
+static inline size_t entry_len(TBCacheEntryHeader *h)
+{
+    return sizeof(*h) + h->nb_relocs * sizeof(TCGTBReloc)
+        + ROUND_UP(h->size, 8)
+        + ROUND_UP(h->code_size + h->search_size, 8);
+}
+
+/*
+ * Find the GNU build ID of the QEMU executable, which identifies the
+ * code of the helpers that the cached TBs call, and the range where
+ * the executable is mapped.
+ */
+static bool tb_cache_find_image(Error **errp)
+{
+    const Elf64_Phdr *phdr = (const void *)qemu_getauxval(AT_PHDR);
+    unsigned long phnum = qemu_getauxval(AT_PHNUM);
+    uintptr_t bias = 0;
+    bool have_bias = false;
+    unsigned long i;
+
+    if (!phdr || !phnum) {
+        error_setg(errp, "cannot find the program headers of QEMU");
+        return false;
+    }
+    for (i = 0; i < phnum; i++) {
+        if (phdr[i].p_type == PT_PHDR) {
+            bias = (uintptr_t)phdr - phdr[i].p_vaddr;
+            have_bias = true;
+        }
+    }
+    if (!have_bias) {
+        error_setg(errp, "cannot find the load address of QEMU");
+        return false;
+    }
+
+    tb_cache.image_start = UINTPTR_MAX;
+    for (i = 0; i < phnum; i++) {
+        const Elf64_Phdr *p = &phdr[i];
+
+        if (p->p_type == PT_LOAD) {
+            tb_cache.image_start = MIN(tb_cache.image_start,
+                                       bias + p->p_vaddr);
+            tb_cache.image_end = MAX(tb_cache.image_end,
+                                     bias + p->p_vaddr + p->p_memsz);
+        } else if (p->p_type == PT_NOTE && !tb_cache.build_id_len) {
+            const uint8_t *n = (const uint8_t *)(bias + p->p_vaddr);
+            const uint8_t *end = n + p->p_memsz;
+
+            while (n + sizeof(Elf64_Nhdr) <= end) {
+                const Elf64_Nhdr *nh = (const Elf64_Nhdr *)n;
+                const uint8_t *desc = n + sizeof(*nh)
+                                      + ROUND_UP(nh->n_namesz, 4);
+
+                if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4 &&
+                    !memcmp(n + sizeof(*nh), "GNU", 4) &&
+                    nh->n_descsz <= TB_CACHE_BUILD_ID_MAX &&
+                    desc + nh->n_descsz <= end) {
+                    memcpy(tb_cache.build_id, desc, nh->n_descsz);
+                    tb_cache.build_id_len = nh->n_descsz;
+                    break;
+                }
+                n = desc + ROUND_UP(nh->n_descsz, 4);
+            }
+        }
+    }
+    if (!tb_cache.build_id_len) {
+        error_setg(errp, "QEMU was linked without a build ID");
+        error_append_hint(errp, "The TB cache needs one to tell whether "
+                          "it was written by the same binary.\n");
+        return false;
+    }
+    return true;
+}
+
+#define FNV1A_INIT  0xcbf29ce484222325ull
+
+static uint64_t fnv1a(uint64_t h, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    while (len--) {
+        h = (h ^ *p++) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+/*
+ * Everything besides the guest code and the TB flags that the
+ * generated code depends on.
+ */
+static uint64_t tb_cache_config(const char *cpu_model)
+{
+    uint64_t h = FNV1A_INIT;
+    unsigned guest_base_kind;
+
+    h = fnv1a(h, TARGET_NAME, strlen(TARGET_NAME) + 1);
+    h = fnv1a(h, cpu_model, strlen(cpu_model) + 1);
+    h = fnv1a(h, &cpuinfo, sizeof(cpuinfo));
+    h = fnv1a(h, &qemu_icache_linesize, sizeof(qemu_icache_linesize));
+
+    /* Whether guest_base is used, and if so whether it needs a register */
+    guest_base_kind = !guest_base ? 0 : guest_base == (int32_t)guest_base
+                      ? 1 : 2;
+    h = fnv1a(h, &guest_base_kind, sizeof(guest_base_kind));
+    return h;
+}
+
+static void tb_cache_insert(TBCacheEntry *e)
+{
+    TBCacheEntry *head = g_hash_table_lookup(tb_cache.entries, &e->h->pc);
+
+    e->next = head;
+    g_hash_table_insert(tb_cache.entries, &e->h->pc, e);
+}
+
+/*
+ * Whether @val, a 64-bit immediate that the backend is about to emit,
+ * can be saved: it must not be the address of anything in QEMU itself.
+ * Values outside of the user address space of an x86-64 host cannot
+ * be.  Without a guest_base, the guest and QEMU share the address
+ * space but not the mappings, so a mapped guest address cannot point
+ * into QEMU either.  Everything else is conservatively refused.
+ */
+static bool tb_cache_imm_ok(uint64_t val)
+{
+    if (val < 64 * KiB || val >= (1ull << 47)) {
+        return true;
+    }
+    return !guest_base && val <= GUEST_ADDR_MAX && page_get_flags(val);
+}
+
+static bool tb_cache_check_entry(TBCacheEntryHeader *h, size_t avail)
+{
+    TCGTBReloc *r;
+    uint32_t i;
+
+    if (avail < sizeof(*h) ||
+        h->nb_relocs > TCG_MAX_TB_RELOCS ||
+        h->size == 0 || h->size > 2 * TARGET_PAGE_SIZE ||
+        h->code_size > TB_CACHE_MAX_SIZE ||
+        h->search_size > TB_CACHE_MAX_SIZE ||
+        h->icount == 0 || h->icount > TCG_MAX_INSNS ||
+        entry_len(h) > avail) {
+        return false;
+    }
+    r = entry_relocs(h);
+    for (i = 0; i < h->nb_relocs; i++) {
+        if ((uint64_t)r[i].offset + 8 > h->code_size) {
+            return false;
+        }
+        switch (r[i].kind) {
+        case TCG_TB_RELOC_ABS64:
+            if (r[i].target >= tb_cache.image_end - tb_cache.image_start) {
+                return false;
+            }
+            break;
+        case TCG_TB_RELOC_PC32:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static void tb_cache_read(void)
+{
+    g_autoptr(GError) err = NULL;
+    TBCacheHeader *fh;
+    size_t file_size, ofs;
+    uint64_t i;
+
+    if (!g_file_get_contents(tb_cache.path, &tb_cache.file,
+                             &file_size, &err)) {
+        if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            warn_report("TB cache: %s", err->message);
+        }
+        return;
+    }
+
+    fh = (TBCacheHeader *)tb_cache.file;
+    if (file_size < sizeof(*fh) ||
+        memcmp(fh->magic, TB_CACHE_MAGIC, sizeof(fh->magic)) ||
+        fh->version != TB_CACHE_VERSION ||
+        fh->build_id_len != tb_cache.build_id_len ||
+        memcmp(fh->build_id, tb_cache.build_id, tb_cache.build_id_len) ||
+        fh->config != tb_cache.config) {
+        trace_tb_cache_stale(tb_cache.path);
+        return;
+    }
+    if (fnv1a(FNV1A_INIT, fh + 1, file_size - sizeof(*fh)) != fh->checksum) {
+        warn_report("TB cache: %s is corrupted, ignoring it", tb_cache.path);
+        return;
+    }
+
+    ofs = sizeof(*fh);
+    for (i = 0; i < fh->nb_entries; i++) {
+        TBCacheEntryHeader *h = (TBCacheEntryHeader *)(tb_cache.file + ofs);
+        TBCacheEntry *e;
+
+        if (!tb_cache_check_entry(h, file_size - ofs)) {
+            warn_report("TB cache: %s is corrupted, ignoring the rest",
+                        tb_cache.path);
+            break;
+        }
+        e = g_new0(TBCacheEntry, 1);
+        e->h = h;
+        tb_cache_insert(e);
+        ofs += entry_len(h);
+        tb_cache.size += entry_len(h);
+    }
+    trace_tb_cache_read(tb_cache.path, i);
+}
+
+bool tb_cache_enable(const char *path, const char *cpu_model, Error **errp)
+{
+    if (!tb_cache_find_image(errp)) {
+        return false;
+    }
+    /* Only 64-bit immediates are checked by tb_cache_imm_ok() */
+    if (tb_cache.image_start < 4 * GiB ||
+        (uintptr_t)tcg_ctx->code_gen_buffer < 4 * GiB) {
+        error_setg(errp, "the TB cache needs QEMU to be mapped above 4 GiB");
+        error_append_hint(errp, "Build QEMU as a position independent "
+                          "executable.\n");
+        return false;
+    }
+    tb_cache.path = g_strdup(path);
+    tb_cache.config = tb_cache_config(cpu_model);
+    tb_cache.entries = g_hash_table_new(g_int64_hash, g_int64_equal);
+    tb_cache_read();
+    tcg_ctx->tb_cache = true;
+    tcg_ctx->tb_cache_imm_ok = tb_cache_imm_ok;
+    return true;
+}
+
+int tb_cache_load(TranslationBlock *tb, vaddr pc, void *gen_code_buf)
+{
+    TBCacheEntry *e = g_hash_table_lookup(tb_cache.entries, &pc);
+    const void *rx = tcg_splitwx_to_rx(gen_code_buf);
+    TBCacheEntryHeader *h;
+    TCGTBReloc *r;
+    size_t len;
+    uint32_t i;
+
+    for (; e; e = e->next) {
+        h = e->h;
+        if (h->cs_base == tb->cs_base && h->flags == tb->flags &&
+            h->cflags == tb->cflags &&
+            page_check_range(pc, pc + h->size - 1, PAGE_EXEC) &&
+            !memcmp(entry_guest(h), g2h_untagged(pc), h->size)) {
+            break;
+        }
+    }
+    if (!e) {
+        trace_tb_cache_miss(pc);
+        return -1;
+    }
+
+    len = h->code_size + h->search_size;
+    if (gen_code_buf + len > tcg_ctx->code_gen_highwater) {
+        return -1;
+    }
+    memcpy(gen_code_buf, entry_host(h), len);
+
+    r = entry_relocs(h);
+    for (i = 0; i < h->nb_relocs; i++) {
+        void *field = gen_code_buf + r[i].offset;
+
+        if (r[i].kind == TCG_TB_RELOC_ABS64) {
+            stq_he_p(field, tb_cache.image_start + r[i].target);
+        } else {
+            intptr_t disp = (intptr_t)(tcg_code_gen_epilogue + r[i].target)
+                - (intptr_t)(rx + r[i].offset + 4);
+
+            if (disp != (int32_t)disp) {
+                return -1;
+            }
+            stl_he_p(field, disp);
+        }
+    }
+
+    if (h->page1) {
+        tb_page_addr_t p1 = (pc + h->size - 1) & TARGET_PAGE_MASK;
+
+        tb_set_page_addr1(tb, p1);
+        tb_lock_page1(tb_page_addr0(tb), p1);
+    }
+    tb->size = h->size;
+    tb->icount = h->icount;
+    tb->tc.size = h->code_size;
+    for (i = 0; i < 2; i++) {
+        tb->jmp_reset_offset[i] = h->jmp_reset_offset[i];
+        tb->jmp_insn_offset[i] = h->jmp_insn_offset[i];
+    }
+    flush_idcache_range((uintptr_t)rx, (uintptr_t)gen_code_buf,
+                        h->code_size);
+
+    e->used = true;
+    trace_tb_cache_hit(pc, h->code_size);
+    return len;
+}
+
+void tb_cache_record(TranslationBlock *tb, vaddr pc,
+                     const void *gen_code_buf, int search_size)
+{
+    TCGContext *s = tcg_ctx;
+    TBCacheEntryHeader *h, tmp = {
+        .pc = pc,
+        .cs_base = tb->cs_base,
+        .flags = tb->flags,
+        .cflags = tb->cflags,
+        .size = tb->size,
+        .code_size = tb->tc.size,
+        .search_size = search_size,
+        .nb_relocs = s->nb_tb_relocs,
+        .icount = tb->icount,
+        .page1 = tb_page_addr1(tb) != -1,
+        .jmp_reset_offset = { tb->jmp_reset_offset[0],
+                              tb->jmp_reset_offset[1] },
+        .jmp_insn_offset = { tb->jmp_insn_offset[0],
+                             tb->jmp_insn_offset[1] },
+    };
+    TBCacheEntry *e;
+    TCGTBReloc *r;
+    int i;
+
+    if (tb_cache.size + entry_len(&tmp) > TB_CACHE_MAX_SIZE) {
+        return;
+    }
+
+    h = g_malloc(entry_len(&tmp));
+    *h = tmp;
+    r = entry_relocs(h);
+    for (i = 0; i < s->nb_tb_relocs; i++) {
+        r[i] = s->tb_relocs[i];
+        if (r[i].kind == TCG_TB_RELOC_ABS64) {
+            if (r[i].target < tb_cache.image_start ||
+                r[i].target >= tb_cache.image_end) {
+                g_free(h);
+                return;
+            }
+            r[i].target -= tb_cache.image_start;
+        } else {
+            r[i].target -= (uintptr_t)tcg_code_gen_epilogue;
+        }
+    }
+    memcpy(entry_guest(h), g2h_untagged(pc), h->size);
+    memcpy(entry_host(h), gen_code_buf, h->code_size + h->search_size);
+
+    e = g_new0(TBCacheEntry, 1);
+    e->h = h;
+    e->used = true;
+    tb_cache_insert(e);
+    tb_cache.size += entry_len(h);
+}
+
+static void tb_cache_write_entries(GByteArray *out, uint64_t *nb_entries,
+                                   bool used)
+{
+    GHashTableIter iter;
+    TBCacheEntry *e;
+
+    g_hash_table_iter_init(&iter, tb_cache.entries);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e)) {
+        for (; e; e = e->next) {
+            size_t len = entry_len(e->h);
+
+            if (e->used != used || out->len + len > TB_CACHE_MAX_SIZE) {
+                continue;
+            }
+            g_byte_array_append(out, (const guint8 *)e->h, len);
+            (*nb_entries)++;
+        }
+    }
+}
+
+void tb_cache_save(void)
+{
+    g_autoptr(GByteArray) out = NULL;
+    g_autoptr(GError) err = NULL;
+    TBCacheHeader fh = {
+        .version = TB_CACHE_VERSION,
+        .build_id_len = tb_cache.build_id_len,
+        .config = tb_cache.config,
+    };
+
+    if (!tb_cache.path) {
+        return;
+    }
+
+    mmap_lock();
+    memcpy(fh.magic, TB_CACHE_MAGIC, sizeof(fh.magic));
+    memcpy(fh.build_id, tb_cache.build_id, sizeof(fh.build_id));
+    out = g_byte_array_new();
+    g_byte_array_append(out, (const guint8 *)&fh, sizeof(fh));
+
+    /* Blocks this run used first, so that they survive the size cap */
+    tb_cache_write_entries(out, &fh.nb_entries, true);
+    tb_cache_write_entries(out, &fh.nb_entries, false);
+    fh.checksum = fnv1a(FNV1A_INIT, out->data + sizeof(fh),
+                        out->len - sizeof(fh));
+    memcpy(out->data, &fh, sizeof(fh));
+    mmap_unlock();
+
+    if (!g_file_set_contents(tb_cache.path, (const gchar *)out->data,
+                             out->len, &err)) {
+        warn_report("TB cache: %s", err->message);
+        return;
+    }
+    trace_tb_cache_save(tb_cache.path, fh.nb_entries, out->len);
+}
+
+#else
+
+bool tb_cache_enable(const char *path, const char *cpu_model, Error **errp)
+{
+    error_setg(errp, "the TB cache is not supported on this host");
+    return false;
+}
+
+int tb_cache_load(TranslationBlock *tb, vaddr pc, void *gen_code_buf)
+{
+    g_assert_not_reached();
+}
+
+void tb_cache_record(TranslationBlock *tb, vaddr pc,
+                     const void *gen_code_buf, int search_size)
+{
+    g_assert_not_reached();
+}
+
+void tb_cache_save(void)
+{
+}
+
+#endif /* TCG_TARGET_TB_CACHE */
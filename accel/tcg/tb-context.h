@@ -31,10 +31,17 @@ typedef struct TBContext TBContext;
 struct TBContext {
 
     struct qht htable;
+    /* keys of the TBs translated again as superblocks */
+    struct qht hot_htable;
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_evict_count;
     unsigned tb_phys_invalidate_count;
+    unsigned tb_hot_count;
+    /* writes to pages holding code, and those that missed all the code */
+    unsigned smc_write_count;
+    unsigned smc_skip_count;
 };
 
 extern TBContext tb_ctx;
@@ -24,6 +24,8 @@
  */
 typedef struct CPUJumpCache {
     struct rcu_head rcu;
+    /* Returns that the shadow return stack in CPUState did not predict */
+    size_t ras_miss_count;
     struct {
         TranslationBlock *tb;
         vaddr pc;
@@ -18,6 +18,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/bitmap.h"
 #include "qemu/interval-tree.h"
 #include "qemu/qtree.h"
 #include "exec/cputlb.h"
@@ -56,11 +57,14 @@ static bool tb_cmp(const void *ap, const void *bp)
             tb_page_addr1(a) == tb_page_addr1(b));
 }
 
+static bool tb_hot_cmp(const void *ap, const void *bp);
+
 void tb_htable_init(void)
 {
     unsigned int mode = QHT_MODE_AUTO_RESIZE;
 
     qht_init(&tb_ctx.htable, tb_cmp, CODE_GEN_HTABLE_SIZE, mode);
+    qht_init(&tb_ctx.hot_htable, tb_hot_cmp, 1 << 10, mode);
 }
 
 typedef struct PageDesc PageDesc;
@@ -183,8 +187,18 @@ struct PageDesc {
     QemuSpin lock;
     /* list of TBs intersecting this ram page */
     uintptr_t first_tb;
+    /*
+     * Bytes of the page covered by TBs, built once the page has seen
+     * SMC_BITMAP_USE_THRESHOLD writes, so that writes to data sharing
+     * the page with code can skip the walk of the TB list.  Dropped
+     * whenever a TB leaves the page.
+     */
+    unsigned long *code_bitmap;
+    unsigned int code_write_count;
 };
 
+#define SMC_BITMAP_USE_THRESHOLD 10
+
 void page_table_config_init(void)
 {
     uint32_t v_l1_bits;
@@ -650,6 +664,51 @@ static void page_collection_unlock(struct page_collection *set)
     g_free(set);
 }
 
+/* Return the range [*start, *last] of page @n of @tb that holds code. */
+static void tb_page_range(const TranslationBlock *tb, unsigned int n,
+                          tb_page_addr_t *start, tb_page_addr_t *last)
+{
+    /* NOTE: this is subtle as a TB may span two physical pages */
+    *start = tb_page_addr0(tb);
+    *last = *start + tb->size - 1;
+    if (n == 0) {
+        *last = MIN(*last, *start | ~TARGET_PAGE_MASK);
+    } else {
+        *start = tb_page_addr1(tb);
+        *last = *start + (*last & ~TARGET_PAGE_MASK);
+    }
+}
+
+/* Called with @p->lock held. */
+static void page_code_bitmap_add(PageDesc *p, TranslationBlock *tb,
+                                 unsigned int n)
+{
+    tb_page_addr_t start, last;
+
+    tb_page_range(tb, n, &start, &last);
+    bitmap_set(p->code_bitmap, start & ~TARGET_PAGE_MASK, last - start + 1);
+}
+
+/* Called with @p->lock held. */
+static void page_build_code_bitmap(PageDesc *p)
+{
+    TranslationBlock *tb;
+    PageForEachNext n;
+
+    p->code_bitmap = bitmap_new(TARGET_PAGE_SIZE);
+    PAGE_FOR_EACH_TB(unused, unused, p, tb, n) {
+        page_code_bitmap_add(p, tb, n);
+    }
+}
+
+/* Called with @p->lock held. */
+static void page_invalidate_code_bitmap(PageDesc *p)
+{
+    g_free(p->code_bitmap);
+    p->code_bitmap = NULL;
+    p->code_write_count = 0;
+}
+
 /* Set to NULL all the 'first_tb' fields in all PageDescs. */
 static void tb_remove_all_1(int level, void **lp)
 {
@@ -664,6 +723,7 @@ static void tb_remove_all_1(int level, void **lp)
         for (i = 0; i < V_L2_SIZE; ++i) {
             page_lock(&pd[i]);
             pd[i].first_tb = (uintptr_t)NULL;
+            page_invalidate_code_bitmap(&pd[i]);
             page_unlock(&pd[i]);
         }
     } else {
@@ -697,6 +757,9 @@ static void tb_page_add(PageDesc *p, TranslationBlock *tb, unsigned int n)
     tb->page_next[n] = p->first_tb;
     page_already_protected = p->first_tb != 0;
     p->first_tb = (uintptr_t)tb | n;
+    if (p->code_bitmap) {
+        page_code_bitmap_add(p, tb, n);
+    }
 
     /*
      * If some code is already present, then the pages are already
@@ -729,6 +792,8 @@ static void tb_page_remove(PageDesc *pd, TranslationBlock *tb)
     PageForEachNext n1;
 
     assert_page_locked(pd);
+    /* The remaining TBs may share bytes with @tb; start over. */
+    page_invalidate_code_bitmap(pd);
     pprev = &pd->first_tb;
     PAGE_FOR_EACH_TB(unused, unused, pd, tb1, n1) {
         if (tb1 == tb) {
@@ -756,6 +821,12 @@ static void tb_remove(TranslationBlock *tb)
 #endif /* CONFIG_USER_ONLY */
 
 /* flush all the translation blocks */
+static bool tb_hot_free(void *p, uint32_t h, void *userp)
+{
+    g_free(p);
+    return true;
+}
+
 static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
 {
     bool did_flush = false;
@@ -772,6 +843,7 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     }
 
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
+    qht_iter_remove(&tb_ctx.hot_htable, tb_hot_free, NULL);
     tb_remove_all();
 
     tcg_region_reset_all();
@@ -893,6 +965,11 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
             }
+            for (int i = 0; i < TB_RAS_SIZE; i++) {
+                if (qatomic_read(&cpu->neg.ras.slot[i].code) == tb->tc.ptr) {
+                    qatomic_set(&cpu->neg.ras.slot[i].valid, 0);
+                }
+            }
         }
     }
 }
@@ -902,7 +979,8 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
  * In !user-mode, if @rm_from_page_list is set, call with the TB's pages'
  * locks held.
  */
-static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
+static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list,
+                                  bool rm_from_jmp_cache)
 {
     uint32_t h;
     tb_page_addr_t phys_pc;
@@ -929,7 +1007,9 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     }
 
     /* remove the TB from the hash list */
-    tb_jmp_cache_inval_tb(tb);
+    if (rm_from_jmp_cache) {
+        tb_jmp_cache_inval_tb(tb);
+    }
 
     /* suppress this TB from the two jump lists */
     tb_remove_from_jmp_list(tb, 0);
@@ -945,7 +1025,7 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 static void tb_phys_invalidate__locked(TranslationBlock *tb)
 {
     qemu_thread_jit_write();
-    do_tb_phys_invalidate(tb, true);
+    do_tb_phys_invalidate(tb, true, true);
     qemu_thread_jit_execute();
 }
 
@@ -957,10 +1037,136 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
 {
     if (page_addr == -1 && tb_page_addr0(tb) != -1) {
         tb_lock_pages(tb);
-        do_tb_phys_invalidate(tb, true);
+        do_tb_phys_invalidate(tb, true, true);
         tb_unlock_pages(tb);
     } else {
-        do_tb_phys_invalidate(tb, false);
+        do_tb_phys_invalidate(tb, false, true);
+    }
+}
+
+/*
+ * Tiered translation: a TB that has run tcg_tier_threshold times is
+ * invalidated and its key recorded in tb_ctx.hot_htable, so that it
+ * is translated again as a superblock.  The keys are dropped by
+ * tb_flush(), so the table holds at most the TBs translated since
+ * the last flush, and code that is still hot is promoted again.
+ */
+typedef struct TBHotKey {
+    tb_page_addr_t phys_pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+} TBHotKey;
+
+static bool tb_hot_cmp(const void *ap, const void *bp)
+{
+    const TBHotKey *a = ap;
+    const TBHotKey *b = bp;
+
+    return a->phys_pc == b->phys_pc &&
+           a->cs_base == b->cs_base &&
+           a->flags == b->flags &&
+           a->cflags == b->cflags;
+}
+
+static uint32_t tb_hot_key(TBHotKey *k, const TranslationBlock *tb)
+{
+    k->phys_pc = tb_page_addr0(tb);
+    k->cs_base = tb->cs_base;
+    k->flags = tb->flags;
+    k->cflags = tb_cflags(tb) & ~CF_INVALID;
+    return qemu_xxhash6(k->phys_pc, k->cs_base, k->flags, k->cflags);
+}
+
+void tb_mark_hot(TranslationBlock *tb)
+{
+    TBHotKey *k = g_new(TBHotKey, 1);
+    uint32_t h = tb_hot_key(k, tb);
+
+    if (!qht_insert(&tb_ctx.hot_htable, k, h, NULL)) {
+        /* Another vCPU got there first */
+        g_free(k);
+        return;
+    }
+    qatomic_inc(&tb_ctx.tb_hot_count);
+
+    /*
+     * The TB stays valid for the rest of its current execution; this
+     * only unlinks it so that the next lookup translates it again.
+     */
+    mmap_lock();
+    tb_phys_invalidate(tb, -1);
+    mmap_unlock();
+}
+
+bool tb_is_hot(const TranslationBlock *tb)
+{
+    TBHotKey k;
+    uint32_t h = tb_hot_key(&k, tb);
+
+    RCU_READ_LOCK_GUARD();
+    return qht_lookup(&tb_ctx.hot_htable, &k, h) != NULL;
+}
+
+static gboolean tb_evict_iter(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+
+    /* The jump caches have been flushed by the caller */
+    if (tb_page_addr0(tb) != -1) {
+        tb_lock_pages(tb);
+        do_tb_phys_invalidate(tb, true, false);
+        tb_unlock_pages(tb);
+    } else {
+        do_tb_phys_invalidate(tb, false, false);
+    }
+    return false;
+}
+
+/* evict the oldest region of translations, or flush them all */
+static void do_tb_evict(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUState *cs;
+    bool evicted = false;
+
+    mmap_lock();
+    /* If it is already been done on request of another CPU, just retry. */
+    if (tcg_region_available()) {
+        goto done;
+    }
+
+    CPU_FOREACH(cs) {
+        tcg_flush_jmp_cache(cs);
+    }
+
+    /* Unlinking patches the jumps of the TBs that are kept. */
+    qemu_thread_jit_write();
+    evicted = tcg_region_evict(tb_evict_iter, NULL);
+    qemu_thread_jit_execute();
+    if (evicted) {
+        qatomic_inc(&tb_ctx.tb_evict_count);
+    }
+
+done:
+    mmap_unlock();
+    if (!evicted && !tcg_region_available()) {
+        do_tb_flush(cpu,
+                    RUN_ON_CPU_HOST_INT(qatomic_read(&tb_ctx.tb_flush_count)));
+    }
+}
+
+/*
+ * Make room in the code buffer once it has filled up.  Evicting only the
+ * oldest region keeps the bulk of the translations alive, so a guest
+ * with a working set larger than the buffer does not have to retranslate
+ * everything each time it wraps around.
+ */
+void tb_evict(CPUState *cpu)
+{
+    if (cpu_in_serial_context(cpu)) {
+        do_tb_evict(cpu, RUN_ON_CPU_NULL);
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_evict, RUN_ON_CPU_NULL);
     }
 }
 
@@ -1117,15 +1323,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
     PAGE_FOR_EACH_TB(start, last, p, tb, n) {
         tb_page_addr_t tb_start, tb_last;
 
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        tb_start = tb_page_addr0(tb);
-        tb_last = tb_start + tb->size - 1;
-        if (n == 0) {
-            tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
-        } else {
-            tb_start = tb_page_addr1(tb);
-            tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
-        }
+        tb_page_range(tb, n, &tb_start, &tb_last);
         if (!(tb_last < start || tb_start > last)) {
 #ifdef TARGET_HAS_PRECISE_SMC
             if (current_tb == tb &&
@@ -1221,6 +1419,35 @@ void tb_invalidate_phys_range_fast(ram_addr_t ram_addr,
                                    uintptr_t retaddr)
 {
     struct page_collection *pages;
+    PageDesc *p = page_find(ram_addr >> TARGET_PAGE_BITS);
+
+    if (!p) {
+        return;
+    }
+
+    qatomic_inc(&tb_ctx.smc_write_count);
+
+    /*
+     * Pages that mix code and data see many writes that miss all TBs;
+     * once the page has seen a few, let its code bitmap answer those
+     * without locking the page collection and walking every TB.
+     */
+    page_lock(p);
+    if (!p->code_bitmap &&
+        ++p->code_write_count >= SMC_BITMAP_USE_THRESHOLD) {
+        page_build_code_bitmap(p);
+    }
+    if (p->code_bitmap && p->first_tb) {
+        unsigned long offset = ram_addr & ~TARGET_PAGE_MASK;
+
+        if (find_next_bit(p->code_bitmap, offset + size, offset) >=
+            offset + size) {
+            page_unlock(p);
+            qatomic_inc(&tb_ctx.smc_skip_count);
+            return;
+        }
+    }
+    page_unlock(p);
 
     pages = page_collection_lock(ram_addr, ram_addr + size - 1);
     tb_invalidate_phys_page_fast__locked(pages, ram_addr, size, retaddr);
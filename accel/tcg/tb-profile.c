@@ -0,0 +1,249 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ *  QEMU TCG sampling profiler
+ *
+ * A timer periodically asks every vCPU for a sample.  The request uses
+ * the same mechanism as cpu_exit(): the check at the start of each TB
+ * makes the vCPU leave the chain of directly linked TBs, and the guest
+ * PC of the next TB it looks up is counted.  Nothing is added to the
+ * generated code, so a disabled profiler costs one predicted branch per
+ * TB lookup and an enabled one a TB chain exit per sample.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/lockable.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "qapi/type-helpers.h"
+#include "qapi/qapi-commands-machine.h"
+#include "qapi/qmp/qdict.h"
+#include "monitor/monitor.h"
+#include "monitor/hmp.h"
+#include "disas/disas.h"
+#include "hw/core/cpu.h"
+#include "sysemu/replay.h"
+#include "sysemu/tcg.h"
+#include "internal-common.h"
+
+#define TB_PROFILE_DEFAULT_INTERVAL 10  /* ms */
+#define TB_PROFILE_DEFAULT_MAX      20
+
+typedef struct TBProfileEntry {
+    uint64_t pc;
+    uint64_t count;
+} TBProfileEntry;
+
+static struct {
+    QemuMutex lock;
+    /* guest PC -> TBProfileEntry, protected by @lock */
+    GHashTable *samples;
+    uint64_t total;
+    /* the fields below are protected by the BQL */
+    QEMUTimer *timer;
+    uint32_t interval;
+} tb_profile;
+
+static void tb_profile_tick(void *opaque)
+{
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        if (cpu->halted) {
+            continue;
+        }
+        qatomic_set(&cpu->tb_profile_pending, true);
+        /* Leave the TB chain at the next TB start, see cpu_exit(). */
+        smp_wmb();
+        qatomic_set(&cpu->neg.icount_decr.u16.high, -1);
+    }
+    timer_mod(tb_profile.timer,
+              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + tb_profile.interval);
+}
+
+void tb_profile_record(CPUState *cpu, vaddr pc)
+{
+    TBProfileEntry *e;
+
+    qatomic_set(&cpu->tb_profile_pending, false);
+
+    QEMU_LOCK_GUARD(&tb_profile.lock);
+    e = g_hash_table_lookup(tb_profile.samples, &pc);
+    if (!e) {
+        e = g_new0(TBProfileEntry, 1);
+        e->pc = pc;
+        g_hash_table_insert(tb_profile.samples, &e->pc, e);
+    }
+    e->count++;
+    tb_profile.total++;
+}
+
+static void tb_profile_init(void)
+{
+    if (!tb_profile.samples) {
+        qemu_mutex_init(&tb_profile.lock);
+        tb_profile.samples = g_hash_table_new_full(g_int64_hash,
+                                                   g_int64_equal,
+                                                   NULL, g_free);
+    }
+}
+
+void qmp_x_tb_profile(bool enable, bool has_interval, uint32_t interval,
+                      bool has_reset, bool reset, Error **errp)
+{
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB profiling is only available with accel=tcg");
+        return;
+    }
+    if (has_interval && interval == 0) {
+        error_setg(errp, "Parameter 'interval' must be positive");
+        return;
+    }
+    if (enable && replay_mode != REPLAY_MODE_NONE) {
+        error_setg(errp, "TB profiling is not available with record/replay");
+        return;
+    }
+
+    tb_profile_init();
+
+    if (reset) {
+        QEMU_LOCK_GUARD(&tb_profile.lock);
+        g_hash_table_remove_all(tb_profile.samples);
+        tb_profile.total = 0;
+    }
+
+    if (!enable) {
+        if (tb_profile.timer) {
+            timer_free(tb_profile.timer);
+            tb_profile.timer = NULL;
+        }
+        return;
+    }
+
+    if (has_interval) {
+        tb_profile.interval = interval;
+    } else if (!tb_profile.timer) {
+        tb_profile.interval = TB_PROFILE_DEFAULT_INTERVAL;
+    }
+    if (!tb_profile.timer) {
+        tb_profile.timer = timer_new_ms(QEMU_CLOCK_REALTIME,
+                                        tb_profile_tick, NULL);
+    }
+    timer_mod(tb_profile.timer,
+              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + tb_profile.interval);
+}
+
+static gint tb_profile_cmp(gconstpointer a, gconstpointer b)
+{
+    const TBProfileEntry *ea = *(const TBProfileEntry **)a;
+    const TBProfileEntry *eb = *(const TBProfileEntry **)b;
+
+    if (ea->count != eb->count) {
+        return ea->count > eb->count ? -1 : 1;
+    }
+    return ea->pc < eb->pc ? -1 : ea->pc > eb->pc;
+}
+
+HumanReadableText *qmp_x_query_tb_profile(bool has_max, uint32_t max,
+                                          Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+    g_autoptr(GPtrArray) entries = NULL;
+    uint64_t total = 0;
+    guint i;
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB profiling is only available with accel=tcg");
+        return NULL;
+    }
+    if (!has_max) {
+        max = TB_PROFILE_DEFAULT_MAX;
+    }
+
+    g_string_append_printf(buf, "TB profiling is %s",
+                           tb_profile.timer ? "on" : "off");
+    if (tb_profile.timer) {
+        g_string_append_printf(buf, ", interval %u ms", tb_profile.interval);
+    }
+    g_string_append_c(buf, '\n');
+
+    if (!tb_profile.samples) {
+        g_string_append_printf(buf, "no samples\n");
+        return human_readable_text_from_str(buf);
+    }
+
+    /* Copy the counts so that the symbol lookups run without the lock. */
+    WITH_QEMU_LOCK_GUARD(&tb_profile.lock) {
+        GHashTableIter iter;
+        TBProfileEntry *e;
+
+        entries = g_ptr_array_new_full(g_hash_table_size(tb_profile.samples),
+                                       g_free);
+        g_hash_table_iter_init(&iter, tb_profile.samples);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e)) {
+            g_ptr_array_add(entries, g_memdup2(e, sizeof(*e)));
+        }
+        total = tb_profile.total;
+    }
+    g_ptr_array_sort(entries, tb_profile_cmp);
+
+    g_string_append_printf(buf, "%" PRIu64 " samples, %u distinct PCs\n",
+                           total, entries->len);
+    if (!total) {
+        return human_readable_text_from_str(buf);
+    }
+
+    g_string_append_printf(buf, "%-18s %10s %7s  %s\n",
+                           "PC", "samples", "%", "symbol");
+    for (i = 0; i < entries->len && i < max; i++) {
+        TBProfileEntry *e = g_ptr_array_index(entries, i);
+        const char *sym = lookup_symbol(e->pc);
+
+        g_string_append_printf(buf, "0x%016" PRIx64 " %10" PRIu64
+                               " %6.2f%%  %s\n",
+                               e->pc, e->count, e->count * 100.0 / total,
+                               sym);
+    }
+
+    return human_readable_text_from_str(buf);
+}
+
+void hmp_tb_profile(Monitor *mon, const QDict *qdict)
+{
+    const char *op = qdict_get_try_str(qdict, "op");
+    bool has_interval = qdict_haskey(qdict, "interval");
+    int64_t interval = qdict_get_try_int(qdict, "interval", 0);
+    Error *err = NULL;
+
+    if (op == NULL) {
+        monitor_printf(mon, "tb-profile is %s\n",
+                       tb_profile.timer ? "on" : "off");
+        return;
+    }
+    if (has_interval && (interval <= 0 || interval > UINT32_MAX)) {
+        error_setg(&err, "invalid interval '%" PRId64 "'", interval);
+    } else if (!strcmp(op, "on")) {
+        qmp_x_tb_profile(true, has_interval, interval, false, false, &err);
+    } else if (!strcmp(op, "off")) {
+        qmp_x_tb_profile(false, false, 0, false, false, &err);
+    } else if (!strcmp(op, "reset")) {
+        qmp_x_tb_profile(!!tb_profile.timer, false, 0, true, true, &err);
+    } else {
+        error_setg(&err, "invalid parameter '%s',"
+                   " expecting 'on', 'off', or 'reset'", op);
+    }
+    hmp_handle_error(mon, err);
+}
+
+void hmp_info_tb_profile(Monitor *mon, const QDict *qdict)
+{
+    int64_t max = qdict_get_try_int(qdict, "max", TB_PROFILE_DEFAULT_MAX);
+    g_autoptr(HumanReadableText) info = NULL;
+    Error *err = NULL;
+
+    info = qmp_x_query_tb_profile(true, MIN(MAX(max, 0), UINT32_MAX), &err);
+    if (hmp_handle_error(mon, err)) {
+        return;
+    }
+    monitor_puts(mon, info->human_readable_text);
+}
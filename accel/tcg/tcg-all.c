@@ -45,6 +45,7 @@ struct TCGState {
 
     bool mttcg_enabled;
     bool one_insn_per_tb;
+    uint32_t tier_threshold;
     int splitwx_enabled;
     unsigned long tb_size;
 };
@@ -99,6 +100,7 @@ static void tcg_accel_instance_init(Object *obj)
 
 bool mttcg_enabled;
 bool one_insn_per_tb;
+uint32_t tcg_tier_threshold;
 
 static int tcg_init_machine(MachineState *ms)
 {
@@ -207,6 +209,31 @@ static void tcg_set_one_insn_per_tb(Object *obj, bool value, Error **errp)
     qatomic_set(&one_insn_per_tb, value);
 }
 
+static void tcg_get_tier_threshold(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->tier_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_tier_threshold(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->tier_threshold = value;
+    qatomic_set(&tcg_tier_threshold, value);
+}
+
 static int tcg_gdbstub_supported_sstep_flags(void)
 {
     /*
@@ -252,6 +279,13 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
                                    tcg_set_one_insn_per_tb);
     object_class_property_set_description(oc, "one-insn-per-tb",
         "Only put one guest insn in each translation block");
+
+    object_class_property_add(oc, "tier-threshold", "int",
+        tcg_get_tier_threshold, tcg_set_tier_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tier-threshold",
+        "Translate a TB again as a superblock after this many "
+        "executions (0 = never)");
 }
 
 static const TypeInfo tcg_accel_type = {
@@ -25,6 +25,8 @@ DEF_HELPER_FLAGS_1(ctpop_i32, TCG_CALL_NO_RWG_SE, i32, i32)
 DEF_HELPER_FLAGS_1(ctpop_i64, TCG_CALL_NO_RWG_SE, i64, i64)
 
 DEF_HELPER_FLAGS_1(lookup_tb_ptr, TCG_CALL_NO_WG_SE, cptr, env)
+DEF_HELPER_FLAGS_3(lookup_tb_ptr_ret, TCG_CALL_NO_WG_SE, cptr, env, i32, i64)
+DEF_HELPER_FLAGS_1(tb_hot, TCG_CALL_NO_RWG, void, ptr)
 
 DEF_HELPER_FLAGS_1(exit_atomic, TCG_CALL_NO_WG, noreturn, env)
 
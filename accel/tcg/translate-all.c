@@ -316,10 +316,10 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        /* eviction (or a flush, if nothing can be evicted) must be done */
+        tb_evict(cpu);
         mmap_unlock();
-        /* Make the execution loop process the flush as soon as possible.  */
+        /* Make the execution loop process the eviction as soon as possible. */
         cpu->exception_index = EXCP_INTERRUPT;
         cpu_loop_exit(cpu);
     }
@@ -338,6 +338,17 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         tb_lock_page0(phys_pc);
     }
 
+#ifdef CONFIG_USER_ONLY
+    if (tcg_ctx->tb_cache && phys_pc != -1) {
+        int size = tb_cache_load(tb, pc, gen_code_buf);
+        if (size >= 0) {
+            gen_code_size = tb->tc.size;
+            search_size = size - gen_code_size;
+            goto code_ready;
+        }
+    }
+#endif
+
     tcg_ctx->gen_tb = tb;
     tcg_ctx->addr_type = TARGET_LONG_BITS == 32 ? TCG_TYPE_I32 : TCG_TYPE_I64;
 #ifdef CONFIG_SOFTMMU
@@ -428,6 +439,12 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     tb->tc.size = gen_code_size;
 
+#ifdef CONFIG_USER_ONLY
+    if (tcg_ctx->nb_tb_relocs >= 0 && phys_pc != -1) {
+        tb_cache_record(tb, pc, gen_code_buf, search_size);
+    }
+#endif
+
     /*
      * For CF_PCREL, attribute all executions of the generated code
      * to its first mapping.
@@ -507,6 +524,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         }
     }
 
+#ifdef CONFIG_USER_ONLY
+ code_ready:
+#endif
     qatomic_set(&tcg_ctx->code_gen_ptr, (void *)
         ROUND_UP((uintptr_t)gen_code_buf + gen_code_size + search_size,
                  CODE_GEN_ALIGN));
@@ -662,4 +682,7 @@ void tcg_flush_jmp_cache(CPUState *cpu)
     for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
+    for (int i = 0; i < TB_RAS_SIZE; i++) {
+        qatomic_set(&cpu->neg.ras.slot[i].valid, 0);
+    }
 }
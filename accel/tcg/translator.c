@@ -16,6 +16,7 @@
 #include "exec/plugin-gen.h"
 #include "exec/cpu_ldst.h"
 #include "tcg/tcg-op-common.h"
+#include "internal-common.h"
 #include "internal-target.h"
 #include "disas/disas.h"
 
@@ -84,6 +85,54 @@ static TCGOp *gen_tb_start(DisasContextBase *db, uint32_t cflags)
     return icount_start_insn;
 }
 
+/*
+ * Tiered translation: return true if the TB should count its executions
+ * so that it can be promoted, and set db->superblock if it already was.
+ */
+static bool tb_tier_check(DisasContextBase *db, uint32_t cflags)
+{
+    db->superblock = false;
+
+    /*
+     * With icount, all the insns of a TB are accounted for on entry,
+     * so there must not be side exits.
+     */
+    if (!qatomic_read(&tcg_tier_threshold) ||
+        (cflags & (CF_USE_ICOUNT | CF_NO_GOTO_TB)) ||
+        tb_page_addr0(db->tb) == -1 || db->max_insns == 1) {
+        return false;
+    }
+    if (tb_is_hot(db->tb)) {
+        db->superblock = true;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The count is a plain load, add and store, shared by all the vCPUs
+ * that run @tb.  With MTTCG, concurrent increments can be lost, so it
+ * is only an approximate heuristic: promotion may come late, but it
+ * cannot be skipped, because a vCPU that stores the threshold also
+ * compares it.  Several vCPUs may call the helper; tb_mark_hot()
+ * only acts once.
+ */
+static void gen_tb_count(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_constant_ptr(&tb->exec_count);
+    TCGv_i32 count = tcg_temp_new_i32();
+    TCGLabel *cold = gen_new_label();
+
+    tb->exec_count = 0;
+    tcg_gen_ld_i32(count, ptr, 0);
+    tcg_gen_addi_i32(count, count, 1);
+    tcg_gen_st_i32(count, ptr, 0);
+    tcg_gen_brcondi_i32(TCG_COND_NE, count,
+                        qatomic_read(&tcg_tier_threshold), cold);
+    gen_helper_tb_hot(tcg_constant_ptr(tb));
+    gen_set_label(cold);
+}
+
 static void gen_tb_end(const TranslationBlock *tb, uint32_t cflags,
                        TCGOp *icount_start_insn, int num_insns)
 {
@@ -113,6 +162,19 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
     return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
 }
 
+bool translator_follow_branch(DisasContextBase *db, vaddr dest)
+{
+    /*
+     * Only follow branches forward, so that the TB still covers a
+     * single range of guest code, [pc_first, pc_next).
+     */
+    return db->superblock && dest > db->pc_next &&
+           translator_use_goto_tb(db, dest) &&
+           db->host_addr[0] != NULL &&
+           db->num_insns < db->max_insns &&
+           !tcg_op_buf_full();
+}
+
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
                      vaddr pc, void *host_pc, const TranslatorOps *ops,
                      DisasContextBase *db)
@@ -121,6 +183,7 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     TCGOp *icount_start_insn;
     TCGOp *first_insn_start = NULL;
     bool plugin_enabled;
+    bool count;
 
     /* Initialize DisasContext */
     db->tb = tb;
@@ -135,12 +198,16 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
     db->host_addr[1] = NULL;
     db->record_start = 0;
     db->record_len = 0;
+    count = tb_tier_check(db, cflags);
 
     ops->init_disas_context(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
     /* Start translating.  */
     icount_start_insn = gen_tb_start(db, cflags);
+    if (count) {
+        gen_tb_count(tb);
+    }
     ops->tb_start(db, cpu);
     tcg_debug_assert(db->is_jmp == DISAS_NEXT);  /* no early exit */
 
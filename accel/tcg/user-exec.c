@@ -23,6 +23,7 @@
 #include "tcg/tcg.h"
 #include "qemu/bitops.h"
 #include "qemu/rcu.h"
+#include "qemu/seqlock.h"
 #include "exec/cpu_ldst.h"
 #include "qemu/main-loop.h"
 #include "exec/translate-all.h"
@@ -154,6 +155,13 @@ typedef struct PageFlagsNode {
 
 static IntervalTreeRoot pageflags_root;
 
+/*
+ * Bumped around every update of pageflags_root, all of which happen
+ * with the mmap lock held.  Lets lockless readers tell a real miss from
+ * one caused by a concurrent rebalance.
+ */
+static QemuSeqLock pageflags_seq;
+
 static PageFlagsNode *pageflags_find(target_ulong start, target_ulong last)
 {
     IntervalTreeNode *n;
@@ -162,6 +170,21 @@ static PageFlagsNode *pageflags_find(target_ulong start, target_ulong last)
     return n ? container_of(n, PageFlagsNode, itree) : NULL;
 }
 
+/*
+ * See util/interval-tree.c re lockless lookups: no false positives but
+ * there are false negatives.  A miss can be trusted only if no update
+ * of the tree overlapped the lookup.  Return false if it cannot, in
+ * which case the caller must retry with the mmap lock held.
+ */
+static bool pageflags_find_lockless(target_ulong start, target_ulong last,
+                                    PageFlagsNode **pp)
+{
+    unsigned seq = seqlock_read_begin(&pageflags_seq);
+
+    *pp = pageflags_find(start, last);
+    return *pp || !seqlock_read_retry(&pageflags_seq, seq);
+}
+
 static PageFlagsNode *pageflags_next(PageFlagsNode *p, target_ulong start,
                                      target_ulong last)
 {
@@ -217,15 +240,10 @@ void page_dump(FILE *f)
 
 int page_get_flags(target_ulong address)
 {
-    PageFlagsNode *p = pageflags_find(address, address);
+    PageFlagsNode *p;
 
-    /*
-     * See util/interval-tree.c re lockless lookups: no false positives but
-     * there are false negatives.  If we find nothing, retry with the mmap
-     * lock acquired.
-     */
-    if (p) {
-        return p->flags;
+    if (pageflags_find_lockless(address, address, &p)) {
+        return p ? p->flags : 0;
     }
     if (have_mmap_lock()) {
         return 0;
@@ -512,6 +530,7 @@ void page_set_flags(target_ulong start, target_ulong last, int flags)
         }
     }
 
+    seqlock_write_begin(&pageflags_seq);
     if (!flags || reset) {
         page_reset_target_data(start, last);
         inval_tb |= pageflags_unset(start, last);
@@ -520,6 +539,7 @@ void page_set_flags(target_ulong start, target_ulong last, int flags)
         inval_tb |= pageflags_set_clear(start, last, flags,
                                         ~(reset ? 0 : PAGE_STICKY));
     }
+    seqlock_write_end(&pageflags_seq);
     if (inval_tb) {
         tb_invalidate_phys_range(start, last);
     }
@@ -542,23 +562,20 @@ bool page_check_range(target_ulong start, target_ulong len, int flags)
 
     locked = have_mmap_lock();
     while (true) {
-        PageFlagsNode *p = pageflags_find(start, last);
+        PageFlagsNode *p;
         int missing;
 
-        if (!p) {
+        if (!pageflags_find_lockless(start, last, &p)) {
+            /* The miss may be false: retry with the lock held. */
             if (!locked) {
-                /*
-                 * Lockless lookups have false negatives.
-                 * Retry with the lock held.
-                 */
                 mmap_lock();
                 locked = -1;
-                p = pageflags_find(start, last);
-            }
-            if (!p) {
-                ret = false; /* entire region invalid */
-                break;
             }
+            p = pageflags_find(start, last);
+        }
+        if (!p) {
+            ret = false; /* entire region invalid */
+            break;
         }
         if (start < p->itree.start) {
             ret = false; /* initial bytes invalid */
@@ -683,7 +700,9 @@ void page_protect(tb_page_addr_t address)
     }
 
     if (prot & PAGE_WRITE) {
+        seqlock_write_begin(&pageflags_seq);
         pageflags_set_clear(start, last, 0, PAGE_WRITE);
+        seqlock_write_end(&pageflags_seq);
         mprotect(g2h_untagged(start), last - start + 1,
                  prot & (PAGE_READ | PAGE_EXEC) ? PROT_READ : PROT_NONE);
     }
@@ -738,7 +757,9 @@ int page_unprotect(target_ulong address, uintptr_t pc)
             start = address & TARGET_PAGE_MASK;
             len = TARGET_PAGE_SIZE;
             prot = p->flags | PAGE_WRITE;
+            seqlock_write_begin(&pageflags_seq);
             pageflags_set_clear(start, start + len - 1, PAGE_WRITE, 0);
+            seqlock_write_end(&pageflags_seq);
             current_tb_invalidated = tb_invalidate_phys_page_unwind(start, pc);
         } else {
             start = address & -host_page_size;
@@ -753,8 +774,10 @@ int page_unprotect(target_ulong address, uintptr_t pc)
                     prot |= p->flags;
                     if (p->flags & PAGE_WRITE_ORG) {
                         prot |= PAGE_WRITE;
+                        seqlock_write_begin(&pageflags_seq);
                         pageflags_set_clear(addr, addr + TARGET_PAGE_SIZE - 1,
                                             PAGE_WRITE, 0);
+                        seqlock_write_end(&pageflags_seq);
                     }
                 }
                 /*
@@ -25,6 +25,8 @@ static GRand *rng;
 static int limit;
 static bool sys;
 
+static struct qemu_plugin_mem_batch *mem_batch;
+
 enum EvictionPolicy {
     LRU,
     FIFO,
@@ -385,31 +387,42 @@ static bool access_cache(Cache *cache, uint64_t addr)
     return false;
 }
 
-static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
-                            uint64_t vaddr, void *userdata)
+/* Access the L1 data cache, with its lock held.  Returns true on a hit. */
+static bool l1_data_access(int cache_idx, uint64_t effective_addr,
+                           InsnData *insn)
 {
-    uint64_t effective_addr;
-    struct qemu_plugin_hwaddr *hwaddr;
-    int cache_idx;
-    InsnData *insn;
     bool hit_in_l1;
 
-    hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
-    if (hwaddr && qemu_plugin_hwaddr_is_io(hwaddr)) {
-        return;
-    }
-
-    effective_addr = hwaddr ? qemu_plugin_hwaddr_phys_addr(hwaddr) : vaddr;
-    cache_idx = vcpu_index % cores;
-
-    g_mutex_lock(&l1_dcache_locks[cache_idx]);
     hit_in_l1 = access_cache(l1_dcaches[cache_idx], effective_addr);
     if (!hit_in_l1) {
-        insn = userdata;
         __atomic_fetch_add(&insn->l1_dmisses, 1, __ATOMIC_SEQ_CST);
         l1_dcaches[cache_idx]->misses++;
     }
     l1_dcaches[cache_idx]->accesses++;
+    return hit_in_l1;
+}
+
+/* Access the L2 cache after an L1 miss, with its lock held. */
+static void l2_data_access(int cache_idx, uint64_t effective_addr,
+                           InsnData *insn)
+{
+    if (!access_cache(l2_ucaches[cache_idx], effective_addr)) {
+        __atomic_fetch_add(&insn->l2_misses, 1, __ATOMIC_SEQ_CST);
+        l2_ucaches[cache_idx]->misses++;
+    }
+    l2_ucaches[cache_idx]->accesses++;
+}
+
+static void data_access(unsigned int vcpu_index, uint64_t effective_addr,
+                        InsnData *insn)
+{
+    int cache_idx;
+    bool hit_in_l1;
+
+    cache_idx = vcpu_index % cores;
+
+    g_mutex_lock(&l1_dcache_locks[cache_idx]);
+    hit_in_l1 = l1_data_access(cache_idx, effective_addr, insn);
     g_mutex_unlock(&l1_dcache_locks[cache_idx]);
 
     if (hit_in_l1 || !use_l2) {
@@ -418,33 +431,48 @@ static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
     }
 
     g_mutex_lock(&l2_ucache_locks[cache_idx]);
-    if (!access_cache(l2_ucaches[cache_idx], effective_addr)) {
-        insn = userdata;
-        __atomic_fetch_add(&insn->l2_misses, 1, __ATOMIC_SEQ_CST);
-        l2_ucaches[cache_idx]->misses++;
-    }
-    l2_ucaches[cache_idx]->accesses++;
+    l2_data_access(cache_idx, effective_addr, insn);
     g_mutex_unlock(&l2_ucache_locks[cache_idx]);
 }
 
-static void vcpu_insn_exec(unsigned int vcpu_index, void *userdata)
+static void vcpu_mem_access(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *userdata)
 {
-    uint64_t insn_addr;
-    InsnData *insn;
-    int cache_idx;
-    bool hit_in_l1;
+    uint64_t effective_addr;
+    struct qemu_plugin_hwaddr *hwaddr;
 
-    insn_addr = ((InsnData *) userdata)->addr;
+    hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
+    if (hwaddr && qemu_plugin_hwaddr_is_io(hwaddr)) {
+        return;
+    }
+
+    effective_addr = hwaddr ? qemu_plugin_hwaddr_phys_addr(hwaddr) : vaddr;
+    data_access(vcpu_index, effective_addr, userdata);
+}
+
+/* Access the L1 instruction cache, with its lock held. */
+static bool l1_insn_access(int cache_idx, uint64_t insn_addr, InsnData *insn)
+{
+    bool hit_in_l1;
 
-    cache_idx = vcpu_index % cores;
-    g_mutex_lock(&l1_icache_locks[cache_idx]);
     hit_in_l1 = access_cache(l1_icaches[cache_idx], insn_addr);
     if (!hit_in_l1) {
-        insn = userdata;
         __atomic_fetch_add(&insn->l1_imisses, 1, __ATOMIC_SEQ_CST);
         l1_icaches[cache_idx]->misses++;
     }
     l1_icaches[cache_idx]->accesses++;
+    return hit_in_l1;
+}
+
+static void vcpu_insn_exec(unsigned int vcpu_index, void *userdata)
+{
+    InsnData *insn = userdata;
+    int cache_idx;
+    bool hit_in_l1;
+
+    cache_idx = vcpu_index % cores;
+    g_mutex_lock(&l1_icache_locks[cache_idx]);
+    hit_in_l1 = l1_insn_access(cache_idx, insn->addr, insn);
     g_mutex_unlock(&l1_icache_locks[cache_idx]);
 
     if (hit_in_l1 || !use_l2) {
@@ -453,15 +481,58 @@ static void vcpu_insn_exec(unsigned int vcpu_index, void *userdata)
     }
 
     g_mutex_lock(&l2_ucache_locks[cache_idx]);
-    if (!access_cache(l2_ucaches[cache_idx], insn_addr)) {
-        insn = userdata;
-        __atomic_fetch_add(&insn->l2_misses, 1, __ATOMIC_SEQ_CST);
-        l2_ucaches[cache_idx]->misses++;
-    }
-    l2_ucaches[cache_idx]->accesses++;
+    l2_data_access(cache_idx, insn->addr, insn);
     g_mutex_unlock(&l2_ucache_locks[cache_idx]);
 }
 
+/*
+ * Batches are only used in user mode, where instructions are keyed by
+ * their virtual address and the data address needs no translation.
+ * Instruction executions are recorded in the same buffer as the data
+ * accesses, so the records replay the accesses in program order and
+ * the L2 cache sees the same sequence as without batching.
+ */
+static void vcpu_mem_batch(unsigned int vcpu_index,
+                           const qemu_plugin_mem_record *recs, size_t n,
+                           void *userdata)
+{
+    int cache_idx = vcpu_index % cores;
+    InsnData *insn = NULL;
+    uint64_t pc = 0;
+    bool hit_in_l1;
+    size_t i;
+
+    /* Take the locks once for the whole batch, not once per access. */
+    g_mutex_lock(&l1_icache_locks[cache_idx]);
+    g_mutex_lock(&l1_dcache_locks[cache_idx]);
+    if (use_l2) {
+        g_mutex_lock(&l2_ucache_locks[cache_idx]);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (!insn || recs[i].pc != pc) {
+            pc = recs[i].pc;
+            g_mutex_lock(&hashtable_lock);
+            insn = g_hash_table_lookup(miss_ht, GUINT_TO_POINTER(pc));
+            g_mutex_unlock(&hashtable_lock);
+        }
+        if (!recs[i].info) {
+            hit_in_l1 = l1_insn_access(cache_idx, recs[i].vaddr, insn);
+        } else {
+            hit_in_l1 = l1_data_access(cache_idx, recs[i].vaddr, insn);
+        }
+        if (!hit_in_l1 && use_l2) {
+            l2_data_access(cache_idx, recs[i].vaddr, insn);
+        }
+    }
+
+    if (use_l2) {
+        g_mutex_unlock(&l2_ucache_locks[cache_idx]);
+    }
+    g_mutex_unlock(&l1_dcache_locks[cache_idx]);
+    g_mutex_unlock(&l1_icache_locks[cache_idx]);
+}
+
 static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
 {
     size_t n_insns;
@@ -496,12 +567,17 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
         }
         g_mutex_unlock(&hashtable_lock);
 
-        qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
-                                         QEMU_PLUGIN_CB_NO_REGS,
-                                         rw, data);
-
-        qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_insn_exec,
-                                               QEMU_PLUGIN_CB_NO_REGS, data);
+        if (mem_batch) {
+            qemu_plugin_register_vcpu_insn_exec_batch(insn, mem_batch);
+            qemu_plugin_register_vcpu_mem_batch(insn, rw, mem_batch);
+        } else {
+            qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem_access,
+                                             QEMU_PLUGIN_CB_NO_REGS,
+                                             rw, data);
+            qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_insn_exec,
+                                                   QEMU_PLUGIN_CB_NO_REGS,
+                                                   data);
+        }
     }
 }
 
@@ -702,6 +778,11 @@ finish:
 
 static void plugin_exit(qemu_plugin_id_t id, void *p)
 {
+    if (mem_batch) {
+        qemu_plugin_mem_batch_flush(mem_batch);
+        qemu_plugin_mem_batch_free(mem_batch);
+    }
+
     log_stats();
     log_top_insns();
 
@@ -749,6 +830,7 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
     int l1_iassoc, l1_iblksize, l1_icachesize;
     int l1_dassoc, l1_dblksize, l1_dcachesize;
     int l2_assoc, l2_blksize, l2_cachesize;
+    int batch = 0;
 
     limit = 32;
     sys = info->system_emulation;
@@ -798,6 +880,8 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
         } else if (g_strcmp0(tokens[0], "l2assoc") == 0) {
             use_l2 = true;
             l2_assoc = STRTOLL(tokens[1]);
+        } else if (g_strcmp0(tokens[0], "batch") == 0) {
+            batch = STRTOLL(tokens[1]);
         } else if (g_strcmp0(tokens[0], "l2") == 0) {
             if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &use_l2)) {
                 fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
@@ -820,6 +904,15 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
         }
     }
 
+    if (batch < 0) {
+        fprintf(stderr, "invalid batch size: %d\n", batch);
+        return -1;
+    }
+    if (batch && sys) {
+        fprintf(stderr, "batch is only supported in user mode\n");
+        return -1;
+    }
+
     policy_init();
 
     l1_dcaches = caches_init(l1_dblksize, l1_dassoc, l1_dcachesize);
@@ -850,6 +943,10 @@ int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
     l1_icache_locks = g_new0(GMutex, cores);
     l2_ucache_locks = use_l2 ? g_new0(GMutex, cores) : NULL;
 
+    if (batch) {
+        mem_batch = qemu_plugin_mem_batch_new(batch, vcpu_mem_batch, NULL);
+    }
+
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
 
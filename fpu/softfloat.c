@@ -241,6 +241,26 @@ static inline bool can_use_fpu(const float_status *s)
                   s->float_rounding_mode == float_round_nearest_even);
 }
 
+/*
+ * Likewise for rounding to an integer in mode @rmode, which need not be
+ * the one of @s.  The host rounds to nearest even, and truncates.
+ */
+static inline bool can_use_fpu_rmode(FloatRoundMode rmode, int scale,
+                                     const float_status *s)
+{
+    if (QEMU_NO_HARDFLOAT || scale != 0) {
+        return false;
+    }
+    return likely(s->float_exception_flags & float_flag_inexact &&
+                  (rmode == float_round_nearest_even ||
+                   rmode == float_round_to_zero));
+}
+
+static inline double hard_round_to_int(double a, FloatRoundMode rmode)
+{
+    return rmode == float_round_to_zero ? trunc(a) : rint(a);
+}
+
 /*
  * Hardfloat generation functions. Each operation can have two flavors:
  * either using softfloat primitives (e.g. float32_is_zero_or_normal) for
@@ -2829,6 +2849,23 @@ float32 float64_to_float32(float64 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (float64_is_zero(a)) {
+        return float32_set_sign(float32_zero, float64_is_neg(a));
+    } else if (likely(can_use_fpu(s) && float64_is_normal(a))) {
+        /*
+         * Narrowing conversion of a value within the normal range of
+         * float32 can only be inexact; leave the rest to softfloat.
+         */
+        union_float64 ua;
+        union_float32 ur;
+
+        ua.s = a;
+        if (fabs(ua.h) >= FLT_MIN && fabs(ua.h) <= FLT_MAX) {
+            ur.h = ua.h;
+            return ur.s;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
     return float32_round_pack_canonical(&p, s);
@@ -2994,6 +3031,14 @@ float32 float32_round_to_int(float32 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(can_use_fpu(s) && float32_is_zero_or_normal(a))) {
+        union_float32 ua;
+
+        ua.s = a;
+        ua.h = rintf(ua.h);
+        return ua.s;
+    }
+
     float32_unpack_canonical(&p, a, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float32_params);
     return float32_round_pack_canonical(&p, s);
@@ -3003,6 +3048,14 @@ float64 float64_round_to_int(float64 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(can_use_fpu(s) && float64_is_zero_or_normal(a))) {
+        union_float64 ua;
+
+        ua.s = a;
+        ua.h = rint(ua.h);
+        return ua.s;
+    }
+
     float64_unpack_canonical(&p, a, s);
     parts_round_to_int(&p, s->float_rounding_mode, 0, s, &float64_params);
     return float64_round_pack_canonical(&p, s);
@@ -3093,6 +3146,17 @@ int32_t float32_to_int32_scalbn(float32 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float32_is_zero_or_normal(a)) {
+        union_float32 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= -0x1p31 && r < 0x1p31) {
+            return r;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
 }
@@ -3102,6 +3166,17 @@ int64_t float32_to_int64_scalbn(float32 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float32_is_zero_or_normal(a)) {
+        union_float32 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= -0x1p63 && r < 0x1p63) {
+            return r;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
 }
@@ -3120,6 +3195,17 @@ int32_t float64_to_int32_scalbn(float64 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float64_is_zero_or_normal(a)) {
+        union_float64 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= -0x1p31 && r < 0x1p31) {
+            return r;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT32_MIN, INT32_MAX, s);
 }
@@ -3129,6 +3215,17 @@ int64_t float64_to_int64_scalbn(float64 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float64_is_zero_or_normal(a)) {
+        union_float64 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= -0x1p63 && r < 0x1p63) {
+            return r;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_sint(&p, rmode, scale, INT64_MIN, INT64_MAX, s);
 }
@@ -3520,6 +3617,17 @@ uint32_t float32_to_uint32_scalbn(float32 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float32_is_zero_or_normal(a)) {
+        union_float32 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= 0 && r < 0x1p32) {
+            return r;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
 }
@@ -3529,6 +3637,17 @@ uint64_t float32_to_uint64_scalbn(float32 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float32_is_zero_or_normal(a)) {
+        union_float32 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= 0 && r < 0x1p64) {
+            return r;
+        }
+    }
+
     float32_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
 }
@@ -3547,6 +3666,17 @@ uint32_t float64_to_uint32_scalbn(float64 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float64_is_zero_or_normal(a)) {
+        union_float64 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= 0 && r < 0x1p32) {
+            return r;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT32_MAX, s);
 }
@@ -3556,6 +3686,17 @@ uint64_t float64_to_uint64_scalbn(float64 a, FloatRoundMode rmode, int scale,
 {
     FloatParts64 p;
 
+    if (can_use_fpu_rmode(rmode, scale, s) && float64_is_zero_or_normal(a)) {
+        union_float64 ua;
+        double r;
+
+        ua.s = a;
+        r = hard_round_to_int(ua.h, rmode);
+        if (r >= 0 && r < 0x1p64) {
+            return r;
+        }
+    }
+
     float64_unpack_canonical(&p, a, s);
     return parts_float_to_uint(&p, rmode, scale, UINT64_MAX, s);
 }
@@ -3948,7 +4089,11 @@ float64 int64_to_float64(int64_t a, float_status *status)
 
 float64 int32_to_float64(int32_t a, float_status *status)
 {
-    return int64_to_float64_scalbn(a, 0, status);
+    /* Every int32_t is exactly representable.  */
+    union_float64 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 float64 int16_to_float64(int16_t a, float_status *status)
@@ -4168,7 +4313,11 @@ float64 uint64_to_float64(uint64_t a, float_status *status)
 
 float64 uint32_to_float64(uint32_t a, float_status *status)
 {
-    return uint64_to_float64_scalbn(a, 0, status);
+    /* Every uint32_t is exactly representable.  */
+    union_float64 ur;
+
+    ur.h = a;
+    return ur.s;
 }
 
 float64 uint16_to_float64(uint16_t a, float_status *status)
@@ -270,6 +270,23 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-profile",
+        .args_type  = "max:i?",
+        .params     = "[max]",
+        .help       = "show the guest PCs most often sampled by the TB "
+                      "profiler, up to max entries (default: 20)",
+        .cmd        = hmp_info_tb_profile,
+    },
+#endif
+
+SRST
+  ``info tb-profile`` [*max*]
+    Show the guest PCs most often sampled by the TB profiler, up to *max*
+    entries (default: 20), with their symbol when it is known.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
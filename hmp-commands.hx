@@ -639,6 +639,27 @@ SRST
   whether profiling is on or off.
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-profile",
+        .args_type  = "op:s?,interval:i?",
+        .params     = "[on|off|reset] [interval]",
+        .help       = "enable, disable or reset sampling of the translation "
+                      "blocks executed by each vCPU, every interval ms "
+                      "(default: 10). With no arguments, prints whether "
+                      "profiling is on or off.",
+        .cmd        = hmp_tb_profile,
+    },
+#endif
+
+SRST
+``tb-profile [on|off|reset]`` [*interval*]
+  Enable, disable or reset sampling of the translation blocks executed by each
+  vCPU, every *interval* milliseconds (default: 10).  The samples are shown by
+  ``info tb-profile``.  With no arguments, prints whether profiling is on or
+  off.
+ERST
+
     {
         .name       = "system_reset",
         .args_type  = "",
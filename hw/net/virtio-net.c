@@ -31,9 +31,11 @@
 #include "net/vhost_net.h"
 #include "net/announce.h"
 #include "hw/virtio/virtio-bus.h"
+#include "hw/virtio/iothread-vq-mapping.h"
 #include "qapi/error.h"
 #include "qapi/qapi-events-net.h"
 #include "hw/qdev-properties.h"
+#include "hw/qdev-properties-system.h"
 #include "qapi/qapi-types-migration.h"
 #include "qapi/qapi-events-migration.h"
 #include "hw/virtio/virtio-access.h"
@@ -138,6 +140,32 @@ static void flush_or_purge_queued_packets(NetClientState *nc)
  * - we could suppress RX interrupt if we were so inclined.
  */
 
+/* Interrupts from queues that run in an IOThread must use the irqfd */
+static void virtio_net_notify(VirtIONet *n, VirtQueue *vq)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+
+    if (n->dataplane_started) {
+        virtio_notify_irqfd(vdev, vq);
+    } else {
+        virtio_notify(vdev, vq);
+    }
+}
+
+/*
+ * Run @fn in the AioContext of the queue pair so that it does not race with
+ * the datapath when the queue pair is serviced by an IOThread.
+ */
+static void virtio_net_queue_run(VirtIONetQueue *q, void (*fn)(void *),
+                                 void *opaque)
+{
+    if (q->ctx && q->ctx != qemu_get_aio_context()) {
+        aio_wait_bh_oneshot(q->ctx, fn, opaque);
+    } else {
+        fn(opaque);
+    }
+}
+
 static void virtio_net_get_config(VirtIODevice *vdev, uint8_t *config)
 {
     VirtIONet *n = VIRTIO_NET(vdev);
@@ -200,7 +228,9 @@ static void virtio_net_set_config(VirtIODevice *vdev, const uint8_t *config)
     if (!virtio_vdev_has_feature(vdev, VIRTIO_NET_F_CTRL_MAC_ADDR) &&
         !virtio_vdev_has_feature(vdev, VIRTIO_F_VERSION_1) &&
         memcmp(netcfg.mac, n->mac, ETH_ALEN)) {
+        seqlock_write_begin(&n->rx_filter_seqlock);
         memcpy(n->mac, netcfg.mac, ETH_ALEN);
+        seqlock_write_end(&n->rx_filter_seqlock);
         qemu_format_nic_info_str(qemu_get_queue(n->nic), n->mac);
     }
 
@@ -378,64 +408,83 @@ static void virtio_net_drop_tx_queue_data(VirtIODevice *vdev, VirtQueue *vq)
 {
     unsigned int dropped = virtqueue_drop_all(vq);
     if (dropped) {
-        virtio_notify(vdev, vq);
+        virtio_net_notify(VIRTIO_NET(vdev), vq);
+    }
+}
+
+typedef struct VirtIONetQueueStatus {
+    VirtIONet *n;
+    int index;
+    uint8_t status;
+} VirtIONetQueueStatus;
+
+static void virtio_net_queue_set_status(void *opaque)
+{
+    VirtIONetQueueStatus *qs = opaque;
+    VirtIONet *n = qs->n;
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    NetClientState *ncs = qemu_get_subqueue(n->nic, qs->index);
+    VirtIONetQueue *q = &n->vqs[qs->index];
+    uint8_t queue_status = qs->status;
+    bool queue_started;
+
+    queue_started =
+        virtio_net_started(n, queue_status) && !n->vhost_started;
+
+    if (queue_started) {
+        qemu_flush_queued_packets(ncs);
+    }
+
+    if (!q->tx_waiting) {
+        return;
+    }
+
+    if (queue_started) {
+        if (q->tx_timer) {
+            timer_mod(q->tx_timer,
+                           qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + n->tx_timeout);
+        } else {
+            replay_bh_schedule_event(q->tx_bh);
+        }
+    } else {
+        if (q->tx_timer) {
+            timer_del(q->tx_timer);
+        } else {
+            qemu_bh_cancel(q->tx_bh);
+        }
+        if ((n->status & VIRTIO_NET_S_LINK_UP) == 0 &&
+            (queue_status & VIRTIO_CONFIG_S_DRIVER_OK) &&
+            vdev->vm_running) {
+            /* if tx is waiting we are likely have some packets in tx queue
+             * and disabled notification */
+            q->tx_waiting = 0;
+            virtio_queue_set_notification(q->tx_vq, 1);
+            virtio_net_drop_tx_queue_data(vdev, q->tx_vq);
+        }
     }
 }
 
 static void virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
 {
     VirtIONet *n = VIRTIO_NET(vdev);
-    VirtIONetQueue *q;
     int i;
-    uint8_t queue_status;
 
     virtio_net_vnet_endian_status(n, status);
     virtio_net_vhost_status(n, status);
 
     for (i = 0; i < n->max_queue_pairs; i++) {
-        NetClientState *ncs = qemu_get_subqueue(n->nic, i);
-        bool queue_started;
-        q = &n->vqs[i];
+        VirtIONetQueueStatus qs = {
+            .n = n,
+            .index = i,
+        };
 
         if ((!n->multiqueue && i != 0) || i >= n->curr_queue_pairs) {
-            queue_status = 0;
+            qs.status = 0;
         } else {
-            queue_status = status;
-        }
-        queue_started =
-            virtio_net_started(n, queue_status) && !n->vhost_started;
-
-        if (queue_started) {
-            qemu_flush_queued_packets(ncs);
-        }
-
-        if (!q->tx_waiting) {
-            continue;
+            qs.status = status;
         }
 
-        if (queue_started) {
-            if (q->tx_timer) {
-                timer_mod(q->tx_timer,
-                               qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + n->tx_timeout);
-            } else {
-                replay_bh_schedule_event(q->tx_bh);
-            }
-        } else {
-            if (q->tx_timer) {
-                timer_del(q->tx_timer);
-            } else {
-                qemu_bh_cancel(q->tx_bh);
-            }
-            if ((n->status & VIRTIO_NET_S_LINK_UP) == 0 &&
-                (queue_status & VIRTIO_CONFIG_S_DRIVER_OK) &&
-                vdev->vm_running) {
-                /* if tx is waiting we are likely have some packets in tx queue
-                 * and disabled notification */
-                q->tx_waiting = 0;
-                virtio_queue_set_notification(q->tx_vq, 1);
-                virtio_net_drop_tx_queue_data(vdev, q->tx_vq);
-            }
-        }
+        virtio_net_queue_run(&n->vqs[i], virtio_net_queue_set_status, &qs);
     }
 }
 
@@ -729,23 +778,41 @@ static int peer_detach(VirtIONet *n, int index)
     return tap_disable(nc->peer);
 }
 
+typedef struct VirtIONetPeerOp {
+    VirtIONet *n;
+    int index;
+} VirtIONetPeerOp;
+
+static void virtio_net_set_queue_pair(void *opaque)
+{
+    VirtIONetPeerOp *op = opaque;
+    int r;
+
+    if (op->index < op->n->curr_queue_pairs) {
+        r = peer_attach(op->n, op->index);
+        assert(!r);
+    } else {
+        r = peer_detach(op->n, op->index);
+        assert(!r);
+    }
+}
+
 static void virtio_net_set_queue_pairs(VirtIONet *n)
 {
     int i;
-    int r;
 
     if (n->nic->peer_deleted) {
         return;
     }
 
     for (i = 0; i < n->max_queue_pairs; i++) {
-        if (i < n->curr_queue_pairs) {
-            r = peer_attach(n, i);
-            assert(!r);
-        } else {
-            r = peer_detach(n, i);
-            assert(!r);
-        }
+        VirtIONetPeerOp op = {
+            .n = n,
+            .index = i,
+        };
+
+        /* The peer's fd handlers may be running in an IOThread */
+        virtio_net_queue_run(&n->vqs[i], virtio_net_set_queue_pair, &op);
     }
 }
 
@@ -762,6 +829,18 @@ static uint64_t virtio_net_get_features(VirtIODevice *vdev, uint64_t features,
 
     virtio_add_feature(&features, VIRTIO_NET_F_MAC);
 
+    if (n->qp_aio_context) {
+        /*
+         * Software RSS would have to steer packets across IOThreads and a
+         * per-queue reset would race with the datapath.
+         */
+        if (!ebpf_rss_is_loaded(&n->ebpf_rss)) {
+            virtio_clear_feature(&features, VIRTIO_NET_F_RSS);
+        }
+        virtio_clear_feature(&features, VIRTIO_NET_F_HASH_REPORT);
+        virtio_clear_feature(&features, VIRTIO_F_RING_RESET);
+    }
+
     if (!peer_has_vnet_hdr(n)) {
         virtio_clear_feature(&features, VIRTIO_NET_F_CSUM);
         virtio_clear_feature(&features, VIRTIO_NET_F_HOST_TSO4);
@@ -1292,6 +1371,9 @@ static void virtio_net_commit_rss_config(VirtIONet *n)
         } else if (!virtio_net_attach_ebpf_rss(n)) {
             if (get_vhost_net(qemu_get_queue(n->nic)->peer)) {
                 warn_report("Can't load eBPF RSS for vhost");
+            } else if (n->qp_aio_context) {
+                warn_report("Can't load eBPF RSS - software RSS is not "
+                            "supported with iothreads");
             } else {
                 warn_report("Can't load eBPF RSS - fallback to software RSS");
                 n->rss_data.enabled_software_rss = true;
@@ -1568,11 +1650,17 @@ size_t virtio_net_handle_ctrl_iov(VirtIODevice *vdev,
     if (s != sizeof(ctrl)) {
         status = VIRTIO_NET_ERR;
     } else if (ctrl.class == VIRTIO_NET_CTRL_RX) {
+        seqlock_write_begin(&n->rx_filter_seqlock);
         status = virtio_net_handle_rx_mode(n, ctrl.cmd, iov, out_num);
+        seqlock_write_end(&n->rx_filter_seqlock);
     } else if (ctrl.class == VIRTIO_NET_CTRL_MAC) {
+        seqlock_write_begin(&n->rx_filter_seqlock);
         status = virtio_net_handle_mac(n, ctrl.cmd, iov, out_num);
+        seqlock_write_end(&n->rx_filter_seqlock);
     } else if (ctrl.class == VIRTIO_NET_CTRL_VLAN) {
+        seqlock_write_begin(&n->rx_filter_seqlock);
         status = virtio_net_handle_vlan_table(n, ctrl.cmd, iov, out_num);
+        seqlock_write_end(&n->rx_filter_seqlock);
     } else if (ctrl.class == VIRTIO_NET_CTRL_ANNOUNCE) {
         status = virtio_net_handle_announce(n, ctrl.cmd, iov, out_num);
     } else if (ctrl.class == VIRTIO_NET_CTRL_MQ) {
@@ -1645,6 +1733,16 @@ static bool virtio_net_can_receive(NetClientState *nc)
     return true;
 }
 
+static int virtio_net_rx_buffers(NetClientState *nc, int max)
+{
+    VirtIONetQueue *q = virtio_net_get_subqueue(nc);
+
+    if (!virtio_net_can_receive(nc)) {
+        return 0;
+    }
+    return virtio_queue_avail_count(q->rx_vq, max);
+}
+
 static int virtio_net_has_buffers(VirtIONetQueue *q, int bufsize)
 {
     int opaque;
@@ -1780,6 +1878,20 @@ static int receive_filter(VirtIONet *n, const uint8_t *buf, int size)
     return 0;
 }
 
+/* The filter may change under our feet if the datapath runs in an IOThread */
+static int virtio_net_receive_filter(VirtIONet *n, const uint8_t *buf,
+                                     int size)
+{
+    unsigned start;
+    int ret;
+
+    do {
+        start = seqlock_read_begin(&n->rx_filter_seqlock);
+        ret = receive_filter(n, buf, size);
+    } while (seqlock_read_retry(&n->rx_filter_seqlock, start));
+    return ret;
+}
+
 static uint8_t virtio_net_get_hash_type(bool hasip4,
                                         bool hasip6,
                                         EthL4HdrProto l4hdr_proto,
@@ -1926,7 +2038,7 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
         return 0;
     }
 
-    if (!receive_filter(n, buf, size))
+    if (!virtio_net_receive_filter(n, buf, size))
         return size;
 
     offset = i = 0;
@@ -1963,7 +2075,7 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
             virtio_error(vdev,
                          "virtio-net receive queue contains no in buffers");
             virtqueue_detach_element(q->rx_vq, elem, 0);
-            g_free(elem);
+            virtqueue_free_element(elem);
             err = -1;
             goto err;
         }
@@ -2003,7 +2115,7 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
          * Otherwise, drop it. */
         if (!n->mergeable_rx_bufs && offset < size) {
             virtqueue_unpop(q->rx_vq, elem, total);
-            g_free(elem);
+            virtqueue_free_element(elem);
             err = size;
             goto err;
         }
@@ -2024,18 +2136,18 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
     for (j = 0; j < i; j++) {
         /* signal other side */
         virtqueue_fill(q->rx_vq, elems[j], lens[j], j);
-        g_free(elems[j]);
+        virtqueue_free_element(elems[j]);
     }
 
     virtqueue_flush(q->rx_vq, i);
-    virtio_notify(vdev, q->rx_vq);
+    virtio_net_notify(n, q->rx_vq);
 
     return size;
 
 err:
     for (j = 0; j < i; j++) {
         virtqueue_detach_element(q->rx_vq, elems[j], lens[j]);
-        g_free(elems[j]);
+        virtqueue_free_element(elems[j]);
     }
 
     return err;
@@ -2659,13 +2771,12 @@ static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
     VirtIONetQueue *q = virtio_net_get_subqueue(nc);
-    VirtIODevice *vdev = VIRTIO_DEVICE(n);
     int ret;
 
     virtqueue_push(q->tx_vq, q->async_tx.elem, 0);
-    virtio_notify(vdev, q->tx_vq);
+    virtio_net_notify(n, q->tx_vq);
 
-    g_free(q->async_tx.elem);
+    virtqueue_free_element(q->async_tx.elem);
     q->async_tx.elem = NULL;
 
     virtio_queue_set_notification(q->tx_vq, 1);
@@ -2770,23 +2881,26 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
         if (ret == 0) {
             virtio_queue_set_notification(q->tx_vq, 0);
             q->async_tx.elem = elem;
+            qemu_send_flush(qemu_get_subqueue(n->nic, queue_index));
             return -EBUSY;
         }
 
 drop:
         virtqueue_push(q->tx_vq, elem, 0);
-        virtio_notify(vdev, q->tx_vq);
-        g_free(elem);
+        virtio_net_notify(n, q->tx_vq);
+        virtqueue_free_element(elem);
 
         if (++num_packets >= n->tx_burst) {
             break;
         }
     }
+    /* End of the burst, let a batching peer write it out */
+    qemu_send_flush(qemu_get_subqueue(n->nic, queue_index));
     return num_packets;
 
 detach:
     virtqueue_detach_element(q->tx_vq, elem, 0);
-    g_free(elem);
+    virtqueue_free_element(elem);
     return -EINVAL;
 }
 
@@ -2946,6 +3060,44 @@ static void virtio_net_tx_bh(void *opaque)
     }
 }
 
+static bool virtio_net_tx_uses_timer(VirtIONet *n)
+{
+    return n->net_conf.tx && !strcmp(n->net_conf.tx, "timer");
+}
+
+/* Create the TX timer or bottom half of @q in @ctx */
+static void virtio_net_tx_init(VirtIONetQueue *q, AioContext *ctx)
+{
+    VirtIONet *n = q->n;
+
+    q->ctx = ctx;
+    if (virtio_net_tx_uses_timer(n)) {
+        q->tx_timer = aio_timer_new(ctx, QEMU_CLOCK_VIRTUAL, SCALE_NS,
+                                    virtio_net_tx_timer, q);
+    } else if (ctx == qemu_get_aio_context()) {
+        q->tx_bh = qemu_bh_new_guarded(virtio_net_tx_bh, q,
+                                       &DEVICE(n)->mem_reentrancy_guard);
+    } else {
+        /*
+         * The reentrancy guard is per device and cannot be shared by queues
+         * that run in different threads.
+         */
+        q->tx_bh = aio_bh_new(ctx, virtio_net_tx_bh, q);
+    }
+}
+
+static void virtio_net_tx_cleanup(VirtIONetQueue *q)
+{
+    if (q->tx_timer) {
+        timer_free(q->tx_timer);
+        q->tx_timer = NULL;
+    } else {
+        qemu_bh_delete(q->tx_bh);
+        q->tx_bh = NULL;
+    }
+    q->ctx = NULL;
+}
+
 static void virtio_net_add_queue(VirtIONet *n, int index)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(n);
@@ -2953,23 +3105,24 @@ static void virtio_net_add_queue(VirtIONet *n, int index)
     n->vqs[index].rx_vq = virtio_add_queue(vdev, n->net_conf.rx_queue_size,
                                            virtio_net_handle_rx);
 
-    if (n->net_conf.tx && !strcmp(n->net_conf.tx, "timer")) {
+    if (virtio_net_tx_uses_timer(n)) {
         n->vqs[index].tx_vq =
             virtio_add_queue(vdev, n->net_conf.tx_queue_size,
                              virtio_net_handle_tx_timer);
-        n->vqs[index].tx_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL,
-                                              virtio_net_tx_timer,
-                                              &n->vqs[index]);
     } else {
         n->vqs[index].tx_vq =
             virtio_add_queue(vdev, n->net_conf.tx_queue_size,
                              virtio_net_handle_tx_bh);
-        n->vqs[index].tx_bh = qemu_bh_new_guarded(virtio_net_tx_bh, &n->vqs[index],
-                                                  &DEVICE(vdev)->mem_reentrancy_guard);
     }
 
+    virtio_queue_enable_element_pool(n->vqs[index].rx_vq,
+                                     sizeof(VirtQueueElement));
+    virtio_queue_enable_element_pool(n->vqs[index].tx_vq,
+                                     sizeof(VirtQueueElement));
+
     n->vqs[index].tx_waiting = 0;
     n->vqs[index].n = n;
+    virtio_net_tx_init(&n->vqs[index], qemu_get_aio_context());
 }
 
 static void virtio_net_del_queue(VirtIONet *n, int index)
@@ -2981,13 +3134,7 @@ static void virtio_net_del_queue(VirtIONet *n, int index)
     qemu_purge_queued_packets(nc);
 
     virtio_del_queue(vdev, index * 2);
-    if (q->tx_timer) {
-        timer_free(q->tx_timer);
-        q->tx_timer = NULL;
-    } else {
-        qemu_bh_delete(q->tx_bh);
-        q->tx_bh = NULL;
-    }
+    virtio_net_tx_cleanup(q);
     q->tx_waiting = 0;
     virtio_del_queue(vdev, index * 2 + 1);
 }
@@ -3365,6 +3512,7 @@ static NetClientInfo net_virtio_info = {
     .link_status_changed = virtio_net_set_link_status,
     .query_rx_filter = virtio_net_query_rxfilter,
     .announce = virtio_net_announce,
+    .rx_buffers = virtio_net_rx_buffers,
 };
 
 static bool virtio_net_guest_notifier_pending(VirtIODevice *vdev, int idx)
@@ -3595,6 +3743,369 @@ static bool failover_hide_primary_device(DeviceListener *listener,
     return qatomic_read(&n->failover_primary_hidden);
 }
 
+static bool virtio_net_qp_aio_context_init(VirtIONet *n, Error **errp)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    virtio_net_conf *conf = &n->net_conf;
+    BusState *qbus = BUS(qdev_get_parent_bus(DEVICE(vdev)));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    int i;
+
+    if (!conf->iothread && !conf->iothread_vq_mapping_list) {
+        return true;
+    }
+
+    if (conf->iothread && conf->iothread_vq_mapping_list) {
+        error_setg(errp,
+                   "iothread and iothread-vq-mapping properties cannot be set "
+                   "at the same time");
+        return false;
+    }
+
+    if (!k->set_guest_notifiers || !k->ioeventfd_assign) {
+        error_setg(errp,
+                   "device is incompatible with iothread "
+                   "(transport does not support notifiers)");
+        return false;
+    }
+    if (!virtio_device_ioeventfd_enabled(vdev)) {
+        error_setg(errp, "ioeventfd is required for iothread");
+        return false;
+    }
+
+    if (virtio_has_feature(n->host_features, VIRTIO_NET_F_RSC_EXT)) {
+        error_setg(errp, "guest_rsc_ext is not supported with iothread");
+        return false;
+    }
+
+    for (i = 0; i < n->max_queue_pairs; i++) {
+        NetClientState *peer = n->nic_conf.peers.ncs[i];
+
+        if (!peer) {
+            continue;
+        }
+        if (get_vhost_net(peer)) {
+            error_setg(errp, "iothread cannot be used with a vhost backend");
+            return false;
+        }
+        if (!qemu_has_set_aio_context(peer)) {
+            error_setg(errp, "netdev '%s' does not support iothread",
+                       peer->name);
+            return false;
+        }
+    }
+
+    n->qp_aio_context = g_new(AioContext *, n->max_queue_pairs);
+
+    if (conf->iothread_vq_mapping_list) {
+        if (!iothread_vq_mapping_apply(conf->iothread_vq_mapping_list,
+                                       n->qp_aio_context,
+                                       n->max_queue_pairs,
+                                       errp)) {
+            g_free(n->qp_aio_context);
+            n->qp_aio_context = NULL;
+            return false;
+        }
+    } else {
+        AioContext *ctx = iothread_get_aio_context(conf->iothread);
+
+        for (i = 0; i < n->max_queue_pairs; i++) {
+            n->qp_aio_context[i] = ctx;
+        }
+
+        /* Released in virtio_net_qp_aio_context_cleanup() */
+        object_ref(OBJECT(conf->iothread));
+    }
+
+    /*
+     * The guest notifier mask/pending callbacks are only implemented for
+     * vhost. Interrupts raised from an IOThread go through the irqfd.
+     */
+    vdev->use_guest_notifier_mask = false;
+    return true;
+}
+
+static void virtio_net_qp_aio_context_cleanup(VirtIONet *n)
+{
+    virtio_net_conf *conf = &n->net_conf;
+
+    if (!n->qp_aio_context) {
+        return;
+    }
+
+    if (conf->iothread_vq_mapping_list) {
+        iothread_vq_mapping_cleanup(conf->iothread_vq_mapping_list);
+    }
+
+    if (conf->iothread) {
+        object_unref(OBJECT(conf->iothread));
+    }
+
+    g_free(n->qp_aio_context);
+    n->qp_aio_context = NULL;
+}
+
+/*
+ * The AioContext servicing virtqueue @vq_index, NULL for the main loop. The
+ * control virtqueue is always the last one and stays in the main loop.
+ */
+static AioContext *virtio_net_vq_aio_context(VirtIONet *n, int vq_index)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    int qp = vq2q(vq_index);
+
+    if (!n->qp_aio_context || vq_index >= virtio_get_num_queues(vdev) - 1 ||
+        n->qp_aio_context[qp] == qemu_get_aio_context()) {
+        return NULL;
+    }
+    return n->qp_aio_context[qp];
+}
+
+/* Move the TX timer or bottom half of @q to @ctx, keeping pending work */
+static void virtio_net_tx_set_aio_context(VirtIONetQueue *q, AioContext *ctx)
+{
+    VirtIONet *n = q->n;
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+
+    if (q->ctx == ctx) {
+        return;
+    }
+
+    virtio_net_tx_cleanup(q);
+    virtio_net_tx_init(q, ctx);
+
+    if (q->tx_waiting && virtio_net_started(n, vdev->status) &&
+        !n->vhost_started) {
+        if (q->tx_timer) {
+            timer_mod(q->tx_timer,
+                      qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + n->tx_timeout);
+        } else {
+            replay_bh_schedule_event(q->tx_bh);
+        }
+    }
+}
+
+/*
+ * Netfilters are not thread-safe: fall back to the main loop if any is
+ * attached on either side of a queue pair.  New ones cannot be attached
+ * while the IOThreads run.
+ */
+static bool virtio_net_has_filters(VirtIONet *n)
+{
+    int i;
+
+    for (i = 0; i < n->max_queue_pairs; i++) {
+        if (qemu_net_client_has_filters(qemu_get_subqueue(n->nic, i))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Context: BQL held */
+static int virtio_net_start_ioeventfd(VirtIODevice *vdev)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    BusState *qbus = BUS(qdev_get_parent_bus(DEVICE(vdev)));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    int nvqs = virtio_get_num_queues(vdev);
+    bool iothreads = n->qp_aio_context != NULL;
+    int i, j, r;
+
+    if (iothreads && virtio_net_has_filters(n)) {
+        warn_report_once("%s: netfilters are attached, running the "
+                         "datapath in the main loop instead of IOThreads",
+                         DEVICE(n)->id ?: "virtio-net");
+        iothreads = false;
+    }
+
+    if (iothreads) {
+        /* Set up guest notifier (irq) */
+        r = k->set_guest_notifiers(qbus->parent, nvqs, true);
+        if (r != 0) {
+            error_report("virtio-net failed to set guest notifier (%d), "
+                         "ensure -accel kvm is set.", r);
+            return r;
+        }
+    }
+
+    /*
+     * Batch all the host notifiers in a single transaction to avoid
+     * quadratic time complexity in address_space_update_ioeventfds().
+     */
+    memory_region_transaction_begin();
+
+    for (i = 0; i < nvqs; i++) {
+        r = virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, true);
+        if (r != 0) {
+            j = i;
+
+            while (i--) {
+                virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
+            }
+
+            /*
+             * The transaction expects the ioeventfds to be open when it
+             * commits. Do it now, before the cleanup loop.
+             */
+            memory_region_transaction_commit();
+
+            while (j--) {
+                virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), j);
+            }
+            if (iothreads) {
+                k->set_guest_notifiers(qbus->parent, nvqs, false);
+            }
+            return r;
+        }
+    }
+
+    memory_region_transaction_commit();
+
+    if (!iothreads) {
+        for (i = 0; i < nvqs; i++) {
+            VirtQueue *vq = virtio_get_queue(vdev, i);
+            EventNotifier *notifier = virtio_queue_get_host_notifier(vq);
+
+            event_notifier_set_handler(notifier,
+                                       virtio_queue_host_notifier_read);
+            /* Kick right away to begin processing requests already in vring */
+            event_notifier_set(notifier);
+        }
+        return 0;
+    }
+
+    /* Paired with aio_notify_accept() on the read side */
+    n->dataplane_started = true;
+    smp_wmb();
+
+    for (i = 0; i < nvqs / 2; i++) {
+        AioContext *ctx = virtio_net_vq_aio_context(n, i * 2);
+        NetClientState *peer = qemu_get_subqueue(n->nic, i)->peer;
+
+        if (!ctx) {
+            continue;
+        }
+        virtio_net_tx_set_aio_context(&n->vqs[i], ctx);
+        if (peer) {
+            qemu_set_aio_context(peer, ctx);
+        }
+    }
+
+    /*
+     * Attaching the notifier also kicks the virtqueues, processing any
+     * buffers they may already have. RX is driven by the peer so it does not
+     * need to be polled.
+     */
+    for (i = 0; i < nvqs; i++) {
+        VirtQueue *vq = virtio_get_queue(vdev, i);
+        AioContext *ctx = virtio_net_vq_aio_context(n, i);
+
+        if (!ctx) {
+            EventNotifier *notifier = virtio_queue_get_host_notifier(vq);
+
+            event_notifier_set_handler(notifier,
+                                       virtio_queue_host_notifier_read);
+            event_notifier_set(notifier);
+        } else if (i % 2 == 0) {
+            virtio_queue_aio_attach_host_notifier_no_poll(vq, ctx);
+        } else {
+            virtio_queue_aio_attach_host_notifier(vq, ctx);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Stop processing the queue pair and hand the peer back to the main loop.
+ *
+ * Context: BH in IOThread
+ */
+static void virtio_net_stop_queue_pair_bh(void *opaque)
+{
+    VirtIONetQueue *q = opaque;
+    VirtIONet *n = q->n;
+    VirtQueue *vqs[] = { q->rx_vq, q->tx_vq };
+    NetClientState *peer = qemu_get_subqueue(n->nic, q - n->vqs)->peer;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(vqs); i++) {
+        virtio_queue_aio_detach_host_notifier(vqs[i],
+                                              qemu_get_current_aio_context());
+
+        /*
+         * Test and clear notifier after disabling event, in case poll
+         * callback didn't have time to run.
+         */
+        virtio_queue_host_notifier_read(virtio_queue_get_host_notifier(vqs[i]));
+    }
+
+    if (q->tx_timer) {
+        timer_del(q->tx_timer);
+    } else {
+        qemu_bh_cancel(q->tx_bh);
+    }
+
+    if (peer) {
+        qemu_set_aio_context(peer, NULL);
+    }
+}
+
+/* Context: BQL held */
+static void virtio_net_stop_ioeventfd(VirtIODevice *vdev)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    BusState *qbus = BUS(qdev_get_parent_bus(DEVICE(vdev)));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    int nvqs = virtio_get_num_queues(vdev);
+    int i;
+
+    if (n->dataplane_started) {
+        for (i = 0; i < nvqs / 2; i++) {
+            AioContext *ctx = virtio_net_vq_aio_context(n, i * 2);
+
+            if (ctx) {
+                aio_wait_bh_oneshot(ctx, virtio_net_stop_queue_pair_bh,
+                                    &n->vqs[i]);
+                virtio_net_tx_set_aio_context(&n->vqs[i],
+                                              qemu_get_aio_context());
+            }
+        }
+    }
+
+    /*
+     * Batch all the host notifiers in a single transaction to avoid
+     * quadratic time complexity in address_space_update_ioeventfds().
+     */
+    memory_region_transaction_begin();
+
+    for (i = 0; i < nvqs; i++) {
+        if (!n->dataplane_started || !virtio_net_vq_aio_context(n, i)) {
+            VirtQueue *vq = virtio_get_queue(vdev, i);
+
+            event_notifier_set_handler(virtio_queue_get_host_notifier(vq),
+                                       NULL);
+        }
+        virtio_bus_set_host_notifier(VIRTIO_BUS(qbus), i, false);
+    }
+
+    /*
+     * The transaction expects the ioeventfds to be open when it
+     * commits. Do it now, before the cleanup loop.
+     */
+    memory_region_transaction_commit();
+
+    for (i = 0; i < nvqs; i++) {
+        virtio_bus_cleanup_host_notifier(VIRTIO_BUS(qbus), i);
+    }
+
+    if (n->dataplane_started) {
+        /* Clean up guest notifier (irq) */
+        k->set_guest_notifiers(qbus->parent, nvqs, false);
+        n->dataplane_started = false;
+    }
+}
+
 static void virtio_net_device_realize(DeviceState *dev, Error **errp)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(dev);
@@ -3689,7 +4200,14 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
         virtio_cleanup(vdev);
         return;
     }
+
+    if (!virtio_net_qp_aio_context_init(n, errp)) {
+        virtio_cleanup(vdev);
+        return;
+    }
+
     n->vqs = g_new0(VirtIONetQueue, n->max_queue_pairs);
+    seqlock_init(&n->rx_filter_seqlock);
     n->curr_queue_pairs = 1;
     n->tx_timeout = n->net_conf.txtimer;
 
@@ -3823,6 +4341,7 @@ static void virtio_net_device_unrealize(DeviceState *dev)
     qemu_announce_timer_del(&n->announce_timer, false);
     g_free(n->vqs);
     qemu_del_nic(n->nic);
+    virtio_net_qp_aio_context_cleanup(n);
     virtio_net_rsc_cleanup(n);
     g_free(n->rss_data.indirections_table);
     net_rx_pkt_uninit(n->rx_pkt);
@@ -4021,6 +4540,10 @@ static Property virtio_net_properties[] = {
                       VIRTIO_NET_F_GUEST_USO6, true),
     DEFINE_PROP_BIT64("host_uso", VirtIONet, host_features,
                       VIRTIO_NET_F_HOST_USO, true),
+    DEFINE_PROP_LINK("iothread", VirtIONet, net_conf.iothread, TYPE_IOTHREAD,
+                     IOThread *),
+    DEFINE_PROP_IOTHREAD_VQ_MAPPING_LIST("iothread-vq-mapping", VirtIONet,
+                                         net_conf.iothread_vq_mapping_list),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -4043,6 +4566,8 @@ static void virtio_net_class_init(ObjectClass *klass, void *data)
     vdc->queue_reset = virtio_net_queue_reset;
     vdc->queue_enable = virtio_net_queue_enable;
     vdc->set_status = virtio_net_set_status;
+    vdc->start_ioeventfd = virtio_net_start_ioeventfd;
+    vdc->stop_ioeventfd = virtio_net_stop_ioeventfd;
     vdc->guest_notifier_mask = virtio_net_guest_notifier_mask;
     vdc->guest_notifier_pending = virtio_net_guest_notifier_pending;
     vdc->legacy_features |= (0x1 << VIRTIO_NET_F_GSO);
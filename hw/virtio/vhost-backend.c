@@ -191,7 +191,8 @@ static int vhost_kernel_set_features(struct vhost_dev *dev,
 static int vhost_kernel_set_backend_cap(struct vhost_dev *dev)
 {
     uint64_t features;
-    uint64_t f = 0x1ULL << VHOST_BACKEND_F_IOTLB_MSG_V2;
+    uint64_t f = 0x1ULL << VHOST_BACKEND_F_IOTLB_MSG_V2 |
+                 0x1ULL << VHOST_BACKEND_F_IOTLB_BATCH;
     int r;
 
     if (vhost_kernel_call(dev, VHOST_GET_BACKEND_FEATURES, &features)) {
@@ -400,6 +401,23 @@ int vhost_backend_invalidate_device_iotlb(struct vhost_dev *dev,
     return -ENODEV;
 }
 
+int vhost_backend_iotlb_batch(struct vhost_dev *dev, bool begin)
+{
+    struct vhost_iotlb_msg imsg = {
+        .type = begin ? VHOST_IOTLB_BATCH_BEGIN : VHOST_IOTLB_BATCH_END,
+    };
+
+    if (!(dev->backend_cap & (0x1ULL << VHOST_BACKEND_F_IOTLB_BATCH))) {
+        return 0;
+    }
+
+    if (dev->vhost_ops && dev->vhost_ops->vhost_send_device_iotlb_msg) {
+        return dev->vhost_ops->vhost_send_device_iotlb_msg(dev, &imsg);
+    }
+
+    return -ENODEV;
+}
+
 int vhost_backend_handle_iotlb_msg(struct vhost_dev *dev,
                                           struct vhost_iotlb_msg *imsg)
 {
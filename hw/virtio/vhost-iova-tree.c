@@ -9,6 +9,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/iova-tree.h"
+#include "qemu/lockable.h"
 #include "vhost-iova-tree.h"
 
 #define iova_min_addr qemu_real_host_page_size()
@@ -28,6 +29,12 @@ struct VhostIOVATree {
 
     /* IOVA address to qemu memory maps. */
     IOVATree *iova_taddr_map;
+
+    /*
+     * Taken by the updates, which all happen under the BQL, and by lookups
+     * from shadow virtqueues that run in an IOThread.
+     */
+    QemuMutex lock;
 };
 
 /**
@@ -44,6 +51,7 @@ VhostIOVATree *vhost_iova_tree_new(hwaddr iova_first, hwaddr iova_last)
     tree->iova_last = iova_last;
 
     tree->iova_taddr_map = iova_tree_new();
+    qemu_mutex_init(&tree->lock);
     return tree;
 }
 
@@ -53,6 +61,7 @@ VhostIOVATree *vhost_iova_tree_new(hwaddr iova_first, hwaddr iova_last)
 void vhost_iova_tree_delete(VhostIOVATree *iova_tree)
 {
     iova_tree_destroy(iova_tree->iova_taddr_map);
+    qemu_mutex_destroy(&iova_tree->lock);
     g_free(iova_tree);
 }
 
@@ -70,6 +79,29 @@ const DMAMap *vhost_iova_tree_find_iova(const VhostIOVATree *tree,
     return iova_tree_find_iova(tree->iova_taddr_map, map);
 }
 
+/**
+ * Find the IOVA address stored from a memory address, without the BQL
+ *
+ * @tree: The iova tree
+ * @map: The map with the memory address
+ * @result: Where to copy the stored mapping
+ *
+ * Return true if found.  The mapping is copied, because it may be removed
+ * as soon as the lock is dropped.
+ */
+bool vhost_iova_tree_find_iova_copy(VhostIOVATree *tree, const DMAMap *map,
+                                    DMAMap *result)
+{
+    const DMAMap *found;
+
+    QEMU_LOCK_GUARD(&tree->lock);
+    found = iova_tree_find_iova(tree->iova_taddr_map, map);
+    if (found) {
+        *result = *found;
+    }
+    return found;
+}
+
 /**
  * Allocate a new mapping
  *
@@ -94,6 +126,7 @@ int vhost_iova_tree_map_alloc(VhostIOVATree *tree, DMAMap *map)
     }
 
     /* Allocate a node in IOVA address */
+    QEMU_LOCK_GUARD(&tree->lock);
     return iova_tree_alloc_map(tree->iova_taddr_map, map, iova_first,
                                tree->iova_last);
 }
@@ -106,5 +139,6 @@ int vhost_iova_tree_map_alloc(VhostIOVATree *tree, DMAMap *map)
  */
 void vhost_iova_tree_remove(VhostIOVATree *iova_tree, DMAMap map)
 {
+    QEMU_LOCK_GUARD(&iova_tree->lock);
     iova_tree_remove(iova_tree->iova_taddr_map, map);
 }
@@ -12,6 +12,7 @@
 
 #include "qemu/error-report.h"
 #include "qapi/error.h"
+#include "block/aio-wait.h"
 #include "qemu/main-loop.h"
 #include "qemu/log.h"
 #include "qemu/memalign.h"
@@ -93,26 +94,29 @@ static bool vhost_svq_translate_addr(const VhostShadowVirtqueue *svq,
             .size = iovec[i].iov_len,
         };
         Int128 needle_last, map_last;
+        DMAMap map;
         size_t off;
 
-        const DMAMap *map = vhost_iova_tree_find_iova(svq->iova_tree, &needle);
         /*
-         * Map cannot be NULL since iova map contains all guest space and
-         * qemu already has a physical address mapped
+         * Map cannot be missing since iova map contains all guest space and
+         * qemu already has a physical address mapped.  The vhost-vdpa
+         * listener may update the tree concurrently when running in an
+         * IOThread, so take a copy.
          */
-        if (unlikely(!map)) {
+        if (unlikely(!vhost_iova_tree_find_iova_copy(svq->iova_tree, &needle,
+                                                     &map))) {
             qemu_log_mask(LOG_GUEST_ERROR,
                           "Invalid address 0x%"HWADDR_PRIx" given by guest",
                           needle.translated_addr);
             return false;
         }
 
-        off = needle.translated_addr - map->translated_addr;
-        addrs[i] = map->iova + off;
+        off = needle.translated_addr - map.translated_addr;
+        addrs[i] = map.iova + off;
 
         needle_last = int128_add(int128_make64(needle.translated_addr),
                                  int128_makes64(iovec[i].iov_len - 1));
-        map_last = int128_make64(map->translated_addr + map->size);
+        map_last = int128_make64(map.translated_addr + map.size);
         if (unlikely(int128_gt(needle_last, map_last))) {
             qemu_log_mask(LOG_GUEST_ERROR,
                           "Guest buffer expands over iova range");
@@ -217,7 +221,10 @@ static bool vhost_svq_add_split(VhostShadowVirtqueue *svq,
     return true;
 }
 
-static void vhost_svq_kick(VhostShadowVirtqueue *svq)
+/**
+ * Notify the device of the buffers made available since @old_idx.
+ */
+static void vhost_svq_kick(VhostShadowVirtqueue *svq, uint16_t old_idx)
 {
     bool needs_kick;
 
@@ -229,7 +236,7 @@ static void vhost_svq_kick(VhostShadowVirtqueue *svq)
 
     if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
         uint16_t avail_event = *(uint16_t *)(&svq->vring.used->ring[svq->vring.num]);
-        needs_kick = vring_need_event(avail_event, svq->shadow_avail_idx, svq->shadow_avail_idx - 1);
+        needs_kick = vring_need_event(avail_event, svq->shadow_avail_idx, old_idx);
     } else {
         needs_kick = !(svq->vring.used->flags & VRING_USED_F_NO_NOTIFY);
     }
@@ -266,7 +273,9 @@ int vhost_svq_add(VhostShadowVirtqueue *svq, const struct iovec *out_sg,
     svq->num_free -= ndescs;
     svq->desc_state[qemu_head].elem = elem;
     svq->desc_state[qemu_head].ndescs = ndescs;
-    vhost_svq_kick(svq);
+    if (!svq->kick_batched) {
+        vhost_svq_kick(svq, svq->shadow_avail_idx - 1);
+    }
     return 0;
 }
 
@@ -293,9 +302,18 @@ static int vhost_svq_add_element(VhostShadowVirtqueue *svq,
  */
 static void vhost_handle_guest_kick(VhostShadowVirtqueue *svq)
 {
+    uint16_t batch_start_idx = svq->shadow_avail_idx;
+
     /* Clear event notifier */
     event_notifier_test_and_clear(&svq->svq_kick);
 
+    /*
+     * Kick the device once for all the buffers forwarded here.  Callers'
+     * avail handlers may wait for the device to use what they add, so they
+     * keep kicking it for every buffer.
+     */
+    svq->kick_batched = !svq->ops;
+
     /* Forward to the device as many available buffers as possible */
     do {
         virtio_queue_set_notification(svq->vq, false);
@@ -336,7 +354,7 @@ static void vhost_handle_guest_kick(VhostShadowVirtqueue *svq)
                 }
 
                 /* VQ is full or broken, just return and ignore kicks */
-                return;
+                goto out;
             }
             /* elem belongs to SVQ or external caller now */
             elem = NULL;
@@ -344,6 +362,14 @@ static void vhost_handle_guest_kick(VhostShadowVirtqueue *svq)
 
         virtio_queue_set_notification(svq->vq, true);
     } while (!virtio_queue_empty(svq->vq));
+
+out:
+    if (svq->kick_batched) {
+        svq->kick_batched = false;
+        if (svq->shadow_avail_idx != batch_start_idx) {
+            vhost_svq_kick(svq, batch_start_idx);
+        }
+    }
 }
 
 /**
@@ -358,6 +384,36 @@ static void vhost_handle_guest_kick_notifier(EventNotifier *n)
     vhost_handle_guest_kick(svq);
 }
 
+static bool vhost_svq_guest_kick_poll(void *opaque)
+{
+    EventNotifier *n = opaque;
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue, svq_kick);
+
+    /* A full SVQ only makes progress once the device uses buffers */
+    return !svq->next_guest_avail_elem && !virtio_queue_empty(svq->vq);
+}
+
+static void vhost_svq_guest_kick_poll_ready(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue, svq_kick);
+
+    vhost_handle_guest_kick(svq);
+}
+
+static void vhost_svq_guest_kick_poll_begin(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue, svq_kick);
+
+    virtio_queue_set_notification(svq->vq, false);
+}
+
+static void vhost_svq_guest_kick_poll_end(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue, svq_kick);
+
+    virtio_queue_set_notification(svq->vq, true);
+}
+
 static bool vhost_svq_more_used(VhostShadowVirtqueue *svq)
 {
     uint16_t *used_idx = &svq->vring.used->idx;
@@ -566,16 +622,145 @@ static void vhost_svq_handle_call(EventNotifier *n)
     vhost_svq_flush(svq, true);
 }
 
-/**
- * Set the call notifier for the SVQ to call the guest
- *
- * @svq: Shadow virtqueue
- * @call_fd: call notifier
- *
- * Called on BQL context.
+static bool vhost_svq_call_poll(void *opaque)
+{
+    EventNotifier *n = opaque;
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue,
+                                             hdev_call);
+
+    return vhost_svq_more_used(svq);
+}
+
+static void vhost_svq_call_poll_ready(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue,
+                                             hdev_call);
+
+    vhost_svq_flush(svq, true);
+}
+
+static void vhost_svq_call_poll_begin(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue,
+                                             hdev_call);
+
+    vhost_svq_disable_notification(svq);
+}
+
+static void vhost_svq_call_poll_end(EventNotifier *n)
+{
+    VhostShadowVirtqueue *svq = container_of(n, VhostShadowVirtqueue,
+                                             hdev_call);
+
+    /* The event loop polls once more after this, catching a racing use */
+    vhost_svq_enable_notification(svq);
+}
+
+static AioContext *vhost_svq_get_aio_context(VhostShadowVirtqueue *svq)
+{
+    return svq->ctx ?: iohandler_get_aio_context();
+}
+
+/*
+ * Run @fn in the AioContext of the SVQ handlers, so that it does not race
+ * with them.  Called on BQL context.
  */
-void vhost_svq_set_svq_call_fd(VhostShadowVirtqueue *svq, int call_fd)
+static void vhost_svq_run(VhostShadowVirtqueue *svq, void (*fn)(void *),
+                          void *opaque)
 {
+    if (svq->ctx) {
+        aio_wait_bh_oneshot(svq->ctx, fn, opaque);
+    } else {
+        fn(opaque);
+    }
+}
+
+static void vhost_svq_attach_kick(void *opaque)
+{
+    VhostShadowVirtqueue *svq = opaque;
+    AioContext *ctx = vhost_svq_get_aio_context(svq);
+
+    /* Check for kicks that arrived before the handler was installed */
+    event_notifier_set(&svq->svq_kick);
+
+    if (svq->ctx) {
+        aio_set_event_notifier(ctx, &svq->svq_kick,
+                               vhost_handle_guest_kick_notifier,
+                               vhost_svq_guest_kick_poll,
+                               vhost_svq_guest_kick_poll_ready);
+        aio_set_event_notifier_poll(ctx, &svq->svq_kick,
+                                    vhost_svq_guest_kick_poll_begin,
+                                    vhost_svq_guest_kick_poll_end);
+    } else {
+        aio_set_event_notifier(ctx, &svq->svq_kick,
+                               vhost_handle_guest_kick_notifier, NULL, NULL);
+    }
+}
+
+static void vhost_svq_detach_kick(void *opaque)
+{
+    VhostShadowVirtqueue *svq = opaque;
+
+    aio_set_event_notifier(vhost_svq_get_aio_context(svq), &svq->svq_kick,
+                           NULL, NULL, NULL);
+    if (svq->ctx) {
+        /* ->io_poll_end() is not called if the handler goes away */
+        virtio_queue_set_notification(svq->vq, true);
+    }
+}
+
+static void vhost_svq_attach_handlers(void *opaque)
+{
+    VhostShadowVirtqueue *svq = opaque;
+    AioContext *ctx = vhost_svq_get_aio_context(svq);
+
+    if (svq->ctx) {
+        aio_set_event_notifier(ctx, &svq->hdev_call, vhost_svq_handle_call,
+                               vhost_svq_call_poll, vhost_svq_call_poll_ready);
+        aio_set_event_notifier_poll(ctx, &svq->hdev_call,
+                                    vhost_svq_call_poll_begin,
+                                    vhost_svq_call_poll_end);
+    } else {
+        aio_set_event_notifier(ctx, &svq->hdev_call, vhost_svq_handle_call,
+                               NULL, NULL);
+    }
+
+    if (event_notifier_get_fd(&svq->svq_kick) != VHOST_FILE_UNBIND) {
+        vhost_svq_attach_kick(svq);
+    }
+    svq->attached = true;
+}
+
+static void vhost_svq_detach_handlers(void *opaque)
+{
+    VhostShadowVirtqueue *svq = opaque;
+
+    aio_set_event_notifier(vhost_svq_get_aio_context(svq), &svq->hdev_call,
+                           NULL, NULL, NULL);
+    if (event_notifier_get_fd(&svq->svq_kick) != VHOST_FILE_UNBIND) {
+        vhost_svq_detach_kick(svq);
+    }
+    svq->attached = false;
+}
+
+static void vhost_svq_attach_bh(void *opaque)
+{
+    VhostShadowVirtqueue *svq = opaque;
+
+    vhost_svq_run(svq, vhost_svq_attach_handlers, svq);
+}
+
+typedef struct VhostSVQSetCallFd {
+    VhostShadowVirtqueue *svq;
+    int call_fd;
+} VhostSVQSetCallFd;
+
+static void vhost_svq_do_set_svq_call_fd(void *opaque)
+{
+    VhostSVQSetCallFd *op = opaque;
+    VhostShadowVirtqueue *svq = op->svq;
+    int call_fd = op->call_fd;
+
     if (call_fd == VHOST_FILE_UNBIND) {
         /*
          * Fail event_notifier_set if called handling device call.
@@ -589,6 +774,29 @@ void vhost_svq_set_svq_call_fd(VhostShadowVirtqueue *svq, int call_fd)
     }
 }
 
+/**
+ * Set the call notifier for the SVQ to call the guest
+ *
+ * @svq: Shadow virtqueue
+ * @call_fd: call notifier
+ *
+ * Called on BQL context.
+ */
+void vhost_svq_set_svq_call_fd(VhostShadowVirtqueue *svq, int call_fd)
+{
+    VhostSVQSetCallFd op = {
+        .svq = svq,
+        .call_fd = call_fd,
+    };
+
+    /* The guest may change its call notifier while the SVQ runs */
+    if (svq->attached) {
+        vhost_svq_run(svq, vhost_svq_do_set_svq_call_fd, &op);
+    } else {
+        vhost_svq_do_set_svq_call_fd(&op);
+    }
+}
+
 /**
  * Get the shadow vq vring address.
  * @svq: Shadow virtqueue
@@ -632,22 +840,33 @@ void vhost_svq_set_svq_kick_fd(VhostShadowVirtqueue *svq, int svq_kick_fd)
     bool poll_stop = VHOST_FILE_UNBIND != event_notifier_get_fd(svq_kick);
     bool poll_start = svq_kick_fd != VHOST_FILE_UNBIND;
 
-    if (poll_stop) {
-        event_notifier_set_handler(svq_kick, NULL);
+    /* Otherwise the handler is installed when the SVQ starts */
+    if (poll_stop && svq->attached) {
+        vhost_svq_run(svq, vhost_svq_detach_kick, svq);
     }
 
     event_notifier_init_fd(svq_kick, svq_kick_fd);
-    /*
-     * event_notifier_set_handler already checks for guest's notifications if
-     * they arrive at the new file descriptor in the switch, so there is no
-     * need to explicitly check for them.
-     */
-    if (poll_start) {
-        event_notifier_set(svq_kick);
-        event_notifier_set_handler(svq_kick, vhost_handle_guest_kick_notifier);
+
+    if (poll_start && svq->attached) {
+        vhost_svq_run(svq, vhost_svq_attach_kick, svq);
     }
 }
 
+/**
+ * Process guest kicks and device calls in @ctx instead of the main loop.
+ * Buffers are then also forwarded while the event loop of @ctx busy polls.
+ *
+ * @svq: The svq
+ * @ctx: The AioContext, or NULL for the main loop
+ *
+ * Must be called while the SVQ is stopped.
+ */
+void vhost_svq_set_aio_context(VhostShadowVirtqueue *svq, AioContext *ctx)
+{
+    assert(!svq->vq);
+    svq->ctx = ctx;
+}
+
 /**
  * Start the shadow virtqueue operation.
  *
@@ -661,7 +880,6 @@ void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
 {
     size_t desc_size;
 
-    event_notifier_set_handler(&svq->hdev_call, vhost_svq_handle_call);
     svq->next_guest_avail_elem = NULL;
     svq->shadow_avail_idx = 0;
     svq->shadow_used_idx = 0;
@@ -685,6 +903,16 @@ void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
     for (unsigned i = 0; i < svq->vring.num - 1; i++) {
         svq->desc_next[i] = cpu_to_le16(i + 1);
     }
+
+    /*
+     * The main loop cannot run the handlers before the device is running.
+     * An IOThread could, so wait until the caller drops the BQL.
+     */
+    if (svq->ctx) {
+        qemu_bh_schedule(svq->attach_bh);
+    } else {
+        vhost_svq_attach_handlers(svq);
+    }
 }
 
 /**
@@ -693,9 +921,14 @@ void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
  */
 void vhost_svq_stop(VhostShadowVirtqueue *svq)
 {
-    vhost_svq_set_svq_kick_fd(svq, VHOST_FILE_UNBIND);
     g_autofree VirtQueueElement *next_avail_elem = NULL;
 
+    qemu_bh_cancel(svq->attach_bh);
+    if (svq->attached) {
+        vhost_svq_run(svq, vhost_svq_detach_handlers, svq);
+    }
+    vhost_svq_set_svq_kick_fd(svq, VHOST_FILE_UNBIND);
+
     if (!svq->vq) {
         return;
     }
@@ -724,7 +957,6 @@ void vhost_svq_stop(VhostShadowVirtqueue *svq)
     g_free(svq->desc_state);
     munmap(svq->vring.desc, vhost_svq_driver_area_size(svq));
     munmap(svq->vring.used, vhost_svq_device_area_size(svq));
-    event_notifier_set_handler(&svq->hdev_call, NULL);
 }
 
 /**
@@ -742,6 +974,7 @@ VhostShadowVirtqueue *vhost_svq_new(const VhostShadowVirtqueueOps *ops,
     event_notifier_init_fd(&svq->svq_kick, VHOST_FILE_UNBIND);
     svq->ops = ops;
     svq->ops_opaque = ops_opaque;
+    svq->attach_bh = qemu_bh_new(vhost_svq_attach_bh, svq);
     return svq;
 }
 
@@ -754,5 +987,6 @@ void vhost_svq_free(gpointer pvq)
 {
     VhostShadowVirtqueue *vq = pvq;
     vhost_svq_stop(vq);
+    qemu_bh_delete(vq->attach_bh);
     g_free(vq);
 }
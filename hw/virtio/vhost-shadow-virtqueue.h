@@ -11,6 +11,7 @@
 #define VHOST_SHADOW_VIRTQUEUE_H
 
 #include "qemu/event_notifier.h"
+#include "block/aio.h"
 #include "hw/virtio/virtio.h"
 #include "standard-headers/linux/vhost_types.h"
 #include "hw/virtio/vhost-iova-tree.h"
@@ -110,6 +111,18 @@ typedef struct VhostShadowVirtqueue {
 
     /* Size of SVQ vring free descriptors */
     uint16_t num_free;
+
+    /* AioContext that processes kicks and calls, NULL for the main loop */
+    AioContext *ctx;
+
+    /* Installs the handlers in @ctx once the device is running */
+    QEMUBH *attach_bh;
+
+    /* Kick and call handlers are installed */
+    bool attached;
+
+    /* Forwarding a batch of guest buffers, kick the device at the end */
+    bool kick_batched;
 } VhostShadowVirtqueue;
 
 bool vhost_svq_valid_features(uint64_t features, Error **errp);
@@ -129,6 +142,7 @@ void vhost_svq_get_vring_addr(const VhostShadowVirtqueue *svq,
 size_t vhost_svq_driver_area_size(const VhostShadowVirtqueue *svq);
 size_t vhost_svq_device_area_size(const VhostShadowVirtqueue *svq);
 
+void vhost_svq_set_aio_context(VhostShadowVirtqueue *svq, AioContext *ctx);
 void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
                      VirtQueue *vq, VhostIOVATree *iova_tree);
 void vhost_svq_stop(VhostShadowVirtqueue *svq);
@@ -1262,6 +1262,9 @@ static bool vhost_vdpa_svqs_start(struct vhost_dev *dev)
             goto err;
         }
 
+        /* Callers with their own ops poll the SVQ from the main loop */
+        vhost_svq_set_aio_context(svq,
+                                  v->shadow_vq_ops ? NULL : v->shared->svq_ctx);
         vhost_svq_start(svq, dev->vdev, vq, v->shared->iova_tree);
         ok = vhost_vdpa_svq_map_rings(dev, svq, &addr, &err);
         if (unlikely(!ok)) {
@@ -1207,44 +1207,93 @@ static int vhost_memory_region_lookup(struct vhost_dev *hdev,
     return -EFAULT;
 }
 
+/*
+ * Maximum number of updates sent to the backend for one IOTLB miss, when a
+ * large IOMMU mapping spans several vhost memory regions.
+ */
+#define VHOST_IOTLB_UPDATE_MAX 16
+
+typedef struct VhostIOTLBUpdate {
+    uint64_t iova;
+    uint64_t uaddr;
+    uint64_t len;
+} VhostIOTLBUpdate;
+
 int vhost_device_iotlb_miss(struct vhost_dev *dev, uint64_t iova, int write)
 {
+    VhostIOTLBUpdate updates[VHOST_IOTLB_UPDATE_MAX];
     IOMMUTLBEntry iotlb;
-    uint64_t uaddr, len;
-    int ret = -EFAULT;
+    uint64_t uaddr, len, left, gpa;
+    unsigned int i, nr = 0;
+    int ret = 0;
 
     RCU_READ_LOCK_GUARD();
 
     trace_vhost_iotlb_miss(dev, 1);
+    dev->iotlb_misses++;
 
     iotlb = address_space_get_iotlb_entry(dev->vdev->dma_as,
                                           iova, write,
                                           MEMTXATTRS_UNSPECIFIED);
-    if (iotlb.target_as != NULL) {
-        ret = vhost_memory_region_lookup(dev, iotlb.translated_addr,
-                                         &uaddr, &len);
-        if (ret) {
-            trace_vhost_iotlb_miss(dev, 3);
-            error_report("Fail to lookup the translated address "
-                         "%"PRIx64, iotlb.translated_addr);
-            goto out;
+    if (iotlb.target_as == NULL) {
+        trace_vhost_iotlb_miss(dev, 2);
+        return -EFAULT;
+    }
+
+    /*
+     * Send the whole range covered by the entry, not only the memory region
+     * that holds @iova.  Nothing beyond the entry is translated: the vIOMMU
+     * would report a fault to the guest for an IOVA that it did not map.
+     */
+    iova &= ~iotlb.addr_mask;
+    gpa = iotlb.translated_addr;
+    left = iotlb.addr_mask;
+    while (nr < VHOST_IOTLB_UPDATE_MAX) {
+        if (vhost_memory_region_lookup(dev, gpa, &uaddr, &len)) {
+            break;
         }
 
-        len = MIN(iotlb.addr_mask + 1, len);
-        iova = iova & ~iotlb.addr_mask;
+        len = MIN(len - 1, left) + 1;
+        updates[nr++] = (VhostIOTLBUpdate) {
+            .iova = iova, .uaddr = uaddr, .len = len,
+        };
+        if (len - 1 == left) {
+            break;
+        }
+        iova += len;
+        gpa += len;
+        left -= len;
+    }
+
+    if (!nr) {
+        trace_vhost_iotlb_miss(dev, 3);
+        error_report("Fail to lookup the translated address "
+                     "%"PRIx64, iotlb.translated_addr);
+        return -EFAULT;
+    }
+
+    dev->iotlb_split_updates += nr - 1;
+    trace_vhost_iotlb_update(dev, updates[0].iova,
+                             updates[nr - 1].iova + updates[nr - 1].len -
+                             updates[0].iova, nr);
 
-        ret = vhost_backend_update_device_iotlb(dev, iova, uaddr,
-                                                len, iotlb.perm);
+    vhost_backend_iotlb_batch(dev, true);
+    for (i = 0; i < nr; i++) {
+        ret = vhost_backend_update_device_iotlb(dev, updates[i].iova,
+                                                updates[i].uaddr,
+                                                updates[i].len,
+                                                iotlb.perm);
         if (ret) {
             trace_vhost_iotlb_miss(dev, 4);
             error_report("Fail to update device iotlb");
-            goto out;
+            break;
         }
     }
+    vhost_backend_iotlb_batch(dev, false);
 
-    trace_vhost_iotlb_miss(dev, 2);
-
-out:
+    if (!ret) {
+        trace_vhost_iotlb_miss(dev, 2);
+    }
     return ret;
 }
 
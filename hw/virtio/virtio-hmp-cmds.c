@@ -171,6 +171,10 @@ void hmp_virtio_status(Monitor *mon, const QDict *qdict)
                        s->vhost_dev->log_enabled ? "true" : "false");
         monitor_printf(mon, "    log_size:       %"PRId64"\n",
                        s->vhost_dev->log_size);
+        monitor_printf(mon, "    iotlb_misses:   %"PRIu64"\n",
+                       s->vhost_dev->iotlb_misses);
+        monitor_printf(mon, "    iotlb_split:    %"PRIu64"\n",
+                       s->vhost_dev->iotlb_split_updates);
         monitor_printf(mon, "    Features:\n");
         hmp_virtio_dump_features(mon, s->vhost_dev->features);
         monitor_printf(mon, "    Acked features:\n");
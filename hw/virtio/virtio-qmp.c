@@ -790,6 +790,8 @@ VirtioStatus *qmp_x_query_virtio_status(const char *path, Error **errp)
         status->vhost_dev->backend_cap = hdev->backend_cap;
         status->vhost_dev->log_enabled = hdev->log_enabled;
         status->vhost_dev->log_size = hdev->log_size;
+        status->vhost_dev->iotlb_misses = hdev->iotlb_misses;
+        status->vhost_dev->iotlb_split_updates = hdev->iotlb_split_updates;
     }
 
     return status;
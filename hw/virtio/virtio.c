@@ -153,6 +153,36 @@ struct VirtQueue
     EventNotifier host_notifier;
     bool host_notifier_enabled;
     QLIST_ENTRY(VirtQueue) node;
+
+    VirtQueueElementPool *elem_pool;
+};
+
+/*
+ * Pooled elements have room for this many descriptors.  Larger elements
+ * are allocated on the heap.
+ */
+#define VIRTQUEUE_POOL_MAX_SG 16
+
+typedef struct VirtQueueElementSlot {
+    QSLIST_ENTRY(VirtQueueElementSlot) next;
+} VirtQueueElementSlot;
+
+/*
+ * Elements are only taken from @free by the thread that pops from the
+ * virtqueue.  They can be released from any thread and go to @returned,
+ * which the popping thread takes over in one go once @free runs dry.
+ *
+ * @refcnt counts the elements in flight plus one reference held by the
+ * virtqueue.  When the virtqueue goes away (resize, reset or unplug)
+ * with elements still in flight, the pool is only detached from it and
+ * is freed when the last of those elements is released.
+ */
+struct VirtQueueElementPool {
+    size_t slot_size;
+    uint8_t *slots;
+    unsigned int refcnt;
+    QSLIST_HEAD(, VirtQueueElementSlot) free;
+    QSLIST_HEAD(, VirtQueueElementSlot) returned;
 };
 
 const char *virtio_device_names[] = {
@@ -744,6 +774,72 @@ int virtio_queue_empty(VirtQueue *vq)
     }
 }
 
+static unsigned int virtio_queue_split_avail_count(VirtQueue *vq,
+                                                  unsigned int max)
+{
+    uint16_t count;
+
+    if (unlikely(!vq->vring.avail)) {
+        return 0;
+    }
+
+    RCU_READ_LOCK_GUARD();
+    count = vring_avail_idx(vq) - vq->last_avail_idx;
+    return MIN(count, max);
+}
+
+static unsigned int virtio_queue_packed_avail_count(VirtQueue *vq,
+                                                   unsigned int max)
+{
+    VRingMemoryRegionCaches *cache;
+    unsigned int idx = vq->last_avail_idx;
+    bool wrap_counter = vq->last_avail_wrap_counter;
+    unsigned int count = 0;
+    uint16_t flags;
+
+    if (unlikely(!vq->vring.desc)) {
+        return 0;
+    }
+
+    RCU_READ_LOCK_GUARD();
+    cache = vring_get_region_caches(vq);
+    if (!cache) {
+        return 0;
+    }
+
+    max = MIN(max, vq->vring.num);
+    while (count < max) {
+        vring_packed_desc_read_flags(vq->vdev, &flags, &cache->desc, idx);
+        if (!is_desc_avail(flags, wrap_counter)) {
+            break;
+        }
+        count++;
+        if (++idx >= vq->vring.num) {
+            idx -= vq->vring.num;
+            wrap_counter ^= 1;
+        }
+    }
+    return count;
+}
+
+/*
+ * Count the buffers that the driver made available, up to @max.  With the
+ * packed ring this counts descriptors, so a chained buffer is counted once
+ * per descriptor.
+ */
+unsigned int virtio_queue_avail_count(VirtQueue *vq, unsigned int max)
+{
+    if (virtio_device_disabled(vq->vdev)) {
+        return 0;
+    }
+
+    if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        return virtio_queue_packed_avail_count(vq, max);
+    } else {
+        return virtio_queue_split_avail_count(vq, max);
+    }
+}
+
 static bool virtio_queue_split_poll(VirtQueue *vq, unsigned shadow_idx)
 {
     if (unlikely(!vq->vring.avail)) {
@@ -1648,18 +1744,124 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
-static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+static size_t virtqueue_element_size(size_t sz, unsigned out_num,
+                                     unsigned in_num)
+{
+    VirtQueueElement *elem;
+    size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
+    size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
+    size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
+    size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
+    size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
+
+    return out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
+}
+
+void virtio_queue_enable_element_pool(VirtQueue *vq, size_t sz)
+{
+    VirtQueueElementPool *pool;
+    unsigned int i;
+
+    assert(!vq->elem_pool);
+    assert(sz >= sizeof(VirtQueueElement));
+
+    pool = g_new0(VirtQueueElementPool, 1);
+    pool->refcnt = 1;
+    pool->slot_size = QEMU_ALIGN_UP(virtqueue_element_size(sz, 0,
+                                                           VIRTQUEUE_POOL_MAX_SG),
+                                    __alignof__(VirtQueueElement));
+    pool->slots = g_malloc(vq->vring.num * pool->slot_size);
+    for (i = vq->vring.num; i-- > 0;) {
+        VirtQueueElementSlot *slot =
+            (VirtQueueElementSlot *)(pool->slots + i * pool->slot_size);
+
+        QSLIST_INSERT_HEAD(&pool->free, slot, next);
+    }
+    vq->elem_pool = pool;
+}
+
+static void virtqueue_pool_unref(VirtQueueElementPool *pool)
+{
+    if (qatomic_fetch_dec(&pool->refcnt) == 1) {
+        g_free(pool->slots);
+        g_free(pool);
+    }
+}
+
+static void virtio_queue_free_element_pool(VirtQueue *vq)
 {
+    if (vq->elem_pool) {
+        virtqueue_pool_unref(vq->elem_pool);
+        vq->elem_pool = NULL;
+    }
+}
+
+/* Called by the thread that pops from @vq */
+static VirtQueueElement *virtqueue_pool_get(VirtQueue *vq, size_t size)
+{
+    VirtQueueElementPool *pool = vq->elem_pool;
+    VirtQueueElementSlot *slot;
     VirtQueueElement *elem;
+
+    if (!pool) {
+        return NULL;
+    }
+    if (size > pool->slot_size) {
+        trace_virtqueue_pool_miss(vq, size, false);
+        return NULL;
+    }
+
+    if (QSLIST_EMPTY(&pool->free)) {
+        QSLIST_MOVE_ATOMIC(&pool->free, &pool->returned);
+    }
+    slot = QSLIST_FIRST(&pool->free);
+    if (!slot) {
+        trace_virtqueue_pool_miss(vq, size, true);
+        return NULL;
+    }
+    QSLIST_REMOVE_HEAD(&pool->free, next);
+    qatomic_inc(&pool->refcnt);
+
+    elem = (VirtQueueElement *)slot;
+    elem->pool = pool;
+    return elem;
+}
+
+void virtqueue_free_element(VirtQueueElement *elem)
+{
+    VirtQueueElementPool *pool;
+
+    if (!elem) {
+        return;
+    }
+
+    pool = elem->pool;
+    if (!pool) {
+        g_free(elem);
+        return;
+    }
+    QSLIST_INSERT_HEAD_ATOMIC(&pool->returned, (VirtQueueElementSlot *)elem,
+                              next);
+    virtqueue_pool_unref(pool);
+}
+
+static void *virtqueue_alloc_element(VirtQueue *vq, size_t sz,
+                                     unsigned out_num, unsigned in_num)
+{
+    VirtQueueElement *elem;
+    size_t size = virtqueue_element_size(sz, out_num, in_num);
     size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
     size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
     size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
     size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
     size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
-    size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
 
     assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+    elem = vq ? virtqueue_pool_get(vq, size) : NULL;
+    if (!elem) {
+        elem = g_malloc(size);
+        elem->pool = NULL;
+    }
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
     elem->out_num = out_num;
     elem->in_num = in_num;
@@ -1784,7 +1986,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     elem->index = head;
     elem->ndescs = 1;
     for (i = 0; i < out_num; i++) {
@@ -1924,7 +2126,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -1978,6 +2180,32 @@ void *virtqueue_pop(VirtQueue *vq, size_t sz)
     }
 }
 
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz,
+                                 VirtQueueElement **elems, unsigned int max)
+{
+    void *(*pop)(VirtQueue *vq, size_t sz);
+    unsigned int n = 0;
+
+    if (virtio_device_disabled(vq->vdev)) {
+        return 0;
+    }
+
+    pop = virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED) ?
+          virtqueue_packed_pop : virtqueue_split_pop;
+
+    /* Make the read-side critical sections of the pops nest */
+    RCU_READ_LOCK_GUARD();
+
+    while (n < max) {
+        elems[n] = pop(vq, sz);
+        if (!elems[n]) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
 static unsigned int virtqueue_packed_drop_all(VirtQueue *vq)
 {
     VRingMemoryRegionCaches *caches;
@@ -2113,7 +2341,7 @@ void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz)
     assert(ARRAY_SIZE(data.in_addr) >= data.in_num);
     assert(ARRAY_SIZE(data.out_addr) >= data.out_num);
 
-    elem = virtqueue_alloc_element(sz, data.out_num, data.in_num);
+    elem = virtqueue_alloc_element(NULL, sz, data.out_num, data.in_num);
     elem->index = data.index;
 
     for (i = 0; i < elem->in_num; i++) {
@@ -2561,6 +2789,7 @@ void virtio_delete_queue(VirtQueue *vq)
     vq->handle_output = NULL;
     g_free(vq->used_elems);
     vq->used_elems = NULL;
+    virtio_queue_free_element_pool(vq);
     virtio_virtqueue_reset_region_cache(vq);
 }
 
@@ -3986,6 +4215,10 @@ static void virtio_device_free_virtqueues(VirtIODevice *vdev)
         return;
     }
 
+    for (i = 0; i < VIRTIO_QUEUE_MAX; i++) {
+        virtio_queue_free_element_pool(&vdev->vq[i]);
+    }
+
     for (i = 0; i < VIRTIO_QUEUE_MAX; i++) {
         if (vdev->vq[i].vring.num == 0) {
             break;
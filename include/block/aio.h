@@ -468,6 +468,16 @@ void aio_set_fd_handler(AioContext *ctx,
                         IOHandler *io_poll_ready,
                         void *opaque);
 
+/*
+ * Set polling begin/end callbacks for a file descriptor that has already been
+ * registered with aio_set_fd_handler and an io_poll callback.  The same
+ * caveats apply as for aio_set_event_notifier_poll.  The callbacks are reset
+ * by aio_set_fd_handler.
+ */
+void aio_set_fd_poll(AioContext *ctx, int fd,
+                     IOHandler *io_poll_begin,
+                     IOHandler *io_poll_end);
+
 /* Register an event notifier and associated callbacks.  Behaves very similarly
  * to event_notifier_set_handler.  Unlike event_notifier_set_handler, these callbacks
  * will be invoked when using aio_poll().
@@ -146,6 +146,47 @@ void tlb_flush_by_mmuidx(CPUState *cpu, uint16_t idxmap);
  * translations using the flushed TLBs.
  */
 void tlb_flush_by_mmuidx_all_cpus_synced(CPUState *cpu, uint16_t idxmap);
+/**
+ * tlb_set_asid_by_mmuidx:
+ * @cpu: CPU whose TLB should be switched
+ * @idxmap: bitmap of MMU indexes to switch
+ * @asid: tag of the address space now in use
+ *
+ * Switch the specified MMU indexes to the address space tagged @asid,
+ * without flushing.  The entries of the previous address space are set
+ * aside and come back when it is switched in again, so a target whose
+ * TLB is tagged (e.g. by ASID) should call this on an address space
+ * switch instead of flushing.  Page and range flushes apply to all
+ * address spaces, full flushes discard all of them.
+ *
+ * After a full flush the tag of the current entries is unknown, and
+ * they are discarded by the next switch rather than set aside.
+ */
+void tlb_set_asid_by_mmuidx(CPUState *cpu, uint16_t idxmap, uint32_t asid);
+/**
+ * tlb_flush_asid_by_mmuidx:
+ * @cpu: CPU whose TLB should be flushed
+ * @idxmap: bitmap of MMU indexes to flush
+ * @asid: tag of the address space to flush
+ *
+ * Flush all entries of the address space tagged @asid from the TLB of
+ * the specified CPU, for the specified MMU indexes.
+ */
+void tlb_flush_asid_by_mmuidx(CPUState *cpu, uint16_t idxmap, uint32_t asid);
+/**
+ * tlb_flush_asid_by_mmuidx_all_cpus_synced:
+ * @cpu: Originating CPU of the flush
+ * @idxmap: bitmap of MMU indexes to flush
+ * @asid: tag of the address space to flush
+ *
+ * Flush all entries of the address space tagged @asid from the TLB of
+ * all CPUs, for the specified MMU indexes.
+ *
+ * When this function returns, no CPUs will subsequently perform
+ * translations using the flushed TLBs.
+ */
+void tlb_flush_asid_by_mmuidx_all_cpus_synced(CPUState *cpu, uint16_t idxmap,
+                                              uint32_t asid);
 
 /**
  * tlb_flush_page_bits_by_mmuidx
@@ -277,6 +318,19 @@ static inline void tlb_flush_by_mmuidx_all_cpus_synced(CPUState *cpu,
                                                        uint16_t idxmap)
 {
 }
+static inline void tlb_set_asid_by_mmuidx(CPUState *cpu, uint16_t idxmap,
+                                          uint32_t asid)
+{
+}
+static inline void tlb_flush_asid_by_mmuidx(CPUState *cpu, uint16_t idxmap,
+                                            uint32_t asid)
+{
+}
+static inline void tlb_flush_asid_by_mmuidx_all_cpus_synced(CPUState *cpu,
+                                                            uint16_t idxmap,
+                                                            uint32_t asid)
+{
+}
 static inline void tlb_flush_page_bits_by_mmuidx(CPUState *cpu,
                                                  vaddr addr,
                                                  uint16_t idxmap,
@@ -30,6 +30,22 @@
 
 extern uint64_t total_dirty_pages;
 
+/*
+ * Dirty pages counted for the dirty rate heatmap, one counter per
+ * BITS_PER_LONG target pages of ram_addr_t space (the alignment of
+ * RAMBlock offsets).  NULL unless a heatmap is being measured; like
+ * total_dirty_pages, it is protected by the BQL.
+ */
+extern uint32_t *dirty_heatmap;
+extern unsigned long dirty_heatmap_size;
+
+static inline void dirty_heatmap_add(unsigned long word, uint32_t pages)
+{
+    if (dirty_heatmap && word < dirty_heatmap_size) {
+        dirty_heatmap[word] += pages;
+    }
+}
+
 /**
  * clear_bmap_size: calculate clear bitmap size
  *
@@ -390,6 +406,7 @@ uint64_t cpu_physical_memory_set_dirty_lebitmap(unsigned long *bitmap,
                         if (unlikely(
                             global_dirty_tracking & GLOBAL_DIRTY_DIRTY_RATE)) {
                             total_dirty_pages += nbits;
+                            dirty_heatmap_add(page + k, nbits);
                         }
                     }
 
@@ -436,6 +453,12 @@ uint64_t cpu_physical_memory_set_dirty_lebitmap(unsigned long *bitmap,
                     ram_addr = start + addr;
                     cpu_physical_memory_set_dirty_range(ram_addr,
                                        TARGET_PAGE_SIZE * hpratio, clients);
+                    if (unlikely(global_dirty_tracking &
+                                 GLOBAL_DIRTY_DIRTY_RATE)) {
+                        dirty_heatmap_add(BIT_WORD(ram_addr >>
+                                                   TARGET_PAGE_BITS),
+                                          hpratio);
+                    }
                 } while (c != 0);
             }
         }
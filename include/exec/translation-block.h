@@ -89,6 +89,12 @@ struct TranslationBlock {
     uint16_t size;
     uint16_t icount;
 
+    /*
+     * Number of executions, counted for tiered translation.  Updated
+     * without atomics by all vCPUs, so only approximate under MTTCG.
+     */
+    uint32_t exec_count;
+
     struct tb_tc tc;
 
     /*
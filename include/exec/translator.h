@@ -75,6 +75,8 @@ typedef enum DisasJumpType {
  * @fake_insn: True if translator_fake_ldb used.
  * @insn_start: The last op emitted by the insn_start hook,
  *              which is expected to be INDEX_op_insn_start.
+ * @superblock: The TB is hot and may extend past direct branches,
+ *              see translator_follow_branch().
  *
  * Architecture-agnostic disassembly context.
  */
@@ -87,6 +89,7 @@ struct DisasContextBase {
     int max_insns;
     bool plugin_enabled;
     bool fake_insn;
+    bool superblock;
     struct TCGOp *insn_start;
     void *host_addr[2];
 
@@ -172,6 +175,19 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
  */
 bool translator_use_goto_tb(DisasContextBase *db, vaddr dest);
 
+/**
+ * translator_follow_branch
+ * @db: Disassembly context
+ * @dest: target pc of a direct branch
+ *
+ * Return true if the TB is translated as a superblock and can continue
+ * at @dest, instead of ending with a goto_tb to it.  The target then
+ * translates the next insn at @dest.  It can likewise continue past a
+ * conditional branch, with the taken side as an exit out of the TB,
+ * if this returns true for the fall-through address.
+ */
+bool translator_follow_branch(DisasContextBase *db, vaddr dest);
+
 /**
  * translator_io_start
  * @db: Disassembly context
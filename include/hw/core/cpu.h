@@ -201,6 +201,9 @@ struct CPUClass {
 /* Use a fully associative victim tlb of 8 entries. */
 #define CPU_VTLB_SIZE 8
 
+/* Track up to 8 large pages per mmu mode individually. */
+#define CPU_LPTLB_SIZE 8
+
 /*
  * The full TLB entry, which is not accessed by generated TCG code,
  * so the layout is not as critical as that of CPUTLBEntry. This is
@@ -264,6 +267,18 @@ struct CPUTLBEntryFull {
     } extra;
 };
 
+/*
+ * A large page that has been mapped into the tlb, one target page
+ * at a time.  Address @va lies within it if (va & mask) == addr.
+ */
+typedef struct CPUTLBLargePage {
+    /* Base virtual address, or -1 if the entry is unused. */
+    vaddr addr;
+    vaddr mask;
+    /* The translation of the page at @addr. */
+    CPUTLBEntryFull full;
+} CPUTLBLargePage;
+
 /*
  * Data elements that are per MMU mode, minus the bits accessed by
  * the TCG fast path.
@@ -271,12 +286,26 @@ struct CPUTLBEntryFull {
 typedef struct CPUTLBDesc {
     /*
      * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
-     * (addr & large_page_mask) == large_page_addr.
+     * into the tlb that are not tracked in lptable.  When any page
+     * within this region is flushed, we must flush the entire tlb.
+     * The region is matched if (addr & large_page_mask) == large_page_addr.
      */
     vaddr large_page_addr;
     vaddr large_page_mask;
+    /*
+     * The most recent large pages allocated into the tlb.  Flushing a
+     * page within one of them flushes just that large page, and a tlb
+     * miss within one of them is refilled without a page table walk.
+     * Entries replaced from here are folded into large_page_addr/mask.
+     */
+    size_t lpindex;
+    CPUTLBLargePage lptable[CPU_LPTLB_SIZE];
+    /*
+     * Tag of the address space the entries belong to, if known;
+     * see tlb_set_asid_by_mmuidx().
+     */
+    bool has_asid;
+    uint32_t asid;
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -310,6 +339,22 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    /* mmu_idx flushes forced by a page flush within large_page_addr/mask */
+    size_t large_flush_count;
+    /* mmu_idx flushes forced by a range flush too large to walk */
+    size_t range_flush_count;
+    /* large pages flushed individually from lptable */
+    size_t large_page_flush_count;
+    /* tlb misses refilled from lptable */
+    size_t large_page_fill_count;
+    /* address space switches, and those that found entries set aside */
+    size_t asid_switch_count;
+    size_t asid_reuse_count;
+    /*
+     * Per mmu_idx, the entries of inactive address spaces.  Allocated
+     * on the first switch.  Protected by tlb_c.lock.
+     */
+    struct CPUTLBAsidCache *asid_cache[NB_MMU_MODES];
 } CPUTLBCommon;
 
 /*
@@ -326,6 +371,32 @@ typedef struct CPUTLB {
 #endif
 } CPUTLB;
 
+#define TB_RAS_SIZE 16
+
+/*
+ * Shadow return address stack: a ring holding the return addresses of
+ * the innermost guest calls, pushed and popped by the code generated by
+ * tcg_gen_push_return_i64() and tcg_gen_lookup_return_and_goto_ptr().
+ * Each slot also remembers the code of the TB found at its address, for
+ * as long as calls keep pushing the same address at the same depth.
+ * The lookup was done on return from a TB with 'flags' and 'cs_base';
+ * generated code compares 'flags' and 'valid' as one 64-bit word.
+ * 'valid' is cleared along with the entries of the jump cache, with
+ * the same rules as their 'tb'.
+ */
+typedef struct CPUReturnStack {
+#ifdef CONFIG_TCG
+    struct {
+        vaddr pc;
+        uint32_t flags;
+        uint32_t valid;
+        uint64_t cs_base;
+        const void *code;
+    } slot[TB_RAS_SIZE];
+    uint32_t top;
+#endif
+} CPUReturnStack;
+
 /*
  * Low 16 bits: number of cycles left, used only in icount mode.
  * High 16 bits: Set to -1 to force TCG to stop executing linked TBs
@@ -349,12 +420,14 @@ typedef union IcountDecr {
 /**
  * CPUNegativeOffsetState: Elements of CPUState most efficiently accessed
  *                         from CPUArchState, via small negative offsets.
+ * @ras: shadow return address stack, accessed via TCG
  * @can_do_io: True if memory-mapped IO is allowed.
  * @plugin_mem_cbs: active plugin memory callbacks
  * @plugin_mem_value_low: 64 lower bits of latest accessed mem value.
  * @plugin_mem_value_high: 64 higher bits of latest accessed mem value.
  */
 typedef struct CPUNegativeOffsetState {
+    CPUReturnStack ras;
     CPUTLB tlb;
 #ifdef CONFIG_PLUGIN
     /*
@@ -507,6 +580,8 @@ struct CPUState {
     MemoryRegion *memory;
 
     struct CPUJumpCache *tb_jmp_cache;
+    /* set by the TCG profiler to sample the next TB, see tb-profile.c */
+    bool tb_profile_pending;
 
     GArray *gdb_regs;
     int gdb_num_regs;
@@ -24,6 +24,7 @@ struct SCSIRequest {
     SCSIBus           *bus;
     SCSIDevice        *dev;
     const SCSIReqOps  *ops;
+    AioContext        *ctx;
     uint32_t          refcount;
     uint32_t          tag;
     uint32_t          lun;
@@ -77,9 +78,12 @@ struct SCSIDevice
     uint32_t sense_len;
 
     /*
-     * The requests list is only accessed from the AioContext that executes
-     * requests or from the main loop when IOThread processing is stopped.
+     * Requests can run in different AioContexts when the HBA spreads its
+     * queues over several IOThreads, so the list is protected by
+     * requests_lock.  A request may only be cancelled or completed from
+     * its own AioContext (SCSIRequest.ctx).
      */
+    QemuMutex requests_lock;
     QTAILQ_HEAD(, SCSIRequest) requests;
 
     uint32_t channel;
@@ -224,6 +224,12 @@ int vhost_backend_update_device_iotlb(struct vhost_dev *dev,
 int vhost_backend_invalidate_device_iotlb(struct vhost_dev *dev,
                                                  uint64_t iova, uint64_t len);
 
+/*
+ * Bracket a series of IOTLB updates so that the backend can apply them at
+ * once.  Does nothing unless the backend supports VHOST_BACKEND_F_IOTLB_BATCH.
+ */
+int vhost_backend_iotlb_batch(struct vhost_dev *dev, bool begin);
+
 int vhost_backend_handle_iotlb_msg(struct vhost_dev *dev,
                                           struct vhost_iotlb_msg *imsg);
 
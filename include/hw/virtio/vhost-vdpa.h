@@ -56,6 +56,9 @@ typedef struct vhost_vdpa_shared {
 
     /* SVQ switching is in progress, or already completed? */
     SVQTransitionState svq_switching;
+
+    /* Runs the data SVQs, NULL for the main loop */
+    AioContext *svq_ctx;
 } VhostVDPAShared;
 
 typedef struct vhost_vdpa {
@@ -124,6 +124,12 @@ struct vhost_dev {
     bool started;
     bool log_enabled;
     uint64_t log_size;
+    /*
+     * IOTLB misses reported by the backend, and additional updates sent
+     * when the vIOMMU mapping of a miss spans several memory regions
+     */
+    uint64_t iotlb_misses;
+    uint64_t iotlb_split_updates;
     Error *migration_blocker;
     const VhostOps *vhost_ops;
     void *opaque;
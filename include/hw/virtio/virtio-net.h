@@ -19,7 +19,10 @@
 #include "hw/virtio/virtio.h"
 #include "net/announce.h"
 #include "qemu/option_int.h"
+#include "qemu/seqlock.h"
 #include "qom/object.h"
+#include "qapi/qapi-types-virtio.h"
+#include "sysemu/iothread.h"
 
 #include "ebpf/ebpf_rss.h"
 
@@ -56,6 +59,8 @@ typedef struct virtio_net_conf
     char *duplex_str;
     uint8_t duplex;
     char *primary_id_str;
+    IOThread *iothread;
+    IOThreadVirtQueueMappingList *iothread_vq_mapping_list;
 } virtio_net_conf;
 
 /* Coalesced packets type & status */
@@ -161,6 +166,8 @@ typedef struct VirtIONetQueue {
         VirtQueueElement *elem;
     } async_tx;
     struct VirtIONet *n;
+    /* Runs tx_bh/tx_timer and the peer's I/O handlers */
+    AioContext *ctx;
 } VirtIONetQueue;
 
 struct VirtIONet {
@@ -227,6 +234,18 @@ struct VirtIONet {
     struct EBPFRSSContext ebpf_rss;
     uint32_t nr_ebpf_rss_fds;
     char **ebpf_rss_fds;
+    /*
+     * Per queue pair AioContext of the userspace datapath, NULL if the
+     * device has no IOThreads.  It is only used while dataplane_started.
+     */
+    AioContext **qp_aio_context;
+    bool dataplane_started;
+    /*
+     * Written from the main loop around updates of the receive filter
+     * (mac, mac_table, vlans and the rx mode), which the datapath may be
+     * reading in an IOThread.
+     */
+    QemuSeqLock rx_filter_seqlock;
 };
 
 size_t virtio_net_handle_ctrl_iov(VirtIODevice *vdev,
@@ -62,6 +62,8 @@ typedef struct VirtQueue VirtQueue;
 
 #define VIRTQUEUE_MAX_SIZE 1024
 
+typedef struct VirtQueueElementPool VirtQueueElementPool;
+
 typedef struct VirtQueueElement
 {
     unsigned int index;
@@ -75,6 +77,8 @@ typedef struct VirtQueueElement
     hwaddr *out_addr;
     struct iovec *in_sg;
     struct iovec *out_sg;
+    /* Pool the element was taken from, NULL if it was g_malloc()ed */
+    VirtQueueElementPool *pool;
 } VirtQueueElement;
 
 #define VIRTIO_QUEUE_MAX 1024
@@ -268,6 +272,48 @@ void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
 
 void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem);
 void *virtqueue_pop(VirtQueue *vq, size_t sz);
+
+/**
+ * virtqueue_pop_batch:
+ * @vq: the virtqueue
+ * @sz: the size of the device's request structure, as for virtqueue_pop()
+ * @elems: array to store the popped elements in
+ * @max: the length of @elems
+ *
+ * Pop up to @max elements at once.  Each of them is laid out and must be
+ * released exactly like an element returned by virtqueue_pop().
+ *
+ * Returns: the number of elements stored in @elems.
+ */
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz,
+                                 VirtQueueElement **elems, unsigned int max);
+
+/**
+ * virtqueue_free_element:
+ * @elem: an element returned by virtqueue_pop() or
+ *        qemu_get_virtqueue_element(), may be NULL
+ *
+ * Release an element.  This must be used instead of g_free() for elements
+ * of virtqueues with an element pool; it may be called from any thread.
+ */
+void virtqueue_free_element(VirtQueueElement *elem);
+
+/**
+ * virtio_queue_enable_element_pool:
+ * @vq: the virtqueue
+ * @sz: the size of the device's request structure
+ *
+ * Preallocate one element per ring entry so that virtqueue_pop() does not
+ * have to allocate memory.  Elements with many descriptors, or larger than
+ * @sz, still come from the heap.  The pool is freed together with the
+ * virtqueue, or once the last element taken from it is released if some
+ * are still in flight at that point.
+ *
+ * Only for devices that release every element of @vq with
+ * virtqueue_free_element().
+ */
+void virtio_queue_enable_element_pool(VirtQueue *vq, size_t sz);
+
 unsigned int virtqueue_drop_all(VirtQueue *vq);
 void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz);
 void qemu_put_virtqueue_element(VirtIODevice *vdev, QEMUFile *f,
@@ -313,6 +359,7 @@ void virtio_queue_set_notification(VirtQueue *vq, int enable);
 int virtio_queue_ready(VirtQueue *vq);
 
 int virtio_queue_empty(VirtQueue *vq);
+unsigned int virtio_queue_avail_count(VirtQueue *vq, unsigned int max);
 
 /**
  * Enable notification and check whether guest has added some
@@ -67,6 +67,9 @@ typedef void (SocketReadStateFinalize)(SocketReadState *rs);
 typedef void (NetAnnounce)(NetClientState *);
 typedef bool (SetSteeringEBPF)(NetClientState *, int);
 typedef bool (NetCheckPeerType)(NetClientState *, ObjectClass *, Error **);
+typedef void (NetSetAioContext)(NetClientState *, AioContext *);
+typedef void (NetFlushTx)(NetClientState *);
+typedef int (NetRxBuffers)(NetClientState *, int);
 
 typedef struct NetClientInfo {
     NetClientDriver type;
@@ -92,6 +95,9 @@ typedef struct NetClientInfo {
     NetAnnounce *announce;
     SetSteeringEBPF *set_steering_ebpf;
     NetCheckPeerType *check_peer_type;
+    NetSetAioContext *set_aio_context;
+    NetFlushTx *flush_tx;
+    NetRxBuffers *rx_buffers;
 } NetClientInfo;
 
 struct NetClientState {
@@ -113,6 +119,8 @@ struct NetClientState {
     bool do_not_pad; /* do not pad to the minimum ethernet frame length */
     bool is_datapath;
     QTAILQ_HEAD(, NetFilterState) filters;
+    /* Where packets from and to this client are handled, NULL for main loop */
+    AioContext *ctx;
 };
 
 typedef QTAILQ_HEAD(NetClientStateList, NetClientState) NetClientStateList;
@@ -175,6 +183,8 @@ ssize_t qemu_receive_packet(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_send_packet_raw(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_send_packet_async(NetClientState *nc, const uint8_t *buf,
                                int size, NetPacketSent *sent_cb);
+void qemu_send_flush(NetClientState *nc);
+int qemu_peer_rx_buffers(NetClientState *nc, int max);
 void qemu_purge_queued_packets(NetClientState *nc);
 void qemu_flush_queued_packets(NetClientState *nc);
 void qemu_flush_or_purge_queued_packets(NetClientState *nc, bool purge);
@@ -191,6 +201,9 @@ int qemu_get_vnet_hdr_len(NetClientState *nc);
 void qemu_set_vnet_hdr_len(NetClientState *nc, int len);
 int qemu_set_vnet_le(NetClientState *nc, bool is_le);
 int qemu_set_vnet_be(NetClientState *nc, bool is_be);
+bool qemu_has_set_aio_context(NetClientState *nc);
+void qemu_set_aio_context(NetClientState *nc, AioContext *ctx);
+bool qemu_net_client_has_filters(NetClientState *nc);
 void qemu_macaddr_default_if_unset(MACAddr *macaddr);
 /**
  * qemu_find_nic_info: Obtain NIC configuration information
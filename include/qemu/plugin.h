@@ -72,6 +72,7 @@ enum plugin_dyn_cb_type {
     PLUGIN_CB_MEM_REGULAR,
     PLUGIN_CB_INLINE_ADD_U64,
     PLUGIN_CB_INLINE_STORE_U64,
+    PLUGIN_CB_MEM_BATCH,
 };
 
 struct qemu_plugin_regular_cb {
@@ -96,6 +97,13 @@ struct qemu_plugin_conditional_cb {
     uint64_t imm;
 };
 
+struct qemu_plugin_batch_cb {
+    struct qemu_plugin_mem_batch *batch;
+    TCGHelperInfo *info;
+    uint64_t pc;
+    enum qemu_plugin_mem_rw rw;
+};
+
 /*
  * A dynamic callback has an insertion point that is determined at run-time.
  * Usually the insertion point is somewhere in the code cache; think for
@@ -107,6 +115,7 @@ struct qemu_plugin_dyn_cb {
         struct qemu_plugin_regular_cb regular;
         struct qemu_plugin_conditional_cb cond;
         struct qemu_plugin_inline_cb inline_insn;
+        struct qemu_plugin_batch_cb batch;
     };
 };
 
@@ -128,6 +137,23 @@ struct qemu_plugin_scoreboard {
     QLIST_ENTRY(qemu_plugin_scoreboard) entry;
 };
 
+/*
+ * Per-vCPU buffer of a memory access batch, stored in a scoreboard.
+ * Translated code appends to @recs and calls plugin_mem_batch_flush_vcpu()
+ * once @n reaches the capacity of the batch.
+ */
+struct qemu_plugin_mem_batch_buf {
+    uint64_t n;
+    qemu_plugin_mem_record recs[];
+};
+
+struct qemu_plugin_mem_batch {
+    struct qemu_plugin_scoreboard *score;
+    size_t capacity;
+    qemu_plugin_vcpu_mem_batch_cb_t cb;
+    void *userp;
+};
+
 /* Internal context for this TranslationBlock */
 struct qemu_plugin_tb {
     GPtrArray *insns;
@@ -171,6 +197,8 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                              uint64_t value_high,
                              MemOpIdx oi, enum qemu_plugin_mem_rw rw);
 
+void plugin_mem_batch_flush_vcpu(unsigned int cpu_index, void *udata);
+
 void qemu_plugin_flush_cb(void);
 
 void qemu_plugin_atexit_cb(void);
@@ -65,11 +65,16 @@ typedef uint64_t qemu_plugin_id_t;
  *
  * version 4:
  * - added qemu_plugin_read_memory_vaddr
+ *
+ * version 5:
+ * - added qemu_plugin_mem_batch_new, qemu_plugin_mem_batch_free,
+ *   qemu_plugin_mem_batch_flush, qemu_plugin_register_vcpu_mem_batch
+ *   and qemu_plugin_register_vcpu_insn_exec_batch
  */
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 4
+#define QEMU_PLUGIN_VERSION 5
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -701,6 +706,113 @@ void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
     qemu_plugin_u64 entry,
     uint64_t imm);
 
+/**
+ * typedef qemu_plugin_mem_record - a recorded memory access
+ * @vaddr: the virtual address of the access
+ * @pc: the virtual address of the instruction doing the access
+ * @info: an opaque handle for further queries about the memory
+ *
+ * Only the qemu_plugin_mem_size_shift(), qemu_plugin_mem_is_*() queries
+ * can be used on @info. The accessed value and the hwaddr handle are not
+ * recorded.
+ *
+ * Records added by qemu_plugin_register_vcpu_insn_exec_batch() stand for
+ * the execution of the instruction at @pc rather than for a memory
+ * access: their @info is 0 and @vaddr is equal to @pc.
+ */
+typedef struct {
+    uint64_t vaddr;
+    uint64_t pc;
+    qemu_plugin_meminfo_t info;
+} qemu_plugin_mem_record;
+
+/** struct qemu_plugin_mem_batch - Opaque handle for a memory access batch */
+struct qemu_plugin_mem_batch;
+
+/**
+ * typedef qemu_plugin_vcpu_mem_batch_cb_t - memory batch callback type
+ * @vcpu_index: the vCPU that did the accesses
+ * @recs: the recorded accesses, oldest first
+ * @n: number of records in @recs
+ * @userdata: any user data attached to the batch
+ *
+ * @recs is only valid for the duration of the callback.
+ */
+typedef void (*qemu_plugin_vcpu_mem_batch_cb_t)(
+    unsigned int vcpu_index,
+    const qemu_plugin_mem_record *recs,
+    size_t n,
+    void *userdata);
+
+/**
+ * qemu_plugin_mem_batch_new() - allocate a memory access batch
+ * @entries: number of records buffered per vCPU
+ * @cb: callback called with the records of a vCPU
+ * @userdata: opaque pointer passed to @cb
+ *
+ * Each vCPU gets a buffer of @entries records. Instrumented accesses
+ * are appended to it by the translated code, and @cb is called on the
+ * vCPU thread once the buffer is full. This is much cheaper than a
+ * callback per access when the plugin can process accesses after the
+ * fact, as a cache model does.
+ *
+ * Returns a batch handle, to be freed with qemu_plugin_mem_batch_free().
+ */
+QEMU_PLUGIN_API
+struct qemu_plugin_mem_batch *
+qemu_plugin_mem_batch_new(size_t entries,
+                          qemu_plugin_vcpu_mem_batch_cb_t cb,
+                          void *userdata);
+
+/**
+ * qemu_plugin_mem_batch_free() - free a memory access batch
+ * @batch: batch to free
+ *
+ * Records still buffered are dropped.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_mem_batch_free(struct qemu_plugin_mem_batch *batch);
+
+/**
+ * qemu_plugin_mem_batch_flush() - report buffered records
+ * @batch: batch to flush
+ *
+ * Calls the batch callback for every vCPU with a partially filled
+ * buffer. vCPUs must not be running, so this is meant to be called
+ * from the atexit callback.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_mem_batch_flush(struct qemu_plugin_mem_batch *batch);
+
+/**
+ * qemu_plugin_register_vcpu_mem_batch() - record memory accesses in a batch
+ * @insn: handle for instruction to instrument
+ * @rw: record reads, writes or both
+ * @batch: batch the records are added to
+ *
+ * Every memory access generated by the instruction is appended to the
+ * @batch buffer of the executing vCPU.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_mem_batch(struct qemu_plugin_insn *insn,
+                                         enum qemu_plugin_mem_rw rw,
+                                         struct qemu_plugin_mem_batch *batch);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_batch() - record insn execution
+ * @insn: handle for instruction to instrument
+ * @batch: batch the records are added to
+ *
+ * Every execution of the instruction appends a record with a zero
+ * @info to the @batch buffer of the executing vCPU, before the records
+ * of its memory accesses. A plugin that registers both can therefore
+ * replay instructions and memory accesses in program order.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_insn_exec_batch(
+    struct qemu_plugin_insn *insn,
+    struct qemu_plugin_mem_batch *batch);
+
 /**
  * qemu_plugin_request_time_control() - request the ability to control time
  *
@@ -74,6 +74,31 @@ void tcg_gen_goto_tb(unsigned idx);
  */
 void tcg_gen_lookup_and_goto_ptr(void);
 
+/**
+ * tcg_gen_push_return_i64() - record the return address of a call
+ * @addr: Guest address the call returns to
+ *
+ * Push @addr on the shadow return stack in CPUState, for a subsequent
+ * tcg_gen_lookup_return_and_goto_ptr() to predict the target of the
+ * matching return.  @addr must be the pc that cpu_get_tb_cpu_state()
+ * computes once the call has returned.  Emitted inline.
+ */
+void tcg_gen_push_return_i64(TCGv_i64 addr);
+
+/**
+ * tcg_gen_lookup_return_and_goto_ptr() - as tcg_gen_lookup_and_goto_ptr(),
+ * for a return from a call
+ * @dest: Guest address returned to, as computed by cpu_get_tb_cpu_state()
+ *
+ * Pop the shadow return stack.  If it predicted @dest, jump directly to
+ * the TB remembered for it, without calling out of generated code.
+ * Otherwise fall back to the usual lookup.
+ *
+ * The TB state once returned must only depend on that of the current TB,
+ * as for the exits chained by tcg_gen_goto_tb().
+ */
+void tcg_gen_lookup_return_and_goto_ptr(TCGv_i64 dest);
+
 void tcg_gen_plugin_cb(unsigned from);
 void tcg_gen_plugin_mem_cb(TCGv_i64 addr, unsigned meminfo);
 
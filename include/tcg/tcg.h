@@ -402,6 +402,25 @@ typedef struct TCGTemp {
 
 typedef struct TCGContext TCGContext;
 
+/*
+ * Relocations recorded for the persistent TB cache, for the host code
+ * that depends on where QEMU and the code buffer are mapped.
+ */
+typedef enum TCGTBRelocKind {
+    /* 64-bit absolute address of a function in the QEMU executable */
+    TCG_TB_RELOC_ABS64,
+    /* 32-bit displacement to the prologue, from the end of the field */
+    TCG_TB_RELOC_PC32,
+} TCGTBRelocKind;
+
+typedef struct TCGTBReloc {
+    uint32_t offset;        /* from the start of the TB's code */
+    uint32_t kind;          /* TCGTBRelocKind */
+    uintptr_t target;
+} TCGTBReloc;
+
+#define TCG_MAX_TB_RELOCS 128
+
 typedef struct TCGTempSet {
     unsigned long l[BITS_TO_LONGS(TCG_MAX_TEMPS)];
 } TCGTempSet;
@@ -547,6 +566,18 @@ struct TCGContext {
     uint16_t gen_insn_end_off[TCG_MAX_INSNS];
     uint64_t *gen_insn_data;
 
+    /*
+     * Persistent TB cache: when @tb_cache is set, the backend emits
+     * code that can be relocated and records the relocations below.
+     * @nb_tb_relocs is -1 if the TB being generated cannot be cached.
+     * @tb_cache_imm_ok tells whether a 64-bit immediate is not a host
+     * address, see tcg_tb_cache_check_imm().
+     */
+    bool tb_cache;
+    bool (*tb_cache_imm_ok)(uint64_t val);
+    int nb_tb_relocs;
+    TCGTBReloc tb_relocs[TCG_MAX_TB_RELOCS];
+
     /* Exit to translator on overflow. */
     sigjmp_buf jmp_trans;
 };
@@ -569,6 +600,27 @@ extern TCGv_env tcg_env;
 
 bool in_code_gen_buffer(const void *p);
 
+void tcg_tb_reloc(TCGContext *s, TCGTBRelocKind kind, void *rw,
+                  uintptr_t target);
+
+/* Mark the TB being generated as not suitable for the persistent cache */
+static inline void tcg_tb_cache_reject(TCGContext *s)
+{
+    s->nb_tb_relocs = -1;
+}
+
+/*
+ * Called by the backend for every 64-bit immediate it emits, so that
+ * host pointers are caught however they were built (tcg_constant_i64,
+ * tcg_gen_movi_*, ...), not only through tcg_constant_ptr.
+ */
+static inline void tcg_tb_cache_check_imm(TCGContext *s, uint64_t val)
+{
+    if (s->nb_tb_relocs >= 0 && !s->tb_cache_imm_ok(val)) {
+        tcg_tb_cache_reject(s);
+    }
+}
+
 #ifdef CONFIG_DEBUG_TCG
 const void *tcg_splitwx_to_rx(void *rw);
 void *tcg_splitwx_to_rw(const void *rx);
@@ -742,6 +794,8 @@ void tcg_pool_reset(TCGContext *s);
 TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
+bool tcg_region_available(void);
+bool tcg_region_evict(GTraverseFunc func, gpointer user_data);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
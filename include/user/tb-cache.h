@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Persistent translation block cache for user-mode emulation.
+ */
+
+#ifndef USER_TB_CACHE_H
+#define USER_TB_CACHE_H
+
+#ifndef CONFIG_USER_ONLY
+#error Cannot include this header from system emulation
+#endif
+
+/**
+ * tb_cache_enable:
+ * @path: the cache file
+ * @cpu_model: the -cpu option in effect, part of the cache key
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Load the translation blocks saved in @path by a previous run of
+ * the same QEMU binary, with the same configuration, and record the
+ * new ones.  Must be called after tcg_prologue_init().  A missing or
+ * stale file is not an error: the cache then starts empty.
+ *
+ * Returns: false if the cache is not supported on this host.
+ */
+bool tb_cache_enable(const char *path, const char *cpu_model, Error **errp);
+
+/**
+ * tb_cache_save:
+ *
+ * Write the cache back to its file, if it is enabled.  Called when
+ * the emulated process exits or executes another program.
+ */
+void tb_cache_save(void);
+
+#endif
@@ -56,6 +56,7 @@
 #include "loader.h"
 #include "user-mmap.h"
 #include "tcg/perf.h"
+#include "user/tb-cache.h"
 #include "exec/page-vary.h"
 
 #ifdef CONFIG_SEMIHOSTING
@@ -71,6 +72,7 @@ char *exec_path;
 char real_exec_path[PATH_MAX];
 
 static bool opt_one_insn_per_tb;
+static unsigned int opt_tier_threshold;
 static const char *argv0;
 static const char *gdbstub;
 static envlist_t *envlist;
@@ -417,6 +419,14 @@ static void handle_arg_one_insn_per_tb(const char *arg)
     opt_one_insn_per_tb = true;
 }
 
+static void handle_arg_tier_threshold(const char *arg)
+{
+    if (qemu_strtoui(arg, NULL, 0, &opt_tier_threshold)) {
+        fprintf(stderr, "Invalid tier threshold: %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
 static void handle_arg_strace(const char *arg)
 {
     enable_strace = true;
@@ -451,6 +461,13 @@ static void handle_arg_jitdump(const char *arg)
     perf_enable_jitdump();
 }
 
+static const char *tb_cache_path;
+
+static void handle_arg_tb_cache(const char *arg)
+{
+    tb_cache_path = arg;
+}
+
 static QemuPluginList plugins = QTAILQ_HEAD_INITIALIZER(plugins);
 
 #ifdef CONFIG_PLUGIN
@@ -506,6 +523,9 @@ static const struct qemu_argument arg_table[] = {
     {"one-insn-per-tb",
                    "QEMU_ONE_INSN_PER_TB",  false, handle_arg_one_insn_per_tb,
      "",           "run with one guest instruction per emulated TB"},
+    {"tier-threshold",
+                   "QEMU_TIER_THRESHOLD",   true, handle_arg_tier_threshold,
+     "count",      "translate TBs run 'count' times again as superblocks"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
      "",           "log system calls"},
     {"seed",       "QEMU_RAND_SEED",   true,  handle_arg_seed,
@@ -526,6 +546,8 @@ static const struct qemu_argument arg_table[] = {
      "",           "Generate a /tmp/perf-${pid}.map file for perf"},
     {"jitdump",    "QEMU_JITDUMP",     false, handle_arg_jitdump,
      "",           "Generate a jit-${pid}.dump file for perf"},
+    {"tb-cache",   "QEMU_TB_CACHE",    true,  handle_arg_tb_cache,
+     "file",       "reuse translated code saved in 'file' by earlier runs"},
     {NULL, NULL, false, NULL, NULL, NULL}
 };
 
@@ -737,6 +759,10 @@ int main(int argc, char **argv, char **envp)
         exit(1);
     }
     trace_init_file();
+    if (tb_cache_path && !QTAILQ_EMPTY(&plugins)) {
+        error_report("-tb-cache cannot be used with plugins");
+        exit(EXIT_FAILURE);
+    }
     qemu_plugin_load_list(&plugins, &error_fatal);
 
     /* Zero out regs */
@@ -797,6 +823,8 @@ int main(int argc, char **argv, char **envp)
         accel_init_interfaces(ac);
         object_property_set_bool(OBJECT(accel), "one-insn-per-tb",
                                  opt_one_insn_per_tb, &error_abort);
+        object_property_set_uint(OBJECT(accel), "tier-threshold",
+                                 opt_tier_threshold, &error_abort);
         ac->init_machine(NULL);
     }
 
@@ -1008,6 +1036,9 @@ int main(int argc, char **argv, char **envp)
        generating the prologue until now so that the prologue can take
        the real value of GUEST_BASE into account.  */
     tcg_prologue_init();
+    if (tb_cache_path) {
+        tb_cache_enable(tb_cache_path, cpu_model, &error_fatal);
+    }
 
     target_cpu_copy_regs(env, regs);
 
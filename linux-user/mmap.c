@@ -31,6 +31,16 @@
 #include "target/arm/cpu-features.h"
 #endif
 
+/*
+ * mmap_lock serializes every change to the guest address space:
+ * target_mmap, target_munmap, target_mremap, target_mprotect, shmat
+ * and shmdt, together with the page flag updates and the invalidation
+ * of the TBs in the range.  Page flag lookups only take it when they
+ * raced with an update (see page_get_flags), but two mapping
+ * operations never run in parallel, even on disjoint ranges.  A range lock would need the TB
+ * invalidation, the host mmap/mprotect calls and the placement of new
+ * mappings by mmap_find_vma to stop depending on this lock first.
+ */
 static pthread_mutex_t mmap_mutex = PTHREAD_MUTEX_INITIALIZER;
 static __thread int mmap_lock_count;
 
@@ -12,6 +12,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/error-report.h"
+#include "qemu/units.h"
 #include "hw/core/cpu.h"
 #include "qapi/error.h"
 #include "exec/ramblock.h"
@@ -19,6 +20,8 @@
 #include "qemu/rcu_queue.h"
 #include "qemu/main-loop.h"
 #include "qapi/qapi-commands-migration.h"
+#include "qapi/qapi-visit-migration.h"
+#include "qapi/clone-visitor.h"
 #include "ram.h"
 #include "trace.h"
 #include "dirtyrate.h"
@@ -37,6 +40,14 @@
  */
 uint64_t total_dirty_pages;
 
+/*
+ * dirty_heatmap counts the dirty pages of each BITS_PER_LONG target
+ * pages while a heatmap is measured, see dirty_heatmap_add().  It is
+ * also protected by BQL.
+ */
+uint32_t *dirty_heatmap;
+unsigned long dirty_heatmap_size;
+
 typedef struct DirtyPageRecord {
     uint64_t start_pages;
     uint64_t end_pages;
@@ -289,6 +300,11 @@ query_dirty_rate_info(TimeUnit calc_time_unit)
         if (dirtyrate_mode == DIRTY_RATE_MEASURE_MODE_DIRTY_BITMAP) {
             info->sample_pages = 0;
         }
+
+        if (DirtyStat.ramblocks) {
+            info->ramblock_dirty_rate = QAPI_CLONE(DirtyRateRamBlockList,
+                                                   DirtyStat.ramblocks);
+        }
     }
 
     trace_query_dirty_rate_info(DirtyRateStatus_str(CalculatingState));
@@ -325,6 +341,9 @@ static void cleanup_dirtyrate_stat(struct DirtyRateConfig config)
         free(DirtyStat.dirty_ring.rates);
         DirtyStat.dirty_ring.rates = NULL;
     }
+
+    qapi_free_DirtyRateRamBlockList(DirtyStat.ramblocks);
+    DirtyStat.ramblocks = NULL;
 }
 
 static void update_dirtyrate_stat(struct RamblockDirtyInfo *info)
@@ -608,6 +627,103 @@ static inline void dirtyrate_manual_reset_protect(void)
     }
 }
 
+/*
+ * Start counting dirty pages per range of ram_addr_t space.  Must be
+ * called with the BQL held, after the log sync that may report all
+ * pages as dirty.
+ */
+static void dirty_heatmap_start(void)
+{
+    ram_addr_t end = 0;
+    RAMBlock *block;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        RAMBLOCK_FOREACH(block) {
+            end = MAX(end, block->offset + block->max_length);
+        }
+    }
+
+    g_free(dirty_heatmap);
+    dirty_heatmap_size = BITS_TO_LONGS(end >> qemu_target_page_bits());
+    dirty_heatmap = g_new0(uint32_t, dirty_heatmap_size);
+}
+
+static DirtyRateRamBlock *dirty_heatmap_ramblock(RAMBlock *block,
+                                                 int64_t calc_time_ms)
+{
+    int page_bits = qemu_target_page_bits();
+    unsigned long range_words =
+        MAX((DIRTYRATE_HEATMAP_RANGE_SIZE >> page_bits) / BITS_PER_LONG, 1);
+    uint64_t range_pages = range_words * BITS_PER_LONG;
+    unsigned long first = BIT_WORD(block->offset >> page_bits);
+    unsigned long nr_words = BITS_TO_LONGS(block->used_length >> page_bits);
+    unsigned long nr_ranges = DIV_ROUND_UP(nr_words, range_words);
+    int nr_buckets = 64 - clz64(range_pages) + 1;
+    g_autofree uint64_t *histogram = g_new0(uint64_t, nr_buckets);
+    GString *heatmap = g_string_sized_new(nr_ranges);
+    DirtyRateRamBlock *info = g_new0(DirtyRateRamBlock, 1);
+    DirtyPageRecord dirty_pages = { };
+    uint64List **tail = &info->histogram;
+    unsigned long r, w;
+    int i;
+
+    /* Buckets are printed as a single hexadecimal digit */
+    assert(nr_buckets <= 16);
+
+    for (r = 0; r < nr_ranges; r++) {
+        uint64_t dirty = 0;
+        int bucket;
+
+        for (w = r * range_words;
+             w < MIN((r + 1) * range_words, nr_words); w++) {
+            if (first + w < dirty_heatmap_size) {
+                dirty += dirty_heatmap[first + w];
+            }
+        }
+
+        /* A page synced more than once is only dirty once */
+        dirty = MIN(dirty, range_pages);
+        bucket = dirty ? 64 - clz64(dirty) : 0;
+        histogram[bucket]++;
+        g_string_append_c(heatmap, "0123456789abcdef"[bucket]);
+        dirty_pages.end_pages += dirty;
+    }
+
+    info->id = g_strdup(block->idstr);
+    info->size = block->used_length;
+    info->range_size = range_pages << page_bits;
+    info->dirty_rate = do_calculate_dirtyrate(dirty_pages, calc_time_ms);
+    for (i = 0; i < nr_buckets; i++) {
+        QAPI_LIST_APPEND(tail, histogram[i]);
+    }
+    info->heatmap = g_string_free(heatmap, false);
+
+    trace_dirtyrate_heatmap_ramblock(info->id, info->dirty_rate, nr_ranges);
+
+    return info;
+}
+
+/*
+ * Build the heatmap of each RAMBlock from the counted dirty pages.  Must
+ * be called with the BQL held, after the final log sync.
+ */
+static void dirty_heatmap_stop(int64_t calc_time_ms)
+{
+    DirtyRateRamBlockList **tail = &DirtyStat.ramblocks;
+    RAMBlock *block;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        RAMBLOCK_FOREACH_MIGRATABLE(block) {
+            QAPI_LIST_APPEND(tail, dirty_heatmap_ramblock(block,
+                                                          calc_time_ms));
+        }
+    }
+
+    g_free(dirty_heatmap);
+    dirty_heatmap = NULL;
+    dirty_heatmap_size = 0;
+}
+
 static void calculate_dirtyrate_dirty_bitmap(struct DirtyRateConfig config)
 {
     int64_t start_time;
@@ -633,6 +749,10 @@ static void calculate_dirtyrate_dirty_bitmap(struct DirtyRateConfig config)
      * KVM_DIRTY_LOG_MANUAL_PROTECT_ENABLE cap is enabled.
      */
     dirtyrate_manual_reset_protect();
+
+    if (config.heatmap) {
+        dirty_heatmap_start();
+    }
     bql_unlock();
 
     record_dirtypages_bitmap(&dirty_pages, true);
@@ -653,6 +773,12 @@ static void calculate_dirtyrate_dirty_bitmap(struct DirtyRateConfig config)
 
     DirtyStat.dirty_rate = do_calculate_dirtyrate(dirty_pages,
                                                   DirtyStat.calc_time_ms);
+
+    if (config.heatmap) {
+        bql_lock();
+        dirty_heatmap_stop(DirtyStat.calc_time_ms);
+        bql_unlock();
+    }
 }
 
 static void calculate_dirtyrate_dirty_ring(struct DirtyRateConfig config)
@@ -664,6 +790,12 @@ static void calculate_dirtyrate_dirty_ring(struct DirtyRateConfig config)
     /* start log sync */
     global_dirty_log_change(GLOBAL_DIRTY_DIRTY_RATE, true);
 
+    if (config.heatmap) {
+        bql_lock();
+        dirty_heatmap_start();
+        bql_unlock();
+    }
+
     DirtyStat.start_time = qemu_clock_get_ms(QEMU_CLOCK_HOST) / 1000;
 
     /* calculate vcpu dirtyrate */
@@ -672,6 +804,12 @@ static void calculate_dirtyrate_dirty_ring(struct DirtyRateConfig config)
                                                       GLOBAL_DIRTY_DIRTY_RATE,
                                                       true);
 
+    if (config.heatmap) {
+        bql_lock();
+        dirty_heatmap_stop(DirtyStat.calc_time_ms);
+        bql_unlock();
+    }
+
     /* calculate vm dirtyrate */
     for (i = 0; i < DirtyStat.dirty_ring.nvcpu; i++) {
         dirtyrate = DirtyStat.dirty_ring.rates[i].dirty_rate;
@@ -756,6 +894,8 @@ void qmp_calc_dirty_rate(int64_t calc_time,
                          int64_t sample_pages,
                          bool has_mode,
                          DirtyRateMeasureMode mode,
+                         bool has_heatmap,
+                         bool heatmap,
                          Error **errp)
 {
     static struct DirtyRateConfig config;
@@ -791,6 +931,13 @@ void qmp_calc_dirty_rate(int64_t calc_time,
         return;
     }
 
+    if (has_heatmap && heatmap &&
+        mode == DIRTY_RATE_MEASURE_MODE_PAGE_SAMPLING) {
+        error_setg(errp, "heatmap is used only in dirty-bitmap and "
+                   "dirty-ring modes");
+        return;
+    }
+
     if (has_sample_pages) {
         if (!is_sample_pages_valid(sample_pages)) {
             error_setg(errp, "sample-pages is out of range[%d, %d].",
@@ -828,6 +975,7 @@ void qmp_calc_dirty_rate(int64_t calc_time,
     config.calc_time_ms = calc_time_ms;
     config.sample_pages_per_gigabytes = sample_pages;
     config.mode = mode;
+    config.heatmap = has_heatmap && heatmap;
 
     cleanup_dirtyrate_stat(config);
 
@@ -879,12 +1027,29 @@ void hmp_info_dirty_rate(Monitor *mon, const QDict *qdict)
                                rate->value->dirty_rate);
             }
         }
+        if (info->ramblock_dirty_rate) {
+            DirtyRateRamBlockList *block;
+
+            for (block = info->ramblock_dirty_rate; block;
+                 block = block->next) {
+                uint64List *bucket;
+                int i = 0;
+
+                monitor_printf(mon, "ramblock[%s], Dirty rate: %"PRIi64
+                               " (MB/s), ranges per bucket:",
+                               block->value->id, block->value->dirty_rate);
+                for (bucket = block->value->histogram; bucket;
+                     bucket = bucket->next) {
+                    monitor_printf(mon, " %d:%"PRIu64, i++, bucket->value);
+                }
+                monitor_printf(mon, "\n");
+            }
+        }
     } else {
         monitor_printf(mon, "(not ready)\n");
     }
 
-    qapi_free_DirtyRateVcpuList(info->vcpu_dirty_rate);
-    g_free(info);
+    qapi_free_DirtyRateInfo(info);
 }
 
 void hmp_calc_dirty_rate(Monitor *mon, const QDict *qdict)
@@ -918,6 +1083,7 @@ void hmp_calc_dirty_rate(Monitor *mon, const QDict *qdict)
                         false, TIME_UNIT_SECOND, /* calc-time-unit */
                         has_sample_pages, sample_pages,
                         true, mode,
+                        false, false, /* heatmap */
                         &err);
     if (err) {
         hmp_handle_error(mon, err);
@@ -44,10 +44,16 @@
 #define MIN_SAMPLE_PAGE_COUNT                     128
 #define MAX_SAMPLE_PAGE_COUNT                     16384
 
+/*
+ * Granularity of the dirty rate heatmap of each RAMBlock.
+ */
+#define DIRTYRATE_HEATMAP_RANGE_SIZE              (2 * MiB)
+
 struct DirtyRateConfig {
     uint64_t sample_pages_per_gigabytes; /* sample pages per GB */
     int64_t calc_time_ms; /* desired calculation time (in milliseconds) */
     DirtyRateMeasureMode mode; /* mode of dirtyrate measurement */
+    bool heatmap; /* also measure per-RAMBlock heatmaps */
 };
 
 /*
@@ -77,6 +83,7 @@ struct DirtyRateStat {
     int64_t start_time; /* calculation start time in units of second */
     int64_t calc_time_ms; /* actual calculation time (in milliseconds) */
     uint64_t sample_pages; /* sample pages per GB */
+    DirtyRateRamBlockList *ramblocks; /* per-RAMBlock heatmaps */
     union {
         SampleVMStat page_sampling;
         VcpuStat dirty_ring;
@@ -86,6 +86,19 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
             monitor_printf(mon, "downtime: %" PRIu64 " ms\n",
                            info->downtime);
         }
+        if (info->has_predicted_downtime) {
+            monitor_printf(mon, "predicted downtime: %" PRIu64 " ms",
+                           info->predicted_downtime);
+            if (info->has_downtime) {
+                monitor_printf(mon, " (%+" PRId64 " ms)",
+                               info->downtime - info->predicted_downtime);
+            }
+            monitor_printf(mon, "\n");
+        }
+        if (info->has_switchover_threshold) {
+            monitor_printf(mon, "switchover threshold: %" PRIu64 " kbytes\n",
+                           info->switchover_threshold >> 10);
+        }
         if (info->has_setup_time) {
             monitor_printf(mon, "setup: %" PRIu64 " ms\n",
                            info->setup_time);
@@ -204,6 +217,15 @@ void hmp_info_migrate(Monitor *mon, const QDict *qdict)
         monitor_printf(mon, "]\n");
     }
 
+    if (info->switchover_cost) {
+        monitor_printf(mon, "switchover vm stop: %" PRIu64 " us\n",
+                       info->switchover_cost->vm_stop_time);
+        monitor_printf(mon, "switchover device state: %" PRIu64 " us, "
+                       "%" PRIu64 " kbytes\n",
+                       info->switchover_cost->device_state_time,
+                       info->switchover_cost->device_state_size >> 10);
+    }
+
     if (info->vfio) {
         monitor_printf(mon, "vfio device transferred: %" PRIu64 " kbytes\n",
                        info->vfio->transferred >> 10);
@@ -358,6 +380,34 @@ void hmp_info_migrate_parameters(Monitor *mon, const QDict *qdict)
                                MIGRATION_PARAMETER_DIRECT_IO),
                            params->direct_io ? "on" : "off");
         }
+
+        if (params->has_multifd_channel_affinity) {
+            const MultiFDChannelAffinityList *l;
+            int i = 0;
+
+            monitor_printf(mon, "%s:\n",
+                           MigrationParameter_str(
+                               MIGRATION_PARAMETER_MULTIFD_CHANNEL_AFFINITY));
+
+            for (l = params->multifd_channel_affinity; l; l = l->next, i++) {
+                const uint16List *v;
+
+                monitor_printf(mon, "  [%d] cpus:", i);
+                for (v = l->value->host_cpus; v; v = v->next) {
+                    monitor_printf(mon, " %u", v->value);
+                }
+                monitor_printf(mon, " nodes:");
+                for (v = l->value->host_nodes; v; v = v->next) {
+                    monitor_printf(mon, " %u", v->value);
+                }
+                monitor_printf(mon, "\n");
+            }
+        }
+
+        assert(params->has_multifd_ramblock_binding);
+        monitor_printf(mon, "%s: %s\n",
+            MigrationParameter_str(MIGRATION_PARAMETER_MULTIFD_RAMBLOCK_BINDING),
+            params->multifd_ramblock_binding ? "on" : "off");
     }
 
     qapi_free_MigrationParameters(params);
@@ -639,6 +689,14 @@ void hmp_migrate_set_parameter(Monitor *mon, const QDict *qdict)
         p->has_direct_io = true;
         visit_type_bool(v, param, &p->direct_io, &err);
         break;
+    case MIGRATION_PARAMETER_MULTIFD_CHANNEL_AFFINITY:
+        error_setg(&err, "The multifd-channel-affinity parameter can only be "
+                   "set through QMP");
+        break;
+    case MIGRATION_PARAMETER_MULTIFD_RAMBLOCK_BINDING:
+        p->has_multifd_ramblock_binding = true;
+        visit_type_bool(v, param, &p->multifd_ramblock_binding, &err);
+        break;
     default:
         g_assert_not_reached();
     }
@@ -128,6 +128,7 @@ static void migration_downtime_end(MigrationState *s)
     }
 
     trace_vmstate_downtime_checkpoint("src-downtime-end");
+    trace_migration_downtime(s->predicted_downtime, s->downtime);
 }
 
 static bool migration_needs_multiple_sockets(void)
@@ -215,6 +216,7 @@ static gint page_request_addr_cmp(gconstpointer ap, gconstpointer bp)
 
 static int migration_stop_vm(MigrationState *s, RunState state)
 {
+    int64_t start_us;
     int ret;
 
     migration_downtime_start(s);
@@ -222,7 +224,11 @@ static int migration_stop_vm(MigrationState *s, RunState state)
     s->vm_old_state = runstate_get();
     global_state_store();
 
+    start_us = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
     ret = vm_stop_force_state(state);
+    if (!ret) {
+        s->vm_stop_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start_us;
+    }
 
     trace_vmstate_downtime_checkpoint("src-vm-stopped");
     trace_migration_completion_vm_stop(ret);
@@ -1187,6 +1193,19 @@ static void populate_time_info(MigrationInfo *info, MigrationState *s)
         info->has_expected_downtime = true;
         info->expected_downtime = s->expected_downtime;
     }
+
+    info->has_predicted_downtime = true;
+    info->predicted_downtime = s->predicted_downtime;
+
+    info->has_switchover_threshold = true;
+    info->switchover_threshold = s->threshold_size;
+
+    if (s->device_state_size) {
+        info->switchover_cost = g_malloc0(sizeof(*info->switchover_cost));
+        info->switchover_cost->vm_stop_time = s->vm_stop_time;
+        info->switchover_cost->device_state_time = s->device_state_time;
+        info->switchover_cost->device_state_size = s->device_state_size;
+    }
 }
 
 static void populate_ram_info(MigrationInfo *info, MigrationState *s)
@@ -1720,6 +1739,8 @@ int migrate_init(MigrationState *s, Error **errp)
     s->pages_per_second = 0.0;
     s->downtime = 0;
     s->expected_downtime = 0;
+    s->predicted_downtime = 0;
+    s->expected_bw_per_ms = 0;
     s->setup_time = 0;
     s->start_postcopy = false;
     s->migration_thread_running = false;
@@ -3151,6 +3172,38 @@ static void migration_completion_end(MigrationState *s)
     bql_unlock();
 }
 
+/*
+ * Time in milliseconds that the stop-and-copy phase needs on top of
+ * sending the remaining RAM: stopping the VM, saving the non-iterable
+ * device state and sending it at the expected bandwidth.
+ *
+ * The cost is the one measured by the last switchover of this QEMU,
+ * be it a migration or a savevm, so that it is known before the first
+ * decision of the next migration.  It is capped to half of the
+ * downtime limit, so that a single slow stop cannot keep migration
+ * from ever converging.
+ */
+static double migration_switchover_overhead(MigrationState *s)
+{
+    double overhead = (s->vm_stop_time + s->device_state_time) / 1000.0;
+
+    if (s->expected_bw_per_ms > 0) {
+        overhead += s->device_state_size / s->expected_bw_per_ms;
+    }
+    return MIN(overhead, migrate_downtime_limit() / 2.0);
+}
+
+static int64_t migration_predict_downtime(MigrationState *s,
+                                          uint64_t pending_size)
+{
+    double downtime = migration_switchover_overhead(s);
+
+    if (s->expected_bw_per_ms > 0) {
+        downtime += pending_size / s->expected_bw_per_ms;
+    }
+    return downtime;
+}
+
 static void update_iteration_initial_status(MigrationState *s)
 {
     /*
@@ -3171,6 +3224,8 @@ static void migration_update_counters(MigrationState *s,
     /* Expected bandwidth when switching over to destination QEMU */
     double expected_bw_per_ms;
     double bandwidth;
+    int64_t downtime_limit;
+    double overhead;
 
     if (current_time < s->iteration_start_time + BUFFER_DELAY) {
         return;
@@ -3193,7 +3248,15 @@ static void migration_update_counters(MigrationState *s,
         expected_bw_per_ms = bandwidth;
     }
 
-    s->threshold_size = expected_bw_per_ms * migrate_downtime_limit();
+    /*
+     * Stopping the VM and saving the non-iterable device state take
+     * time too, so only the remainder of the downtime limit can be
+     * spent sending the pending data.
+     */
+    downtime_limit = migrate_downtime_limit();
+    s->expected_bw_per_ms = expected_bw_per_ms;
+    overhead = migration_switchover_overhead(s);
+    s->threshold_size = expected_bw_per_ms * (downtime_limit - overhead);
 
     s->mbps = (((double) transferred * 8.0) /
                ((double) time_spent / 1000.0)) / 1000.0 / 1000.0;
@@ -3211,6 +3274,7 @@ static void migration_update_counters(MigrationState *s,
         transferred > 10000) {
         s->expected_downtime =
             stat64_get(&mig_stats.dirty_bytes_last_sync) / expected_bw_per_ms;
+        s->predicted_downtime = s->expected_downtime + overhead;
     }
 
     migration_rate_reset();
@@ -3221,6 +3285,8 @@ static void migration_update_counters(MigrationState *s,
                               /* Both in unit bytes/ms */
                               bandwidth, switchover_bw / 1000,
                               s->threshold_size);
+    trace_migration_switchover_overhead(downtime_limit, overhead * 1000,
+                                        s->predicted_downtime);
 }
 
 static bool migration_can_switchover(MigrationState *s)
@@ -3267,6 +3333,7 @@ static MigIterateState migration_iteration_run(MigrationState *s)
 
     if ((!pending_size || pending_size < s->threshold_size) && can_switchover) {
         trace_migration_thread_low_pending(pending_size);
+        s->predicted_downtime = migration_predict_downtime(s, pending_size);
         migration_completion(s);
         return MIG_ITERATE_BREAK;
     }
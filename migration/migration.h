@@ -339,6 +339,22 @@ struct MigrationState {
     int64_t downtime_start;
     int64_t downtime;
     int64_t expected_downtime;
+    /*
+     * Downtime (ms) predicted from the remaining data, the expected
+     * bandwidth and the switchover cost below.  Frozen once the
+     * decision to switch over is taken.
+     */
+    int64_t predicted_downtime;
+    /* Bandwidth (bytes/ms) expected when switching over */
+    double expected_bw_per_ms;
+    /*
+     * Cost of the last stop-and-copy phase (us and bytes), from either
+     * a migration or a savevm.  Kept across migrations to seed the
+     * switchover threshold of the next one.
+     */
+    int64_t vm_stop_time;
+    int64_t device_state_time;
+    uint64_t device_state_size;
     bool capabilities[MIGRATION_CAPABILITY__MAX];
     int64_t setup_time;
 
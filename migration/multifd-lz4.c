@@ -0,0 +1,248 @@
+/*
+ * Multifd lz4 compression implementation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <lz4.h>
+#include "qemu/bswap.h"
+#include "exec/ramblock.h"
+#include "qapi/error.h"
+#include "migration.h"
+#include "multifd.h"
+
+/*
+ * Every normal page is compressed as an independent LZ4 block, so the
+ * receiver can decompress straight into guest memory.  On the wire each
+ * page is a 32-bit big-endian length followed by that many bytes.  Pages
+ * that LZ4 cannot shrink are sent raw and carry a length equal to the
+ * page size.
+ */
+#define LZ4_PAGE_HDR_SIZE sizeof(uint32_t)
+
+struct lz4_data {
+    /* compression state for LZ4_compress_fast_extState() */
+    void *state;
+    /* compressed buffer */
+    uint8_t *zbuff;
+    /* size of compressed buffer */
+    uint32_t zbuff_len;
+};
+
+static uint32_t multifd_lz4_buff_len(void)
+{
+    return multifd_ram_page_count() *
+           (LZ4_PAGE_HDR_SIZE + multifd_ram_page_size());
+}
+
+/* Multifd lz4 compression */
+
+static int multifd_lz4_send_setup(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+
+    z->state = g_try_malloc(LZ4_sizeofState());
+    if (!z->state) {
+        g_free(z);
+        error_setg(errp, "multifd %u: out of memory for lz4 state", p->id);
+        return -1;
+    }
+    /* This is the maximum size of the compressed buffer */
+    z->zbuff_len = multifd_lz4_buff_len();
+    z->zbuff = g_try_malloc(z->zbuff_len);
+    if (!z->zbuff) {
+        g_free(z->state);
+        g_free(z);
+        error_setg(errp, "multifd %u: out of memory for zbuff", p->id);
+        return -1;
+    }
+    p->compress_data = z;
+
+    /* Needs 2 IOVs, one for packet header and one for compressed data */
+    p->iov = g_new0(struct iovec, 2);
+    return 0;
+}
+
+static void multifd_lz4_send_cleanup(MultiFDSendParams *p, Error **errp)
+{
+    struct lz4_data *z = p->compress_data;
+
+    g_free(z->state);
+    z->state = NULL;
+    g_free(z->zbuff);
+    z->zbuff = NULL;
+    g_free(p->compress_data);
+    p->compress_data = NULL;
+
+    g_free(p->iov);
+    p->iov = NULL;
+}
+
+static int multifd_lz4_send_prepare(MultiFDSendParams *p, Error **errp)
+{
+    MultiFDPages_t *pages = &p->data->u.ram;
+    struct lz4_data *z = p->compress_data;
+    uint32_t page_size = multifd_ram_page_size();
+    uint32_t out_size = 0;
+    uint32_t i;
+
+    if (!multifd_send_prepare_common(p)) {
+        goto out;
+    }
+
+    for (i = 0; i < pages->normal_num; i++) {
+        const char *src = (const char *)pages->block->host + pages->offset[i];
+        uint8_t *hdr = z->zbuff + out_size;
+        char *dst = (char *)hdr + LZ4_PAGE_HDR_SIZE;
+        int ret;
+
+        /*
+         * Unlike zlib, LZ4 block compression never reads outside the
+         * input and always emits a block that decodes to exactly
+         * page_size bytes, so a page changing under our feet at worst
+         * yields stale contents.  The page is dirty again and will be
+         * resent, so there is no need to copy it first.
+         *
+         * Limiting the output to page_size - 1 makes LZ4 give up (and
+         * return 0) on pages that do not compress.
+         */
+        ret = LZ4_compress_fast_extState(z->state, src, dst, page_size,
+                                         page_size - 1, 1);
+        if (ret < 0) {
+            error_setg(errp, "multifd %u: LZ4_compress_fast_extState "
+                       "returned %d", p->id, ret);
+            return -1;
+        }
+        if (ret == 0) {
+            memcpy(dst, src, page_size);
+            ret = page_size;
+        }
+        stl_be_p(hdr, ret);
+        out_size += LZ4_PAGE_HDR_SIZE + ret;
+    }
+    p->iov[p->iovs_num].iov_base = z->zbuff;
+    p->iov[p->iovs_num].iov_len = out_size;
+    p->iovs_num++;
+    p->next_packet_size = out_size;
+
+out:
+    p->flags |= MULTIFD_FLAG_LZ4;
+    multifd_send_fill_packet(p);
+    return 0;
+}
+
+static int multifd_lz4_recv_setup(MultiFDRecvParams *p, Error **errp)
+{
+    struct lz4_data *z = g_new0(struct lz4_data, 1);
+
+    z->zbuff_len = multifd_lz4_buff_len();
+    z->zbuff = g_try_malloc(z->zbuff_len);
+    if (!z->zbuff) {
+        g_free(z);
+        error_setg(errp, "multifd %u: out of memory for zbuff", p->id);
+        return -1;
+    }
+    p->compress_data = z;
+    return 0;
+}
+
+static void multifd_lz4_recv_cleanup(MultiFDRecvParams *p)
+{
+    struct lz4_data *z = p->compress_data;
+
+    g_free(z->zbuff);
+    z->zbuff = NULL;
+    g_free(p->compress_data);
+    p->compress_data = NULL;
+}
+
+static int multifd_lz4_recv(MultiFDRecvParams *p, Error **errp)
+{
+    struct lz4_data *z = p->compress_data;
+    uint32_t in_size = p->next_packet_size;
+    uint32_t in_pos = 0;
+    uint32_t page_size = multifd_ram_page_size();
+    uint32_t flags = p->flags & MULTIFD_FLAG_COMPRESSION_MASK;
+    int ret;
+    int i;
+
+    if (flags != MULTIFD_FLAG_LZ4) {
+        error_setg(errp, "multifd %u: flags received %x flags expected %x",
+                   p->id, flags, MULTIFD_FLAG_LZ4);
+        return -1;
+    }
+
+    multifd_recv_zero_page_process(p);
+
+    if (!p->normal_num) {
+        assert(in_size == 0);
+        return 0;
+    }
+
+    if (in_size > z->zbuff_len) {
+        error_setg(errp, "multifd %u: packet size %u exceeds buffer size %u",
+                   p->id, in_size, z->zbuff_len);
+        return -1;
+    }
+
+    ret = qio_channel_read_all(p->c, (void *)z->zbuff, in_size, errp);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < p->normal_num; i++) {
+        uint8_t *dst = p->host + p->normal[i];
+        uint32_t len;
+
+        if (in_size - in_pos < LZ4_PAGE_HDR_SIZE) {
+            error_setg(errp, "multifd %u: truncated lz4 packet", p->id);
+            return -1;
+        }
+        len = ldl_be_p(z->zbuff + in_pos);
+        in_pos += LZ4_PAGE_HDR_SIZE;
+        if (len > page_size || len > in_size - in_pos) {
+            error_setg(errp, "multifd %u: invalid lz4 page length %u",
+                       p->id, len);
+            return -1;
+        }
+
+        ramblock_recv_bitmap_set_offset(p->block, p->normal[i]);
+        if (len == page_size) {
+            memcpy(dst, z->zbuff + in_pos, page_size);
+        } else {
+            ret = LZ4_decompress_safe((const char *)z->zbuff + in_pos,
+                                      (char *)dst, len, page_size);
+            if (ret != page_size) {
+                error_setg(errp, "multifd %u: LZ4_decompress_safe returned %d"
+                           " size expected %u", p->id, ret, page_size);
+                return -1;
+            }
+        }
+        in_pos += len;
+    }
+    if (in_pos != in_size) {
+        error_setg(errp, "multifd %u: packet size received %u size consumed %u",
+                   p->id, in_size, in_pos);
+        return -1;
+    }
+    return 0;
+}
+
+static const MultiFDMethods multifd_lz4_ops = {
+    .send_setup = multifd_lz4_send_setup,
+    .send_cleanup = multifd_lz4_send_cleanup,
+    .send_prepare = multifd_lz4_send_prepare,
+    .recv_setup = multifd_lz4_recv_setup,
+    .recv_cleanup = multifd_lz4_recv_cleanup,
+    .recv = multifd_lz4_recv
+};
+
+static void multifd_lz4_register(void)
+{
+    multifd_register_ops(MULTIFD_COMPRESSION_LZ4, &multifd_lz4_ops);
+}
+
+migration_init(multifd_lz4_register);
@@ -343,17 +343,27 @@ retry:
     return true;
 }
 
+/* Send the queued pages without waiting for the queue to fill up */
+bool multifd_ram_flush(void)
+{
+    if (!multifd_payload_empty(multifd_ram_send)) {
+        if (!multifd_send(&multifd_ram_send)) {
+            error_report("%s: multifd_send fail", __func__);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int multifd_ram_flush_and_sync(void)
 {
     if (!migrate_multifd()) {
         return 0;
     }
 
-    if (!multifd_payload_empty(multifd_ram_send)) {
-        if (!multifd_send(&multifd_ram_send)) {
-            error_report("%s: multifd_send fail", __func__);
-            return -1;
-        }
+    if (!multifd_ram_flush()) {
+        return -1;
     }
 
     return multifd_send_sync_main();
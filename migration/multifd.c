@@ -16,6 +16,7 @@
 #include "exec/target_page.h"
 #include "sysemu/sysemu.h"
 #include "exec/ramblock.h"
+#include "qemu/bitmap.h"
 #include "qemu/error-report.h"
 #include "qapi/error.h"
 #include "file.h"
@@ -24,6 +25,7 @@
 #include "socket.h"
 #include "tls.h"
 #include "qemu-file.h"
+#include "ram.h"
 #include "trace.h"
 #include "multifd.h"
 #include "threadinfo.h"
@@ -31,8 +33,14 @@
 #include "qemu/yank.h"
 #include "io/channel-file.h"
 #include "io/channel-socket.h"
+#include "sysemu/numa.h"
 #include "yank_functions.h"
 
+#ifdef CONFIG_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
 /* Multiple fd's */
 
 #define MULTIFD_MAGIC 0x11223344U
@@ -77,6 +85,9 @@ struct {
     int exiting;
     /* multifd ops */
     const MultiFDMethods *ops;
+    /* host node of the last RAMBlock sent, for multifd-ramblock-binding */
+    RAMBlock *last_block;
+    int last_block_node;
 } *multifd_send_state;
 
 struct {
@@ -123,6 +134,161 @@ static bool multifd_use_packets(void)
     return !migrate_mapped_ram();
 }
 
+/*
+ * Resolve the multifd-channel-affinity entry of channel @id into host
+ * CPU and node bitmaps.  Entries are reused round-robin when there are
+ * fewer of them than channels; without any entry the channel thread is
+ * left unpinned.
+ */
+static void multifd_affinity_setup(MultiFDAffinity *aff, uint8_t id)
+{
+    const MultiFDChannelAffinityList *list = migrate_multifd_channel_affinity();
+    const MultiFDChannelAffinityList *entry;
+    const uint16List *l;
+    unsigned long nbits = 0;
+    int count = 0;
+
+    for (entry = list; entry; entry = entry->next) {
+        count++;
+    }
+    if (!count) {
+        return;
+    }
+    for (entry = list, count = id % count; count; count--) {
+        entry = entry->next;
+    }
+
+    for (l = entry->value->host_cpus; l; l = l->next) {
+        nbits = MAX(nbits, l->value + 1);
+    }
+#ifdef CONFIG_NUMA
+    if (entry->value->host_nodes) {
+        nbits = MAX(nbits, numa_num_possible_cpus());
+    }
+#endif
+
+    aff->cpus = bitmap_new(nbits);
+    aff->cpus_nbits = nbits;
+    for (l = entry->value->host_cpus; l; l = l->next) {
+        set_bit(l->value, aff->cpus);
+    }
+
+#ifdef CONFIG_NUMA
+    if (entry->value->host_nodes) {
+        struct bitmask *tmp_cpus = numa_allocate_cpumask();
+        int i;
+
+        aff->nodes = bitmap_new(MAX_NODES);
+        for (l = entry->value->host_nodes; l; l = l->next) {
+            set_bit(l->value, aff->nodes);
+            numa_bitmask_clearall(tmp_cpus);
+            if (numa_node_to_cpus(l->value, tmp_cpus)) {
+                /* We ignore any errors, such as impossible nodes. */
+                continue;
+            }
+            for (i = 0; i < numa_num_possible_cpus(); i++) {
+                if (numa_bitmask_isbitset(tmp_cpus, i)) {
+                    set_bit(i, aff->cpus);
+                }
+            }
+        }
+        numa_free_cpumask(tmp_cpus);
+    }
+#endif
+}
+
+static void multifd_affinity_cleanup(MultiFDAffinity *aff)
+{
+    g_free(aff->cpus);
+    aff->cpus = NULL;
+    aff->cpus_nbits = 0;
+    g_free(aff->nodes);
+    aff->nodes = NULL;
+}
+
+/*
+ * Called by the channel thread itself before it does any work, so that
+ * the memory it allocates from then on is local to its CPUs.  Failing to
+ * pin the thread is not fatal to the migration.
+ */
+static void multifd_affinity_apply(MultiFDAffinity *aff, const char *name)
+{
+    QemuThread self;
+    int ret;
+
+    if (!aff->cpus) {
+        return;
+    }
+
+    qemu_thread_get_self(&self);
+    ret = qemu_thread_set_affinity(&self, aff->cpus, aff->cpus_nbits);
+    if (ret) {
+        warn_report("multifd: setting CPU affinity of %s failed: %s",
+                    name, strerror(ret));
+        return;
+    }
+    trace_multifd_affinity_apply(name, bitmap_count_one(aff->cpus,
+                                                        aff->cpus_nbits));
+}
+
+/*
+ * Host NUMA node backing the RAMBlock of @pages, or -1 if unknown.  This
+ * is looked up once per RAMBlock, since memory backends are normally
+ * placed on a single node.
+ */
+static int multifd_ram_host_node(MultiFDPages_t *pages)
+{
+#ifdef CONFIG_NUMA
+    int node;
+
+    if (pages->block == multifd_send_state->last_block) {
+        return multifd_send_state->last_block_node;
+    }
+
+    if (get_mempolicy(&node, NULL, 0, pages->block->host + pages->offset[0],
+                      MPOL_F_NODE | MPOL_F_ADDR)) {
+        node = -1;
+    }
+    multifd_send_state->last_block = pages->block;
+    multifd_send_state->last_block_node = node;
+    trace_multifd_ram_host_node(pages->block->idstr, node);
+    return node;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Find an idle channel bound to the host node of @data, starting the
+ * search at @start.  Returns NULL if there is none.
+ */
+static MultiFDSendParams *multifd_send_pick_bound_channel(MultiFDSendData *data,
+                                                          int start)
+{
+    int channels = migrate_multifd_channels();
+    int node, i;
+
+    if (data->type != MULTIFD_PAYLOAD_RAM) {
+        return NULL;
+    }
+
+    node = multifd_ram_host_node(&data->u.ram);
+    if (node < 0 || node >= MAX_NODES) {
+        return NULL;
+    }
+
+    for (i = 0; i < channels; i++) {
+        MultiFDSendParams *p = &multifd_send_state->params[(start + i) %
+                                                            channels];
+
+        if (p->affinity.nodes && test_bit(node, p->affinity.nodes) &&
+            !qatomic_read(&p->pending_job)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
 void multifd_send_channel_created(void)
 {
     qemu_sem_post(&multifd_send_state->channels_created);
@@ -318,7 +484,17 @@ bool multifd_send(MultiFDSendData **send_data)
      * limit is lower now.
      */
     next_channel %= migrate_multifd_channels();
-    for (i = next_channel;; i = (i + 1) % migrate_multifd_channels()) {
+
+    /*
+     * With RAMBlock binding, prefer an idle channel on the host node the
+     * pages live on.  channels_ready only guarantees that some channel
+     * is idle, so fall back to any of them rather than waiting.
+     */
+    if (migrate_multifd_ramblock_binding()) {
+        p = multifd_send_pick_bound_channel(*send_data, next_channel);
+    }
+
+    for (i = next_channel; !p; i = (i + 1) % migrate_multifd_channels()) {
         if (multifd_send_should_exit()) {
             return false;
         }
@@ -331,6 +507,7 @@ bool multifd_send(MultiFDSendData **send_data)
             next_channel = (i + 1) % migrate_multifd_channels();
             break;
         }
+        p = NULL;
     }
 
     /*
@@ -460,6 +637,7 @@ static bool multifd_send_cleanup_channel(MultiFDSendParams *p, Error **errp)
     qemu_sem_destroy(&p->sem_sync);
     g_free(p->name);
     p->name = NULL;
+    multifd_affinity_cleanup(&p->affinity);
     g_free(p->data);
     p->data = NULL;
     p->packet_len = 0;
@@ -576,6 +754,7 @@ static void *multifd_send_thread(void *opaque)
     bool use_packets = multifd_use_packets();
 
     thread = migration_threads_add(p->name, qemu_get_thread_id());
+    multifd_affinity_apply(&p->affinity, p->name);
 
     trace_multifd_send_thread_start(p->id);
     rcu_register_thread();
@@ -621,6 +800,23 @@ static void *multifd_send_thread(void *opaque)
                 break;
             }
 
+            /*
+             * For background snapshots, the pages are now safely in the
+             * file and the guest may write to them again.
+             */
+            if (migrate_background_snapshot() &&
+                p->data->type == MULTIFD_PAYLOAD_RAM) {
+                MultiFDPages_t *pages = &p->data->u.ram;
+
+                if (ram_write_tracking_release(pages->block, pages->offset,
+                                               pages->num)) {
+                    error_setg(&local_err, "multifd %u: failed to release "
+                               "write protection", p->id);
+                    ret = -1;
+                    break;
+                }
+            }
+
             stat64_add(&mig_stats.multifd_bytes,
                        p->next_packet_size + p->packet_len);
 
@@ -843,6 +1039,7 @@ bool multifd_send_setup(void)
         }
         p->name = g_strdup_printf("mig/src/send_%d", i);
         p->write_flags = 0;
+        multifd_affinity_setup(&p->affinity, i);
 
         if (!multifd_new_send_channel_create(p, &local_err)) {
             migrate_set_error(s, local_err);
@@ -1011,6 +1208,7 @@ static void multifd_recv_cleanup_channel(MultiFDRecvParams *p)
     p->data = NULL;
     g_free(p->name);
     p->name = NULL;
+    multifd_affinity_cleanup(&p->affinity);
     p->packet_len = 0;
     g_free(p->packet);
     p->packet = NULL;
@@ -1122,6 +1320,8 @@ static void *multifd_recv_thread(void *opaque)
     bool use_packets = multifd_use_packets();
     int ret;
 
+    multifd_affinity_apply(&p->affinity, p->name);
+
     trace_multifd_recv_thread_start(p->id);
     rcu_register_thread();
 
@@ -1260,6 +1460,7 @@ int multifd_recv_setup(Error **errp)
             p->packet = g_malloc0(p->packet_len);
         }
         p->name = g_strdup_printf("mig/dst/recv_%d", i);
+        multifd_affinity_setup(&p->affinity, i);
         p->normal = g_new0(ram_addr_t, page_count);
         p->zero = g_new0(ram_addr_t, page_count);
     }
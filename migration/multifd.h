@@ -42,6 +42,7 @@ MultiFDRecvData *multifd_get_recv_data(void);
 #define MULTIFD_FLAG_NOCOMP (0 << 1)
 #define MULTIFD_FLAG_ZLIB (1 << 1)
 #define MULTIFD_FLAG_ZSTD (2 << 1)
+#define MULTIFD_FLAG_LZ4 (3 << 1)
 #define MULTIFD_FLAG_QPL (4 << 1)
 #define MULTIFD_FLAG_UADK (8 << 1)
 #define MULTIFD_FLAG_QATZIP (16 << 1)
@@ -115,6 +116,15 @@ static inline void multifd_set_payload_type(MultiFDSendData *data,
     data->type = type;
 }
 
+/* Host placement of a channel thread, see multifd-channel-affinity */
+typedef struct {
+    /* host CPUs the thread may run on, NULL if the thread is not pinned */
+    unsigned long *cpus;
+    unsigned long cpus_nbits;
+    /* host NUMA nodes (MAX_NODES bits) the channel is bound to, or NULL */
+    unsigned long *nodes;
+} MultiFDAffinity;
+
 typedef struct {
     /* Fields are only written at creating/deletion time */
     /* No lock required for them, they are read only */
@@ -126,6 +136,8 @@ typedef struct {
     /* channel thread id */
     QemuThread thread;
     bool thread_created;
+    /* channel thread placement */
+    MultiFDAffinity affinity;
     QemuThread tls_thread;
     bool tls_thread_created;
     /* communication channel */
@@ -182,6 +194,8 @@ typedef struct {
     /* channel thread id */
     QemuThread thread;
     bool thread_created;
+    /* channel thread placement */
+    MultiFDAffinity affinity;
     /* communication channel */
     QIOChannel *c;
     /* packet allocated len */
@@ -337,6 +351,7 @@ static inline uint32_t multifd_ram_page_count(void)
 
 void multifd_ram_save_setup(void);
 void multifd_ram_save_cleanup(void);
+bool multifd_ram_flush(void);
 int multifd_ram_flush_and_sync(void);
 size_t multifd_ram_payload_size(void);
 void multifd_ram_fill_packet(MultiFDSendParams *p);
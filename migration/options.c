@@ -20,6 +20,7 @@
 #include "qapi/qapi-visit-migration.h"
 #include "qapi/qmp/qerror.h"
 #include "qapi/qmp/qnull.h"
+#include "sysemu/numa.h"
 #include "sysemu/runstate.h"
 #include "migration/colo.h"
 #include "migration/misc.h"
@@ -172,6 +173,8 @@ Property migration_properties[] = {
     DEFINE_PROP_ZERO_PAGE_DETECTION("zero-page-detection", MigrationState,
                        parameters.zero_page_detection,
                        ZERO_PAGE_DETECTION_MULTIFD),
+    DEFINE_PROP_BOOL("multifd-ramblock-binding", MigrationState,
+                      parameters.multifd_ramblock_binding, false),
 
     /* Migration capabilities */
     DEFINE_PROP_MIG_CAP("x-xbzrle", MIGRATION_CAPABILITY_XBZRLE),
@@ -421,7 +424,6 @@ INITIALIZE_MIGRATE_CAPS_SET(check_caps_background_snapshot,
     MIGRATION_CAPABILITY_POSTCOPY_BLOCKTIME,
     MIGRATION_CAPABILITY_LATE_BLOCK_ACTIVATE,
     MIGRATION_CAPABILITY_RETURN_PATH,
-    MIGRATION_CAPABILITY_MULTIFD,
     MIGRATION_CAPABILITY_PAUSE_BEFORE_SWITCHOVER,
     MIGRATION_CAPABILITY_AUTO_CONVERGE,
     MIGRATION_CAPABILITY_RELEASE_RAM,
@@ -517,6 +519,26 @@ bool migrate_caps_check(bool *old_caps, bool *new_caps, Error **errp)
                 return false;
             }
         }
+
+        /*
+         * Multifd channels release the write protection of the pages
+         * they have written, which only works out if every page has a
+         * fixed place in the snapshot and host pages are never split
+         * between two channels.
+         */
+        if (new_caps[MIGRATION_CAPABILITY_MULTIFD]) {
+            if (!new_caps[MIGRATION_CAPABILITY_MAPPED_RAM]) {
+                error_setg(errp, "Background-snapshot with multifd "
+                           "requires mapped-ram");
+                return false;
+            }
+            if (!ram_block_page_size_is_target()) {
+                error_setg(errp, "Background-snapshot with multifd requires "
+                           "guest memory backed by pages of the target "
+                           "page size");
+                return false;
+            }
+        }
     }
 
 #ifdef CONFIG_LINUX
@@ -752,6 +774,13 @@ MigMode migrate_mode(void)
     return mode;
 }
 
+const MultiFDChannelAffinityList *migrate_multifd_channel_affinity(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->parameters.multifd_channel_affinity;
+}
+
 int migrate_multifd_channels(void)
 {
     MigrationState *s = migrate_get_current();
@@ -767,6 +796,13 @@ MultiFDCompression migrate_multifd_compression(void)
     return s->parameters.multifd_compression;
 }
 
+bool migrate_multifd_ramblock_binding(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->parameters.multifd_ramblock_binding;
+}
+
 int migrate_multifd_zlib_level(void)
 {
     MigrationState *s = migrate_get_current();
@@ -923,6 +959,15 @@ MigrationParameters *qmp_query_migrate_parameters(Error **errp)
     params->has_direct_io = true;
     params->direct_io = s->parameters.direct_io;
 
+    if (s->parameters.has_multifd_channel_affinity) {
+        params->has_multifd_channel_affinity = true;
+        params->multifd_channel_affinity =
+            QAPI_CLONE(MultiFDChannelAffinityList,
+                       s->parameters.multifd_channel_affinity);
+    }
+    params->has_multifd_ramblock_binding = true;
+    params->multifd_ramblock_binding = s->parameters.multifd_ramblock_binding;
+
     return params;
 }
 
@@ -956,6 +1001,37 @@ void migrate_params_init(MigrationParameters *params)
     params->has_mode = true;
     params->has_zero_page_detection = true;
     params->has_direct_io = true;
+    params->has_multifd_ramblock_binding = true;
+}
+
+static bool
+check_multifd_channel_affinity(const MultiFDChannelAffinityList *list,
+                               Error **errp)
+{
+    const MultiFDChannelAffinityList *l;
+    const uint16List *node;
+
+    for (l = list; l; l = l->next) {
+        if (!l->value->host_cpus && !l->value->host_nodes) {
+            error_setg(errp, "Either host-cpus or host-nodes must be set");
+            return false;
+        }
+        for (node = l->value->host_nodes; node; node = node->next) {
+#ifdef CONFIG_NUMA
+            if (node->value >= MAX_NODES) {
+                error_setg(errp, "Invalid host node %u, must be lower than %d",
+                           node->value, MAX_NODES);
+                return false;
+            }
+#else
+            error_setg(errp, "NUMA node affinity is not supported by this "
+                       "QEMU");
+            return false;
+#endif
+        }
+    }
+
+    return true;
 }
 
 /*
@@ -1142,6 +1218,13 @@ bool migrate_params_check(MigrationParameters *params, Error **errp)
         return false;
     }
 
+    if (params->has_multifd_channel_affinity &&
+        !check_multifd_channel_affinity(params->multifd_channel_affinity,
+                                        errp)) {
+        error_prepend(errp, "Invalid multifd-channel-affinity: ");
+        return false;
+    }
+
     return true;
 }
 
@@ -1255,6 +1338,15 @@ static void migrate_params_test_apply(MigrateSetParameters *params,
     if (params->has_direct_io) {
         dest->direct_io = params->direct_io;
     }
+
+    if (params->has_multifd_channel_affinity) {
+        dest->has_multifd_channel_affinity = true;
+        dest->multifd_channel_affinity = params->multifd_channel_affinity;
+    }
+
+    if (params->has_multifd_ramblock_binding) {
+        dest->multifd_ramblock_binding = params->multifd_ramblock_binding;
+    }
 }
 
 static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
@@ -1387,6 +1479,21 @@ static void migrate_params_apply(MigrateSetParameters *params, Error **errp)
     if (params->has_direct_io) {
         s->parameters.direct_io = params->direct_io;
     }
+
+    if (params->has_multifd_channel_affinity) {
+        qapi_free_MultiFDChannelAffinityList(
+            s->parameters.multifd_channel_affinity);
+
+        s->parameters.has_multifd_channel_affinity = true;
+        s->parameters.multifd_channel_affinity =
+            QAPI_CLONE(MultiFDChannelAffinityList,
+                       params->multifd_channel_affinity);
+    }
+
+    if (params->has_multifd_ramblock_binding) {
+        s->parameters.multifd_ramblock_binding =
+            params->multifd_ramblock_binding;
+    }
 }
 
 void qmp_migrate_set_parameters(MigrateSetParameters *params, Error **errp)
@@ -73,8 +73,10 @@ uint8_t migrate_max_cpu_throttle(void);
 uint64_t migrate_max_bandwidth(void);
 uint64_t migrate_avail_switchover_bandwidth(void);
 uint64_t migrate_max_postcopy_bandwidth(void);
+const MultiFDChannelAffinityList *migrate_multifd_channel_affinity(void);
 int migrate_multifd_channels(void);
 MultiFDCompression migrate_multifd_compression(void);
+bool migrate_multifd_ramblock_binding(void);
 int migrate_multifd_zlib_level(void);
 int migrate_multifd_qatzip_level(void);
 int migrate_multifd_zstd_level(void);
@@ -1446,6 +1446,14 @@ static int ram_save_release_protection(RAMState *rs, PageSearchStatus *pss,
 {
     int res = 0;
 
+    /*
+     * Multifd channels release the pages once they have written them;
+     * zero pages detected here are released by the caller.
+     */
+    if (migrate_multifd()) {
+        return 0;
+    }
+
     /* Check if page is from UFFD-managed region. */
     if (pss->block->flags & RAM_UF_WRITEPROTECT) {
         void *page_address = pss->block->host + (start_page << TARGET_PAGE_BITS);
@@ -1461,6 +1469,44 @@ static int ram_save_release_protection(RAMState *rs, PageSearchStatus *pss,
     return res;
 }
 
+/**
+ * ram_write_tracking_release: release UFFD write protection of pages
+ *   that a multifd channel has written out
+ *
+ * Runs in the multifd send threads.  Runs of contiguous pages are
+ * released at once.
+ *
+ * Returns 0 on success, negative value in case of an error
+ *
+ * @block: RAMBlock the pages belong to
+ * @offset: offsets of the pages relative to @block
+ * @num: number of pages
+ */
+int ram_write_tracking_release(RAMBlock *block, const ram_addr_t *offset,
+                               uint32_t num)
+{
+    uint32_t i, start;
+
+    if (!(block->flags & RAM_UF_WRITEPROTECT)) {
+        return 0;
+    }
+
+    for (start = 0, i = 1; i <= num; i++) {
+        if (i < num && offset[i] == offset[i - 1] + TARGET_PAGE_SIZE) {
+            continue;
+        }
+        if (uffd_change_protection(ram_state->uffdio_fd,
+                                   block->host + offset[start],
+                                   (ram_addr_t)(i - start) << TARGET_PAGE_BITS,
+                                   false, false)) {
+            return -1;
+        }
+        start = i;
+    }
+
+    return 0;
+}
+
 /* ram_write_tracking_available: check if kernel supports required UFFD features
  *
  * Returns true if supports, false otherwise
@@ -1758,6 +1804,12 @@ static int ram_save_release_protection(RAMState *rs, PageSearchStatus *pss,
     return 0;
 }
 
+int ram_write_tracking_release(RAMBlock *block, const ram_addr_t *offset,
+                               uint32_t num)
+{
+    g_assert_not_reached();
+}
+
 bool ram_write_tracking_available(void)
 {
     return false;
@@ -1779,6 +1831,26 @@ void ram_write_tracking_stop(void)
 }
 #endif /* defined(__linux__) */
 
+/**
+ * ram_block_page_size_is_target: check that the RAM blocks are backed
+ *   by pages of the target page size
+ *
+ * Returns true if no RAM block uses larger pages (e.g. hugetlbfs)
+ */
+bool ram_block_page_size_is_target(void)
+{
+    RAMBlock *block;
+
+    RCU_READ_LOCK_GUARD();
+
+    RAMBLOCK_FOREACH_NOT_IGNORED(block) {
+        if (qemu_ram_pagesize(block) != qemu_target_page_size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /**
  * get_queued_page: unqueue a page from the postcopy requests
  *
@@ -2027,6 +2099,11 @@ static int ram_save_target_page_multifd(RAMState *rs, PageSearchStatus *pss)
      */
     if (migrate_zero_page_detection() == ZERO_PAGE_DETECTION_LEGACY) {
         if (save_zero_page(rs, pss, offset)) {
+            /* No multifd channel will see this page, release it here */
+            if (migrate_background_snapshot() &&
+                ram_write_tracking_release(block, &offset, 1)) {
+                return -1;
+            }
             return 1;
         }
     }
@@ -2237,6 +2314,7 @@ static int ram_save_host_page(RAMState *rs, PageSearchStatus *pss)
 static int ram_find_and_save_block(RAMState *rs)
 {
     PageSearchStatus *pss = &rs->pss[RAM_CHANNEL_PRECOPY];
+    bool queued = false;
     int pages = 0;
 
     /* No dirty page as there is zero RAM */
@@ -2259,7 +2337,9 @@ static int ram_find_and_save_block(RAMState *rs)
     pss_init(pss, rs->last_seen_block, rs->last_page);
 
     while (true){
-        if (!get_queued_page(rs, pss)) {
+        if (get_queued_page(rs, pss)) {
+            queued = true;
+        } else {
             /* priority queue empty, so just search for something dirty */
             int res = find_dirty_block(rs, pss);
             if (res != PAGE_DIRTY_FOUND) {
@@ -2279,6 +2359,16 @@ static int ram_find_and_save_block(RAMState *rs)
         }
     }
 
+    /*
+     * A vCPU is blocked on the write-protected page it faulted on, so
+     * send it now rather than when the multifd queue fills up.  The
+     * page may also have been queued earlier and still be waiting.
+     */
+    if (queued && pages >= 0 && migrate_background_snapshot() &&
+        migrate_multifd() && !multifd_ram_flush()) {
+        pages = -1;
+    }
+
     rs->last_seen_block = pss->block;
     rs->last_page = pss->page;
 
@@ -3106,6 +3196,34 @@ static void ram_save_file_bmap(QEMUFile *f)
     }
 }
 
+/*
+ * Wait for the multifd channels to write out all queued pages, then
+ * write the mapped-ram bitmap that tells which pages the file holds.
+ */
+static int ram_save_flush_pages(QEMUFile *f)
+{
+    int ret;
+
+    ret = multifd_ram_flush_and_sync();
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (migrate_mapped_ram()) {
+        ram_save_file_bmap(f);
+
+        if (qemu_file_get_error(f)) {
+            Error *local_err = NULL;
+            int err = qemu_file_get_error_obj(f, &local_err);
+
+            error_reportf_err(local_err, "Failed to write bitmap to file: ");
+            return -err;
+        }
+    }
+
+    return 0;
+}
+
 void ramblock_set_file_bmap_atomic(RAMBlock *block, ram_addr_t offset, bool set)
 {
     if (set) {
@@ -3217,6 +3335,18 @@ out:
             }
         }
 
+        /*
+         * Background snapshots never get to ram_save_complete(): the
+         * dirty bitmap must not be synced after the snapshot point.
+         * Once all pages are saved, finish the file here.
+         */
+        if (done && migrate_background_snapshot()) {
+            ret = ram_save_flush_pages(f);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+
         qemu_put_be64(f, RAM_SAVE_FLAG_EOS);
         ram_transferred_add(8);
         ret = qemu_fflush(f);
@@ -3283,23 +3413,11 @@ static int ram_save_complete(QEMUFile *f, void *opaque)
         }
     }
 
-    ret = multifd_ram_flush_and_sync();
+    ret = ram_save_flush_pages(f);
     if (ret < 0) {
         return ret;
     }
 
-    if (migrate_mapped_ram()) {
-        ram_save_file_bmap(f);
-
-        if (qemu_file_get_error(f)) {
-            Error *local_err = NULL;
-            int err = qemu_file_get_error_obj(f, &local_err);
-
-            error_reportf_err(local_err, "Failed to write bitmap to file: ");
-            return -err;
-        }
-    }
-
     qemu_put_be64(f, RAM_SAVE_FLAG_EOS);
     return qemu_fflush(f);
 }
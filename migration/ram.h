@@ -87,10 +87,13 @@ void colo_incoming_start_dirty_log(void);
 void colo_record_bitmap(RAMBlock *block, ram_addr_t *normal, uint32_t pages);
 
 /* Background snapshot */
+bool ram_block_page_size_is_target(void);
 bool ram_write_tracking_available(void);
 bool ram_write_tracking_compatible(void);
 void ram_write_tracking_prepare(void);
 int ram_write_tracking_start(void);
 void ram_write_tracking_stop(void);
+int ram_write_tracking_release(RAMBlock *block, const ram_addr_t *offset,
+                               uint32_t num);
 
 #endif
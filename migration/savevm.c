@@ -1538,6 +1538,8 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
 {
     MigrationState *ms = migrate_get_current();
     int64_t start_ts_each, end_ts_each;
+    int64_t start_ts = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    uint64_t start_bytes = qemu_file_transferred(f);
     JSONWriter *vmdesc = ms->vmdesc;
     int vmdesc_len;
     SaveStateEntry *se;
@@ -1565,6 +1567,12 @@ int qemu_savevm_state_complete_precopy_non_iterable(QEMUFile *f,
                                     end_ts_each - start_ts_each);
     }
 
+    /* Remembered to predict the downtime of the next switchover */
+    ms->device_state_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME) - start_ts;
+    ms->device_state_size = qemu_file_transferred(f) - start_bytes;
+    trace_vmstate_downtime_device_state(ms->device_state_time,
+                                        ms->device_state_size);
+
     if (inactivate_disks) {
         /* Inactivate before sending QEMU_VM_EOF so that the
          * bdrv_activate_all() on the other end won't fail. */
@@ -52,20 +52,37 @@ typedef struct AFXDPState {
     uint32_t             n_queues;
     uint32_t             xdp_flags;
     bool                 inhibit;
+    bool                 busy_poll;
+    bool                 busy_poll_kick;
+
+    AioContext           *ctx;
 } AFXDPState;
 
 #define AF_XDP_BATCH_SIZE 64
 
+/* Time the kernel may spend busy polling the device per system call. */
+#define AF_XDP_BUSY_POLL_USEC 20
+
 static void af_xdp_send(void *opaque);
 static void af_xdp_writable(void *opaque);
+static bool af_xdp_busy_poll(void *opaque);
+static void af_xdp_busy_poll_ready(void *opaque);
+static void af_xdp_busy_poll_begin(void *opaque);
 
 /* Set the event-loop handlers for the af-xdp backend. */
 static void af_xdp_update_fd_handler(AFXDPState *s)
 {
-    qemu_set_fd_handler(xsk_socket__fd(s->xsk),
-                        s->read_poll ? af_xdp_send : NULL,
-                        s->write_poll ? af_xdp_writable : NULL,
-                        s);
+    bool poll = s->busy_poll && (s->read_poll || s->write_poll);
+    int fd = xsk_socket__fd(s->xsk);
+
+    aio_set_fd_handler(s->ctx, fd,
+                       s->read_poll ? af_xdp_send : NULL,
+                       s->write_poll ? af_xdp_writable : NULL,
+                       poll ? af_xdp_busy_poll : NULL,
+                       poll ? af_xdp_busy_poll_ready : NULL, s);
+    if (poll) {
+        aio_set_fd_poll(s->ctx, fd, af_xdp_busy_poll_begin, NULL);
+    }
 }
 
 /* Update the read handler. */
@@ -257,6 +274,58 @@ static void af_xdp_send(void *opaque)
     af_xdp_fq_refill(s, AF_XDP_BATCH_SIZE);
 }
 
+/*
+ * AioContext polling callback: check the rings without a system call.
+ * When the rings are empty, let the kernel busy poll the device on our
+ * behalf instead of waiting for an interrupt to schedule NAPI.
+ *
+ * The event loop calls this in a tight loop, so the kernel is kicked only
+ * once per polling window, and again only after the rings had some work.
+ */
+static bool af_xdp_busy_poll(void *opaque)
+{
+    AFXDPState *s = opaque;
+    int fd = xsk_socket__fd(s->xsk);
+
+    if ((s->read_poll && xsk_cons_nb_avail(&s->rx, 1)) ||
+        (s->write_poll && xsk_cons_nb_avail(&s->cq, 1))) {
+        s->busy_poll_kick = true;
+        return true;
+    }
+
+    if (!s->busy_poll_kick) {
+        return false;
+    }
+    s->busy_poll_kick = false;
+
+    if (s->read_poll && xsk_ring_prod__needs_wakeup(&s->fq)) {
+        recvfrom(fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    }
+    if (s->write_poll && xsk_ring_prod__needs_wakeup(&s->tx)) {
+        sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    }
+    return false;
+}
+
+static void af_xdp_busy_poll_begin(void *opaque)
+{
+    AFXDPState *s = opaque;
+
+    s->busy_poll_kick = true;
+}
+
+static void af_xdp_busy_poll_ready(void *opaque)
+{
+    AFXDPState *s = opaque;
+
+    if (s->write_poll) {
+        af_xdp_writable(s);
+    }
+    if (s->read_poll) {
+        af_xdp_send(s);
+    }
+}
+
 /* Flush and close. */
 static void af_xdp_cleanup(NetClientState *nc)
 {
@@ -396,13 +465,56 @@ static int af_xdp_socket_create(AFXDPState *s,
     return 0;
 }
 
+/*
+ * Raising these options needs CAP_NET_ADMIN.  Leave them alone if they are
+ * high enough already, e.g. when set by whoever passed in sock-fds.
+ */
+static int af_xdp_raise_sockopt(int fd, int optname, int val)
+{
+    socklen_t len = sizeof(int);
+    int cur;
+
+    if (getsockopt(fd, SOL_SOCKET, optname, &cur, &len) == 0 && cur >= val) {
+        return 0;
+    }
+    return setsockopt(fd, SOL_SOCKET, optname, &val, sizeof(val));
+}
+
+/*
+ * Poll the rings from the event loop.  Returns false if the kernel does not
+ * busy poll the device for us, in which case a kick only wakes up NAPI.
+ */
+static bool af_xdp_busy_poll_setup(AFXDPState *s)
+{
+    int fd = xsk_socket__fd(s->xsk);
+
+    s->busy_poll = true;
+
+    return af_xdp_raise_sockopt(fd, SO_PREFER_BUSY_POLL, 1) == 0 &&
+           af_xdp_raise_sockopt(fd, SO_BUSY_POLL, AF_XDP_BUSY_POLL_USEC) == 0 &&
+           af_xdp_raise_sockopt(fd, SO_BUSY_POLL_BUDGET,
+                                AF_XDP_BATCH_SIZE) == 0;
+}
+
 /* NetClientInfo methods. */
+/* Move the event-loop handlers to another AioContext. */
+static void af_xdp_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+
+    aio_set_fd_handler(s->ctx, xsk_socket__fd(s->xsk),
+                       NULL, NULL, NULL, NULL, NULL);
+    s->ctx = ctx ?: iohandler_get_aio_context();
+    af_xdp_update_fd_handler(s);
+}
+
 static NetClientInfo net_af_xdp_info = {
     .type = NET_CLIENT_DRIVER_AF_XDP,
     .size = sizeof(AFXDPState),
     .receive = af_xdp_receive,
     .poll = af_xdp_poll,
     .cleanup = af_xdp_cleanup,
+    .set_aio_context = af_xdp_set_aio_context,
 };
 
 static int *parse_socket_fds(const char *sock_fds_str,
@@ -448,6 +560,7 @@ int net_init_af_xdp(const Netdev *netdev,
     uint32_t prog_id = 0;
     g_autofree int *sock_fds = NULL;
     int64_t i, queues;
+    int busy_poll_err = 0;
     Error *err = NULL;
     AFXDPState *s;
 
@@ -491,6 +604,7 @@ int net_init_af_xdp(const Netdev *netdev,
         pstrcpy(s->ifname, sizeof(s->ifname), opts->ifname);
         s->ifindex = ifindex;
         s->n_queues = queues;
+        s->ctx = iohandler_get_aio_context();
 
         if (af_xdp_umem_create(s, sock_fds ? sock_fds[i] : -1, errp)
             || af_xdp_socket_create(s, opts, errp)) {
@@ -499,6 +613,20 @@ int net_init_af_xdp(const Netdev *netdev,
             error_propagate(errp, err);
             goto err;
         }
+
+        if (opts->has_busy_poll && opts->busy_poll &&
+            !af_xdp_busy_poll_setup(s) && !busy_poll_err) {
+            busy_poll_err = errno;
+        }
+    }
+
+    if (busy_poll_err) {
+        warn_report("af-xdp: cannot enable kernel busy polling for '%s': %s",
+                    opts->ifname, strerror(busy_poll_err));
+        error_printf("The AF_XDP rings are still polled.  Kernel busy polling "
+                     "needs CAP_NET_ADMIN, or sockets passed with sock-fds "
+                     "that have SO_PREFER_BUSY_POLL, SO_BUSY_POLL and "
+                     "SO_BUSY_POLL_BUDGET set already.\n");
     }
 
     if (nc0) {
@@ -245,6 +245,14 @@ static void netfilter_complete(UserCreatable *uc, Error **errp)
         return;
     }
 
+    /* See qemu_net_client_has_filters() */
+    if (ncs[0]->ctx) {
+        error_setg(errp, "netdev '%s' is running in an IOThread, filters "
+                   "can only be added while the guest is stopped",
+                   nf->netdev_id);
+        return;
+    }
+
     if (strcmp(nf->position, "head") && strcmp(nf->position, "tail")) {
         Object *container;
         Object *obj;
@@ -48,6 +48,7 @@
 #include "qemu/qemu-print.h"
 #include "qemu/main-loop.h"
 #include "qemu/option.h"
+#include "block/aio-wait.h"
 #include "qemu/keyval.h"
 #include "qapi/error.h"
 #include "qapi/opts-visitor.h"
@@ -589,6 +590,38 @@ int qemu_set_vnet_be(NetClientState *nc, bool is_be)
 #endif
 }
 
+bool qemu_has_set_aio_context(NetClientState *nc)
+{
+    return nc && nc->info->set_aio_context;
+}
+
+/*
+ * Move the I/O handlers of @nc to @ctx, or back to the main loop if @ctx is
+ * NULL.  Must be called from the thread that currently runs @nc, and nothing
+ * else may use @nc until it has returned.  The packets of the peer of @nc
+ * are handled in @ctx too from then on.
+ */
+void qemu_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    assert(qemu_has_set_aio_context(nc));
+
+    nc->info->set_aio_context(nc, ctx);
+    nc->ctx = ctx;
+    if (nc->peer) {
+        nc->peer->ctx = ctx;
+    }
+}
+
+/*
+ * Netfilters run in the main loop and are not thread-safe, so @nc must
+ * stay in the main loop if it or its peer has any.
+ */
+bool qemu_net_client_has_filters(NetClientState *nc)
+{
+    return !QTAILQ_EMPTY(&nc->filters) ||
+           (nc->peer && !QTAILQ_EMPTY(&nc->peer->filters));
+}
+
 int qemu_can_receive_packet(NetClientState *nc)
 {
     if (nc->receive_disabled) {
@@ -883,6 +916,33 @@ qemu_sendv_packet(NetClientState *nc, const struct iovec *iov, int iovcnt)
     return qemu_sendv_packet_async(nc, iov, iovcnt, NULL);
 }
 
+/*
+ * Tell the peer of @nc that a burst of packets sent by @nc is complete, so
+ * that a peer which batches its writes can push them out now.
+ */
+void qemu_send_flush(NetClientState *nc)
+{
+    NetClientState *peer = nc->peer;
+
+    if (peer && peer->info->flush_tx) {
+        peer->info->flush_tx(peer);
+    }
+}
+
+/*
+ * Return how many packets the peer of @nc can take right now, at most @max.
+ * Peers that cannot tell, or that are behind filters, return @max.
+ */
+int qemu_peer_rx_buffers(NetClientState *nc, int max)
+{
+    NetClientState *peer = nc->peer;
+
+    if (!peer || !peer->info->rx_buffers || qemu_net_client_has_filters(nc)) {
+        return max;
+    }
+    return peer->info->rx_buffers(peer, max);
+}
+
 NetClientState *qemu_find_netdev(const char *id)
 {
     NetClientState *nc;
@@ -1635,6 +1695,29 @@ void qmp_set_link(const char *name, bool up, Error **errp)
     }
 }
 
+typedef struct NetVMChangeState {
+    NetClientState *nc;
+    bool running;
+} NetVMChangeState;
+
+static void net_vm_change_state_nc(void *opaque)
+{
+    NetVMChangeState *s = opaque;
+    NetClientState *nc = s->nc;
+
+    if (s->running) {
+        /* Flush queued packets and wake up backends. */
+        if (nc->peer && qemu_can_send_packet(nc)) {
+            qemu_flush_queued_packets(nc->peer);
+        }
+    } else {
+        /* Complete all queued packets, to guarantee we don't modify
+         * state later when VM is not running.
+         */
+        qemu_flush_or_purge_queued_packets(nc, true);
+    }
+}
+
 static void net_vm_change_state_handler(void *opaque, bool running,
                                         RunState state)
 {
@@ -1642,16 +1725,16 @@ static void net_vm_change_state_handler(void *opaque, bool running,
     NetClientState *tmp;
 
     QTAILQ_FOREACH_SAFE(nc, &net_clients, next, tmp) {
-        if (running) {
-            /* Flush queued packets and wake up backends. */
-            if (nc->peer && qemu_can_send_packet(nc)) {
-                qemu_flush_queued_packets(nc->peer);
-            }
+        NetVMChangeState s = {
+            .nc = nc,
+            .running = running,
+        };
+
+        /* The queues of @nc may be in use by an IOThread */
+        if (nc->ctx) {
+            aio_wait_bh_oneshot(nc->ctx, net_vm_change_state_nc, &s);
         } else {
-            /* Complete all queued packets, to guarantee we don't modify
-             * state later when VM is not running.
-             */
-            qemu_flush_or_purge_queued_packets(nc, true);
+            net_vm_change_state_nc(&s);
         }
     }
 }
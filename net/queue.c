@@ -23,6 +23,8 @@
 
 #include "qemu/osdep.h"
 #include "net/queue.h"
+#include "qemu/atomic.h"
+#include "qemu/iov.h"
 #include "qemu/queue.h"
 #include "net/net.h"
 
@@ -40,13 +42,34 @@
  * unbounded queueing.
  */
 
+/*
+ * Queued packets keep their bytes in a refcounted payload.  When a queued
+ * packet is delivered to a filter or hub that has to queue it again, the
+ * next queue takes a reference to the payload instead of copying it.
+ *
+ * Each queue also keeps a slab of free packet headers and of payloads of
+ * NET_PACKET_SLAB_DATA_SIZE bytes, so that queueing under backpressure
+ * does not hit the allocator for every packet.
+ */
+
+#define NET_PACKET_SLAB_DATA_SIZE 2048
+#define NET_PACKET_SLAB_MAX 256
+
+typedef struct NetPacketData {
+    int refcnt;
+    size_t size;
+    QSLIST_ENTRY(NetPacketData) next;
+    uint8_t data[];
+} NetPacketData;
+
 struct NetPacket {
     QTAILQ_ENTRY(NetPacket) entry;
     NetClientState *sender;
     unsigned flags;
     int size;
     NetPacketSent *sent_cb;
-    uint8_t data[];
+    NetPacketData *payload;
+    uint8_t *data;
 };
 
 struct NetQueue {
@@ -57,9 +80,18 @@ struct NetQueue {
 
     QTAILQ_HEAD(, NetPacket) packets;
 
+    /* Slab of unused packet headers and payloads */
+    QTAILQ_HEAD(, NetPacket) free_packets;
+    uint32_t nr_free_packets;
+    QSLIST_HEAD(, NetPacketData) free_data;
+    uint32_t nr_free_data;
+
     unsigned delivering : 1;
 };
 
+/* The queued packet that this thread is delivering, if any */
+static __thread NetPacket *net_queue_delivering_packet;
+
 NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque)
 {
     NetQueue *queue;
@@ -72,45 +104,108 @@ NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque)
     queue->deliver = deliver;
 
     QTAILQ_INIT(&queue->packets);
+    QTAILQ_INIT(&queue->free_packets);
+    QSLIST_INIT(&queue->free_data);
 
     queue->delivering = 0;
 
     return queue;
 }
 
+static NetPacketData *qemu_net_queue_data_alloc(NetQueue *queue, size_t size)
+{
+    NetPacketData *payload;
+
+    if (size <= NET_PACKET_SLAB_DATA_SIZE &&
+        !QSLIST_EMPTY(&queue->free_data)) {
+        payload = QSLIST_FIRST(&queue->free_data);
+        QSLIST_REMOVE_HEAD(&queue->free_data, next);
+        queue->nr_free_data--;
+    } else {
+        size = MAX(size, NET_PACKET_SLAB_DATA_SIZE);
+        payload = g_malloc(sizeof(NetPacketData) + size);
+        payload->size = size;
+    }
+    payload->refcnt = 1;
+    return payload;
+}
+
+/*
+ * The last reference may be dropped by a different queue than the one that
+ * allocated the payload; it then goes to that queue's slab.
+ */
+static void qemu_net_queue_data_unref(NetQueue *queue, NetPacketData *payload)
+{
+    if (qatomic_fetch_dec(&payload->refcnt) != 1) {
+        return;
+    }
+
+    if (payload->size == NET_PACKET_SLAB_DATA_SIZE &&
+        queue->nr_free_data < NET_PACKET_SLAB_MAX) {
+        QSLIST_INSERT_HEAD(&queue->free_data, payload, next);
+        queue->nr_free_data++;
+    } else {
+        g_free(payload);
+    }
+}
+
+static void qemu_net_queue_packet_free(NetQueue *queue, NetPacket *packet)
+{
+    qemu_net_queue_data_unref(queue, packet->payload);
+
+    if (queue->nr_free_packets < NET_PACKET_SLAB_MAX) {
+        QTAILQ_INSERT_HEAD(&queue->free_packets, packet, entry);
+        queue->nr_free_packets++;
+    } else {
+        g_free(packet);
+    }
+}
+
 void qemu_del_net_queue(NetQueue *queue)
 {
     NetPacket *packet, *next;
+    NetPacketData *payload;
 
     QTAILQ_FOREACH_SAFE(packet, &queue->packets, entry, next) {
         QTAILQ_REMOVE(&queue->packets, packet, entry);
+        qemu_net_queue_packet_free(queue, packet);
+    }
+
+    QTAILQ_FOREACH_SAFE(packet, &queue->free_packets, entry, next) {
+        QTAILQ_REMOVE(&queue->free_packets, packet, entry);
         g_free(packet);
     }
+    while ((payload = QSLIST_FIRST(&queue->free_data))) {
+        QSLIST_REMOVE_HEAD(&queue->free_data, next);
+        g_free(payload);
+    }
 
     g_free(queue);
 }
 
-static void qemu_net_queue_append(NetQueue *queue,
-                                  NetClientState *sender,
-                                  unsigned flags,
-                                  const uint8_t *buf,
-                                  size_t size,
-                                  NetPacketSent *sent_cb)
+/*
+ * If @iov is (part of) the payload of the queued packet being delivered by
+ * this thread, share that payload instead of copying it.
+ */
+static NetPacketData *qemu_net_queue_share_data(const struct iovec *iov,
+                                                int iovcnt)
 {
-    NetPacket *packet;
+    NetPacket *delivering = net_queue_delivering_packet;
+    uint8_t *base;
 
-    if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
-        return; /* drop if queue full and no callback */
+    if (!delivering || iovcnt != 1) {
+        return NULL;
     }
-    packet = g_malloc(sizeof(NetPacket) + size);
-    packet->sender = sender;
-    packet->flags = flags;
-    packet->size = size;
-    packet->sent_cb = sent_cb;
-    memcpy(packet->data, buf, size);
 
-    queue->nq_count++;
-    QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
+    base = iov[0].iov_base;
+    if (base < delivering->data ||
+        base > delivering->data + delivering->size ||
+        iov[0].iov_len > delivering->data + delivering->size - base) {
+        return NULL;
+    }
+
+    qatomic_inc(&delivering->payload->refcnt);
+    return delivering->payload;
 }
 
 void qemu_net_queue_append_iov(NetQueue *queue,
@@ -121,33 +216,54 @@ void qemu_net_queue_append_iov(NetQueue *queue,
                                NetPacketSent *sent_cb)
 {
     NetPacket *packet;
-    size_t max_len = 0;
-    int i;
+    NetPacketData *payload;
 
     if (queue->nq_count >= queue->nq_maxlen && !sent_cb) {
         return; /* drop if queue full and no callback */
     }
-    for (i = 0; i < iovcnt; i++) {
-        max_len += iov[i].iov_len;
-    }
 
-    packet = g_malloc(sizeof(NetPacket) + max_len);
+    packet = QTAILQ_FIRST(&queue->free_packets);
+    if (packet) {
+        QTAILQ_REMOVE(&queue->free_packets, packet, entry);
+        queue->nr_free_packets--;
+    } else {
+        packet = g_new(NetPacket, 1);
+    }
     packet->sender = sender;
     packet->sent_cb = sent_cb;
     packet->flags = flags;
-    packet->size = 0;
-
-    for (i = 0; i < iovcnt; i++) {
-        size_t len = iov[i].iov_len;
 
-        memcpy(packet->data + packet->size, iov[i].iov_base, len);
-        packet->size += len;
+    payload = qemu_net_queue_share_data(iov, iovcnt);
+    if (payload) {
+        packet->data = iov[0].iov_base;
+        packet->size = iov[0].iov_len;
+    } else {
+        payload = qemu_net_queue_data_alloc(queue, iov_size(iov, iovcnt));
+        packet->data = payload->data;
+        packet->size = iov_to_buf(iov, iovcnt, 0, payload->data,
+                                  payload->size);
     }
+    packet->payload = payload;
 
     queue->nq_count++;
     QTAILQ_INSERT_TAIL(&queue->packets, packet, entry);
 }
 
+static void qemu_net_queue_append(NetQueue *queue,
+                                  NetClientState *sender,
+                                  unsigned flags,
+                                  const uint8_t *buf,
+                                  size_t size,
+                                  NetPacketSent *sent_cb)
+{
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = size
+    };
+
+    qemu_net_queue_append_iov(queue, sender, flags, &iov, 1, sent_cb);
+}
+
 static ssize_t qemu_net_queue_deliver(NetQueue *queue,
                                       NetClientState *sender,
                                       unsigned flags,
@@ -254,7 +370,7 @@ void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
             if (packet->sent_cb) {
                 packet->sent_cb(packet->sender, 0);
             }
-            g_free(packet);
+            qemu_net_queue_packet_free(queue, packet);
         }
     }
 }
@@ -265,18 +381,21 @@ bool qemu_net_queue_flush(NetQueue *queue)
         return false;
 
     while (!QTAILQ_EMPTY(&queue->packets)) {
-        NetPacket *packet;
+        NetPacket *packet, *outer;
         int ret;
 
         packet = QTAILQ_FIRST(&queue->packets);
         QTAILQ_REMOVE(&queue->packets, packet, entry);
         queue->nq_count--;
 
+        outer = net_queue_delivering_packet;
+        net_queue_delivering_packet = packet;
         ret = qemu_net_queue_deliver(queue,
                                      packet->sender,
                                      packet->flags,
                                      packet->data,
                                      packet->size);
+        net_queue_delivering_packet = outer;
         if (ret == 0) {
             queue->nq_count++;
             QTAILQ_INSERT_HEAD(&queue->packets, packet, entry);
@@ -287,7 +406,7 @@ bool qemu_net_queue_flush(NetQueue *queue)
             packet->sent_cb(packet->sender, ret);
         }
 
-        g_free(packet);
+        qemu_net_queue_packet_free(queue, packet);
     }
     return true;
 }
@@ -43,17 +43,19 @@ typedef struct NetSocketState {
     IOHandler *send_fn;           /* differs between SOCK_STREAM/SOCK_DGRAM */
     bool read_poll;               /* waiting to receive data? */
     bool write_poll;              /* waiting to transmit data? */
+    AioContext *ctx;              /* where the handlers of fd run */
 } NetSocketState;
 
 static void net_socket_accept(void *opaque);
+static void net_socket_connect(void *opaque);
 static void net_socket_writable(void *opaque);
 
 static void net_socket_update_fd_handler(NetSocketState *s)
 {
-    qemu_set_fd_handler(s->fd,
-                        s->read_poll ? s->send_fn : NULL,
-                        s->write_poll ? net_socket_writable : NULL,
-                        s);
+    aio_set_fd_handler(s->ctx, s->fd,
+                       s->read_poll ? s->send_fn : NULL,
+                       s->write_poll ? net_socket_writable : NULL,
+                       NULL, NULL, s);
 }
 
 static void net_socket_read_poll(NetSocketState *s, bool enable)
@@ -319,11 +321,34 @@ static void net_socket_cleanup(NetClientState *nc)
     }
 }
 
+/* Move the handlers of the connected socket; listening stays in main loop */
+static void net_socket_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    NetSocketState *s = DO_UPCAST(NetSocketState, nc, nc);
+
+    if (s->fd != -1) {
+        aio_set_fd_handler(s->ctx, s->fd, NULL, NULL, NULL, NULL, NULL);
+    }
+    s->ctx = ctx ?: iohandler_get_aio_context();
+    if (s->fd == -1) {
+        return;
+    }
+
+    if (s->send_fn) {
+        net_socket_update_fd_handler(s);
+    } else {
+        /* Still connecting */
+        aio_set_fd_handler(s->ctx, s->fd, NULL, net_socket_connect,
+                           NULL, NULL, s);
+    }
+}
+
 static NetClientInfo net_dgram_socket_info = {
     .type = NET_CLIENT_DRIVER_SOCKET,
     .size = sizeof(NetSocketState),
     .receive = net_socket_receive_dgram,
     .cleanup = net_socket_cleanup,
+    .set_aio_context = net_socket_set_aio_context,
 };
 
 static NetSocketState *net_socket_fd_init_dgram(NetClientState *peer,
@@ -378,6 +403,7 @@ static NetSocketState *net_socket_fd_init_dgram(NetClientState *peer,
 
     s->fd = fd;
     s->listen_fd = -1;
+    s->ctx = iohandler_get_aio_context();
     s->send_fn = net_socket_send_dgram;
     net_socket_rs_init(&s->rs, net_socket_rs_finalize, false);
     net_socket_read_poll(s, true);
@@ -415,6 +441,7 @@ static NetClientInfo net_socket_info = {
     .size = sizeof(NetSocketState),
     .receive = net_socket_receive,
     .cleanup = net_socket_cleanup,
+    .set_aio_context = net_socket_set_aio_context,
 };
 
 static NetSocketState *net_socket_fd_init_stream(NetClientState *peer,
@@ -433,6 +460,7 @@ static NetSocketState *net_socket_fd_init_stream(NetClientState *peer,
 
     s->fd = fd;
     s->listen_fd = -1;
+    s->ctx = iohandler_get_aio_context();
     net_socket_rs_init(&s->rs, net_socket_rs_finalize, false);
 
     /* Disable Nagle algorithm on TCP sockets to reduce latency */
@@ -441,7 +469,8 @@ static NetSocketState *net_socket_fd_init_stream(NetClientState *peer,
     if (is_connected) {
         net_socket_connect(s);
     } else {
-        qemu_set_fd_handler(s->fd, NULL, net_socket_connect, s);
+        aio_set_fd_handler(s->ctx, s->fd, NULL, net_socket_connect,
+                           NULL, NULL, s);
     }
     return s;
 }
@@ -530,6 +559,7 @@ static int net_socket_listen_init(NetClientState *peer,
     s = DO_UPCAST(NetSocketState, nc, nc);
     s->fd = -1;
     s->listen_fd = fd;
+    s->ctx = iohandler_get_aio_context();
     s->nc.link_down = true;
     net_socket_rs_init(&s->rs, net_socket_rs_finalize, false);
 
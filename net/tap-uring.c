@@ -0,0 +1,290 @@
+/*
+ * Batched tap I/O using io_uring
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include <liburing.h>
+#include "qapi/error.h"
+#include "qemu/iov.h"
+#include "qemu/units.h"
+#include "tap_int.h"
+
+/*
+ * A tap file descriptor only moves one packet per read(2) or write(2), so
+ * small packet throughput is bound by the number of system calls.  TapUring
+ * submits a whole burst of reads or writes with a single io_uring_enter(2).
+ *
+ * Requests of a burst are linked so that the kernel executes them in order
+ * and packets are neither reordered on RX nor on TX.  The tap fd is
+ * non-blocking, so each request completes right away with a packet or with
+ * -EAGAIN and waiting for the whole burst never blocks.
+ *
+ * Each RX slot must hold the largest packet the tap device can return, so
+ * the RX depth is limited by TAP_URING_RX_MEM rather than by the TX depth.
+ */
+
+struct TapUring {
+    struct io_uring ring;
+    int fd;
+    unsigned int depth;
+    unsigned int rx_depth;
+    /* requests that may still complete after a failed submission */
+    unsigned int inflight;
+
+    /* RX slots and the length read into each of them, or -errno */
+    uint8_t *rx_buf;
+    size_t rx_buf_size;
+    ssize_t *rx_len;
+    unsigned int *rx_order; /* slots holding a packet, in arrival order */
+    unsigned int rx_count;
+
+    /* TX slots holding copied packets waiting for tap_uring_tx_flush() */
+    uint8_t *tx_buf;
+    size_t *tx_len;
+    unsigned int tx_count;
+};
+
+TapUring *tap_uring_new(int fd, unsigned int depth, size_t rx_buf_size,
+                        Error **errp)
+{
+    TapUring *tu = g_new0(TapUring, 1);
+    int ret;
+
+    assert(depth > 0);
+
+    ret = io_uring_queue_init(depth, &tu->ring, 0);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "failed to initialize io_uring");
+        g_free(tu);
+        return NULL;
+    }
+
+    tu->fd = fd;
+    tu->depth = depth;
+    tu->rx_depth = MIN(depth, MAX(TAP_URING_RX_MEM / rx_buf_size, 1));
+    tu->rx_buf_size = rx_buf_size;
+    tu->rx_buf = g_malloc(tu->rx_depth * rx_buf_size);
+    tu->rx_len = g_new0(ssize_t, tu->rx_depth);
+    tu->rx_order = g_new0(unsigned int, tu->rx_depth);
+    tu->tx_buf = g_malloc(depth * TAP_URING_TX_BUF_SIZE);
+    tu->tx_len = g_new0(size_t, depth);
+    return tu;
+}
+
+void tap_uring_free(TapUring *tu)
+{
+    if (!tu) {
+        return;
+    }
+    io_uring_queue_exit(&tu->ring);
+    if (tu->inflight) {
+        /* The kernel may still be using the buffers */
+        return;
+    }
+    g_free(tu->rx_buf);
+    g_free(tu->rx_len);
+    g_free(tu->rx_order);
+    g_free(tu->tx_buf);
+    g_free(tu->tx_len);
+    g_free(tu);
+}
+
+/*
+ * Wait for the completions of requests that were submitted before a
+ * submission failed, so that they do not show up in a later burst.
+ */
+static void tap_uring_drain(TapUring *tu)
+{
+    struct io_uring_cqe *cqe;
+    int ret;
+
+    while (tu->inflight) {
+        ret = io_uring_wait_cqe(&tu->ring, &cqe);
+        if (ret == -EINTR) {
+            continue;
+        } else if (ret < 0) {
+            break;
+        }
+        io_uring_cqe_seen(&tu->ring, cqe);
+        tu->inflight--;
+    }
+}
+
+/*
+ * Submit the prepared SQEs and reap @nr completions, storing each result in
+ * @res indexed by the request's user_data.
+ *
+ * If the submission fails, the requests that the kernel did not take stay
+ * in the submission queue and would run with the next burst, so the ring
+ * must not be used anymore.
+ */
+static int tap_uring_run(TapUring *tu, unsigned int nr, ssize_t *res)
+{
+    struct io_uring_cqe *cqe;
+    unsigned int head;
+    unsigned int submitted = 0;
+    unsigned int done = 0;
+    int ret;
+
+    while (done < nr) {
+        unsigned int seen = 0;
+
+        ret = io_uring_submit_and_wait(&tu->ring, nr - done);
+        if (ret > 0) {
+            submitted += ret;
+        } else if (ret < 0 && ret != -EINTR) {
+            tu->inflight = submitted - done;
+            tap_uring_drain(tu);
+            return ret;
+        }
+
+        io_uring_for_each_cqe(&tu->ring, head, cqe) {
+            res[cqe->user_data] = cqe->res;
+            seen++;
+        }
+        io_uring_cq_advance(&tu->ring, seen);
+        done += seen;
+    }
+    return 0;
+}
+
+unsigned int tap_uring_rx_depth(TapUring *tu)
+{
+    return tu->rx_depth;
+}
+
+int tap_uring_read(TapUring *tu, unsigned int max)
+{
+    unsigned int nr = MIN(MAX(max, 1), tu->rx_depth);
+    unsigned int i;
+    int ret;
+
+    tu->rx_count = 0;
+
+    for (i = 0; i < nr; i++) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&tu->ring);
+
+        io_uring_prep_read(sqe, tu->fd, tu->rx_buf + i * tu->rx_buf_size,
+                           tu->rx_buf_size, 0);
+        io_uring_sqe_set_data(sqe, (void *)(uintptr_t)i);
+
+        /*
+         * A short read does not break a hard link, so later reads still run
+         * (in order) after the queue ran dry.
+         */
+        if (i + 1 < nr) {
+            io_uring_sqe_set_flags(sqe, IOSQE_IO_HARDLINK);
+        }
+    }
+
+    ret = tap_uring_run(tu, nr, tu->rx_len);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (i = 0; i < nr; i++) {
+        if (tu->rx_len[i] > 0) {
+            tu->rx_order[tu->rx_count++] = i;
+        }
+    }
+    return tu->rx_count;
+}
+
+ssize_t tap_uring_rx_packet(TapUring *tu, unsigned int index, uint8_t **buf)
+{
+    unsigned int slot;
+
+    assert(index < tu->rx_count);
+
+    slot = tu->rx_order[index];
+    *buf = tu->rx_buf + slot * tu->rx_buf_size;
+    return tu->rx_len[slot];
+}
+
+bool tap_uring_tx_queue(TapUring *tu, const struct iovec *iov, int iovcnt)
+{
+    size_t len = iov_size(iov, iovcnt);
+
+    if (tu->tx_count == tu->depth || len > TAP_URING_TX_BUF_SIZE) {
+        return false;
+    }
+
+    iov_to_buf(iov, iovcnt, 0,
+               tu->tx_buf + tu->tx_count * TAP_URING_TX_BUF_SIZE, len);
+    tu->tx_len[tu->tx_count++] = len;
+    return true;
+}
+
+unsigned int tap_uring_tx_pending(TapUring *tu)
+{
+    return tu->tx_count;
+}
+
+int tap_uring_tx_flush(TapUring *tu)
+{
+    g_autofree ssize_t *res = NULL;
+    unsigned int sent = 0;
+    unsigned int i;
+    int ret;
+
+    if (!tu->tx_count) {
+        return 0;
+    }
+
+    res = g_new(ssize_t, tu->tx_count);
+
+    while (sent < tu->tx_count) {
+        unsigned int nr = tu->tx_count - sent;
+
+        for (i = 0; i < nr; i++) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&tu->ring);
+            unsigned int slot = sent + i;
+
+            io_uring_prep_write(sqe, tu->fd,
+                                tu->tx_buf + slot * TAP_URING_TX_BUF_SIZE,
+                                tu->tx_len[slot], 0);
+            io_uring_sqe_set_data(sqe, (void *)(uintptr_t)i);
+
+            /* A failed write cancels the rest of the burst */
+            if (i + 1 < nr) {
+                io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+            }
+        }
+
+        ret = tap_uring_run(tu, nr, res);
+        if (ret < 0) {
+            /* Whatever was not written is lost with the ring */
+            tu->tx_count = 0;
+            return ret;
+        }
+
+        for (i = 0; i < nr && res[i] >= 0; i++) {
+            sent++;
+        }
+        if (i == nr || res[i] == -ECANCELED) {
+            /* All sent, or the link was broken by a short write */
+            continue;
+        }
+
+        if (res[i] == -EAGAIN) {
+            ret = -EAGAIN;
+            break;
+        }
+
+        /* Drop a packet that the tap device refused and go on */
+        sent++;
+    }
+
+    /* Keep what was not sent at the front, in order */
+    if (sent < tu->tx_count) {
+        memmove(tu->tx_buf, tu->tx_buf + sent * TAP_URING_TX_BUF_SIZE,
+                (tu->tx_count - sent) * TAP_URING_TX_BUF_SIZE);
+        memmove(tu->tx_len, tu->tx_len + sent,
+                (tu->tx_count - sent) * sizeof(tu->tx_len[0]));
+    }
+    tu->tx_count -= sent;
+
+    return tu->tx_count ? ret : 0;
+}
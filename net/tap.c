@@ -34,12 +34,14 @@
 
 #include "net/eth.h"
 #include "net/net.h"
+#include "net/queue.h"
 #include "clients.h"
 #include "monitor/monitor.h"
 #include "sysemu/sysemu.h"
 #include "qapi/error.h"
 #include "qemu/cutils.h"
 #include "qemu/error-report.h"
+#include "qemu/iov.h"
 #include "qemu/main-loop.h"
 #include "qemu/sockets.h"
 
@@ -62,8 +64,22 @@ typedef struct TAPState {
     VHostNetState *vhost_net;
     unsigned host_vnet_hdr_len;
     Notifier exit;
+    AioContext *ctx; /* where the fd handlers run */
+#ifdef CONFIG_LINUX_IO_URING
+    TapUring *uring; /* batched I/O, NULL unless batch-size > 1 */
+    QEMUBH *flush_bh; /* flushes the TX batch if the sender does not */
+#endif
 } TAPState;
 
+/*
+ * When the host keeps receiving more packets while tap_send() is running we
+ * can hog the BQL.  Limit the number of packets that are processed per
+ * tap_send() callback to prevent stalling the guest.
+ */
+#define TAP_SEND_BUDGET 50
+
+#define TAP_BATCH_MAX 256
+
 static void launch_script(const char *setup_script, const char *ifname,
                           int fd, Error **errp);
 
@@ -72,10 +88,10 @@ static void tap_writable(void *opaque);
 
 static void tap_update_fd_handler(TAPState *s)
 {
-    qemu_set_fd_handler(s->fd,
-                        s->read_poll && s->enabled ? tap_send : NULL,
-                        s->write_poll && s->enabled ? tap_writable : NULL,
-                        s);
+    aio_set_fd_handler(s->ctx, s->fd,
+                       s->read_poll && s->enabled ? tap_send : NULL,
+                       s->write_poll && s->enabled ? tap_writable : NULL,
+                       NULL, NULL, s);
 }
 
 static void tap_read_poll(TAPState *s, bool enable)
@@ -90,12 +106,58 @@ static void tap_write_poll(TAPState *s, bool enable)
     tap_update_fd_handler(s);
 }
 
+#ifdef CONFIG_LINUX_IO_URING
+/* After a failed submission the ring is unusable, go on without it */
+static void tap_uring_failed(TAPState *s, int err)
+{
+    warn_report("tap: io_uring submission failed (%s), disabling batching",
+                strerror(-err));
+    qemu_bh_delete(s->flush_bh);
+    s->flush_bh = NULL;
+    tap_uring_free(s->uring);
+    s->uring = NULL;
+}
+
+static int tap_flush_batch(TAPState *s)
+{
+    int ret = tap_uring_tx_flush(s->uring);
+
+    if (ret == -EAGAIN) {
+        tap_write_poll(s, true);
+    } else if (ret < 0) {
+        tap_uring_failed(s, ret);
+    }
+    return ret;
+}
+
+static void tap_flush_bh(void *opaque)
+{
+    tap_flush_batch(opaque);
+}
+
+static void tap_flush_tx(NetClientState *nc)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+
+    if (s->uring && tap_uring_tx_pending(s->uring)) {
+        qemu_bh_cancel(s->flush_bh);
+        tap_flush_batch(s);
+    }
+}
+#endif
+
 static void tap_writable(void *opaque)
 {
     TAPState *s = opaque;
 
     tap_write_poll(s, false);
 
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->uring && tap_flush_batch(s) == -EAGAIN) {
+        return;
+    }
+#endif
+
     qemu_flush_queued_packets(&s->nc);
 }
 
@@ -113,6 +175,33 @@ static ssize_t tap_write_packet(TAPState *s, const struct iovec *iov, int iovcnt
     return len;
 }
 
+#ifdef CONFIG_LINUX_IO_URING
+/*
+ * Queue the packet in the TX batch.  The batch goes out when the sender
+ * calls qemu_send_flush(), when it is full, or at the latest from a bottom
+ * half for senders that never flush.
+ */
+static ssize_t tap_write_batched(TAPState *s, const struct iovec *iov,
+                                 int iovcnt)
+{
+    if (tap_uring_tx_queue(s->uring, iov, iovcnt)) {
+        qemu_bh_schedule(s->flush_bh);
+        return iov_size(iov, iovcnt);
+    }
+
+    /* Batch full or packet too large, keep the packets in order */
+    if (tap_flush_batch(s) == -EAGAIN) {
+        return 0;
+    }
+
+    if (s->uring && tap_uring_tx_queue(s->uring, iov, iovcnt)) {
+        qemu_bh_schedule(s->flush_bh);
+        return iov_size(iov, iovcnt);
+    }
+    return tap_write_packet(s, iov, iovcnt);
+}
+#endif
+
 static ssize_t tap_receive_iov(NetClientState *nc, const struct iovec *iov,
                                int iovcnt)
 {
@@ -130,6 +219,12 @@ static ssize_t tap_receive_iov(NetClientState *nc, const struct iovec *iov,
         iovcnt++;
     }
 
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->uring) {
+        return tap_write_batched(s, iovp, iovcnt);
+    }
+#endif
+
     return tap_write_packet(s, iovp, iovcnt);
 }
 
@@ -156,35 +251,95 @@ static void tap_send_completed(NetClientState *nc, ssize_t len)
     tap_read_poll(s, true);
 }
 
+/* Pass a packet read from the tap device to the peer */
+static int tap_send_one(TAPState *s, uint8_t *buf, int size)
+{
+    uint8_t min_pkt[ETH_ZLEN];
+    size_t min_pktsz = sizeof(min_pkt);
+
+    if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
+        buf  += s->host_vnet_hdr_len;
+        size -= s->host_vnet_hdr_len;
+    }
+
+    if (net_peer_needs_padding(&s->nc)) {
+        if (eth_pad_short_frame(min_pkt, &min_pktsz, buf, size)) {
+            buf = min_pkt;
+            size = min_pktsz;
+        }
+    }
+
+    return qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
+}
+
+#ifdef CONFIG_LINUX_IO_URING
+static int tap_send_batched(TAPState *s)
+{
+    unsigned int depth = tap_uring_rx_depth(s->uring);
+    int packets = 0;
+    bool full = false;
+    int want, n, i;
+
+    while (!full && packets < TAP_SEND_BUDGET) {
+        /* Only read what the peer can take without queueing */
+        want = MAX(qemu_peer_rx_buffers(&s->nc, depth), 1);
+        n = tap_uring_read(s->uring, want);
+        if (n < 0) {
+            return n;
+        } else if (n == 0) {
+            break;
+        }
+
+        /*
+         * The whole burst has been read already.  If the peer fills up, the
+         * rest of it is queued by the net layer.
+         */
+        for (i = 0; i < n; i++) {
+            uint8_t *buf;
+            int size = tap_uring_rx_packet(s->uring, i, &buf);
+
+            if (tap_send_one(s, buf, size) == 0) {
+                full = true;
+            }
+        }
+        packets += n;
+
+        if (n < want) {
+            break; /* drained */
+        }
+    }
+
+    if (full) {
+        tap_read_poll(s, false);
+    }
+    return 0;
+}
+#endif
+
 static void tap_send(void *opaque)
 {
     TAPState *s = opaque;
     int size;
     int packets = 0;
 
-    while (true) {
-        uint8_t *buf = s->buf;
-        uint8_t min_pkt[ETH_ZLEN];
-        size_t min_pktsz = sizeof(min_pkt);
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->uring) {
+        int ret = tap_send_batched(s);
+
+        if (ret == 0) {
+            return;
+        }
+        tap_uring_failed(s, ret);
+    }
+#endif
 
+    while (true) {
         size = tap_read_packet(s->fd, s->buf, sizeof(s->buf));
         if (size <= 0) {
             break;
         }
 
-        if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
-            buf  += s->host_vnet_hdr_len;
-            size -= s->host_vnet_hdr_len;
-        }
-
-        if (net_peer_needs_padding(&s->nc)) {
-            if (eth_pad_short_frame(min_pkt, &min_pktsz, buf, size)) {
-                buf = min_pkt;
-                size = min_pktsz;
-            }
-        }
-
-        size = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
+        size = tap_send_one(s, s->buf, size);
         if (size == 0) {
             tap_read_poll(s, false);
             break;
@@ -192,14 +347,8 @@ static void tap_send(void *opaque)
             break;
         }
 
-        /*
-         * When the host keeps receiving more packets while tap_send() is
-         * running we can hog the BQL.  Limit the number of
-         * packets that are processed per tap_send() callback to prevent
-         * stalling the guest.
-         */
         packets++;
-        if (packets >= 50) {
+        if (packets >= TAP_SEND_BUDGET) {
             break;
         }
     }
@@ -303,6 +452,18 @@ static void tap_cleanup(NetClientState *nc)
 
     tap_read_poll(s, false);
     tap_write_poll(s, false);
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->uring) {
+        qemu_bh_delete(s->flush_bh);
+        s->flush_bh = NULL;
+        /* Last chance for the batch, what still does not fit is dropped */
+        tap_uring_tx_flush(s->uring);
+        tap_uring_free(s->uring);
+        s->uring = NULL;
+        /* Complete the packets that were queued while the batch was full */
+        qemu_net_queue_purge(nc->incoming_queue, nc->peer);
+    }
+#endif
     close(s->fd);
     s->fd = -1;
 }
@@ -322,6 +483,25 @@ static bool tap_set_steering_ebpf(NetClientState *nc, int prog_fd)
     return tap_fd_set_steering_ebpf(s->fd, prog_fd) == 0;
 }
 
+static void tap_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    TAPState *s = DO_UPCAST(TAPState, nc, nc);
+    assert(nc->info->type == NET_CLIENT_DRIVER_TAP);
+
+    aio_set_fd_handler(s->ctx, s->fd, NULL, NULL, NULL, NULL, NULL);
+    s->ctx = ctx ?: iohandler_get_aio_context();
+#ifdef CONFIG_LINUX_IO_URING
+    if (s->uring) {
+        tap_flush_tx(nc);
+    }
+    if (s->uring) {
+        qemu_bh_delete(s->flush_bh);
+        s->flush_bh = aio_bh_new(s->ctx, tap_flush_bh, s);
+    }
+#endif
+    tap_update_fd_handler(s);
+}
+
 int tap_get_fd(NetClientState *nc)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
@@ -347,6 +527,10 @@ static NetClientInfo net_tap_info = {
     .set_vnet_le = tap_set_vnet_le,
     .set_vnet_be = tap_set_vnet_be,
     .set_steering_ebpf = tap_set_steering_ebpf,
+    .set_aio_context = tap_set_aio_context,
+#ifdef CONFIG_LINUX_IO_URING
+    .flush_tx = tap_flush_tx,
+#endif
 };
 
 static TAPState *net_tap_fd_init(NetClientState *peer,
@@ -363,6 +547,7 @@ static TAPState *net_tap_fd_init(NetClientState *peer,
     s = DO_UPCAST(TAPState, nc, nc);
 
     s->fd = fd;
+    s->ctx = iohandler_get_aio_context();
     s->host_vnet_hdr_len = vnet_hdr ? sizeof(struct virtio_net_hdr) : 0;
     s->using_vnet_hdr = false;
     s->has_ufo = tap_probe_has_ufo(s->fd);
@@ -724,6 +909,27 @@ static void net_init_tap_one(const NetdevTapOptions *tap, NetClientState *peer,
         goto failed;
     }
 
+    if (tap->has_batch_size && tap->batch_size > 1) {
+        if (s->vhost_net) {
+            error_setg(errp, "batch-size is not supported with vhost");
+            goto failed;
+        }
+        if (tap->batch_size > TAP_BATCH_MAX) {
+            error_setg(errp, "batch-size must not exceed %d", TAP_BATCH_MAX);
+            goto failed;
+        }
+#ifdef CONFIG_LINUX_IO_URING
+        s->uring = tap_uring_new(s->fd, tap->batch_size, NET_BUFSIZE, errp);
+        if (!s->uring) {
+            goto failed;
+        }
+        s->flush_bh = aio_bh_new(s->ctx, tap_flush_bh, s);
+#else
+        error_setg(errp, "batch-size requires io_uring support");
+        goto failed;
+#endif
+    }
+
     return;
 
 failed:
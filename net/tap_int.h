@@ -47,4 +47,42 @@ int tap_fd_disable(int fd);
 int tap_fd_get_ifname(int fd, char *ifname);
 int tap_fd_set_steering_ebpf(int fd, int prog_fd);
 
+#ifdef CONFIG_LINUX_IO_URING
+/* Packets larger than this are not batched on TX */
+#define TAP_URING_TX_BUF_SIZE 2048
+/* Limit for the RX slots, which are sized for the largest packet */
+#define TAP_URING_RX_MEM (2 * MiB)
+
+typedef struct TapUring TapUring;
+
+TapUring *tap_uring_new(int fd, unsigned int depth, size_t rx_buf_size,
+                        Error **errp);
+void tap_uring_free(TapUring *tu);
+
+/*
+ * Read up to @max packets, but no more than tap_uring_rx_depth(), with one
+ * system call.  Returns the number of packets read, to be fetched with
+ * tap_uring_rx_packet(), or -errno if the submission failed.  The TapUring
+ * can only be freed after a failure.
+ */
+int tap_uring_read(TapUring *tu, unsigned int max);
+unsigned int tap_uring_rx_depth(TapUring *tu);
+ssize_t tap_uring_rx_packet(TapUring *tu, unsigned int index, uint8_t **buf);
+
+/*
+ * Copy a packet into the TX batch.  Returns false if the batch is full or
+ * the packet is too large to be batched.
+ */
+bool tap_uring_tx_queue(TapUring *tu, const struct iovec *iov, int iovcnt);
+unsigned int tap_uring_tx_pending(TapUring *tu);
+
+/*
+ * Write out the TX batch with one system call.  Returns -EAGAIN if the tap
+ * device is full; the packets that were not written stay queued in order.
+ * Other errors mean that the submission failed: the packets that were not
+ * written are dropped and the TapUring can only be freed.
+ */
+int tap_uring_tx_flush(TapUring *tu);
+#endif
+
 #endif /* NET_TAP_INT_H */
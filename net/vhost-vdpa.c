@@ -21,6 +21,7 @@
 #include "qemu/memalign.h"
 #include "qemu/option.h"
 #include "qapi/error.h"
+#include "sysemu/iothread.h"
 #include <linux/vhost.h>
 #include <sys/ioctl.h>
 #include <err.h>
@@ -48,6 +49,9 @@ typedef struct VhostVDPAState {
     bool cvq_isolated;
 
     bool started;
+
+    /* IOThread running the data SVQs, only set for the first queue pair */
+    IOThread *svq_iothread;
 } VhostVDPAState;
 
 /*
@@ -242,6 +246,10 @@ static void vhost_vdpa_cleanup(NetClientState *nc)
     if (s->vhost_vdpa.index != 0) {
         return;
     }
+    if (s->svq_iothread) {
+        object_unref(OBJECT(s->svq_iothread));
+        s->svq_iothread = NULL;
+    }
     qemu_close(s->vhost_vdpa.shared->device_fd);
     g_free(s->vhost_vdpa.shared);
 }
@@ -1793,6 +1801,7 @@ int net_init_vhost_vdpa(const Netdev *netdev, const char *name,
     int vdpa_device_fd;
     g_autofree NetClientState **ncs = NULL;
     struct vhost_vdpa_iova_range iova_range;
+    IOThread *svq_iothread = NULL;
     NetClientState *nc;
     int queue_pairs, r, i = 0, has_cvq = 0;
 
@@ -1810,6 +1819,15 @@ int net_init_vhost_vdpa(const Netdev *netdev, const char *name,
         return -1;
     }
 
+    if (opts->x_svq_iothread) {
+        svq_iothread = iothread_by_id(opts->x_svq_iothread);
+        if (!svq_iothread) {
+            error_setg(errp, "vhost-vdpa: iothread '%s' not found",
+                       opts->x_svq_iothread);
+            return -1;
+        }
+    }
+
     if (opts->vhostdev) {
         vdpa_device_fd = qemu_open(opts->vhostdev, O_RDWR, errp);
         if (vdpa_device_fd == -1) {
@@ -1874,6 +1892,14 @@ int net_init_vhost_vdpa(const Netdev *netdev, const char *name,
             goto err;
     }
 
+    if (svq_iothread) {
+        VhostVDPAState *s0 = DO_UPCAST(VhostVDPAState, nc, ncs[0]);
+
+        s0->svq_iothread = svq_iothread;
+        object_ref(OBJECT(svq_iothread));
+        s0->vhost_vdpa.shared->svq_ctx = iothread_get_aio_context(svq_iothread);
+    }
+
     return 0;
 
 err:
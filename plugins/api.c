@@ -200,6 +200,20 @@ void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
     plugin_register_inline_op_on_entry(&insn->mem_cbs, rw, op, entry, imm);
 }
 
+void qemu_plugin_register_vcpu_mem_batch(struct qemu_plugin_insn *insn,
+                                         enum qemu_plugin_mem_rw rw,
+                                         struct qemu_plugin_mem_batch *batch)
+{
+    plugin_register_vcpu_mem_batch(&insn->mem_cbs, rw, insn->vaddr, batch);
+}
+
+void qemu_plugin_register_vcpu_insn_exec_batch(
+    struct qemu_plugin_insn *insn,
+    struct qemu_plugin_mem_batch *batch)
+{
+    plugin_register_vcpu_mem_batch(&insn->insn_cbs, 0, insn->vaddr, batch);
+}
+
 void qemu_plugin_register_vcpu_tb_trans_cb(qemu_plugin_id_t id,
                                            qemu_plugin_vcpu_tb_trans_cb_t cb)
 {
@@ -597,6 +611,39 @@ void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
     plugin_scoreboard_free(score);
 }
 
+struct qemu_plugin_mem_batch *
+qemu_plugin_mem_batch_new(size_t entries,
+                          qemu_plugin_vcpu_mem_batch_cb_t cb,
+                          void *userdata)
+{
+    struct qemu_plugin_mem_batch *batch;
+
+    g_assert(entries > 0);
+    batch = g_new0(struct qemu_plugin_mem_batch, 1);
+    batch->score = plugin_scoreboard_new(
+        sizeof(struct qemu_plugin_mem_batch_buf) +
+        entries * sizeof(qemu_plugin_mem_record));
+    batch->capacity = entries;
+    batch->cb = cb;
+    batch->userp = userdata;
+    return batch;
+}
+
+void qemu_plugin_mem_batch_free(struct qemu_plugin_mem_batch *batch)
+{
+    plugin_scoreboard_free(batch->score);
+    g_free(batch);
+}
+
+void qemu_plugin_mem_batch_flush(struct qemu_plugin_mem_batch *batch)
+{
+    int i;
+
+    for (i = 0; i < qemu_plugin_num_vcpus(); i++) {
+        plugin_mem_batch_flush_vcpu(i, batch);
+    }
+}
+
 void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
                                   unsigned int vcpu_index)
 {
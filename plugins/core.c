@@ -465,6 +465,31 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
     dyn_cb->regular = regular_cb;
 }
 
+void plugin_register_vcpu_mem_batch(GArray **arr,
+                                    enum qemu_plugin_mem_rw rw,
+                                    uint64_t pc,
+                                    struct qemu_plugin_mem_batch *batch)
+{
+    static TCGHelperInfo info = {
+        .flags = TCG_CALL_NO_RWG,
+        /*
+         * Match plugin_mem_batch_flush_vcpu:
+         *   void (*)(uint32_t, void *)
+         */
+        .typemask = (dh_typemask(void, 0) |
+                     dh_typemask(i32, 1) |
+                     dh_typemask(ptr, 2))
+    };
+
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+    struct qemu_plugin_batch_cb batch_cb = { .batch = batch,
+                                             .info = &info,
+                                             .pc = pc,
+                                             .rw = rw };
+    dyn_cb->type = PLUGIN_CB_MEM_BATCH;
+    dyn_cb->batch = batch_cb;
+}
+
 /*
  * Disable CFI checks.
  * The callback function has been loaded from an external library so we do not
@@ -601,6 +626,45 @@ void exec_inline_op(enum plugin_dyn_cb_type type,
     }
 }
 
+static struct qemu_plugin_mem_batch_buf *
+mem_batch_buf(struct qemu_plugin_mem_batch *batch, int cpu_index)
+{
+    GArray *data = batch->score->data;
+
+    return (void *)(data->data + cpu_index * g_array_get_element_size(data));
+}
+
+/*
+ * Called from translated code when the buffer of a vCPU is full, and
+ * from qemu_plugin_mem_batch_flush() for partially filled buffers.
+ */
+QEMU_DISABLE_CFI
+void plugin_mem_batch_flush_vcpu(unsigned int cpu_index, void *udata)
+{
+    struct qemu_plugin_mem_batch *batch = udata;
+    struct qemu_plugin_mem_batch_buf *buf = mem_batch_buf(batch, cpu_index);
+
+    if (buf->n) {
+        batch->cb(cpu_index, buf->recs, buf->n, batch->userp);
+        buf->n = 0;
+    }
+}
+
+static void exec_mem_batch(struct qemu_plugin_batch_cb *cb, int cpu_index,
+                           uint64_t vaddr, qemu_plugin_meminfo_t info)
+{
+    struct qemu_plugin_mem_batch_buf *buf = mem_batch_buf(cb->batch, cpu_index);
+
+    buf->recs[buf->n++] = (qemu_plugin_mem_record) {
+        .vaddr = vaddr,
+        .pc = cb->pc,
+        .info = info,
+    };
+    if (buf->n == cb->batch->capacity) {
+        plugin_mem_batch_flush_vcpu(cpu_index, cb->batch);
+    }
+}
+
 void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                              uint64_t value_low,
                              uint64_t value_high,
@@ -634,6 +698,12 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                 exec_inline_op(cb->type, &cb->inline_insn, cpu->cpu_index);
             }
             break;
+        case PLUGIN_CB_MEM_BATCH:
+            if (rw & cb->batch.rw) {
+                exec_mem_batch(&cb->batch, cpu->cpu_index, vaddr,
+                               make_plugin_meminfo(oi, rw));
+            }
+            break;
         default:
             g_assert_not_reached();
         }
@@ -108,6 +108,11 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
                                  enum qemu_plugin_mem_rw rw,
                                  void *udata);
 
+void plugin_register_vcpu_mem_batch(GArray **arr,
+                                    enum qemu_plugin_mem_rw rw,
+                                    uint64_t pc,
+                                    struct qemu_plugin_mem_batch *batch);
+
 void exec_inline_op(enum plugin_dyn_cb_type type,
                     struct qemu_plugin_inline_cb *cb,
                     int cpu_index);
@@ -187,6 +187,7 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tier-threshold=n (TCG superblock translation after n executions, default 0, disabled)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
@@ -230,6 +231,16 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``tier-threshold=n``
+        Enables tiered translation. Each translation block counts its
+        executions, and after ``n`` of them it is translated again as a
+        superblock, which continues past forward direct jumps and
+        forward conditional branches within the same guest page. The
+        lazily computed flags then carry across those branches instead
+        of being resolved at the end of each block. Only x86 guests form
+        superblocks so far.
+        Not used with icount. The default is 0, which disables tiering.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -2769,7 +2780,7 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "-netdev tap,id=str[,fd=h][,fds=x:y:...:z][,ifname=name][,script=file][,downscript=dfile]\n"
     "         [,br=bridge][,helper=helper][,sndbuf=nbytes][,vnet_hdr=on|off][,vhost=on|off]\n"
     "         [,vhostfd=h][,vhostfds=x:y:...:z][,vhostforce=on|off][,queues=n]\n"
-    "         [,poll-us=n]\n"
+    "         [,poll-us=n][,batch-size=n]\n"
     "                configure a host TAP network backend with ID 'str'\n"
     "                connected to a bridge (default=" DEFAULT_BRIDGE_INTERFACE ")\n"
     "                use network scripts 'file' (default=" DEFAULT_NETWORK_SCRIPT ")\n"
@@ -2792,6 +2803,8 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "                use 'queues=n' to specify the number of queues to be created for multiqueue TAP\n"
     "                use 'poll-us=n' to specify the maximum number of microseconds that could be\n"
     "                spent on busy polling for vhost net\n"
+    "                use 'batch-size=n' to read and write up to n packets per io_uring\n"
+    "                submission (not compatible with vhost)\n"
     "-netdev bridge,id=str[,br=bridge][,helper=helper]\n"
     "                configure a host TAP network backend with ID 'str' that is\n"
     "                connected to a bridge (default=" DEFAULT_BRIDGE_INTERFACE ")\n"
@@ -2863,6 +2876,7 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
 #ifdef CONFIG_AF_XDP
     "-netdev af-xdp,id=str,ifname=name[,mode=native|skb][,force-copy=on|off]\n"
     "         [,queues=n][,start-queue=m][,inhibit=on|off][,sock-fds=x:y:...:z]\n"
+    "         [,busy-poll=on|off]\n"
     "                attach to the existing network interface 'name' with AF_XDP socket\n"
     "                use 'mode=MODE' to specify an XDP program attach mode\n"
     "                use 'force-copy=on|off' to force XDP copy mode even if device supports zero-copy (default: off)\n"
@@ -2872,6 +2886,7 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "                  added to a socket map in XDP program.  One socket per queue.\n"
     "                use 'queues=n' to specify how many queues of a multiqueue interface should be used\n"
     "                use 'start-queue=m' to specify the first queue that should be used\n"
+    "                use 'busy-poll=on|off' to busy poll the AF_XDP rings from an IOThread (default: off)\n"
 #endif
 #ifdef CONFIG_POSIX
     "-netdev vhost-user,id=str,chardev=dev[,vhostforce=on|off]\n"
@@ -3564,7 +3579,7 @@ SRST
         # launch QEMU instance
         |qemu_system| linux.img -nic vde,sock=/tmp/myswitch
 
-``-netdev af-xdp,id=str,ifname=name[,mode=native|skb][,force-copy=on|off][,queues=n][,start-queue=m][,inhibit=on|off][,sock-fds=x:y:...:z]``
+``-netdev af-xdp,id=str,ifname=name[,mode=native|skb][,force-copy=on|off][,queues=n][,start-queue=m][,inhibit=on|off][,sock-fds=x:y:...:z][,busy-poll=on|off]``
     Configure AF_XDP backend to connect to a network interface 'name'
     using AF_XDP socket.  A specific program attach mode for a default
     XDP program can be forced with 'mode', defaults to best-effort,
@@ -3613,6 +3628,28 @@ SRST
         |qemu_system| linux.img -device virtio-net-pci,netdev=n1 \\
             -netdev af-xdp,id=n1,ifname=eth0,queues=3,inhibit=on,sock-fds=15:16:17
 
+    With 'busy-poll=on' the AF_XDP rings are checked by the adaptive polling
+    of the IOThread that runs the network device, and the kernel busy polls
+    the NIC on QEMU's behalf instead of waiting for interrupts.  This trades
+    CPU time for latency and packet rate.  It has no effect for devices that
+    run in the main loop.  Deferring hard interrupts on the host NIC makes
+    the kernel rely on busy polling alone.
+
+    .. parsed-literal::
+
+        echo 2 > /sys/class/net/eth0/napi_defer_hard_irqs
+        echo 200000 > /sys/class/net/eth0/gro_flush_timeout
+        |qemu_system| linux.img -object iothread,id=io1,poll-max-ns=50000 \\
+            -device virtio-net-pci,netdev=n1,iothread=io1 \\
+            -netdev af-xdp,id=n1,ifname=eth0,busy-poll=on
+
+    Kernel busy polling is set up with the ``SO_PREFER_BUSY_POLL``,
+    ``SO_BUSY_POLL`` and ``SO_BUSY_POLL_BUDGET`` socket options, which
+    need ``CAP_NET_ADMIN``.  Without it QEMU warns and only polls the rings.
+    An unprivileged QEMU that gets its sockets with 'sock-fds' can still
+    use kernel busy polling if the process that creates the sockets sets
+    these options to at least 1, 20 and 64 respectively.
+
 ``-netdev vhost-user,chardev=id[,vhostforce=on|off][,queues=n]``
     Establish a vhost-user netdev, backed by a chardev id. The chardev
     should be a unix domain socket backed one. The vhost-user uses a
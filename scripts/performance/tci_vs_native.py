@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+#  Compare the speed of the TCG interpreter (TCI) against a native TCG
+#  backend by running the same guest program under two QEMU user mode
+#  binaries, one configured with --enable-tcg-interpreter and one without.
+#
+#  Syntax:
+#  tci_vs_native.py [-h] [-n <runs>] --tci <qemu executable> \
+#                   --native <qemu executable> -- \
+#                   <target executable> [<target executable options>]
+#
+#  [-h] - Print the script arguments help message.
+#  [-n] - Number of runs of each binary; the fastest run is reported.
+#
+#  Example of usage, with the sha512 test from "make check-tcg" as the
+#  guest workload:
+#  tci_vs_native.py --tci build-tci/qemu-x86_64 \
+#      --native build/qemu-x86_64 -- \
+#      build/tests/tcg/x86_64-linux-user/sha512
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+
+def run_once(qemu, command):
+    """
+    Run the guest command once under the given QEMU binary.
+
+    Parameters:
+    qemu (str): Path of the QEMU user mode executable
+    command (list): Target executable and its arguments
+
+    Returns:
+    (float): Wall clock time of the run in seconds
+    """
+    start = time.perf_counter()
+    run = subprocess.run([qemu] + command,
+                         stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    elapsed = time.perf_counter() - start
+    if run.returncode:
+        sys.exit("{} failed with exit code {}:\n{}".format(
+            qemu, run.returncode, run.stderr.decode("utf-8")))
+    return elapsed
+
+
+def main():
+    # Parse the command line arguments
+    parser = argparse.ArgumentParser(
+        usage='tci_vs_native.py [-h] [-n <runs>] '
+        '--tci <qemu executable> --native <qemu executable> -- '
+        '<target executable> [<target executable options>]')
+
+    parser.add_argument('-n', dest='runs', type=int, default=3,
+                        help='Number of runs of each binary (default 3)')
+    parser.add_argument('--tci', dest='tci', type=str, required=True,
+                        help='QEMU executable configured with TCI')
+    parser.add_argument('--native', dest='native', type=str, required=True,
+                        help='QEMU executable using a native TCG backend')
+    parser.add_argument('command', type=str, nargs='+', help=argparse.SUPPRESS)
+
+    args = parser.parse_args()
+
+    for qemu in (args.tci, args.native):
+        if not os.access(qemu, os.X_OK):
+            sys.exit("{} is not an executable ... Exiting.".format(qemu))
+    if args.runs < 1:
+        sys.exit("Number of runs must be at least 1 ... Exiting.")
+
+    results = {}
+    for name, qemu in (("native", args.native), ("tci", args.tci)):
+        results[name] = min(run_once(qemu, args.command)
+                            for _ in range(args.runs))
+
+    print("{:<10}{:>12}".format("Backend", "Time (s)"))
+    print("-" * 22)
+    for name in ("native", "tci"):
+        print("{:<10}{:>12.3f}".format(name, results[name]))
+    print("-" * 22)
+    print("TCI is {:.2f}x slower than native".format(
+        results["tci"] / results["native"]))
+
+
+if __name__ == "__main__":
+    main()
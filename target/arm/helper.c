@@ -4371,9 +4371,38 @@ static void vmsa_tcr_el12_write(CPUARMState *env, const ARMCPRegInfo *ri,
     raw_write(env, ri, value);
 }
 
+/* Return the ASID in use by the EL1&0 regime with AArch64 at EL1. */
+static uint32_t aa64_e10_asid(CPUARMState *env)
+{
+    uint64_t tcr = env->cp15.tcr_el[1];
+    uint64_t ttbr = tcr & TTBCR_A1 ? env->cp15.ttbr1_el[1]
+                                   : env->cp15.ttbr0_el[1];
+
+    return extract64(ttbr, 48, tcr & TCR_AS ? 16 : 8);
+}
+
 static void vmsa_ttbr_write(CPUARMState *env, const ARMCPRegInfo *ri,
                             uint64_t value)
 {
+    if (ri->state == ARM_CP_STATE_AA64) {
+        /*
+         * The softmmu TLB is tagged by ASID, so there is no need to
+         * flush on a change of the active ASID; just switch to it.
+         */
+        uint32_t old_asid = aa64_e10_asid(env);
+        uint32_t new_asid;
+
+        raw_write(env, ri, value);
+        new_asid = aa64_e10_asid(env);
+        if (new_asid != old_asid) {
+            tlb_set_asid_by_mmuidx(env_cpu(env),
+                                   ARMMMUIdxBit_E10_1 |
+                                   ARMMMUIdxBit_E10_1_PAN |
+                                   ARMMMUIdxBit_E10_0, new_asid);
+        }
+        return;
+    }
+
     /* If the ASID changes (with a 64-bit write), we must flush the TLB.  */
     if (cpreg_field_is_64bit(ri) &&
         extract64(raw_read(env, ri) ^ value, 48, 16) != 0) {
@@ -4998,6 +5027,52 @@ static void tlbi_aa64_vmalle1_write(CPUARMState *env, const ARMCPRegInfo *ri,
     }
 }
 
+/*
+ * Invalidate by ASID.  Only the EL1&0 regime has its TLB tagged by
+ * ASID (see vmsa_ttbr_write), otherwise invalidate everything.
+ */
+static bool tlbi_aa64_aside1_asid(CPUARMState *env, uint64_t value,
+                                  uint32_t *asid)
+{
+    if (vae1_tlbmask(env) != (ARMMMUIdxBit_E10_1 |
+                              ARMMMUIdxBit_E10_1_PAN |
+                              ARMMMUIdxBit_E10_0)) {
+        return false;
+    }
+    *asid = extract64(value, 48, env->cp15.tcr_el[1] & TCR_AS ? 16 : 8);
+    return true;
+}
+
+static void tlbi_aa64_aside1is_write(CPUARMState *env, const ARMCPRegInfo *ri,
+                                     uint64_t value)
+{
+    CPUState *cs = env_cpu(env);
+    uint32_t asid;
+
+    if (!tlbi_aa64_aside1_asid(env, value, &asid)) {
+        tlbi_aa64_vmalle1is_write(env, ri, value);
+        return;
+    }
+    tlb_flush_asid_by_mmuidx_all_cpus_synced(cs, vae1_tlbmask(env), asid);
+}
+
+static void tlbi_aa64_aside1_write(CPUARMState *env, const ARMCPRegInfo *ri,
+                                   uint64_t value)
+{
+    CPUState *cs = env_cpu(env);
+    uint32_t asid;
+
+    if (!tlbi_aa64_aside1_asid(env, value, &asid)) {
+        tlbi_aa64_vmalle1_write(env, ri, value);
+        return;
+    }
+    if (tlb_force_broadcast(env)) {
+        tlb_flush_asid_by_mmuidx_all_cpus_synced(cs, vae1_tlbmask(env), asid);
+    } else {
+        tlb_flush_asid_by_mmuidx(cs, vae1_tlbmask(env), asid);
+    }
+}
+
 static int e2_tlbmask(CPUARMState *env)
 {
     return (ARMMMUIdxBit_E20_0 |
@@ -5686,7 +5761,7 @@ static const ARMCPRegInfo v8_cp_reginfo[] = {
       .opc0 = 1, .opc1 = 0, .crn = 8, .crm = 3, .opc2 = 2,
       .access = PL1_W, .accessfn = access_ttlbis, .type = ARM_CP_NO_RAW,
       .fgt = FGT_TLBIASIDE1IS,
-      .writefn = tlbi_aa64_vmalle1is_write },
+      .writefn = tlbi_aa64_aside1is_write },
     { .name = "TLBI_VAAE1IS", .state = ARM_CP_STATE_AA64,
       .opc0 = 1, .opc1 = 0, .crn = 8, .crm = 3, .opc2 = 3,
       .access = PL1_W, .accessfn = access_ttlbis, .type = ARM_CP_NO_RAW,
@@ -5716,7 +5791,7 @@ static const ARMCPRegInfo v8_cp_reginfo[] = {
       .opc0 = 1, .opc1 = 0, .crn = 8, .crm = 7, .opc2 = 2,
       .access = PL1_W, .accessfn = access_ttlb, .type = ARM_CP_NO_RAW,
       .fgt = FGT_TLBIASIDE1,
-      .writefn = tlbi_aa64_vmalle1_write },
+      .writefn = tlbi_aa64_aside1_write },
     { .name = "TLBI_VAAE1", .state = ARM_CP_STATE_AA64,
       .opc0 = 1, .opc1 = 0, .crn = 8, .crm = 7, .opc2 = 3,
       .access = PL1_W, .accessfn = access_ttlb, .type = ARM_CP_NO_RAW,
@@ -7971,7 +8046,7 @@ static const ARMCPRegInfo tlbios_reginfo[] = {
       .opc0 = 1, .opc1 = 0, .crn = 8, .crm = 1, .opc2 = 2,
       .access = PL1_W, .accessfn = access_ttlbos, .type = ARM_CP_NO_RAW,
       .fgt = FGT_TLBIASIDE1OS,
-      .writefn = tlbi_aa64_vmalle1is_write },
+      .writefn = tlbi_aa64_aside1is_write },
     { .name = "TLBI_VAAE1OS", .state = ARM_CP_STATE_AA64,
       .opc0 = 1, .opc1 = 0, .crn = 8, .crm = 1, .opc2 = 3,
       .access = PL1_W, .accessfn = access_ttlbos, .type = ARM_CP_NO_RAW,
@@ -1456,6 +1456,7 @@ static bool trans_B(DisasContext *s, arg_i *a)
 static bool trans_BL(DisasContext *s, arg_i *a)
 {
     gen_pc_plus_diff(s, cpu_reg(s, 30), curr_insn_len(s));
+    tcg_gen_push_return_i64(cpu_reg(s, 30));
     reset_btype(s);
     gen_goto_tb(s, 0, a->imm);
     return true;
@@ -1560,6 +1561,7 @@ static bool trans_BLR(DisasContext *s, arg_r *a)
         dst = tmp;
     }
     gen_pc_plus_diff(s, lr, curr_insn_len(s));
+    tcg_gen_push_return_i64(lr);
     gen_a64_set_pc(s, dst);
     set_btype_for_blr(s);
     s->base.is_jmp = DISAS_JUMP;
@@ -1569,7 +1571,7 @@ static bool trans_BLR(DisasContext *s, arg_r *a)
 static bool trans_RET(DisasContext *s, arg_r *a)
 {
     gen_a64_set_pc(s, cpu_reg(s, a->rn));
-    s->base.is_jmp = DISAS_JUMP;
+    s->base.is_jmp = DISAS_RETURN;
     return true;
 }
 
@@ -1626,6 +1628,7 @@ static bool trans_BLRAZ(DisasContext *s, arg_braz *a)
         dst = tmp;
     }
     gen_pc_plus_diff(s, lr, curr_insn_len(s));
+    tcg_gen_push_return_i64(lr);
     gen_a64_set_pc(s, dst);
     set_btype_for_blr(s);
     s->base.is_jmp = DISAS_JUMP;
@@ -1638,7 +1641,7 @@ static bool trans_RETA(DisasContext *s, arg_reta *a)
 
     dst = auth_branch_target(s, cpu_reg(s, 30), cpu_X[31], !a->m);
     gen_a64_set_pc(s, dst);
-    s->base.is_jmp = DISAS_JUMP;
+    s->base.is_jmp = DISAS_RETURN;
     return true;
 }
 
@@ -1671,6 +1674,7 @@ static bool trans_BLRA(DisasContext *s, arg_bra *a)
         dst = tmp;
     }
     gen_pc_plus_diff(s, lr, curr_insn_len(s));
+    tcg_gen_push_return_i64(lr);
     gen_a64_set_pc(s, dst);
     set_btype_for_blr(s);
     s->base.is_jmp = DISAS_JUMP;
@@ -11897,6 +11901,7 @@ static void aarch64_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
             /* fall through */
         case DISAS_EXIT:
         case DISAS_JUMP:
+        case DISAS_RETURN:
             gen_step_complete_exception(dc);
             break;
         case DISAS_NORETURN:
@@ -11921,6 +11926,9 @@ static void aarch64_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
         case DISAS_JUMP:
             tcg_gen_lookup_and_goto_ptr();
             break;
+        case DISAS_RETURN:
+            tcg_gen_lookup_return_and_goto_ptr(cpu_pc);
+            break;
         case DISAS_NORETURN:
         case DISAS_SWI:
             break;
@@ -321,6 +321,8 @@ static inline int curr_insn_len(DisasContext *s)
 #define DISAS_EXIT      DISAS_TARGET_9
 /* CPU state was modified dynamically; no need to exit, but do not chain. */
 #define DISAS_UPDATE_NOCHAIN  DISAS_TARGET_10
+/* As DISAS_JUMP, for a function return (A64 only) */
+#define DISAS_RETURN    DISAS_TARGET_11
 
 #ifdef TARGET_AARCH64
 void a64_translate_init(void);
@@ -143,6 +143,17 @@ typedef struct DisasContext {
     sigjmp_buf jmpbuf;
     TCGOp *prev_insn_start;
     TCGOp *prev_insn_end;
+
+    /* Taken side of the conditional branches a superblock went past */
+    int nb_side_exits;
+    struct {
+        TCGLabel *label;
+        target_ulong pc;
+        target_ulong pc_save;
+        target_long diff;
+        MemOp ot;
+        CCOp cc_op;
+    } side_exit[8];
 } DisasContext;
 
 /*
@@ -175,6 +186,12 @@ typedef struct DisasContext {
  */
 #define DISAS_EOB_RECHECK_TF   DISAS_TARGET_4
 
+/*
+ * As DISAS_JUMP, for a near return; predict the target with the
+ * return address pushed by gen_push_return().
+ */
+#define DISAS_RETURN           DISAS_TARGET_5
+
 /* The environment in which user-only runs is constrained. */
 #ifdef CONFIG_USER_ONLY
 #define PE(S)     true
@@ -1799,9 +1816,36 @@ static target_long insn_get_signed(CPUX86State *env, DisasContext *s, MemOp ot)
     return ret;
 }
 
+/*
+ * In a superblock, continue with the next insn after a forward
+ * conditional branch, and emit the jump to its target at the end
+ * of the TB.
+ */
+static bool gen_side_exit(DisasContext *s, target_long diff, TCGLabel *taken)
+{
+    int i = s->nb_side_exits;
+
+    if (diff <= 0 || !s->jmp_opt || i == ARRAY_SIZE(s->side_exit) ||
+        !translator_follow_branch(&s->base, s->pc)) {
+        return false;
+    }
+    assert(!s->cc_op_dirty);
+    s->side_exit[i].label = taken;
+    s->side_exit[i].pc = s->pc;
+    s->side_exit[i].pc_save = s->pc_save;
+    s->side_exit[i].diff = diff;
+    s->side_exit[i].ot = s->dflag;
+    s->side_exit[i].cc_op = s->cc_op;
+    s->nb_side_exits++;
+    return true;
+}
+
 static void gen_conditional_jump_labels(DisasContext *s, target_long diff,
                                         TCGLabel *not_taken, TCGLabel *taken)
 {
+    if (!not_taken && gen_side_exit(s, diff, taken)) {
+        return;
+    }
     if (not_taken) {
         gen_set_label(not_taken);
     }
@@ -2107,6 +2151,25 @@ static void gen_reset_eflags(DisasContext *s, target_ulong mask)
     tcg_gen_st_tl(t, tcg_env, offsetof(CPUX86State, eflags));
 }
 
+/* The pc of @eip in the current code segment, as cpu_get_tb_cpu_state(). */
+static TCGv_i64 gen_tb_pc(DisasContext *s, TCGv eip)
+{
+    TCGv_i64 pc = tcg_temp_new_i64();
+
+    tcg_gen_extu_tl_i64(pc, eip);
+    if (!CODE64(s)) {
+        tcg_gen_addi_i64(pc, pc, s->cs_base);
+        tcg_gen_ext32u_i64(pc, pc);
+    }
+    return pc;
+}
+
+/* Record the return address of a near call, for DISAS_RETURN. */
+static void gen_push_return(DisasContext *s)
+{
+    tcg_gen_push_return_i64(gen_tb_pc(s, eip_next_tl(s)));
+}
+
 /* Clear BND registers during legacy branches.  */
 static void gen_bnd_jmp(DisasContext *s)
 {
@@ -2153,6 +2216,8 @@ gen_eob(DisasContext *s, int mode)
                /* give irqs a chance to happen */
                !inhibit_reset) {
         tcg_gen_lookup_and_goto_ptr();
+    } else if (mode == DISAS_RETURN && !inhibit_reset) {
+        tcg_gen_lookup_return_and_goto_ptr(gen_tb_pc(s, cpu_eip));
     } else {
         tcg_gen_exit_tb(NULL, 0);
     }
@@ -2163,7 +2228,7 @@ gen_eob(DisasContext *s, int mode)
 /* Jump to eip+diff, truncating the result to OT. */
 static void gen_jmp_rel(DisasContext *s, MemOp ot, int diff, int tb_num)
 {
-    bool use_goto_tb = s->jmp_opt;
+    bool use_goto_tb = s->jmp_opt && tb_num >= 0;
     target_ulong mask = -1;
     target_ulong new_pc = s->pc + diff;
     target_ulong new_eip = new_pc - s->cs_base;
@@ -2183,6 +2248,20 @@ static void gen_jmp_rel(DisasContext *s, MemOp ot, int diff, int tb_num)
     }
     new_eip &= mask;
 
+    if (!(tb_cflags(s->base.tb) & CF_PCREL) && !CODE64(s)) {
+        new_pc = (uint32_t)(new_eip + s->cs_base);
+    }
+
+    if (use_goto_tb && translator_follow_branch(&s->base, new_pc)) {
+        /*
+         * Superblock: translate the target as part of this TB.  With
+         * CF_PCREL, cpu_eip stays relative to pc_save, which is still
+         * valid since the target is on the same page.
+         */
+        s->pc = new_pc;
+        return;
+    }
+
     if (tb_cflags(s->base.tb) & CF_PCREL) {
         tcg_gen_addi_tl(cpu_eip, cpu_eip, new_pc - s->pc_save);
         /*
@@ -2194,8 +2273,6 @@ static void gen_jmp_rel(DisasContext *s, MemOp ot, int diff, int tb_num)
             tcg_gen_andi_tl(cpu_eip, cpu_eip, mask);
             use_goto_tb = false;
         }
-    } else if (!CODE64(s)) {
-        new_pc = (uint32_t)(new_eip + s->cs_base);
     }
 
     if (use_goto_tb && translator_use_goto_tb(&s->base, new_pc)) {
@@ -3642,6 +3719,7 @@ static void i386_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cpu)
      * would even allow accounting up to 64k iterations at once for icount.
      */
     dc->repz_opt = !dc->jmp_opt && !(cflags & CF_USE_ICOUNT);
+    dc->nb_side_exits = 0;
 
     dc->T0 = tcg_temp_new();
     dc->T1 = tcg_temp_new();
@@ -3763,11 +3841,22 @@ static void i386_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     case DISAS_EOB_ONLY:
     case DISAS_EOB_RECHECK_TF:
     case DISAS_JUMP:
+    case DISAS_RETURN:
         gen_eob(dc, dc->base.is_jmp);
         break;
     default:
         g_assert_not_reached();
     }
+
+    /* The goto_tb slots may be taken, so side exits look up their TB. */
+    for (int i = 0; i < dc->nb_side_exits; i++) {
+        dc->pc = dc->side_exit[i].pc;
+        dc->pc_save = dc->side_exit[i].pc_save;
+        dc->cc_op = dc->side_exit[i].cc_op;
+        dc->cc_op_dirty = false;
+        gen_set_label(dc->side_exit[i].label);
+        gen_jmp_rel(dc, dc->side_exit[i].ot, dc->side_exit[i].diff, -1);
+    }
 }
 
 static const TranslatorOps i386_tr_ops = {
@@ -278,6 +278,49 @@ static void lookup_and_goto_ptr(DisasContext *ctx)
     tcg_gen_lookup_and_goto_ptr();
 }
 
+/* The pc of @dest, as computed by cpu_get_tb_cpu_state(). */
+static TCGv_i64 gen_tb_pc(DisasContext *ctx, TCGv dest)
+{
+    TCGv_i64 pc = tcg_temp_new_i64();
+
+    tcg_gen_extu_tl_i64(pc, dest);
+    if (get_xl(ctx) == MXL_RV32) {
+        tcg_gen_ext32u_i64(pc, pc);
+    }
+    return pc;
+}
+
+static void lookup_return_and_goto_ptr(DisasContext *ctx)
+{
+#ifndef CONFIG_USER_ONLY
+    /* A trigger match may change the TB flags; do not predict. */
+    if (ctx->itrigger) {
+        lookup_and_goto_ptr(ctx);
+        return;
+    }
+#endif
+    tcg_gen_lookup_return_and_goto_ptr(gen_tb_pc(ctx, cpu_pc));
+}
+
+/*
+ * Calls and returns are told apart by the use of x1 or x5 as link
+ * register, see the return-address stack hints for JALR in the
+ * unprivileged spec.
+ */
+static bool is_link_reg(int reg)
+{
+    return reg == xRA || reg == xT0;
+}
+
+/*
+ * Record the return address of a call.  Only once the call can no
+ * longer raise an exception, since nothing would pop it then.
+ */
+static void gen_push_return(DisasContext *ctx, TCGv succ_pc)
+{
+    tcg_gen_push_return_i64(gen_tb_pc(ctx, succ_pc));
+}
+
 static void exit_tb(DisasContext *ctx)
 {
 #ifndef CONFIG_USER_ONLY
@@ -579,6 +622,9 @@ static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
 
     gen_pc_plus_diff(succ_pc, ctx, ctx->cur_insn_len);
     gen_set_gpr(ctx, rd, succ_pc);
+    if (is_link_reg(rd)) {
+        gen_push_return(ctx, succ_pc);
+    }
 
     gen_goto_tb(ctx, 0, imm); /* must use this for safety */
     ctx->base.is_jmp = DISAS_NORETURN;
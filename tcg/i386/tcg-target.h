@@ -250,4 +250,9 @@ typedef enum {
 #define TCG_TARGET_NEED_LDST_LABELS
 #define TCG_TARGET_NEED_POOL_LABELS
 
+/* The backend can emit relocatable code for the persistent TB cache */
+#if TCG_TARGET_REG_BITS == 64
+#define TCG_TARGET_TB_CACHE
+#endif
+
 #endif
@@ -52,11 +52,25 @@ struct tcg_region_tree {
     /* padding to avoid false sharing is computed at run-time */
 };
 
+/*
+ * Allocation state of a single region.  A region is free when it has
+ * never been handed out (index >= region.current) or when it has been
+ * evicted (gen == 0 and !in_use).
+ */
+struct tcg_region_info {
+    uint64_t gen;   /* allocation order, 0 once evicted */
+    size_t used;    /* bytes of code, once full */
+    bool in_use;    /* assigned to a TCGContext */
+};
+
 /*
  * We divide code_gen_buffer into equally-sized "regions" that TCG threads
  * dynamically allocate from as demand dictates. Given appropriate region
  * sizing, this minimizes flushes even when some TCG threads generate a lot
  * more code than others.
+ *
+ * Once every region has been handed out, full regions are recycled oldest
+ * first; see tcg_region_evict().
  */
 struct tcg_region_state {
     QemuMutex lock;
@@ -72,6 +86,9 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    size_t n_free; /* number of evicted regions not yet reused */
+    uint64_t gen; /* last allocation generation */
+    struct tcg_region_info *info;
 };
 
 static struct tcg_region_state region;
@@ -191,10 +208,23 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/* @p must point into the rw view of code_gen_buffer */
+static size_t tcg_region_index(const void *p)
 {
-    size_t region_idx;
+    ptrdiff_t offset;
 
+    if (p < region.start_aligned) {
+        return 0;
+    }
+    offset = p - region.start_aligned;
+    if (offset > region.stride * (region.n - 1)) {
+        return region.n - 1;
+    }
+    return offset / region.stride;
+}
+
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -206,18 +236,7 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
         }
     }
 
-    if (p < region.start_aligned) {
-        region_idx = 0;
-    } else {
-        ptrdiff_t offset = p - region.start_aligned;
-
-        if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
-        }
-    }
-    return region_trees + region_idx * tree_size;
+    return region_trees + tcg_region_index(p) * tree_size;
 }
 
 void tcg_tb_insert(TranslationBlock *tb)
@@ -311,6 +330,13 @@ size_t tcg_nb_tbs(void)
     return nb_tbs;
 }
 
+static void tcg_region_tree_reset(struct tcg_region_tree *rt)
+{
+    /* Increment the refcount first so that destroy acts as a reset */
+    q_tree_ref(rt->tree);
+    q_tree_destroy(rt->tree);
+}
+
 static void tcg_region_tree_reset_all(void)
 {
     size_t i;
@@ -319,9 +345,7 @@ static void tcg_region_tree_reset_all(void)
     for (i = 0; i < region.n; i++) {
         struct tcg_region_tree *rt = region_trees + i * tree_size;
 
-        /* Increment the refcount first so that destroy acts as a reset */
-        q_tree_ref(rt->tree);
-        q_tree_destroy(rt->tree);
+        tcg_region_tree_reset(rt);
     }
     tcg_region_tree_unlock_all();
 }
@@ -359,11 +383,25 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
+    size_t i;
+
+    if (region.current < region.n) {
+        i = region.current++;
+    } else if (region.n_free) {
+        for (i = 0; i < region.n; i++) {
+            if (!region.info[i].gen && !region.info[i].in_use) {
+                break;
+            }
+        }
+        g_assert(i < region.n);
+        region.n_free--;
+    } else {
         return true;
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
+    tcg_region_assign(s, i);
+    region.info[i].gen = ++region.gen;
+    region.info[i].used = 0;
+    region.info[i].in_use = true;
     return false;
 }
 
@@ -374,18 +412,78 @@ static bool tcg_region_alloc__locked(TCGContext *s)
 bool tcg_region_alloc(TCGContext *s)
 {
     bool err;
-    /* read the region size now; alloc__locked will overwrite it on success */
+    /* read the region now; alloc__locked will overwrite it on success */
     size_t size_full = s->code_gen_buffer_size;
+    size_t full = tcg_region_index(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
         region.agg_size_full += size_full - TCG_HIGHWATER;
+        region.info[full].used = size_full - TCG_HIGHWATER;
+        region.info[full].in_use = false;
     }
     qemu_mutex_unlock(&region.lock);
     return err;
 }
 
+/*
+ * Return true if a region can be allocated without evicting or flushing
+ * translations first.
+ */
+bool tcg_region_available(void)
+{
+    bool ret;
+
+    qemu_mutex_lock(&region.lock);
+    ret = region.current < region.n || region.n_free;
+    qemu_mutex_unlock(&region.lock);
+    return ret;
+}
+
+/*
+ * Evict the least recently allocated region that no context is currently
+ * generating code into, so that it can be reused.  @func is called on
+ * every TB of the region first, and must unlink it from all the other
+ * data structures that reference it.
+ *
+ * Returns false if there is no such region, in which case the caller
+ * has to fall back to a full flush.  Call from a safe-work context.
+ */
+bool tcg_region_evict(GTraverseFunc func, gpointer user_data)
+{
+    struct tcg_region_tree *rt;
+    struct tcg_region_info *ri;
+    size_t i, victim = region.n;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < region.current; i++) {
+        ri = &region.info[i];
+        if (ri->gen && !ri->in_use &&
+            (victim == region.n || ri->gen < region.info[victim].gen)) {
+            victim = i;
+        }
+    }
+    if (victim == region.n) {
+        qemu_mutex_unlock(&region.lock);
+        return false;
+    }
+
+    rt = region_trees + victim * tree_size;
+    qemu_mutex_lock(&rt->lock);
+    q_tree_foreach(rt->tree, func, user_data);
+    tcg_region_tree_reset(rt);
+    qemu_mutex_unlock(&rt->lock);
+
+    ri = &region.info[victim];
+    region.agg_size_full -= ri->used;
+    ri->gen = 0;
+    ri->used = 0;
+    region.n_free++;
+    qemu_mutex_unlock(&region.lock);
+    return true;
+}
+
 /*
  * Perform a context's first region allocation.
  * This function does _not_ increment region.agg_size_full.
@@ -412,6 +510,8 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.n_free = 0;
+    memset(region.info, 0, region.n * sizeof(*region.info));
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -422,10 +522,19 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+/*
+ * Even with a single TCG context, split the buffer into a few regions of
+ * at least this size, so that filling it up evicts the oldest region
+ * rather than flushing every translation.
+ */
+#define MIN_EVICT_REGION_SIZE   (2 * MiB)
+#define MAX_EVICT_REGIONS       8
+
 static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
 {
+    size_t n_evict = MIN(tb_size / MIN_EVICT_REGION_SIZE, MAX_EVICT_REGIONS);
 #ifdef CONFIG_USER_ONLY
-    return 1;
+    return MAX(n_evict, 1);
 #else
     size_t n_regions;
 
@@ -435,9 +544,9 @@ static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
      * being of reasonable size. If that's not possible we make do by evenly
      * dividing the code_gen_buffer among the vCPUs.
      */
-    /* Use a single region if all we have is one vCPU thread */
+    /* A single vCPU thread only needs regions for eviction */
     if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
-        return 1;
+        return MAX(n_evict, 1);
     }
 
     /*
@@ -737,17 +846,20 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
  * must have been parsed before calling this function, since it calls
  * qemu_tcg_mttcg_enabled().
  *
- * In user-mode we use a single region.  Having multiple regions in user-mode
- * is not supported, because the number of vCPU threads (recall that each thread
- * spawned by the guest corresponds to a vCPU thread) is only bounded by the
- * OS, and usually this number is huge (tens of thousands is not uncommon).
- * Thus, given this large bound on the number of vCPU threads and the fact
- * that code_gen_buffer is allocated at compile-time, we cannot guarantee
- * that the availability of at least one region per vCPU thread.
+ * In user-mode all vCPU threads share a single TCG context.  Having a region
+ * per vCPU thread is not supported, because the number of vCPU threads (recall
+ * that each thread spawned by the guest corresponds to a vCPU thread) is only
+ * bounded by the OS, and usually this number is huge (tens of thousands is not
+ * uncommon).  Thus, given this large bound on the number of vCPU threads and
+ * the fact that code_gen_buffer is allocated at compile-time, we cannot
+ * guarantee that the availability of at least one region per vCPU thread.
  *
  * However, this user-mode limitation is unlikely to be a significant problem
  * in practice. Multi-threaded guests share most if not all of their translated
  * code, which makes parallel code generation less appealing than in system-mode
+ *
+ * The single context still moves through a handful of regions, so that a full
+ * buffer can be recycled one region at a time.
  */
 void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
 {
@@ -850,6 +962,7 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
         }
     }
 
+    region.info = g_new0(struct tcg_region_info, region.n);
     tcg_region_trees_init();
 
     /*
@@ -3353,3 +3353,114 @@ void tcg_gen_lookup_and_goto_ptr(void)
     tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
     tcg_temp_free_ptr(ptr);
 }
+
+/* Offset from tcg_env of a field of the shadow return stack. */
+#define RAS_OFS(F) \
+    (offsetof(CPUNegativeOffsetState, ras.F) - sizeof(CPUNegativeOffsetState))
+#define RAS_SLOT_SIZE  sizeof(((CPUReturnStack *)NULL)->slot[0])
+
+/* Return tcg_env plus the offset of slot @top from slot 0. */
+static TCGv_ptr gen_ras_slot(TCGv_i32 top)
+{
+    TCGv_i32 ofs = tcg_temp_ebb_new_i32();
+    TCGv_ptr slot = tcg_temp_ebb_new_ptr();
+
+    tcg_gen_muli_i32(ofs, top, RAS_SLOT_SIZE);
+    tcg_gen_ext_i32_ptr(slot, ofs);
+    tcg_gen_add_ptr(slot, slot, tcg_env);
+    tcg_temp_free_i32(ofs);
+    return slot;
+}
+
+void tcg_gen_push_return_i64(TCGv_i64 addr)
+{
+    TCGv_i32 top;
+    TCGv_ptr slot;
+    TCGv_i64 pc, key;
+
+    /* Without goto_ptr, nothing would ever pop it. */
+    if (tcg_ctx->gen_tb->cflags & CF_NO_GOTO_PTR) {
+        return;
+    }
+
+    top = tcg_temp_ebb_new_i32();
+    tcg_gen_ld_i32(top, tcg_env, RAS_OFS(top));
+    tcg_gen_addi_i32(top, top, 1);
+    tcg_gen_andi_i32(top, top, TB_RAS_SIZE - 1);
+    tcg_gen_st_i32(top, tcg_env, RAS_OFS(top));
+    slot = gen_ras_slot(top);
+    tcg_temp_free_i32(top);
+
+    /*
+     * Keep the TB remembered by the slot if it was for @addr already,
+     * otherwise clear 'flags' and 'valid' together.
+     */
+    pc = tcg_temp_ebb_new_i64();
+    key = tcg_temp_ebb_new_i64();
+    tcg_gen_ld_i64(pc, slot, RAS_OFS(slot[0].pc));
+    tcg_gen_ld_i64(key, slot, RAS_OFS(slot[0].flags));
+    tcg_gen_movcond_i64(TCG_COND_EQ, key, pc, addr,
+                        key, tcg_constant_i64(0));
+    tcg_gen_st_i64(key, slot, RAS_OFS(slot[0].flags));
+    tcg_gen_st_i64(addr, slot, RAS_OFS(slot[0].pc));
+    tcg_temp_free_i64(key);
+    tcg_temp_free_i64(pc);
+    tcg_temp_free_ptr(slot);
+}
+
+void tcg_gen_lookup_return_and_goto_ptr(TCGv_i64 dest)
+{
+    TranslationBlock *tb = tcg_ctx->gen_tb;
+    TCGLabel *miss;
+    TCGv_i32 top;
+    TCGv_ptr slot, ptr;
+    TCGv_i64 t;
+    uint64_t key;
+
+    if (tb->cflags & CF_NO_GOTO_PTR) {
+        tcg_gen_exit_tb(NULL, 0);
+        return;
+    }
+
+    plugin_gen_disable_mem_helpers();
+
+    top = tcg_temp_ebb_new_i32();
+    tcg_gen_ld_i32(top, tcg_env, RAS_OFS(top));
+    slot = gen_ras_slot(top);
+    tcg_gen_subi_i32(top, top, 1);
+    tcg_gen_andi_i32(top, top, TB_RAS_SIZE - 1);
+    tcg_gen_st_i32(top, tcg_env, RAS_OFS(top));
+    tcg_temp_free_i32(top);
+
+    /*
+     * On a correct prediction, jump straight to the TB remembered by
+     * the slot, if it was looked up on return from a TB like this one.
+     */
+    QEMU_BUILD_BUG_ON(RAS_OFS(slot[0].valid) !=
+                      RAS_OFS(slot[0].flags) + sizeof(uint32_t));
+    key = HOST_BIG_ENDIAN ? ((uint64_t)tb->flags << 32) | 1
+                          : (1ull << 32) | tb->flags;
+
+    miss = gen_new_label();
+    t = tcg_temp_ebb_new_i64();
+    tcg_gen_ld_i64(t, slot, RAS_OFS(slot[0].pc));
+    tcg_gen_brcond_i64(TCG_COND_NE, t, dest, miss);
+    tcg_gen_ld_i64(t, slot, RAS_OFS(slot[0].flags));
+    tcg_gen_brcondi_i64(TCG_COND_NE, t, key, miss);
+    tcg_gen_ld_i64(t, slot, RAS_OFS(slot[0].cs_base));
+    tcg_gen_brcondi_i64(TCG_COND_NE, t, tb->cs_base, miss);
+    tcg_temp_free_i64(t);
+
+    ptr = tcg_temp_ebb_new_ptr();
+    tcg_gen_ld_ptr(ptr, slot, RAS_OFS(slot[0].code));
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
+    tcg_temp_free_ptr(ptr);
+    tcg_temp_free_ptr(slot);
+
+    gen_set_label(miss);
+    ptr = tcg_temp_ebb_new_ptr();
+    gen_helper_lookup_tb_ptr_ret(ptr, tcg_env, tcg_constant_i32(tb->flags),
+                                 tcg_constant_i64(tb->cs_base));
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
+    tcg_temp_free_ptr(ptr);
+}
@@ -1307,6 +1307,7 @@ static void tcg_context_init(unsigned max_cpus)
 
     memset(s, 0, sizeof(*s));
     s->nb_globals = 0;
+    s->nb_tb_relocs = -1;
 
     /* Count total number of arguments and allocate the corresponding
        space */
@@ -1501,6 +1502,7 @@ void tcg_func_start(TCGContext *s)
     s->nb_ops = 0;
     s->nb_labels = 0;
     s->current_frame_offset = s->frame_start;
+    s->nb_tb_relocs = s->tb_cache ? 0 : -1;
 
 #ifdef CONFIG_DEBUG_TCG
     s->goto_tb_issue_mask = 0;
@@ -1895,6 +1897,14 @@ TCGv_i64 tcg_constant_i64(int64_t val)
 
 TCGv_ptr tcg_constant_ptr_int(intptr_t val)
 {
+    /*
+     * Anything but a small offset is most likely a host pointer, which
+     * would not be valid in another process.  Host addresses built as
+     * integer constants are caught by tcg_tb_cache_check_imm().
+     */
+    if (val != (int16_t)val) {
+        tcg_tb_cache_reject(tcg_ctx);
+    }
     return temp_tcgv_ptr(tcg_constant_internal(TCG_TYPE_PTR, val));
 }
 
@@ -6087,6 +6097,28 @@ static void tcg_out_st_helper_args(TCGContext *s, const TCGLabelQemuLdst *ldst,
     tcg_out_helper_load_common_args(s, ldst, parm, info, next_arg);
 }
 
+/*
+ * Record a relocation at @rw, in the code of the TB being generated,
+ * for the persistent TB cache.
+ */
+void tcg_tb_reloc(TCGContext *s, TCGTBRelocKind kind, void *rw,
+                  uintptr_t target)
+{
+    TCGTBReloc *r;
+
+    if (s->nb_tb_relocs < 0) {
+        return;
+    }
+    if (s->nb_tb_relocs == TCG_MAX_TB_RELOCS) {
+        tcg_tb_cache_reject(s);
+        return;
+    }
+    r = &s->tb_relocs[s->nb_tb_relocs++];
+    r->offset = tcg_ptr_byte_diff(rw, s->code_buf);
+    r->kind = kind;
+    r->target = target;
+}
+
 int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
 {
     int i, start_words, num_insns;
@@ -59,6 +59,7 @@ static uint64_t tci_uint64(uint32_t high, uint32_t low)
  *   i = immediate (uint32_t)
  *   I = immediate (tcg_target_ulong)
  *   l = label or pointer
+ *   L = label, as a 32-bit displacement in the following word
  *   m = immediate (MemOpIdx)
  *   n = immediate (call return length)
  *   r = register
@@ -142,6 +143,17 @@ static void tci_args_rrrc(uint32_t insn,
     *c3 = extract32(insn, 20, 4);
 }
 
+static void tci_args_rrcL(uint32_t insn, const uint32_t **tb_ptr,
+                          TCGReg *r0, TCGReg *r1, TCGCond *c2, void **l3)
+{
+    int32_t diff = *(*tb_ptr)++;
+
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *c2 = extract32(insn, 16, 4);
+    *l3 = (void *)*tb_ptr + diff;
+}
+
 static void tci_args_rrrbb(uint32_t insn, TCGReg *r0, TCGReg *r1,
                            TCGReg *r2, uint8_t *i3, uint8_t *i4)
 {
@@ -339,18 +351,37 @@ static void tci_qemu_st(CPUArchState *env, uint64_t taddr, uint64_t val,
     }
 }
 
+/*
+ * The interpreter uses threaded dispatch: every opcode handler is a label,
+ * and each handler ends by decoding the next instruction and jumping
+ * straight to its handler through a table of label addresses.  Compared
+ * to a single switch this gives the host branch predictor one indirect
+ * branch per handler to learn from, instead of one for the whole loop.
+ *
+ * OP() defines a handler label, DISPATCH() the matching table entry.
+ * A handler without a table entry or vice versa fails to compile.
+ */
+#define OP(x)           glue(op_, x):
+#define DISPATCH(x)     [glue(INDEX_op_, x)] = &&glue(op_, x),
+
 #if TCG_TARGET_REG_BITS == 64
-# define CASE_32_64(x) \
-        case glue(glue(INDEX_op_, x), _i64): \
-        case glue(glue(INDEX_op_, x), _i32):
-# define CASE_64(x) \
-        case glue(glue(INDEX_op_, x), _i64):
+# define OP_32_64(x)        OP(glue(x, _i64)) OP(glue(x, _i32))
+# define OP_64(x)           OP(glue(x, _i64))
+# define DISPATCH_32_64(x)  DISPATCH(glue(x, _i64)) DISPATCH(glue(x, _i32))
+# define DISPATCH_64(x)     DISPATCH(glue(x, _i64))
 #else
-# define CASE_32_64(x) \
-        case glue(glue(INDEX_op_, x), _i32):
-# define CASE_64(x)
+# define OP_32_64(x)        OP(glue(x, _i32))
+# define OP_64(x)
+# define DISPATCH_32_64(x)  DISPATCH(glue(x, _i32))
+# define DISPATCH_64(x)
 #endif
 
+#define NEXT()                                  \
+    do {                                        \
+        insn = *tb_ptr++;                       \
+        goto *dispatch[extract32(insn, 0, 8)];  \
+    } while (0)
+
 /* Interpret pseudo code in tb. */
 /*
  * Disable CFI checks.
@@ -365,660 +396,840 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
     uint64_t stack[(TCG_STATIC_CALL_ARGS_SIZE + TCG_STATIC_FRAME_SIZE)
                    / sizeof(uint64_t)];
 
+    static const void * const dispatch[NB_OPS] = {
+        [0 ... NB_OPS - 1] = &&op_invalid,
+        DISPATCH(call)
+        DISPATCH(br)
+        DISPATCH(setcond_i32)
+        DISPATCH(movcond_i32)
+#if TCG_TARGET_REG_BITS == 32
+        DISPATCH(setcond2_i32)
+#elif TCG_TARGET_REG_BITS == 64
+        DISPATCH(setcond_i64)
+        DISPATCH(movcond_i64)
+#endif
+        DISPATCH_32_64(mov)
+        DISPATCH(tci_movi)
+        DISPATCH(tci_movl)
+        DISPATCH_32_64(ld8u)
+        DISPATCH_32_64(ld8s)
+        DISPATCH_32_64(ld16u)
+        DISPATCH_32_64(ld16s)
+        DISPATCH(ld_i32)
+        DISPATCH_64(ld32u)
+        DISPATCH_32_64(st8)
+        DISPATCH_32_64(st16)
+        DISPATCH(st_i32)
+        DISPATCH_64(st32)
+        DISPATCH_32_64(add)
+        DISPATCH_32_64(sub)
+        DISPATCH_32_64(mul)
+        DISPATCH_32_64(and)
+        DISPATCH_32_64(or)
+        DISPATCH_32_64(xor)
+#if TCG_TARGET_HAS_andc_i32 || TCG_TARGET_HAS_andc_i64
+        DISPATCH_32_64(andc)
+#endif
+#if TCG_TARGET_HAS_orc_i32 || TCG_TARGET_HAS_orc_i64
+        DISPATCH_32_64(orc)
+#endif
+#if TCG_TARGET_HAS_eqv_i32 || TCG_TARGET_HAS_eqv_i64
+        DISPATCH_32_64(eqv)
+#endif
+#if TCG_TARGET_HAS_nand_i32 || TCG_TARGET_HAS_nand_i64
+        DISPATCH_32_64(nand)
+#endif
+#if TCG_TARGET_HAS_nor_i32 || TCG_TARGET_HAS_nor_i64
+        DISPATCH_32_64(nor)
+#endif
+        DISPATCH(div_i32)
+        DISPATCH(divu_i32)
+        DISPATCH(rem_i32)
+        DISPATCH(remu_i32)
+#if TCG_TARGET_HAS_clz_i32
+        DISPATCH(clz_i32)
+#endif
+#if TCG_TARGET_HAS_ctz_i32
+        DISPATCH(ctz_i32)
+#endif
+#if TCG_TARGET_HAS_ctpop_i32
+        DISPATCH(ctpop_i32)
+#endif
+        DISPATCH(shl_i32)
+        DISPATCH(shr_i32)
+        DISPATCH(sar_i32)
+#if TCG_TARGET_HAS_rot_i32
+        DISPATCH(rotl_i32)
+        DISPATCH(rotr_i32)
+#endif
+#if TCG_TARGET_HAS_deposit_i32
+        DISPATCH(deposit_i32)
+#endif
+#if TCG_TARGET_HAS_extract_i32
+        DISPATCH(extract_i32)
+#endif
+#if TCG_TARGET_HAS_sextract_i32
+        DISPATCH(sextract_i32)
+#endif
+        DISPATCH(brcond_i32)
+        DISPATCH(tci_brcond_i32)
+#if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_add2_i32
+        DISPATCH(add2_i32)
+#endif
+#if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_sub2_i32
+        DISPATCH(sub2_i32)
+#endif
+#if TCG_TARGET_HAS_mulu2_i32
+        DISPATCH(mulu2_i32)
+#endif
+#if TCG_TARGET_HAS_muls2_i32
+        DISPATCH(muls2_i32)
+#endif
+#if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
+        DISPATCH_32_64(ext8s)
+#endif
+#if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64 || \
+    TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
+        DISPATCH_32_64(ext16s)
+#endif
+#if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
+        DISPATCH_32_64(ext8u)
+#endif
+#if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
+        DISPATCH_32_64(ext16u)
+#endif
+#if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
+        DISPATCH_32_64(bswap16)
+#endif
+#if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
+        DISPATCH_32_64(bswap32)
+#endif
+#if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
+        DISPATCH_32_64(not)
+#endif
+        DISPATCH_32_64(neg)
+#if TCG_TARGET_REG_BITS == 64
+        DISPATCH(ld32s_i64)
+        DISPATCH(ld_i64)
+        DISPATCH(st_i64)
+        DISPATCH(div_i64)
+        DISPATCH(divu_i64)
+        DISPATCH(rem_i64)
+        DISPATCH(remu_i64)
+#if TCG_TARGET_HAS_clz_i64
+        DISPATCH(clz_i64)
+#endif
+#if TCG_TARGET_HAS_ctz_i64
+        DISPATCH(ctz_i64)
+#endif
+#if TCG_TARGET_HAS_ctpop_i64
+        DISPATCH(ctpop_i64)
+#endif
+#if TCG_TARGET_HAS_mulu2_i64
+        DISPATCH(mulu2_i64)
+#endif
+#if TCG_TARGET_HAS_muls2_i64
+        DISPATCH(muls2_i64)
+#endif
+#if TCG_TARGET_HAS_add2_i64
+        DISPATCH(add2_i64)
+#endif
+#if TCG_TARGET_HAS_add2_i64
+        DISPATCH(sub2_i64)
+#endif
+        DISPATCH(shl_i64)
+        DISPATCH(shr_i64)
+        DISPATCH(sar_i64)
+#if TCG_TARGET_HAS_rot_i64
+        DISPATCH(rotl_i64)
+        DISPATCH(rotr_i64)
+#endif
+#if TCG_TARGET_HAS_deposit_i64
+        DISPATCH(deposit_i64)
+#endif
+#if TCG_TARGET_HAS_extract_i64
+        DISPATCH(extract_i64)
+#endif
+#if TCG_TARGET_HAS_sextract_i64
+        DISPATCH(sextract_i64)
+#endif
+        DISPATCH(tci_brcond_i64)
+        DISPATCH(ext32s_i64)
+        DISPATCH(ext_i32_i64)
+        DISPATCH(ext32u_i64)
+        DISPATCH(extu_i32_i64)
+#if TCG_TARGET_HAS_bswap64_i64
+        DISPATCH(bswap64_i64)
+#endif
+#endif /* TCG_TARGET_REG_BITS == 64 */
+        DISPATCH(exit_tb)
+        DISPATCH(goto_tb)
+        DISPATCH(goto_ptr)
+        DISPATCH(qemu_ld_a32_i32)
+        DISPATCH(qemu_ld_a64_i32)
+        DISPATCH(qemu_ld_a32_i64)
+        DISPATCH(qemu_ld_a64_i64)
+        DISPATCH(qemu_st_a32_i32)
+        DISPATCH(qemu_st_a64_i32)
+        DISPATCH(qemu_st_a32_i64)
+        DISPATCH(qemu_st_a64_i64)
+        DISPATCH(mb)
+    };
+    uint32_t insn;
+    TCGReg r0, r1, r2, r3, r4, r5;
+    tcg_target_ulong t1;
+    TCGCond condition;
+    uint8_t pos, len;
+    uint32_t tmp32;
+    uint64_t tmp64, taddr;
+    uint64_t T1, T2;
+    MemOpIdx oi;
+    int32_t ofs;
+    void *ptr;
+
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = (uintptr_t)stack;
     tci_assert(tb_ptr);
 
-    for (;;) {
-        uint32_t insn;
-        TCGOpcode opc;
-        TCGReg r0, r1, r2, r3, r4, r5;
-        tcg_target_ulong t1;
-        TCGCond condition;
-        uint8_t pos, len;
-        uint32_t tmp32;
-        uint64_t tmp64, taddr;
-        uint64_t T1, T2;
-        MemOpIdx oi;
-        int32_t ofs;
-        void *ptr;
-
-        insn = *tb_ptr++;
-        opc = extract32(insn, 0, 8);
-
-        switch (opc) {
-        case INDEX_op_call:
-            {
-                void *call_slots[MAX_CALL_IARGS];
-                ffi_cif *cif;
-                void *func;
-                unsigned i, s, n;
-
-                tci_args_nl(insn, tb_ptr, &len, &ptr);
-                func = ((void **)ptr)[0];
-                cif = ((void **)ptr)[1];
-
-                n = cif->nargs;
-                for (i = s = 0; i < n; ++i) {
-                    ffi_type *t = cif->arg_types[i];
-                    call_slots[i] = &stack[s];
-                    s += DIV_ROUND_UP(t->size, 8);
-                }
-
-                /* Helper functions may need to access the "return address" */
-                tci_tb_ptr = (uintptr_t)tb_ptr;
-                ffi_call(cif, func, stack, call_slots);
+    NEXT();
+
+    OP(call)
+        {
+            void *call_slots[MAX_CALL_IARGS];
+            ffi_cif *cif;
+            void *func;
+            unsigned i, s, n;
+
+            tci_args_nl(insn, tb_ptr, &len, &ptr);
+            func = ((void **)ptr)[0];
+            cif = ((void **)ptr)[1];
+
+            n = cif->nargs;
+            for (i = s = 0; i < n; ++i) {
+                ffi_type *t = cif->arg_types[i];
+                call_slots[i] = &stack[s];
+                s += DIV_ROUND_UP(t->size, 8);
             }
 
-            switch (len) {
-            case 0: /* void */
-                break;
-            case 1: /* uint32_t */
-                /*
-                 * The result winds up "left-aligned" in the stack[0] slot.
-                 * Note that libffi has an odd special case in that it will
-                 * always widen an integral result to ffi_arg.
-                 */
-                if (sizeof(ffi_arg) == 8) {
-                    regs[TCG_REG_R0] = (uint32_t)stack[0];
-                } else {
-                    regs[TCG_REG_R0] = *(uint32_t *)stack;
-                }
-                break;
-            case 2: /* uint64_t */
-                /*
-                 * For TCG_TARGET_REG_BITS == 32, the register pair
-                 * must stay in host memory order.
-                 */
-                memcpy(&regs[TCG_REG_R0], stack, 8);
-                break;
-            case 3: /* Int128 */
-                memcpy(&regs[TCG_REG_R0], stack, 16);
-                break;
-            default:
-                g_assert_not_reached();
+            /* Helper functions may need to access the "return address" */
+            tci_tb_ptr = (uintptr_t)tb_ptr;
+            ffi_call(cif, func, stack, call_slots);
+        }
+
+        switch (len) {
+        case 0: /* void */
+            break;
+        case 1: /* uint32_t */
+            /*
+             * The result winds up "left-aligned" in the stack[0] slot.
+             * Note that libffi has an odd special case in that it will
+             * always widen an integral result to ffi_arg.
+             */
+            if (sizeof(ffi_arg) == 8) {
+                regs[TCG_REG_R0] = (uint32_t)stack[0];
+            } else {
+                regs[TCG_REG_R0] = *(uint32_t *)stack;
             }
             break;
-
-        case INDEX_op_br:
-            tci_args_l(insn, tb_ptr, &ptr);
-            tb_ptr = ptr;
-            continue;
-        case INDEX_op_setcond_i32:
-            tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
-            regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
+        case 2: /* uint64_t */
+            /*
+             * For TCG_TARGET_REG_BITS == 32, the register pair
+             * must stay in host memory order.
+             */
+            memcpy(&regs[TCG_REG_R0], stack, 8);
             break;
-        case INDEX_op_movcond_i32:
-            tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
-            tmp32 = tci_compare32(regs[r1], regs[r2], condition);
-            regs[r0] = regs[tmp32 ? r3 : r4];
+        case 3: /* Int128 */
+            memcpy(&regs[TCG_REG_R0], stack, 16);
             break;
+        default:
+            g_assert_not_reached();
+        }
+        NEXT();
+
+    OP(br)
+        tci_args_l(insn, tb_ptr, &ptr);
+        tb_ptr = ptr;
+        NEXT();
+    OP(setcond_i32)
+        tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
+        regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
+        NEXT();
+    OP(movcond_i32)
+        tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
+        tmp32 = tci_compare32(regs[r1], regs[r2], condition);
+        regs[r0] = regs[tmp32 ? r3 : r4];
+        NEXT();
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_setcond2_i32:
-            tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
-            T1 = tci_uint64(regs[r2], regs[r1]);
-            T2 = tci_uint64(regs[r4], regs[r3]);
-            regs[r0] = tci_compare64(T1, T2, condition);
-            break;
+    OP(setcond2_i32)
+        tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
+        T1 = tci_uint64(regs[r2], regs[r1]);
+        T2 = tci_uint64(regs[r4], regs[r3]);
+        regs[r0] = tci_compare64(T1, T2, condition);
+        NEXT();
 #elif TCG_TARGET_REG_BITS == 64
-        case INDEX_op_setcond_i64:
-            tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
-            regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
-            break;
-        case INDEX_op_movcond_i64:
-            tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
-            tmp32 = tci_compare64(regs[r1], regs[r2], condition);
-            regs[r0] = regs[tmp32 ? r3 : r4];
-            break;
+    OP(setcond_i64)
+        tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
+        regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
+        NEXT();
+    OP(movcond_i64)
+        tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
+        tmp32 = tci_compare64(regs[r1], regs[r2], condition);
+        regs[r0] = regs[tmp32 ? r3 : r4];
+        NEXT();
 #endif
-        CASE_32_64(mov)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = regs[r1];
-            break;
-        case INDEX_op_tci_movi:
-            tci_args_ri(insn, &r0, &t1);
-            regs[r0] = t1;
-            break;
-        case INDEX_op_tci_movl:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            regs[r0] = *(tcg_target_ulong *)ptr;
-            break;
-
-            /* Load/store operations (32 bit). */
-
-        CASE_32_64(ld8u)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint8_t *)ptr;
-            break;
-        CASE_32_64(ld8s)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int8_t *)ptr;
-            break;
-        CASE_32_64(ld16u)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint16_t *)ptr;
-            break;
-        CASE_32_64(ld16s)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int16_t *)ptr;
-            break;
-        case INDEX_op_ld_i32:
-        CASE_64(ld32u)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint32_t *)ptr;
-            break;
-        CASE_32_64(st8)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint8_t *)ptr = regs[r0];
-            break;
-        CASE_32_64(st16)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint16_t *)ptr = regs[r0];
-            break;
-        case INDEX_op_st_i32:
-        CASE_64(st32)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint32_t *)ptr = regs[r0];
-            break;
-
-            /* Arithmetic operations (mixed 32/64 bit). */
-
-        CASE_32_64(add)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] + regs[r2];
-            break;
-        CASE_32_64(sub)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] - regs[r2];
-            break;
-        CASE_32_64(mul)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] * regs[r2];
-            break;
-        CASE_32_64(and)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] & regs[r2];
-            break;
-        CASE_32_64(or)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] | regs[r2];
-            break;
-        CASE_32_64(xor)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ^ regs[r2];
-            break;
+    OP_32_64(mov)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = regs[r1];
+        NEXT();
+    OP(tci_movi)
+        tci_args_ri(insn, &r0, &t1);
+        regs[r0] = t1;
+        NEXT();
+    OP(tci_movl)
+        tci_args_rl(insn, tb_ptr, &r0, &ptr);
+        regs[r0] = *(tcg_target_ulong *)ptr;
+        NEXT();
+
+        /* Load/store operations (32 bit). */
+
+    OP_32_64(ld8u)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint8_t *)ptr;
+        NEXT();
+    OP_32_64(ld8s)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(int8_t *)ptr;
+        NEXT();
+    OP_32_64(ld16u)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint16_t *)ptr;
+        NEXT();
+    OP_32_64(ld16s)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(int16_t *)ptr;
+        NEXT();
+    OP(ld_i32)
+    OP_64(ld32u)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint32_t *)ptr;
+        NEXT();
+    OP_32_64(st8)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint8_t *)ptr = regs[r0];
+        NEXT();
+    OP_32_64(st16)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint16_t *)ptr = regs[r0];
+        NEXT();
+    OP(st_i32)
+    OP_64(st32)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint32_t *)ptr = regs[r0];
+        NEXT();
+
+        /* Arithmetic operations (mixed 32/64 bit). */
+
+    OP_32_64(add)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] + regs[r2];
+        NEXT();
+    OP_32_64(sub)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] - regs[r2];
+        NEXT();
+    OP_32_64(mul)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] * regs[r2];
+        NEXT();
+    OP_32_64(and)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] & regs[r2];
+        NEXT();
+    OP_32_64(or)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] | regs[r2];
+        NEXT();
+    OP_32_64(xor)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] ^ regs[r2];
+        NEXT();
 #if TCG_TARGET_HAS_andc_i32 || TCG_TARGET_HAS_andc_i64
-        CASE_32_64(andc)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] & ~regs[r2];
-            break;
+    OP_32_64(andc)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] & ~regs[r2];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_orc_i32 || TCG_TARGET_HAS_orc_i64
-        CASE_32_64(orc)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] | ~regs[r2];
-            break;
+    OP_32_64(orc)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] | ~regs[r2];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_eqv_i32 || TCG_TARGET_HAS_eqv_i64
-        CASE_32_64(eqv)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ~(regs[r1] ^ regs[r2]);
-            break;
+    OP_32_64(eqv)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = ~(regs[r1] ^ regs[r2]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_nand_i32 || TCG_TARGET_HAS_nand_i64
-        CASE_32_64(nand)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ~(regs[r1] & regs[r2]);
-            break;
+    OP_32_64(nand)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = ~(regs[r1] & regs[r2]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_nor_i32 || TCG_TARGET_HAS_nor_i64
-        CASE_32_64(nor)
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ~(regs[r1] | regs[r2]);
-            break;
+    OP_32_64(nor)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = ~(regs[r1] | regs[r2]);
+        NEXT();
 #endif
 
-            /* Arithmetic operations (32 bit). */
+        /* Arithmetic operations (32 bit). */
 
-        case INDEX_op_div_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
-            break;
-        case INDEX_op_divu_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
-            break;
-        case INDEX_op_rem_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
-            break;
-        case INDEX_op_remu_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
-            break;
+    OP(div_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
+        NEXT();
+    OP(divu_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
+        NEXT();
+    OP(rem_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
+        NEXT();
+    OP(remu_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
+        NEXT();
 #if TCG_TARGET_HAS_clz_i32
-        case INDEX_op_clz_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            tmp32 = regs[r1];
-            regs[r0] = tmp32 ? clz32(tmp32) : regs[r2];
-            break;
+    OP(clz_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        tmp32 = regs[r1];
+        regs[r0] = tmp32 ? clz32(tmp32) : regs[r2];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ctz_i32
-        case INDEX_op_ctz_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            tmp32 = regs[r1];
-            regs[r0] = tmp32 ? ctz32(tmp32) : regs[r2];
-            break;
+    OP(ctz_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        tmp32 = regs[r1];
+        regs[r0] = tmp32 ? ctz32(tmp32) : regs[r2];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ctpop_i32
-        case INDEX_op_ctpop_i32:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = ctpop32(regs[r1]);
-            break;
+    OP(ctpop_i32)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = ctpop32(regs[r1]);
+        NEXT();
 #endif
 
-            /* Shift/rotate operations (32 bit). */
+        /* Shift/rotate operations (32 bit). */
 
-        case INDEX_op_shl_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
-            break;
-        case INDEX_op_shr_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
-            break;
-        case INDEX_op_sar_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
-            break;
+    OP(shl_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
+        NEXT();
+    OP(shr_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
+        NEXT();
+    OP(sar_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
+        NEXT();
 #if TCG_TARGET_HAS_rot_i32
-        case INDEX_op_rotl_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = rol32(regs[r1], regs[r2] & 31);
-            break;
-        case INDEX_op_rotr_i32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ror32(regs[r1], regs[r2] & 31);
-            break;
+    OP(rotl_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = rol32(regs[r1], regs[r2] & 31);
+        NEXT();
+    OP(rotr_i32)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = ror32(regs[r1], regs[r2] & 31);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_deposit_i32
-        case INDEX_op_deposit_i32:
-            tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
-            regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
-            break;
+    OP(deposit_i32)
+        tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
+        regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_extract_i32
-        case INDEX_op_extract_i32:
-            tci_args_rrbb(insn, &r0, &r1, &pos, &len);
-            regs[r0] = extract32(regs[r1], pos, len);
-            break;
+    OP(extract_i32)
+        tci_args_rrbb(insn, &r0, &r1, &pos, &len);
+        regs[r0] = extract32(regs[r1], pos, len);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_sextract_i32
-        case INDEX_op_sextract_i32:
-            tci_args_rrbb(insn, &r0, &r1, &pos, &len);
-            regs[r0] = sextract32(regs[r1], pos, len);
-            break;
+    OP(sextract_i32)
+        tci_args_rrbb(insn, &r0, &r1, &pos, &len);
+        regs[r0] = sextract32(regs[r1], pos, len);
+        NEXT();
 #endif
-        case INDEX_op_brcond_i32:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            if ((uint32_t)regs[r0]) {
-                tb_ptr = ptr;
-            }
-            break;
+    OP(brcond_i32)
+        tci_args_rl(insn, tb_ptr, &r0, &ptr);
+        if ((uint32_t)regs[r0]) {
+            tb_ptr = ptr;
+        }
+        NEXT();
+    OP(tci_brcond_i32)
+        tci_args_rrcL(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+        if (tci_compare32(regs[r0], regs[r1], condition)) {
+            tb_ptr = ptr;
+        }
+        NEXT();
 #if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_add2_i32
-        case INDEX_op_add2_i32:
-            tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
-            T1 = tci_uint64(regs[r3], regs[r2]);
-            T2 = tci_uint64(regs[r5], regs[r4]);
-            tci_write_reg64(regs, r1, r0, T1 + T2);
-            break;
+    OP(add2_i32)
+        tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
+        T1 = tci_uint64(regs[r3], regs[r2]);
+        T2 = tci_uint64(regs[r5], regs[r4]);
+        tci_write_reg64(regs, r1, r0, T1 + T2);
+        NEXT();
 #endif
 #if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_sub2_i32
-        case INDEX_op_sub2_i32:
-            tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
-            T1 = tci_uint64(regs[r3], regs[r2]);
-            T2 = tci_uint64(regs[r5], regs[r4]);
-            tci_write_reg64(regs, r1, r0, T1 - T2);
-            break;
+    OP(sub2_i32)
+        tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
+        T1 = tci_uint64(regs[r3], regs[r2]);
+        T2 = tci_uint64(regs[r5], regs[r4]);
+        tci_write_reg64(regs, r1, r0, T1 - T2);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_mulu2_i32
-        case INDEX_op_mulu2_i32:
-            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-            tmp64 = (uint64_t)(uint32_t)regs[r2] * (uint32_t)regs[r3];
-            tci_write_reg64(regs, r1, r0, tmp64);
-            break;
+    OP(mulu2_i32)
+        tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+        tmp64 = (uint64_t)(uint32_t)regs[r2] * (uint32_t)regs[r3];
+        tci_write_reg64(regs, r1, r0, tmp64);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_muls2_i32
-        case INDEX_op_muls2_i32:
-            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-            tmp64 = (int64_t)(int32_t)regs[r2] * (int32_t)regs[r3];
-            tci_write_reg64(regs, r1, r0, tmp64);
-            break;
+    OP(muls2_i32)
+        tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+        tmp64 = (int64_t)(int32_t)regs[r2] * (int32_t)regs[r3];
+        tci_write_reg64(regs, r1, r0, tmp64);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
-        CASE_32_64(ext8s)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (int8_t)regs[r1];
-            break;
+    OP_32_64(ext8s)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = (int8_t)regs[r1];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64 || \
-    TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
-        CASE_32_64(ext16s)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (int16_t)regs[r1];
-            break;
+TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
+    OP_32_64(ext16s)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = (int16_t)regs[r1];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
-        CASE_32_64(ext8u)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (uint8_t)regs[r1];
-            break;
+    OP_32_64(ext8u)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = (uint8_t)regs[r1];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
-        CASE_32_64(ext16u)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (uint16_t)regs[r1];
-            break;
+    OP_32_64(ext16u)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = (uint16_t)regs[r1];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
-        CASE_32_64(bswap16)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = bswap16(regs[r1]);
-            break;
+    OP_32_64(bswap16)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = bswap16(regs[r1]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
-        CASE_32_64(bswap32)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = bswap32(regs[r1]);
-            break;
+    OP_32_64(bswap32)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = bswap32(regs[r1]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
-        CASE_32_64(not)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = ~regs[r1];
-            break;
+    OP_32_64(not)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = ~regs[r1];
+        NEXT();
 #endif
-        CASE_32_64(neg)
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = -regs[r1];
-            break;
+    OP_32_64(neg)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = -regs[r1];
+        NEXT();
 #if TCG_TARGET_REG_BITS == 64
-            /* Load/store operations (64 bit). */
-
-        case INDEX_op_ld32s_i64:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int32_t *)ptr;
-            break;
-        case INDEX_op_ld_i64:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint64_t *)ptr;
-            break;
-        case INDEX_op_st_i64:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint64_t *)ptr = regs[r0];
-            break;
-
-            /* Arithmetic operations (64 bit). */
-
-        case INDEX_op_div_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
-            break;
-        case INDEX_op_divu_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
-            break;
-        case INDEX_op_rem_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
-            break;
-        case INDEX_op_remu_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
-            break;
+        /* Load/store operations (64 bit). */
+
+    OP(ld32s_i64)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(int32_t *)ptr;
+        NEXT();
+    OP(ld_i64)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint64_t *)ptr;
+        NEXT();
+    OP(st_i64)
+        tci_args_rrs(insn, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint64_t *)ptr = regs[r0];
+        NEXT();
+
+        /* Arithmetic operations (64 bit). */
+
+    OP(div_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
+        NEXT();
+    OP(divu_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
+        NEXT();
+    OP(rem_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
+        NEXT();
+    OP(remu_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
+        NEXT();
 #if TCG_TARGET_HAS_clz_i64
-        case INDEX_op_clz_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ? clz64(regs[r1]) : regs[r2];
-            break;
+    OP(clz_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] ? clz64(regs[r1]) : regs[r2];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ctz_i64
-        case INDEX_op_ctz_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ? ctz64(regs[r1]) : regs[r2];
-            break;
+    OP(ctz_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] ? ctz64(regs[r1]) : regs[r2];
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_ctpop_i64
-        case INDEX_op_ctpop_i64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = ctpop64(regs[r1]);
-            break;
+    OP(ctpop_i64)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = ctpop64(regs[r1]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_mulu2_i64
-        case INDEX_op_mulu2_i64:
-            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-            mulu64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
-            break;
+    OP(mulu2_i64)
+        tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+        mulu64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_muls2_i64
-        case INDEX_op_muls2_i64:
-            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-            muls64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
-            break;
+    OP(muls2_i64)
+        tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+        muls64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_add2_i64
-        case INDEX_op_add2_i64:
-            tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
-            T1 = regs[r2] + regs[r4];
-            T2 = regs[r3] + regs[r5] + (T1 < regs[r2]);
-            regs[r0] = T1;
-            regs[r1] = T2;
-            break;
+    OP(add2_i64)
+        tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
+        T1 = regs[r2] + regs[r4];
+        T2 = regs[r3] + regs[r5] + (T1 < regs[r2]);
+        regs[r0] = T1;
+        regs[r1] = T2;
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_add2_i64
-        case INDEX_op_sub2_i64:
-            tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
-            T1 = regs[r2] - regs[r4];
-            T2 = regs[r3] - regs[r5] - (regs[r2] < regs[r4]);
-            regs[r0] = T1;
-            regs[r1] = T2;
-            break;
+    OP(sub2_i64)
+        tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
+        T1 = regs[r2] - regs[r4];
+        T2 = regs[r3] - regs[r5] - (regs[r2] < regs[r4]);
+        regs[r0] = T1;
+        regs[r1] = T2;
+        NEXT();
 #endif
 
-            /* Shift/rotate operations (64 bit). */
+        /* Shift/rotate operations (64 bit). */
 
-        case INDEX_op_shl_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] << (regs[r2] & 63);
-            break;
-        case INDEX_op_shr_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] >> (regs[r2] & 63);
-            break;
-        case INDEX_op_sar_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
-            break;
+    OP(shl_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] << (regs[r2] & 63);
+        NEXT();
+    OP(shr_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = regs[r1] >> (regs[r2] & 63);
+        NEXT();
+    OP(sar_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
+        NEXT();
 #if TCG_TARGET_HAS_rot_i64
-        case INDEX_op_rotl_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = rol64(regs[r1], regs[r2] & 63);
-            break;
-        case INDEX_op_rotr_i64:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ror64(regs[r1], regs[r2] & 63);
-            break;
+    OP(rotl_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = rol64(regs[r1], regs[r2] & 63);
+        NEXT();
+    OP(rotr_i64)
+        tci_args_rrr(insn, &r0, &r1, &r2);
+        regs[r0] = ror64(regs[r1], regs[r2] & 63);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_deposit_i64
-        case INDEX_op_deposit_i64:
-            tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
-            regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
-            break;
+    OP(deposit_i64)
+        tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
+        regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_extract_i64
-        case INDEX_op_extract_i64:
-            tci_args_rrbb(insn, &r0, &r1, &pos, &len);
-            regs[r0] = extract64(regs[r1], pos, len);
-            break;
+    OP(extract_i64)
+        tci_args_rrbb(insn, &r0, &r1, &pos, &len);
+        regs[r0] = extract64(regs[r1], pos, len);
+        NEXT();
 #endif
 #if TCG_TARGET_HAS_sextract_i64
-        case INDEX_op_sextract_i64:
-            tci_args_rrbb(insn, &r0, &r1, &pos, &len);
-            regs[r0] = sextract64(regs[r1], pos, len);
-            break;
+    OP(sextract_i64)
+        tci_args_rrbb(insn, &r0, &r1, &pos, &len);
+        regs[r0] = sextract64(regs[r1], pos, len);
+        NEXT();
 #endif
-        case INDEX_op_brcond_i64:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            if (regs[r0]) {
-                tb_ptr = ptr;
-            }
-            break;
-        case INDEX_op_ext32s_i64:
-        case INDEX_op_ext_i32_i64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (int32_t)regs[r1];
-            break;
-        case INDEX_op_ext32u_i64:
-        case INDEX_op_extu_i32_i64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (uint32_t)regs[r1];
-            break;
+    OP(tci_brcond_i64)
+        tci_args_rrcL(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+        if (tci_compare64(regs[r0], regs[r1], condition)) {
+            tb_ptr = ptr;
+        }
+        NEXT();
+    OP(ext32s_i64)
+    OP(ext_i32_i64)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = (int32_t)regs[r1];
+        NEXT();
+    OP(ext32u_i64)
+    OP(extu_i32_i64)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = (uint32_t)regs[r1];
+        NEXT();
 #if TCG_TARGET_HAS_bswap64_i64
-        case INDEX_op_bswap64_i64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = bswap64(regs[r1]);
-            break;
+    OP(bswap64_i64)
+        tci_args_rr(insn, &r0, &r1);
+        regs[r0] = bswap64(regs[r1]);
+        NEXT();
 #endif
 #endif /* TCG_TARGET_REG_BITS == 64 */
 
-            /* QEMU specific operations. */
+        /* QEMU specific operations. */
 
-        case INDEX_op_exit_tb:
-            tci_args_l(insn, tb_ptr, &ptr);
-            return (uintptr_t)ptr;
+    OP(exit_tb)
+        tci_args_l(insn, tb_ptr, &ptr);
+        return (uintptr_t)ptr;
 
-        case INDEX_op_goto_tb:
-            tci_args_l(insn, tb_ptr, &ptr);
-            tb_ptr = *(void **)ptr;
-            break;
+    OP(goto_tb)
+        tci_args_l(insn, tb_ptr, &ptr);
+        tb_ptr = *(void **)ptr;
+        NEXT();
 
-        case INDEX_op_goto_ptr:
-            tci_args_r(insn, &r0);
-            ptr = (void *)regs[r0];
-            if (!ptr) {
-                return 0;
-            }
-            tb_ptr = ptr;
-            break;
+    OP(goto_ptr)
+        tci_args_r(insn, &r0);
+        ptr = (void *)regs[r0];
+        if (!ptr) {
+            return 0;
+        }
+        tb_ptr = ptr;
+        NEXT();
+
+    OP(qemu_ld_a32_i32)
+        tci_args_rrm(insn, &r0, &r1, &oi);
+        taddr = (uint32_t)regs[r1];
+        goto do_ld_i32;
+    OP(qemu_ld_a64_i32)
+        if (TCG_TARGET_REG_BITS == 64) {
+            tci_args_rrm(insn, &r0, &r1, &oi);
+            taddr = regs[r1];
+        } else {
+            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+            taddr = tci_uint64(regs[r2], regs[r1]);
+            oi = regs[r3];
+        }
+    do_ld_i32:
+        regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
+        NEXT();
 
-        case INDEX_op_qemu_ld_a32_i32:
+    OP(qemu_ld_a32_i64)
+        if (TCG_TARGET_REG_BITS == 64) {
             tci_args_rrm(insn, &r0, &r1, &oi);
             taddr = (uint32_t)regs[r1];
-            goto do_ld_i32;
-        case INDEX_op_qemu_ld_a64_i32:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(insn, &r0, &r1, &oi);
-                taddr = regs[r1];
-            } else {
-                tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-                taddr = tci_uint64(regs[r2], regs[r1]);
-                oi = regs[r3];
-            }
-        do_ld_i32:
-            regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
-            break;
-
-        case INDEX_op_qemu_ld_a32_i64:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(insn, &r0, &r1, &oi);
-                taddr = (uint32_t)regs[r1];
-            } else {
-                tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-                taddr = (uint32_t)regs[r2];
-                oi = regs[r3];
-            }
-            goto do_ld_i64;
-        case INDEX_op_qemu_ld_a64_i64:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(insn, &r0, &r1, &oi);
-                taddr = regs[r1];
-            } else {
-                tci_args_rrrrr(insn, &r0, &r1, &r2, &r3, &r4);
-                taddr = tci_uint64(regs[r3], regs[r2]);
-                oi = regs[r4];
-            }
-        do_ld_i64:
-            tmp64 = tci_qemu_ld(env, taddr, oi, tb_ptr);
-            if (TCG_TARGET_REG_BITS == 32) {
-                tci_write_reg64(regs, r1, r0, tmp64);
-            } else {
-                regs[r0] = tmp64;
-            }
-            break;
+        } else {
+            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+            taddr = (uint32_t)regs[r2];
+            oi = regs[r3];
+        }
+        goto do_ld_i64;
+    OP(qemu_ld_a64_i64)
+        if (TCG_TARGET_REG_BITS == 64) {
+            tci_args_rrm(insn, &r0, &r1, &oi);
+            taddr = regs[r1];
+        } else {
+            tci_args_rrrrr(insn, &r0, &r1, &r2, &r3, &r4);
+            taddr = tci_uint64(regs[r3], regs[r2]);
+            oi = regs[r4];
+        }
+    do_ld_i64:
+        tmp64 = tci_qemu_ld(env, taddr, oi, tb_ptr);
+        if (TCG_TARGET_REG_BITS == 32) {
+            tci_write_reg64(regs, r1, r0, tmp64);
+        } else {
+            regs[r0] = tmp64;
+        }
+        NEXT();
+
+    OP(qemu_st_a32_i32)
+        tci_args_rrm(insn, &r0, &r1, &oi);
+        taddr = (uint32_t)regs[r1];
+        goto do_st_i32;
+    OP(qemu_st_a64_i32)
+        if (TCG_TARGET_REG_BITS == 64) {
+            tci_args_rrm(insn, &r0, &r1, &oi);
+            taddr = regs[r1];
+        } else {
+            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+            taddr = tci_uint64(regs[r2], regs[r1]);
+            oi = regs[r3];
+        }
+    do_st_i32:
+        tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
+        NEXT();
 
-        case INDEX_op_qemu_st_a32_i32:
+    OP(qemu_st_a32_i64)
+        if (TCG_TARGET_REG_BITS == 64) {
             tci_args_rrm(insn, &r0, &r1, &oi);
+            tmp64 = regs[r0];
             taddr = (uint32_t)regs[r1];
-            goto do_st_i32;
-        case INDEX_op_qemu_st_a64_i32:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(insn, &r0, &r1, &oi);
-                taddr = regs[r1];
-            } else {
-                tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-                taddr = tci_uint64(regs[r2], regs[r1]);
-                oi = regs[r3];
-            }
-        do_st_i32:
-            tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
-            break;
+        } else {
+            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+            tmp64 = tci_uint64(regs[r1], regs[r0]);
+            taddr = (uint32_t)regs[r2];
+            oi = regs[r3];
+        }
+        goto do_st_i64;
+    OP(qemu_st_a64_i64)
+        if (TCG_TARGET_REG_BITS == 64) {
+            tci_args_rrm(insn, &r0, &r1, &oi);
+            tmp64 = regs[r0];
+            taddr = regs[r1];
+        } else {
+            tci_args_rrrrr(insn, &r0, &r1, &r2, &r3, &r4);
+            tmp64 = tci_uint64(regs[r1], regs[r0]);
+            taddr = tci_uint64(regs[r3], regs[r2]);
+            oi = regs[r4];
+        }
+    do_st_i64:
+        tci_qemu_st(env, taddr, tmp64, oi, tb_ptr);
+        NEXT();
 
-        case INDEX_op_qemu_st_a32_i64:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(insn, &r0, &r1, &oi);
-                tmp64 = regs[r0];
-                taddr = (uint32_t)regs[r1];
-            } else {
-                tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-                tmp64 = tci_uint64(regs[r1], regs[r0]);
-                taddr = (uint32_t)regs[r2];
-                oi = regs[r3];
-            }
-            goto do_st_i64;
-        case INDEX_op_qemu_st_a64_i64:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(insn, &r0, &r1, &oi);
-                tmp64 = regs[r0];
-                taddr = regs[r1];
-            } else {
-                tci_args_rrrrr(insn, &r0, &r1, &r2, &r3, &r4);
-                tmp64 = tci_uint64(regs[r1], regs[r0]);
-                taddr = tci_uint64(regs[r3], regs[r2]);
-                oi = regs[r4];
-            }
-        do_st_i64:
-            tci_qemu_st(env, taddr, tmp64, oi, tb_ptr);
-            break;
+    OP(mb)
+        /* Ensure ordering for all kinds */
+        smp_mb();
+        NEXT();
 
-        case INDEX_op_mb:
-            /* Ensure ordering for all kinds */
-            smp_mb();
-            break;
-        default:
-            g_assert_not_reached();
-        }
-    }
+    op_invalid:
+        g_assert_not_reached();
 }
 
 /*
@@ -1107,12 +1318,18 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
         break;
 
     case INDEX_op_brcond_i32:
-    case INDEX_op_brcond_i64:
         tci_args_rl(insn, tb_ptr, &r0, &ptr);
         info->fprintf_func(info->stream, "%-12s  %s, 0, ne, %p",
                            op_name, str_r(r0), ptr);
         break;
 
+    case INDEX_op_tci_brcond_i32:
+    case INDEX_op_tci_brcond_i64:
+        tci_args_rrcL(insn, &tb_ptr, &r0, &r1, &c, &ptr);
+        info->fprintf_func(info->stream, "%-12s  %s, %s, %s, %p",
+                           op_name, str_r(r0), str_r(r1), str_c(c), ptr);
+        break;
+
     case INDEX_op_setcond_i32:
     case INDEX_op_setcond_i64:
         tci_args_rrrc(insn, &r0, &r1, &r2, &c);
@@ -1330,5 +1547,5 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
         break;
     }
 
-    return sizeof(insn);
+    return (uintptr_t)tb_ptr - addr;
 }
@@ -0,0 +1,318 @@
+/*
+ * Multifd compression method benchmark
+ *
+ * Compresses synthetic multifd packets the same way the multifd
+ * compression backends do, and reports throughput, CPU seconds spent
+ * per GiB of guest memory and the resulting compression ratio.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include <zlib.h>
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
+#ifdef CONFIG_LZ4
+#include <lz4.h>
+#endif
+
+/* Matches MULTIFD_PACKET_SIZE with 4KiB target pages */
+#define BENCH_PAGE_SIZE (4 * KiB)
+#define BENCH_PAGE_COUNT 128
+#define BENCH_PACKET_SIZE (BENCH_PAGE_SIZE * BENCH_PAGE_COUNT)
+
+typedef struct CompressMethod {
+    const char *name;
+    void *(*setup)(void);
+    /* Compress BENCH_PAGE_COUNT pages, return the number of output bytes */
+    size_t (*compress)(void *opaque, uint8_t *pages, uint8_t *out,
+                       size_t out_len);
+    void (*cleanup)(void *opaque);
+} CompressMethod;
+
+typedef struct PageMix {
+    const char *name;
+    void (*fill)(uint8_t *page, unsigned idx);
+} PageMix;
+
+typedef struct BenchCase {
+    const CompressMethod *method;
+    const PageMix *mix;
+} BenchCase;
+
+/* none: the cost of touching every byte once, as a baseline */
+
+static void *none_setup(void)
+{
+    return NULL;
+}
+
+static size_t none_compress(void *opaque, uint8_t *pages, uint8_t *out,
+                            size_t out_len)
+{
+    memcpy(out, pages, BENCH_PACKET_SIZE);
+    return BENCH_PACKET_SIZE;
+}
+
+static void none_cleanup(void *opaque)
+{
+}
+
+/* zlib: one deflate stream per channel, synced at the end of a packet */
+
+static void *zlib_setup(void)
+{
+    z_stream *zs = g_new0(z_stream, 1);
+
+    g_assert(deflateInit(zs, 1) == Z_OK);
+    return zs;
+}
+
+static size_t zlib_compress(void *opaque, uint8_t *pages, uint8_t *out,
+                            size_t out_len)
+{
+    z_stream *zs = opaque;
+    size_t out_size = 0;
+    unsigned i;
+    int ret;
+
+    for (i = 0; i < BENCH_PAGE_COUNT; i++) {
+        int flush = i == BENCH_PAGE_COUNT - 1 ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+        size_t available = out_len - out_size;
+
+        zs->avail_in = BENCH_PAGE_SIZE;
+        zs->next_in = pages + i * BENCH_PAGE_SIZE;
+        zs->avail_out = available;
+        zs->next_out = out + out_size;
+        do {
+            ret = deflate(zs, flush);
+        } while (ret == Z_OK && zs->avail_in && zs->avail_out);
+        g_assert(ret == Z_OK && !zs->avail_in);
+        out_size += available - zs->avail_out;
+    }
+    return out_size;
+}
+
+static void zlib_cleanup(void *opaque)
+{
+    deflateEnd(opaque);
+    g_free(opaque);
+}
+
+#ifdef CONFIG_ZSTD
+/* zstd: one compression stream per channel, flushed at end of a packet */
+
+static void *zstd_setup(void)
+{
+    ZSTD_CStream *zcs = ZSTD_createCStream();
+
+    g_assert(!ZSTD_isError(ZSTD_initCStream(zcs, 1)));
+    return zcs;
+}
+
+static size_t zstd_compress(void *opaque, uint8_t *pages, uint8_t *out,
+                            size_t out_len)
+{
+    ZSTD_outBuffer zout = { .dst = out, .size = out_len, .pos = 0 };
+    unsigned i;
+    size_t ret;
+
+    for (i = 0; i < BENCH_PAGE_COUNT; i++) {
+        ZSTD_EndDirective flush = i == BENCH_PAGE_COUNT - 1 ?
+                                  ZSTD_e_flush : ZSTD_e_continue;
+        ZSTD_inBuffer zin = {
+            .src = pages + i * BENCH_PAGE_SIZE,
+            .size = BENCH_PAGE_SIZE,
+            .pos = 0,
+        };
+
+        do {
+            ret = ZSTD_compressStream2(opaque, &zout, &zin, flush);
+        } while (ret > 0 && zin.size > zin.pos && zout.size > zout.pos);
+        g_assert(!ZSTD_isError(ret) && zin.size == zin.pos);
+    }
+    return zout.pos;
+}
+
+static void zstd_cleanup(void *opaque)
+{
+    ZSTD_freeCStream(opaque);
+}
+#endif
+
+#ifdef CONFIG_LZ4
+/* lz4: an independent block per page, raw when incompressible */
+
+static void *lz4_setup(void)
+{
+    return g_malloc(LZ4_sizeofState());
+}
+
+static size_t lz4_compress(void *opaque, uint8_t *pages, uint8_t *out,
+                           size_t out_len)
+{
+    size_t out_size = 0;
+    unsigned i;
+
+    for (i = 0; i < BENCH_PAGE_COUNT; i++) {
+        const char *src = (const char *)pages + i * BENCH_PAGE_SIZE;
+        char *dst = (char *)out + out_size + sizeof(uint32_t);
+        int ret;
+
+        ret = LZ4_compress_fast_extState(opaque, src, dst, BENCH_PAGE_SIZE,
+                                         BENCH_PAGE_SIZE - 1, 1);
+        g_assert(ret >= 0);
+        if (ret == 0) {
+            memcpy(dst, src, BENCH_PAGE_SIZE);
+            ret = BENCH_PAGE_SIZE;
+        }
+        out_size += sizeof(uint32_t) + ret;
+    }
+    return out_size;
+}
+
+static void lz4_cleanup(void *opaque)
+{
+    g_free(opaque);
+}
+#endif
+
+static const CompressMethod methods[] = {
+    { "none", none_setup, none_compress, none_cleanup },
+    { "zlib", zlib_setup, zlib_compress, zlib_cleanup },
+#ifdef CONFIG_ZSTD
+    { "zstd", zstd_setup, zstd_compress, zstd_cleanup },
+#endif
+#ifdef CONFIG_LZ4
+    { "lz4", lz4_setup, lz4_compress, lz4_cleanup },
+#endif
+};
+
+/*
+ * Synthetic page contents.  Zero pages never reach the compressors since
+ * multifd detects them first, so none of the mixes contain any.
+ */
+
+static void fill_random(uint8_t *page, unsigned idx)
+{
+    uint32_t *p = (uint32_t *)page;
+    unsigned i;
+
+    for (i = 0; i < BENCH_PAGE_SIZE / sizeof(uint32_t); i++) {
+        p[i] = g_test_rand_int();
+    }
+}
+
+static void fill_text(uint8_t *page, unsigned idx)
+{
+    static const char *const words[] = {
+        "migration ", "multifd ", "channel ", "page ", "dirty ",
+        "bitmap ", "guest ", "memory ", "qemu ", "compress ",
+    };
+    unsigned off = 0;
+
+    while (off < BENCH_PAGE_SIZE) {
+        const char *w = words[g_test_rand_int_range(0, ARRAY_SIZE(words))];
+        size_t len = MIN(strlen(w), BENCH_PAGE_SIZE - off);
+
+        memcpy(page + off, w, len);
+        off += len;
+    }
+}
+
+/* Mostly zero with a few scattered words, like page tables or heaps */
+static void fill_sparse(uint8_t *page, unsigned idx)
+{
+    uint64_t *p = (uint64_t *)page;
+    unsigned i;
+
+    memset(page, 0, BENCH_PAGE_SIZE);
+    for (i = 0; i < 16; i++) {
+        p[g_test_rand_int_range(0, BENCH_PAGE_SIZE / sizeof(uint64_t))] =
+            (uint64_t)g_test_rand_int() << 12;
+    }
+}
+
+static void fill_mixed(uint8_t *page, unsigned idx)
+{
+    switch (idx % 4) {
+    case 0:
+        fill_random(page, idx);
+        break;
+    case 1:
+        fill_sparse(page, idx);
+        break;
+    default:
+        fill_text(page, idx);
+        break;
+    }
+}
+
+static const PageMix mixes[] = {
+    { "random", fill_random },
+    { "text", fill_text },
+    { "sparse", fill_sparse },
+    { "mixed", fill_mixed },
+};
+
+static void test_compress_speed(const void *opaque)
+{
+    const BenchCase *bc = opaque;
+    size_t out_len = BENCH_PACKET_SIZE * 2;
+    uint8_t *pages = g_malloc(BENCH_PACKET_SIZE);
+    uint8_t *out = g_malloc(out_len);
+    void *state = bc->method->setup();
+    double in_total = 0, out_total = 0;
+    double elapsed, cpu;
+    clock_t cpu_start;
+    unsigned i;
+
+    for (i = 0; i < BENCH_PAGE_COUNT; i++) {
+        bc->mix->fill(pages + i * BENCH_PAGE_SIZE, i);
+    }
+
+    cpu_start = clock();
+    g_test_timer_start();
+    do {
+        out_total += bc->method->compress(state, pages, out, out_len);
+        in_total += BENCH_PACKET_SIZE;
+    } while (g_test_timer_elapsed() < 0.5);
+    elapsed = g_test_timer_last();
+    cpu = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+
+    g_test_message("%-4s %-6s: %8.0f MB/sec %7.3f CPU sec/GiB ratio %6.2f",
+                   bc->method->name, bc->mix->name,
+                   in_total / MiB / elapsed, cpu / (in_total / GiB),
+                   in_total / out_total);
+
+    bc->method->cleanup(state);
+    g_free(out);
+    g_free(pages);
+}
+
+int main(int argc, char **argv)
+{
+    BenchCase *cases;
+    unsigned i, j;
+
+    g_test_init(&argc, &argv, NULL);
+
+    cases = g_new(BenchCase, ARRAY_SIZE(methods) * ARRAY_SIZE(mixes));
+    for (i = 0; i < ARRAY_SIZE(methods); i++) {
+        for (j = 0; j < ARRAY_SIZE(mixes); j++) {
+            BenchCase *bc = &cases[i * ARRAY_SIZE(mixes) + j];
+            g_autofree char *name = NULL;
+
+            bc->method = &methods[i];
+            bc->mix = &mixes[j];
+            name = g_strdup_printf("/migration/multifd/compress/%s/%s",
+                                   methods[i].name, mixes[j].name);
+            g_test_add_data_func(name, bc, test_compress_speed);
+        }
+    }
+
+    return g_test_run();
+}
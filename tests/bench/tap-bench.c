@@ -0,0 +1,211 @@
+/*
+ * Tap packets-per-second benchmark
+ *
+ * Compares one read(2)/write(2) per packet, the way net/tap.c works by
+ * default, with the io_uring batches used for the tap "batch-size"
+ * option.  Needs CAP_NET_ADMIN to create a tap device; the test is
+ * skipped otherwise.
+ *
+ * TX writes minimum size frames to the tap fd, which the host stack
+ * receives and drops.  RX fills the tap queue from an AF_PACKET socket
+ * bound to the tap interface and only times draining it.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include <linux/if_ether.h>
+#include <linux/if_tun.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include "qapi/error.h"
+#include "qemu/cutils.h"
+#include "../../net/tap_int.h"
+
+#define BENCH_FRAME_SIZE ETH_ZLEN
+/* Stay below the default tap txqueuelen of 1000 so RX never drops */
+#define BENCH_RX_BURST 512
+#define BENCH_RX_BUF_SIZE 2048
+
+typedef struct TapBench {
+    int fd;
+    int pkt_fd;
+    char ifname[IFNAMSIZ];
+    uint8_t frame[BENCH_FRAME_SIZE];
+} TapBench;
+
+static bool tap_bench_open(TapBench *tb)
+{
+    struct ifreq ifr = {
+        .ifr_flags = IFF_TAP | IFF_NO_PI,
+    };
+    struct sockaddr_ll sll = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(ETH_P_ALL),
+    };
+    int sock;
+
+    tb->fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+    if (tb->fd < 0) {
+        return false;
+    }
+    if (ioctl(tb->fd, TUNSETIFF, &ifr) < 0) {
+        close(tb->fd);
+        return false;
+    }
+    pstrcpy(tb->ifname, sizeof(tb->ifname), ifr.ifr_name);
+
+    /* Bring the interface up, writes fail with EIO otherwise */
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    g_assert(sock >= 0);
+    g_assert(ioctl(sock, SIOCGIFFLAGS, &ifr) == 0);
+    ifr.ifr_flags |= IFF_UP;
+    g_assert(ioctl(sock, SIOCSIFFLAGS, &ifr) == 0);
+    close(sock);
+
+    tb->pkt_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    g_assert(tb->pkt_fd >= 0);
+    sll.sll_ifindex = if_nametoindex(tb->ifname);
+    g_assert(bind(tb->pkt_fd, (struct sockaddr *)&sll, sizeof(sll)) == 0);
+
+    /* A broadcast frame with a local ethertype, nobody will answer */
+    memset(tb->frame, 0, sizeof(tb->frame));
+    memset(tb->frame, 0xff, ETH_ALEN);
+    tb->frame[ETH_ALEN + 5] = 0x02;
+    tb->frame[2 * ETH_ALEN] = 0x88;
+    tb->frame[2 * ETH_ALEN + 1] = 0xb5;
+    return true;
+}
+
+static void tap_bench_close(TapBench *tb)
+{
+    close(tb->pkt_fd);
+    close(tb->fd);
+}
+
+static void tap_bench_fill(TapBench *tb)
+{
+    for (int i = 0; i < BENCH_RX_BURST; i++) {
+        g_assert(send(tb->pkt_fd, tb->frame, sizeof(tb->frame), 0) ==
+                 sizeof(tb->frame));
+    }
+}
+
+static void report(const char *what, unsigned int batch, uint64_t packets,
+                   double secs)
+{
+    g_test_message("%s batch %3u: %10.0f packets/sec", what, batch,
+                   packets / secs);
+}
+
+static void test_tx(const void *opaque)
+{
+    unsigned int batch = GPOINTER_TO_UINT(opaque);
+    struct iovec iov;
+    TapUring *tu = NULL;
+    uint64_t packets = 0;
+    TapBench tb;
+
+    if (!tap_bench_open(&tb)) {
+        g_test_skip("cannot create a tap device");
+        return;
+    }
+    iov.iov_base = tb.frame;
+    iov.iov_len = sizeof(tb.frame);
+
+    if (batch > 1) {
+        tu = tap_uring_new(tb.fd, batch, BENCH_RX_BUF_SIZE, &error_abort);
+    }
+
+    g_test_timer_start();
+    do {
+        if (tu) {
+            for (unsigned int i = 0; i < batch; i++) {
+                g_assert(tap_uring_tx_queue(tu, &iov, 1));
+            }
+            g_assert(tap_uring_tx_flush(tu) == 0);
+            packets += batch;
+        } else {
+            g_assert(write(tb.fd, tb.frame, sizeof(tb.frame)) ==
+                     sizeof(tb.frame));
+            packets++;
+        }
+    } while (g_test_timer_elapsed() < 1.0);
+
+    report("tx", batch, packets, g_test_timer_last());
+    tap_uring_free(tu);
+    tap_bench_close(&tb);
+}
+
+static void test_rx(const void *opaque)
+{
+    unsigned int batch = GPOINTER_TO_UINT(opaque);
+    uint8_t buf[BENCH_RX_BUF_SIZE];
+    TapUring *tu = NULL;
+    uint64_t packets = 0;
+    double secs = 0;
+    TapBench tb;
+
+    if (!tap_bench_open(&tb)) {
+        g_test_skip("cannot create a tap device");
+        return;
+    }
+
+    if (batch > 1) {
+        tu = tap_uring_new(tb.fd, batch, BENCH_RX_BUF_SIZE, &error_abort);
+    }
+
+    /* Drop whatever the host sent while the interface came up */
+    while (read(tb.fd, buf, sizeof(buf)) > 0) {
+        /* nothing */
+    }
+
+    while (secs < 1.0) {
+        unsigned int left = BENCH_RX_BURST;
+
+        tap_bench_fill(&tb);
+
+        g_test_timer_start();
+        while (left) {
+            int n;
+
+            if (tu) {
+                n = tap_uring_read(tu, batch);
+            } else {
+                n = read(tb.fd, buf, sizeof(buf)) > 0;
+            }
+            g_assert(n >= 0);
+            /* Frames can be dropped by the host, do not spin forever */
+            if (n == 0) {
+                break;
+            }
+            left -= MIN(left, n);
+            packets += n;
+        }
+        secs += g_test_timer_elapsed();
+    }
+
+    report("rx", batch, packets, secs);
+    tap_uring_free(tu);
+    tap_bench_close(&tb);
+}
+
+int main(int argc, char **argv)
+{
+    static const unsigned int batches[] = { 1, 8, 32, 64 };
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (int i = 0; i < ARRAY_SIZE(batches); i++) {
+        g_autofree char *tx = g_strdup_printf("/net/tap/tx/batch-%u",
+                                              batches[i]);
+        g_autofree char *rx = g_strdup_printf("/net/tap/rx/batch-%u",
+                                              batches[i]);
+
+        g_test_add_data_func(tx, GUINT_TO_POINTER(batches[i]), test_tx);
+        g_test_add_data_func(rx, GUINT_TO_POINTER(batches[i]), test_rx);
+    }
+    return g_test_run();
+}
@@ -34,6 +34,9 @@ enum op {
     OP_FMA,
     OP_SQRT,
     OP_CMP,
+    OP_CVT,
+    OP_TO_INT,
+    OP_RINT,
     OP_MAX_NR,
 };
 
@@ -45,6 +48,9 @@ static const char * const op_names[] = {
     [OP_FMA] = "mulAdd",
     [OP_SQRT] = "sqrt",
     [OP_CMP] = "cmp",
+    [OP_CVT] = "cvt",
+    [OP_TO_INT] = "toint",
+    [OP_RINT] = "rint",
     [OP_MAX_NR] = NULL,
 };
 
@@ -191,8 +197,12 @@ static void update_random_ops(int n_ops, enum precision prec)
     }
 }
 
+/*
+ * With @small, replace the exponent so that operands lie within +-[1, 2^32),
+ * where conversions to narrower formats and to integers are valid.
+ */
 static void fill_random(union fp *ops, int n_ops, enum precision prec,
-                        bool no_neg)
+                        bool no_neg, bool small)
 {
     int i;
 
@@ -201,6 +211,11 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
         case PREC_SINGLE:
         case PREC_FLOAT32:
             ops[i].f32 = make_float32(random_ops[i]);
+            if (small) {
+                ops[i].f32 = make_float32(deposit32(float32_val(ops[i].f32),
+                                                    23, 8,
+                                                    0x7f + random_ops[i] % 32));
+            }
             if (no_neg && float32_is_neg(ops[i].f32)) {
                 ops[i].f32 = float32_chs(ops[i].f32);
             }
@@ -208,6 +223,11 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
         case PREC_DOUBLE:
         case PREC_FLOAT64:
             ops[i].f64 = make_float64(random_ops[i]);
+            if (small) {
+                ops[i].f64 = make_float64(deposit64(float64_val(ops[i].f64),
+                                                    52, 11,
+                                                    0x3ff + random_ops[i] % 32));
+            }
             if (no_neg && float64_is_neg(ops[i].f64)) {
                 ops[i].f64 = float64_chs(ops[i].f64);
             }
@@ -215,6 +235,10 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
         case PREC_QUAD:
         case PREC_FLOAT128:
             ops[i].f128 = random_quad_ops[i];
+            if (small) {
+                ops[i].f128.high = deposit64(ops[i].f128.high, 48, 15,
+                                             0x3fff + ops[i].f128.low % 32);
+            }
             if (no_neg && float128_is_neg(ops[i].f128)) {
                 ops[i].f128 = float128_chs(ops[i].f128);
             }
@@ -232,6 +256,7 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
 static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
 {
     int64_t tf = get_clock() + duration * 1000000000LL;
+    bool small = op == OP_CVT || op == OP_TO_INT || op == OP_RINT;
 
     while (get_clock() < tf) {
         union fp ops[MAX_OPERANDS];
@@ -241,7 +266,7 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
         update_random_ops(n_ops, prec);
         switch (prec) {
         case PREC_SINGLE:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, no_neg, small);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float a = ops[0].f;
@@ -270,13 +295,22 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_CVT:
+                    res.d = a;
+                    break;
+                case OP_TO_INT:
+                    res.u64 = llrintf(a);
+                    break;
+                case OP_RINT:
+                    res.f = rintf(a);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_DOUBLE:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, no_neg, small);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 double a = ops[0].d;
@@ -305,13 +339,22 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = isgreater(a, b);
                     break;
+                case OP_CVT:
+                    res.f = a;
+                    break;
+                case OP_TO_INT:
+                    res.u64 = llrint(a);
+                    break;
+                case OP_RINT:
+                    res.d = rint(a);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_FLOAT32:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, no_neg, small);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float32 a = ops[0].f32;
@@ -340,13 +383,22 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float32_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_CVT:
+                    res.f64 = float32_to_float64(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float32_to_int64(a, &soft_status);
+                    break;
+                case OP_RINT:
+                    res.f32 = float32_round_to_int(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_FLOAT64:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, no_neg, small);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float64 a = ops[0].f64;
@@ -375,13 +427,22 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float64_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_CVT:
+                    res.f32 = float64_to_float32(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float64_to_int64(a, &soft_status);
+                    break;
+                case OP_RINT:
+                    res.f64 = float64_round_to_int(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
             }
             break;
         case PREC_FLOAT128:
-            fill_random(ops, n_ops, prec, no_neg);
+            fill_random(ops, n_ops, prec, no_neg, small);
             t0 = get_clock();
             for (i = 0; i < OPS_PER_ITER; i++) {
                 float128 a = ops[0].f128;
@@ -410,6 +471,15 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 case OP_CMP:
                     res.u64 = float128_compare_quiet(a, b, &soft_status);
                     break;
+                case OP_CVT:
+                    res.f64 = float128_to_float64(a, &soft_status);
+                    break;
+                case OP_TO_INT:
+                    res.u64 = float128_to_int64(a, &soft_status);
+                    break;
+                case OP_RINT:
+                    res.f128 = float128_round_to_int(a, &soft_status);
+                    break;
                 default:
                     g_assert_not_reached();
                 }
@@ -448,6 +518,9 @@ GEN_BENCH_ALL_TYPES(mul, OP_MUL, 2)
 GEN_BENCH_ALL_TYPES(div, OP_DIV, 2)
 GEN_BENCH_ALL_TYPES(fma, OP_FMA, 3)
 GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
+GEN_BENCH_ALL_TYPES(cvt, OP_CVT, 1)
+GEN_BENCH_ALL_TYPES(toint, OP_TO_INT, 1)
+GEN_BENCH_ALL_TYPES(rint, OP_RINT, 1)
 #undef GEN_BENCH_ALL_TYPES
 
 #define GEN_BENCH_ALL_TYPES_NO_NEG(name, op, n)                         \
@@ -480,6 +553,9 @@ static const bench_func_t bench_funcs[OP_MAX_NR][PREC_MAX_NR] = {
     GEN_BENCH_FUNCS(fma, OP_FMA),
     GEN_BENCH_FUNCS(sqrt, OP_SQRT),
     GEN_BENCH_FUNCS(cmp, OP_CMP),
+    GEN_BENCH_FUNCS(cvt, OP_CVT),
+    GEN_BENCH_FUNCS(toint, OP_TO_INT),
+    GEN_BENCH_FUNCS(rint, OP_RINT),
 };
 
 #undef GEN_BENCH_FUNCS
@@ -21,6 +21,7 @@
 #include "chardev/char.h"
 #include "crypto/tlscredspsk.h"
 #include "qapi/qmp/qlist.h"
+#include "qapi/qmp/qnum.h"
 #include "ppc-util.h"
 
 #include "migration-helpers.h"
@@ -40,6 +41,7 @@
 unsigned start_address;
 unsigned end_address;
 static bool uffd_feature_thread_id;
+static bool uffd_feature_wp;
 static QTestMigrationState src_state;
 static QTestMigrationState dst_state;
 
@@ -112,6 +114,7 @@ static bool ufd_version_check(void)
         return false;
     }
     uffd_feature_thread_id = api_struct.features & UFFD_FEATURE_THREAD_ID;
+    uffd_feature_wp = api_struct.features & UFFD_FEATURE_PAGEFAULT_FLAG_WP;
 
     ioctl_mask = 1ULL << _UFFDIO_REGISTER |
                  1ULL << _UFFDIO_UNREGISTER;
@@ -1920,6 +1923,133 @@ static void test_precopy_unix_plain(void)
     test_precopy_common(&args);
 }
 
+/*
+ * Check that the switchover threshold follows the downtime limit, and
+ * that the cost measured at switchover is reported once done.
+ */
+static void test_precopy_unix_switchover_threshold(void)
+{
+    g_autofree char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
+    MigrateStart args = {};
+    QTestState *from, *to;
+    int64_t threshold, prev_threshold;
+    QDict *rsp_return, *cost;
+
+    if (test_migrate_start(&from, &to, uri, &args)) {
+        return;
+    }
+
+    migrate_ensure_non_converge(from);
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    migrate_qmp(from, to, uri, NULL, "{}");
+
+    wait_for_migration_pass(from);
+    prev_threshold = read_migrate_property_int(from, "switchover-threshold");
+    g_assert_cmpint(prev_threshold, >, 0);
+
+    /*
+     * A thousand times the downtime limit, still far from enough to
+     * converge at 3 MB/s.  Allow for the bandwidth estimate to move.
+     */
+    migrate_set_parameter_int(from, "downtime-limit", 1000);
+    do {
+        usleep(1000);
+        g_assert_false(src_state.stop_seen);
+        threshold = read_migrate_property_int(from, "switchover-threshold");
+    } while (threshold < prev_threshold * 100);
+
+    migrate_ensure_converge(from);
+
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+    wait_for_migration_complete(from);
+
+    rsp_return = migrate_query_not_failed(from);
+    g_assert_cmpint(qdict_get_int(rsp_return, "switchover-threshold"), >, 0);
+    g_assert(qdict_haskey(rsp_return, "predicted-downtime"));
+    cost = qdict_get_qdict(rsp_return, "switchover-cost");
+    g_assert(cost);
+    g_assert_cmpint(qdict_get_int(cost, "device-state-size"), >, 0);
+    qobject_unref(rsp_return);
+
+    test_migrate_end(from, to, true);
+}
+
+/*
+ * Check that the device state measured by a previous switchover of
+ * the source is taken off the switchover threshold of the next
+ * migration, from its first iteration on.
+ */
+static void test_precopy_unix_switchover_cost(void)
+{
+    g_autofree char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
+    MigrateStart args = {};
+    QTestState *from, *to;
+    int64_t threshold, limit = 2000, bw_per_ms = 1000;
+    uint64_t device_state_size;
+    QDict *rsp_return, *cost;
+
+    if (test_migrate_start(&from, &to, uri, &args)) {
+        return;
+    }
+
+    /* Wait for the first serial output from the source */
+    wait_for_serial("src_serial");
+
+    /* Measure a first switchover by saving the source away */
+    migrate_ensure_converge(from);
+    migrate_qmp(from, to, "exec:cat > /dev/null", NULL, "{}");
+    wait_for_migration_complete(from);
+
+    rsp_return = migrate_query_not_failed(from);
+    cost = qdict_get_qdict(rsp_return, "switchover-cost");
+    g_assert(cost);
+    device_state_size = qdict_get_int(cost, "device-state-size");
+    g_assert_cmpint(device_state_size, >, 0);
+    qobject_unref(rsp_return);
+
+    qtest_qmp_assert_success(from, "{ 'execute' : 'cont'}");
+    qtest_qmp_eventwait(from, "RESUME");
+    src_state.stop_seen = false;
+
+    /*
+     * Fix the switchover bandwidth so that the threshold does not
+     * depend on the bandwidth estimate: without any cost it would be
+     * exactly bw_per_ms * limit.
+     */
+    migrate_ensure_non_converge(from);
+    migrate_set_parameter_int(from, "downtime-limit", limit);
+    migrate_set_parameter_int(from, "avail-switchover-bandwidth",
+                              bw_per_ms * 1000);
+
+    migrate_qmp(from, to, uri, NULL, "{}");
+
+    wait_for_migration_pass(from);
+    rsp_return = migrate_query_not_failed(from);
+    threshold = qdict_get_int(rsp_return, "switchover-threshold");
+    g_assert(qdict_haskey(rsp_return, "switchover-cost"));
+    qobject_unref(rsp_return);
+
+    g_assert_cmpint(threshold, >=, bw_per_ms * limit / 2);
+    g_assert_cmpint(threshold, <=,
+                    bw_per_ms * limit - MIN(device_state_size,
+                                            bw_per_ms * limit / 2));
+
+    migrate_set_parameter_int(from, "avail-switchover-bandwidth", 0);
+    migrate_ensure_converge(from);
+
+    qtest_qmp_eventwait(to, "RESUME");
+
+    wait_for_serial("dest_serial");
+    wait_for_migration_complete(from);
+
+    test_migrate_end(from, to, true);
+}
+
 static void test_precopy_unix_suspend_live(void)
 {
     g_autofree char *uri = g_strdup_printf("unix:%s/migsocket", tmpfs);
@@ -2267,6 +2397,29 @@ static void test_multifd_file_mapped_ram(void)
     test_file_common(&args, true);
 }
 
+static void *
+migrate_multifd_mapped_ram_background_start(QTestState *from, QTestState *to)
+{
+    migrate_multifd_mapped_ram_start(from, to);
+
+    migrate_set_capability(from, "background-snapshot", true);
+
+    return NULL;
+}
+
+static void test_multifd_file_mapped_ram_background_snapshot(void)
+{
+    g_autofree char *uri = g_strdup_printf("file:%s/%s", tmpfs,
+                                           FILE_TEST_FILENAME);
+    MigrateCommon args = {
+        .connect_uri = uri,
+        .listen_uri = "defer",
+        .start_hook = migrate_multifd_mapped_ram_background_start,
+    };
+
+    test_file_common(&args, false);
+}
+
 static void *multifd_mapped_ram_dio_start(QTestState *from, QTestState *to)
 {
     migrate_multifd_mapped_ram_start(from, to);
@@ -2920,6 +3073,15 @@ test_migrate_precopy_tcp_multifd_zstd_start(QTestState *from,
 }
 #endif /* CONFIG_ZSTD */
 
+#ifdef CONFIG_LZ4
+static void *
+test_migrate_precopy_tcp_multifd_lz4_start(QTestState *from,
+                                           QTestState *to)
+{
+    return test_migrate_precopy_tcp_multifd_start_common(from, to, "lz4");
+}
+#endif /* CONFIG_LZ4 */
+
 #ifdef CONFIG_QATZIP
 static void *
 test_migrate_precopy_tcp_multifd_qatzip_start(QTestState *from,
@@ -2964,6 +3126,36 @@ static void test_multifd_tcp_uri_none(void)
     test_precopy_common(&args);
 }
 
+static void *
+test_migrate_precopy_tcp_multifd_start_affinity(QTestState *from,
+                                                QTestState *to)
+{
+    /*
+     * Pin every channel to host CPU 0, which always exists.  Failing to
+     * pin, e.g. in a restricted cpuset, is only a warning.
+     */
+    qtest_qmp_assert_success(from,
+                             "{ 'execute': 'migrate-set-parameters',"
+                             "'arguments': { 'multifd-channel-affinity':"
+                             "[ { 'host-cpus': [ 0 ] } ] } }");
+    qtest_qmp_assert_success(to,
+                             "{ 'execute': 'migrate-set-parameters',"
+                             "'arguments': { 'multifd-channel-affinity':"
+                             "[ { 'host-cpus': [ 0 ] } ] } }");
+    migrate_set_parameter_bool(from, "multifd-ramblock-binding", true);
+
+    return test_migrate_precopy_tcp_multifd_start_common(from, to, "none");
+}
+
+static void test_multifd_tcp_affinity(void)
+{
+    MigrateCommon args = {
+        .listen_uri = "defer",
+        .start_hook = test_migrate_precopy_tcp_multifd_start_affinity,
+    };
+    test_precopy_common(&args);
+}
+
 static void test_multifd_tcp_zero_page_legacy(void)
 {
     MigrateCommon args = {
@@ -3029,6 +3221,17 @@ static void test_multifd_tcp_zstd(void)
 }
 #endif
 
+#ifdef CONFIG_LZ4
+static void test_multifd_tcp_lz4(void)
+{
+    MigrateCommon args = {
+        .listen_uri = "defer",
+        .start_hook = test_migrate_precopy_tcp_multifd_lz4_start,
+    };
+    test_precopy_common(&args);
+}
+#endif
+
 #ifdef CONFIG_QATZIP
 static void test_multifd_tcp_qatzip(void)
 {
@@ -3552,6 +3755,52 @@ static void test_vcpu_dirty_limit(void)
     dirtylimit_stop_vm(vm);
 }
 
+static void test_dirty_rate_heatmap(void)
+{
+    QTestState *vm;
+    QDict *rsp_return, *block;
+    QList *blocks, *histogram;
+    const QListEntry *entry;
+    uint64_t ranges = 0;
+    int64_t size, range_size;
+    const char *heatmap;
+
+    vm = dirtylimit_start_vm();
+    wait_for_serial("vm_serial");
+
+    qtest_qmp_assert_success(vm,
+                             "{ 'execute': 'calc-dirty-rate',"
+                             "'arguments': { "
+                             "'calc-time': 1,"
+                             "'mode': 'dirty-ring',"
+                             "'heatmap': true }}");
+    wait_for_calc_dirtyrate_complete(vm, 1);
+
+    rsp_return = query_dirty_rate(vm);
+    blocks = qdict_get_qlist(rsp_return, "ramblock-dirty-rate");
+    g_assert(blocks && !qlist_empty(blocks));
+
+    /* RAMBlocks are sorted by size, so the guest RAM comes first */
+    block = qobject_to(QDict, qlist_entry_obj(qlist_first(blocks)));
+    g_assert(block);
+    g_assert_cmpint(qdict_get_int(block, "dirty-rate"), >, 0);
+
+    size = qdict_get_int(block, "size");
+    range_size = qdict_get_int(block, "range-size");
+    heatmap = qdict_get_str(block, "heatmap");
+    g_assert_cmpint(strlen(heatmap), ==, DIV_ROUND_UP(size, range_size));
+    g_assert(strspn(heatmap, "0") != strlen(heatmap));
+
+    histogram = qdict_get_qlist(block, "histogram");
+    QLIST_FOREACH_ENTRY(histogram, entry) {
+        ranges += qnum_get_uint(qobject_to(QNum, qlist_entry_obj(entry)));
+    }
+    g_assert_cmpint(ranges, ==, strlen(heatmap));
+
+    qobject_unref(rsp_return);
+    dirtylimit_stop_vm(vm);
+}
+
 static void migrate_dirty_limit_wait_showup(QTestState *from,
                                             const int64_t period,
                                             const int64_t value)
@@ -3811,6 +4060,10 @@ int main(int argc, char **argv)
 
     migration_test_add("/migration/precopy/unix/plain",
                        test_precopy_unix_plain);
+    migration_test_add("/migration/precopy/unix/switchover-threshold",
+                       test_precopy_unix_switchover_threshold);
+    migration_test_add("/migration/precopy/unix/switchover-cost",
+                       test_precopy_unix_switchover_cost);
     if (g_test_slow()) {
         migration_test_add("/migration/precopy/unix/xbzrle",
                            test_precopy_unix_xbzrle);
@@ -3843,6 +4096,11 @@ int main(int argc, char **argv)
                        test_multifd_file_mapped_ram);
     migration_test_add("/migration/multifd/file/mapped-ram/live",
                        test_multifd_file_mapped_ram_live);
+    if (has_uffd && uffd_feature_wp) {
+        migration_test_add("/migration/multifd/file/mapped-ram/"
+                           "background-snapshot",
+                           test_multifd_file_mapped_ram_background_snapshot);
+    }
 
     migration_test_add("/migration/multifd/file/mapped-ram/dio",
                        test_multifd_file_mapped_ram_dio);
@@ -3949,12 +4207,18 @@ int main(int argc, char **argv)
                        test_multifd_tcp_no_zero_page);
     migration_test_add("/migration/multifd/tcp/plain/cancel",
                        test_multifd_tcp_cancel);
+    migration_test_add("/migration/multifd/tcp/plain/affinity",
+                       test_multifd_tcp_affinity);
     migration_test_add("/migration/multifd/tcp/plain/zlib",
                        test_multifd_tcp_zlib);
 #ifdef CONFIG_ZSTD
     migration_test_add("/migration/multifd/tcp/plain/zstd",
                        test_multifd_tcp_zstd);
 #endif
+#ifdef CONFIG_LZ4
+    migration_test_add("/migration/multifd/tcp/plain/lz4",
+                       test_multifd_tcp_lz4);
+#endif
 #ifdef CONFIG_QATZIP
     migration_test_add("/migration/multifd/tcp/plain/qatzip",
                 test_multifd_tcp_qatzip);
@@ -3989,6 +4253,10 @@ int main(int argc, char **argv)
     if (g_str_equal(arch, "x86_64") && has_kvm && kvm_dirty_ring_supported()) {
         migration_test_add("/migration/dirty_ring",
                            test_precopy_unix_dirty_ring);
+        if (qtest_has_machine("pc")) {
+            migration_test_add("/migration/dirty_ring/heatmap",
+                               test_dirty_rate_heatmap);
+        }
         if (qtest_has_machine("pc") && g_test_slow()) {
             migration_test_add("/migration/vcpu_dirty_limit",
                                test_vcpu_dirty_limit);
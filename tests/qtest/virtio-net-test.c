@@ -261,6 +261,37 @@ static void announce_self(void *obj, void *data, QGuestAllocator *t_alloc)
     };
 }
 
+static void iothread_test(void *obj, void *data, QGuestAllocator *t_alloc)
+{
+    QVirtioNetPCI *dev = obj;
+    QDict *rsp;
+
+    send_recv_test(&dev->net, data, t_alloc);
+
+    /* Filters cannot be attached while the datapath runs in the IOThread */
+    rsp = qmp("{'execute': 'object-add', 'arguments': {"
+              " 'qom-type': 'filter-buffer', 'id': 'qtest-f1',"
+              " 'netdev': 'hs0', 'interval': 1000, 'status': 'off' } }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+}
+
+static void iothread_filter_fallback(void *obj, void *data,
+                                     QGuestAllocator *t_alloc)
+{
+    QVirtioNetPCI *dev = obj;
+    QDict *rsp;
+
+    /* With a filter attached the datapath stays in the main loop */
+    send_recv_test(&dev->net, data, t_alloc);
+
+    rsp = qmp("{'execute': 'object-add', 'arguments': {"
+              " 'qom-type': 'filter-buffer', 'id': 'qtest-f1',"
+              " 'netdev': 'hs0', 'interval': 1000, 'status': 'off' } }");
+    g_assert(!qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+}
+
 static void virtio_net_test_cleanup(void *sockets)
 {
     int *sv = sockets;
@@ -285,6 +316,21 @@ static void *virtio_net_test_setup(GString *cmd_line, void *arg)
     return sv;
 }
 
+static void *virtio_net_test_setup_iothread(GString *cmd_line, void *arg)
+{
+    g_string_append(cmd_line, " -object iothread,id=thread0 ");
+    return virtio_net_test_setup(cmd_line, arg);
+}
+
+static void *virtio_net_test_setup_filter(GString *cmd_line, void *arg)
+{
+    void *sv = virtio_net_test_setup_iothread(cmd_line, arg);
+
+    g_string_append(cmd_line, " -object filter-buffer,id=qtest-f0,"
+                    "netdev=hs0,interval=1000,status=off ");
+    return sv;
+}
+
 #endif /* _WIN32 */
 
 static void large_tx(void *obj, void *data, QGuestAllocator *t_alloc)
@@ -328,6 +374,16 @@ static void register_virtio_net_test(void)
     qos_add_test("basic", "virtio-net", send_recv_test, &opts);
     qos_add_test("rx_stop_cont", "virtio-net", stop_cont_test, &opts);
     qos_add_test("announce-self", "virtio-net", announce_self, &opts);
+
+    opts.before = virtio_net_test_setup_iothread;
+    opts.edge = (QOSGraphEdgeOptions) {
+        .extra_device_opts = "iothread=thread0",
+    };
+    qos_add_test("iothread/basic", "virtio-net-pci", iothread_test, &opts);
+    opts.before = virtio_net_test_setup_filter;
+    qos_add_test("iothread/filter-fallback", "virtio-net-pci",
+                 iothread_filter_fallback, &opts);
+    opts.edge = (QOSGraphEdgeOptions) { 0 };
 #endif
 
     /* These tests do not need a loopback backend.  */
@@ -61,6 +61,7 @@ static qemu_plugin_u64 mem_count;
 static qemu_plugin_u64 io_count;
 static bool do_inline, do_callback, do_print_accesses, do_region_summary;
 static bool do_haddr;
+static struct qemu_plugin_mem_batch *batch;
 static enum qemu_plugin_mem_rw rw = QEMU_PLUGIN_MEM_RW;
 
 
@@ -80,7 +81,12 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
 {
     g_autoptr(GString) out = g_string_new("");
 
-    if (do_inline || do_callback) {
+    if (batch) {
+        qemu_plugin_mem_batch_flush(batch);
+        qemu_plugin_mem_batch_free(batch);
+    }
+
+    if (do_inline || do_callback || batch) {
         g_string_printf(out, "mem accesses: %" PRIu64 "\n",
                         qemu_plugin_u64_sum(mem_count));
     }
@@ -253,6 +259,13 @@ static void vcpu_mem(unsigned int cpu_index, qemu_plugin_meminfo_t meminfo,
     }
 }
 
+static void vcpu_mem_batch(unsigned int cpu_index,
+                           const qemu_plugin_mem_record *recs, size_t n,
+                           void *udata)
+{
+    qemu_plugin_u64_add(mem_count, cpu_index, n);
+}
+
 static void print_access(unsigned int cpu_index, qemu_plugin_meminfo_t meminfo,
                          uint64_t vaddr, void *udata)
 {
@@ -305,6 +318,9 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
                 QEMU_PLUGIN_INLINE_ADD_U64,
                 mem_count, 1);
         }
+        if (batch) {
+            qemu_plugin_register_vcpu_mem_batch(insn, rw, batch);
+        }
         if (do_callback || do_region_summary) {
             qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem,
                                              QEMU_PLUGIN_CB_NO_REGS,
@@ -327,6 +343,7 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
                                            const qemu_info_t *info,
                                            int argc, char **argv)
 {
+    int batch_size = 0;
 
     for (int i = 0; i < argc; i++) {
         char *opt = argv[i];
@@ -358,6 +375,12 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
                 fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
                 return -1;
             }
+        } else if (g_strcmp0(tokens[0], "batch") == 0) {
+            batch_size = g_ascii_strtoll(tokens[1], NULL, 10);
+            if (batch_size <= 0) {
+                fprintf(stderr, "invalid batch size: %s\n", opt);
+                return -1;
+            }
         } else if (g_strcmp0(tokens[0], "print-accesses") == 0) {
             if (!qemu_plugin_bool_parse(tokens[0], tokens[1],
                                         &do_print_accesses)) {
@@ -376,9 +399,10 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
         }
     }
 
-    if (do_inline && do_callback) {
+    if (do_inline + do_callback + !!batch_size > 1) {
         fprintf(stderr,
-                "can't enable inline and callback counting at the same time\n");
+                "can't enable more than one of inline, callback and batch "
+                "counting at the same time\n");
         return -1;
     }
 
@@ -399,6 +423,9 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
     mem_count = qemu_plugin_scoreboard_u64_in_struct(
         counts, CPUCount, mem_count);
     io_count = qemu_plugin_scoreboard_u64_in_struct(counts, CPUCount, io_count);
+    if (batch_size) {
+        batch = qemu_plugin_mem_batch_new(batch_size, vcpu_mem_batch, NULL);
+    }
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
     return 0;
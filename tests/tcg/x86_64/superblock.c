@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Exercise superblocks formed by tiered translation: forward jumps,
+ * calls and conditional branches taken in both directions, with the
+ * flags live across them.  Run with -tier-threshold.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+
+static uint64_t step(uint64_t x, uint64_t i)
+{
+    uint64_t r;
+
+    asm("mov %1, %0\n\t"
+        "add %2, %0\n\t"
+        "jmp 1f\n\t"
+        "xor %0, %0\n"
+        "1:\n\t"
+        "jc 2f\n\t"             /* flags from the add, across the jmp */
+        "test $1, %2\n\t"
+        "jnz 3f\n\t"
+        "rol $7, %0\n\t"
+        "jmp 4f\n"
+        "2:\n\t"
+        "not %0\n\t"
+        "jmp 4f\n"
+        "3:\n\t"
+        "ror $3, %0\n"
+        "4:\n\t"
+        "cmp $100, %2\n\t"
+        "ja 5f\n\t"
+        "inc %0\n"
+        "5:"
+        : "=&r"(r) : "r"(x), "r"(i) : "cc");
+    return r;
+}
+
+static uint64_t step_ref(uint64_t x, uint64_t i)
+{
+    uint64_t r = x + i;
+
+    if (r < x) {
+        r = ~r;
+    } else if (i & 1) {
+        r = (r >> 3) | (r << 61);
+    } else {
+        r = (r << 7) | (r >> 57);
+    }
+    if (i <= 100) {
+        r++;
+    }
+    return r;
+}
+
+int main(void)
+{
+    uint64_t x = 0x0123456789abcdefull;
+    uint64_t y = x;
+    uint64_t i;
+
+    for (i = 0; i < 100000; i++) {
+        uint64_t k = i * 0x9e3779b97f4a7c15ull;
+
+        x = step(x, k % 200 == 0 ? UINT64_MAX - (x >> 1) : k % 200);
+        y = step_ref(y, k % 200 == 0 ? UINT64_MAX - (y >> 1) : k % 200);
+        assert(x == y);
+    }
+    return 0;
+}
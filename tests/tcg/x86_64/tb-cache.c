@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Guest for tb-cache.sh: run a little code, print the results.  The
+ * script patches the immediate in magic() to check that a cached
+ * translation of the old code is not used.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+static unsigned __attribute__((noinline)) magic(void)
+{
+    unsigned r;
+
+    asm volatile("mov $0x5eed1234, %0" : "=r"(r));
+    return r;
+}
+
+static uint64_t __attribute__((noinline)) mix(uint64_t x, uint64_t i)
+{
+    if (i & 1) {
+        x ^= x >> 31;
+    } else {
+        x += i * 0x9e3779b97f4a7c15ull;
+    }
+    return x * 0xbf58476d1ce4e5b9ull;
+}
+
+int main(void)
+{
+    uint64_t x = 1;
+    uint64_t i;
+
+    for (i = 0; i < 100000; i++) {
+        x = mix(x, i);
+    }
+    printf("magic %#x mix %#llx\n", magic(), (unsigned long long)x);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#!/usr/bin/env bash
+#
+# Check the persistent TB cache of linux-user: a second run loads TBs
+# from the cache and gives the same results, a cached translation is
+# not used once the guest binary changed, and corrupted cache files
+# are ignored.
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+set -euo pipefail
+
+die()
+{
+    echo "$@" 1>&2
+    exit 1
+}
+
+[ $# -eq 2 ] || die "usage: qemu_bin exe"
+
+qemu=$1
+exe=$2
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cache=$dir/cache
+
+expected=$($qemu "$exe") || die "running $exe failed"
+
+# Populate the cache, unless this host or build does not support it
+if ! $qemu -tb-cache "$cache" "$exe" > "$dir/out" 2> "$dir/err"; then
+    if grep -q "not supported\|above 4 GiB\|build ID" "$dir/err"; then
+        echo "SKIP: $(cat "$dir/err")"
+        exit 0
+    fi
+    die "populating the cache failed: $(cat "$dir/err")"
+fi
+[ "$(cat "$dir/out")" = "$expected" ] || die "wrong output populating the cache"
+[ -s "$cache" ] || die "the cache was not written"
+
+# Round trip: TBs are loaded from the cache and run to the same result
+$qemu -tb-cache "$cache" -d trace:tb_cache_hit -D "$dir/log" "$exe" \
+    > "$dir/out" || die "running from the cache failed"
+[ "$(cat "$dir/out")" = "$expected" ] || die "wrong output from the cache"
+grep -q tb_cache_hit "$dir/log" || die "no TB was loaded from the cache"
+
+# A modified guest binary must not run the old translation of magic()
+LC_ALL=C sed 's/\x34\x12\xed\x5e/\x35\x12\xed\x5e/' "$exe" > "$dir/patched"
+chmod +x "$dir/patched"
+[ "$(cmp -l "$exe" "$dir/patched" | wc -l)" -eq 1 ] ||
+    die "cannot patch the immediate of magic() in $exe"
+patched=$($qemu "$dir/patched") || die "running the patched binary failed"
+[ "$patched" != "$expected" ] || die "patching did not change the output"
+[ "$($qemu -tb-cache "$cache" "$dir/patched")" = "$patched" ] ||
+    die "a stale translation was used for the patched binary"
+
+# Corrupted files are ignored, and the guest still runs correctly
+size=$(stat -c %s "$cache")
+
+check_corrupted()
+{
+    local name=$1
+
+    $qemu -tb-cache "$dir/bad" "$exe" > "$dir/out" 2> "$dir/err" ||
+        die "$name: running with a corrupted cache failed"
+    [ "$(cat "$dir/out")" = "$expected" ] ||
+        die "$name: wrong output with a corrupted cache"
+}
+
+poke()
+{
+    printf "$2" | dd of="$dir/bad" bs=1 seek="$1" conv=notrunc 2> /dev/null
+}
+
+: > "$dir/bad"
+check_corrupted empty
+
+head -c "$size" /dev/urandom > "$dir/bad"
+check_corrupted garbage
+
+cp "$cache" "$dir/bad"
+truncate -s $((size / 2)) "$dir/bad"
+check_corrupted truncated
+grep -q corrupted "$dir/err" || die "truncated: no warning"
+
+# Header only: the checksum of the (missing) entries does not match
+cp "$cache" "$dir/bad"
+truncate -s 104 "$dir/bad"
+check_corrupted header-only
+grep -q corrupted "$dir/err" || die "header-only: no warning"
+
+# Flip bytes in the middle of the entries, e.g. in the host code
+cp "$cache" "$dir/bad"
+dd if=/dev/zero bs=1 count=16 2> /dev/null | tr '\0' '\377' |
+    dd of="$dir/bad" bs=1 seek=$((size / 2)) conv=notrunc 2> /dev/null
+check_corrupted flipped
+grep -q corrupted "$dir/err" || die "flipped: no warning"
+
+# More entries than the file holds (the header is not checksummed)
+cp "$cache" "$dir/bad"
+poke 88 '\377\377\377\377\377\377\377\177'
+check_corrupted nb_entries
+grep -q corrupted "$dir/err" || die "nb_entries: no warning"
+
+# Another version of the file format is stale, not corrupted
+cp "$cache" "$dir/bad"
+poke 8 '\377'
+check_corrupted version
@@ -179,9 +179,9 @@ void aio_set_fd_handler(AioContext *ctx,
     }
 }
 
-static void aio_set_fd_poll(AioContext *ctx, int fd,
-                            IOHandler *io_poll_begin,
-                            IOHandler *io_poll_end)
+void aio_set_fd_poll(AioContext *ctx, int fd,
+                     IOHandler *io_poll_begin,
+                     IOHandler *io_poll_end)
 {
     AioHandler *node = find_aio_handler(ctx, fd);
 